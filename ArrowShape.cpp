@@ -26,28 +26,24 @@ void ArrowShape::drawArrowHead(QPainter &painter, const QPointF &start, const QP
     painter.restore();
 }
 
-void ArrowShape::draw(QPainter &painter) {
+void ArrowShape::draw(QPainter &painter, bool draft) {
     painter.save();
 
-    painter.setPen(QPen(m_borderColor, m_penWidth, m_borderStyle));
-    painter.drawLine(m_start, m_end);
-    drawArrowHead(painter, m_start, m_end);
-
-    if (!m_text.isEmpty()) {
-        painter.save();
-        QPointF mid = (m_start + m_end) / 2;
-        QRectF rect(mid.x() - 40, mid.y() - 15, 80, 30);
-
-        painter.setPen(QPen(m_fontColor));
-        QFont font(m_font);
-        painter.setFont(font);
-        painter.drawText(rect, m_textAlignment, m_text);
-        painter.restore();
+    painter.setPen(QPen(m_borderColor, m_penWidth, penStyle(m_borderStyle, draft)));
+    if (m_routing == Straight) {
+        painter.drawLine(m_start, m_end);
+        drawArrowHead(painter, m_start, m_end);
+    } else {
+        const QVector<QPointF> points = pathPoints();
+        painter.drawPolyline(QPolygonF(points));
+        drawArrowHead(painter, points[points.size() - 2], points.last());   // 箭头沿最后一段的方向
     }
 
+    drawText(painter, draft);
+
     if (m_selected) {
         painter.save();
-        painter.setPen(QPen(Qt::blue, 1, Qt::DashLine));
+        painter.setPen(QPen(Qt::blue, 1, penStyle(Qt::DashLine, draft)));
         painter.setBrush(Qt::white);
 
         // 绘制控制点
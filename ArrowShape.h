@@ -7,7 +7,7 @@ class ArrowShape : public LineBaseShape {
 public:
     ArrowShape(const QPointF &start, const QPointF &end);
 
-    void draw(QPainter &painter) override;
+    void draw(QPainter &painter, bool draft) override;
 
     ShapeBase *clone() const override;
 
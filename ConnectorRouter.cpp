@@ -0,0 +1,339 @@
+﻿#include "ConnectorRouter.h"
+#include <QtMath>
+#include <algorithm>
+#include <limits>
+#include <queue>
+
+namespace {
+    // 方向：0向右，1向左，2向下，3向上；-1表示不限制
+    const int DX[4] = {1, -1, 0, 0};
+    const int DY[4] = {0, 0, 1, -1};
+
+    inline int opposite(int dir) {
+        return dir ^ 1;
+    }
+
+    // 端点从所绑定图形最近的一条边向外引出
+    int exitDirection(const ConnectorRouter::Endpoint &end) {
+        if (end.box.isNull()) {
+            return -1;
+        }
+        const QRectF &box = end.box;
+        const qreal distances[4] = {
+                qAbs(box.right() - end.point.x()),
+                qAbs(end.point.x() - box.left()),
+                qAbs(box.bottom() - end.point.y()),
+                qAbs(end.point.y() - box.top())
+        };
+        return static_cast<int>(std::min_element(distances, distances + 4) - distances);
+    }
+
+    QPointF stubPoint(const ConnectorRouter::Endpoint &end, int dir) {
+        if (dir < 0) {
+            return end.point;
+        }
+        return end.point + QPointF(DX[dir], DY[dir]) * ConnectorRouter::STUB;
+    }
+
+    // 去掉重复点和共线的中间点
+    QVector<QPointF> simplify(const QVector<QPointF> &points) {
+        QVector<QPointF> result;
+        result.reserve(points.size());
+        for (const QPointF &point: points) {
+            if (!result.isEmpty() && qFuzzyCompare(result.last().x(), point.x())
+                && qFuzzyCompare(result.last().y(), point.y())) {
+                continue;
+            }
+            if (result.size() >= 2) {
+                const QPointF &a = result[result.size() - 2];
+                const QPointF &b = result.last();
+                const qreal cross = (b.x() - a.x()) * (point.y() - b.y()) - (b.y() - a.y()) * (point.x() - b.x());
+                if (qAbs(cross) < 1e-6) {
+                    result.last() = point;
+                    continue;
+                }
+            }
+            result.append(point);
+        }
+        return result;
+    }
+
+    // 升序去重后的坐标
+    void uniqueSorted(std::vector<qreal> &values) {
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end(), [](qreal a, qreal b) {
+            return qAbs(a - b) < 1e-6;
+        }), values.end());
+    }
+
+    // 一条水平（或竖直）候选线上被障碍物内部占据的开区间，按左端（上端）排序，重叠的已合并
+    using Blocks = std::vector<std::pair<qreal, qreal>>;
+
+    // 障碍物内部与坐标c处的候选线相交的部分，vertical为true时c为x坐标
+    Blocks blocksOnLine(const std::vector<QRectF> &obstacles, qreal c, bool vertical) {
+        Blocks blocks;
+        for (const QRectF &box: obstacles) {
+            const qreal low = vertical ? box.left() : box.top();
+            const qreal high = vertical ? box.right() : box.bottom();
+            if (c > low + 1e-6 && c < high - 1e-6) {
+                blocks.emplace_back(vertical ? box.top() : box.left(), vertical ? box.bottom() : box.right());
+            }
+        }
+        std::sort(blocks.begin(), blocks.end());
+        size_t merged = 0;
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            if (merged > 0 && blocks[i].first < blocks[merged - 1].second - 1e-6) {
+                blocks[merged - 1].second = qMax(blocks[merged - 1].second, blocks[i].second);
+            } else {
+                blocks[merged++] = blocks[i];
+            }
+        }
+        blocks.resize(merged);
+        return blocks;
+    }
+
+    // 开区间(a, b)是否与某个被占据的区间相交；a == b时判断该点是否在障碍物内部
+    bool blocksOverlap(const Blocks &blocks, qreal a, qreal b) {
+        auto it = std::upper_bound(blocks.begin(), blocks.end(), a + 1e-6,
+                                   [](qreal v, const std::pair<qreal, qreal> &block) { return v < block.second; });
+        return it != blocks.end() && it->first < b - 1e-6;
+    }
+
+    // 搜索状态表：以（顶点，进入方向）编号为键的开放寻址哈希表，大小随访问过的状态数量增长
+    class VisitTable {
+    public:
+        struct Visit {
+            qint64 state;                                  // -1表示空位
+            qreal cost;
+            qint64 parent;
+        };
+
+        VisitTable() : m_slots(INITIAL_SIZE, Visit{-1, 0, -1}) {}
+
+        // 查找状态，不存在时插入一个代价为无穷大的记录
+        Visit &operator[](qint64 state) {
+            if ((m_count + 1) * 2 > m_slots.size()) {
+                grow();
+            }
+            Visit &slot = probe(m_slots, state);
+            if (slot.state < 0) {
+                slot = {state, std::numeric_limits<qreal>::max(), -1};
+                ++m_count;
+            }
+            return slot;
+        }
+
+    private:
+        static const size_t INITIAL_SIZE = 1024;           // 必须是2的幂
+
+        static Visit &probe(std::vector<Visit> &slots, qint64 state) {
+            const size_t mask = slots.size() - 1;
+            size_t i = static_cast<size_t>(static_cast<quint64>(state) * 0x9E3779B97F4A7C15ull >> 17) & mask;
+            while (slots[i].state >= 0 && slots[i].state != state) {
+                i = (i + 1) & mask;
+            }
+            return slots[i];
+        }
+
+        void grow() {
+            std::vector<Visit> slots(m_slots.size() * 2, Visit{-1, 0, -1});
+            for (const Visit &visit: m_slots) {
+                if (visit.state >= 0) probe(slots, visit.state) = visit;
+            }
+            m_slots.swap(slots);
+        }
+
+        std::vector<Visit> m_slots;
+        size_t m_count = 0;
+    };
+
+    // 在稀疏正交可见性图上搜索，成功时points为搜索起点到搜索终点经过的顶点。
+    // 候选线取自障碍物的边界和两个端点的坐标，顶点和边在搜索经过时才生成：
+    // 从一个顶点沿某个方向只连到同一候选线上相邻的下一个顶点，线段穿过障碍物内部时没有这条边。
+    // 搜索状态按（顶点，进入方向）存放在哈希表中，内存只与访问过的状态数量有关
+    bool search(const QPointF &from, int fromDir, const QPointF &to, int toDir,
+                const QRectF &region, const std::vector<QRectF> &obstacles, QVector<QPointF> &points) {
+        std::vector<qreal> xs = {region.left(), region.right(), from.x(), to.x()};
+        std::vector<qreal> ys = {region.top(), region.bottom(), from.y(), to.y()};
+        for (const QRectF &box: obstacles) {
+            if (box.left() > region.left()) xs.push_back(box.left());
+            if (box.right() < region.right()) xs.push_back(box.right());
+            if (box.top() > region.top()) ys.push_back(box.top());
+            if (box.bottom() < region.bottom()) ys.push_back(box.bottom());
+        }
+        uniqueSorted(xs);
+        uniqueSorted(ys);
+        const qint64 nx = static_cast<qint64>(xs.size());
+        const qint64 ny = static_cast<qint64>(ys.size());
+
+        // 每条候选线上的障碍物区间在第一次经过时计算
+        std::vector<Blocks> rows(static_cast<size_t>(ny)), columns(static_cast<size_t>(nx));
+        std::vector<bool> rowReady(static_cast<size_t>(ny), false), columnReady(static_cast<size_t>(nx), false);
+        auto rowBlocks = [&](qint64 iy) -> const Blocks & {
+            if (!rowReady[iy]) {
+                rows[iy] = blocksOnLine(obstacles, ys[iy], false);
+                rowReady[iy] = true;
+            }
+            return rows[iy];
+        };
+        auto columnBlocks = [&](qint64 ix) -> const Blocks & {
+            if (!columnReady[ix]) {
+                columns[ix] = blocksOnLine(obstacles, xs[ix], true);
+                columnReady[ix] = true;
+            }
+            return columns[ix];
+        };
+
+        auto indexOf = [](const std::vector<qreal> &values, qreal v) {
+            return static_cast<qint64>(std::lower_bound(values.begin(), values.end(), v - 1e-6) - values.begin());
+        };
+        const qint64 goalX = indexOf(xs, to.x());
+        const qint64 goalY = indexOf(ys, to.y());
+        const qint64 startNode = indexOf(ys, from.y()) * nx + indexOf(xs, from.x());
+        const qint64 goalNode = goalY * nx + goalX;
+        const int arriveDir = toDir < 0 ? -1 : opposite(toDir);
+
+        // 状态为（顶点，进入方向），代价为长度加拐弯惩罚。启发函数为曼哈顿距离，
+        // 横纵坐标都与搜索终点不同时至少还要拐一次弯
+        VisitTable visits;
+        using Entry = std::pair<qreal, qint64>;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+        auto heuristic = [&](qint64 node) {
+            const qint64 x = node % nx;
+            const qint64 y = node / nx;
+            return qAbs(xs[x] - xs[goalX]) + qAbs(ys[y] - ys[goalY])
+                   + (x != goalX && y != goalY ? ConnectorRouter::BEND_PENALTY : 0);
+        };
+        for (int dir = 0; dir < 4; ++dir) {
+            if (fromDir >= 0 && dir != fromDir) continue;
+            const qint64 state = startNode * 4 + dir;
+            visits[state].cost = 0;
+            open.emplace(heuristic(startNode), state);
+        }
+
+        qint64 bestState = -1;
+        qreal bestCost = std::numeric_limits<qreal>::max();
+        while (!open.empty()) {
+            const Entry top = open.top();
+            open.pop();
+            if (top.first >= bestCost) break;
+            const qint64 state = top.second;
+            const qint64 node = state / 4;
+            const int dir = static_cast<int>(state % 4);
+            const qreal g = visits[state].cost;
+            if (top.first > g + heuristic(node) + 1e-9) continue;     // 已有更优的记录
+
+            if (node == goalNode) {
+                const qreal total = g + (arriveDir >= 0 && dir != arriveDir ? ConnectorRouter::BEND_PENALTY : 0);
+                if (total < bestCost) {
+                    bestCost = total;
+                    bestState = state;
+                }
+                continue;
+            }
+
+            const qint64 x = node % nx;
+            const qint64 y = node / nx;
+            for (int next = 0; next < 4; ++next) {
+                if (next == opposite(dir)) continue;                // 不走回头路
+                const qint64 tx = x + DX[next];
+                const qint64 ty = y + DY[next];
+                if (tx < 0 || ty < 0 || tx >= nx || ty >= ny) continue;
+                const qint64 target = ty * nx + tx;
+
+                // 线段不能穿过障碍物内部，终点不能位于障碍物内部（搜索终点除外）
+                const bool horizontal = next < 2;
+                const Blocks &line = horizontal ? rowBlocks(y) : columnBlocks(x);
+                const qreal a = horizontal ? xs[x] : ys[y];
+                const qreal b = horizontal ? xs[tx] : ys[ty];
+                if (blocksOverlap(line, qMin(a, b), qMax(a, b))) continue;
+                if (target != goalNode) {
+                    const Blocks &cross = horizontal ? columnBlocks(tx) : rowBlocks(ty);
+                    const qreal c = horizontal ? ys[y] : xs[x];
+                    if (blocksOverlap(cross, c, c)) continue;
+                }
+
+                const qreal nextCost = g + qAbs(b - a) + (next != dir ? ConnectorRouter::BEND_PENALTY : 0);
+                const qint64 nextState = target * 4 + next;
+                VisitTable::Visit &visit = visits[nextState];
+                if (nextCost < visit.cost) {
+                    visit.cost = nextCost;
+                    visit.parent = state;
+                    open.emplace(nextCost + heuristic(target), nextState);
+                }
+            }
+        }
+        if (bestState < 0) {
+            return false;
+        }
+
+        points.clear();
+        for (qint64 state = bestState; state >= 0; state = visits[state].parent) {
+            const qint64 node = state / 4;
+            points.prepend(QPointF(xs[node % nx], ys[node / nx]));
+        }
+        return true;
+    }
+}
+
+QVector<QPointF> ConnectorRouter::route(const Endpoint &start, const Endpoint &end, const ObstacleQuery &query) {
+    const int startDir = exitDirection(start);
+    const int endDir = exitDirection(end);
+    const QPointF from = stubPoint(start, startDir);
+    const QPointF to = stubPoint(end, endDir);
+
+    QRectF core = QRectF(from, to).normalized();
+    if (!start.box.isNull()) core |= start.box;
+    if (!end.box.isNull()) core |= end.box;
+
+    std::vector<QRectF> obstacles;
+    qreal margin = REGION_MARGIN;
+    for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt, margin *= 2) {
+        const QRectF region = core.adjusted(-margin, -margin, margin, margin);
+        obstacles.clear();
+        if (query) {
+            query(region, obstacles);
+        }
+
+        // 障碍物外扩MARGIN；包含搜索起点或终点的障碍物（端点落在图形内部）不参与
+        size_t keep = 0;
+        for (const QRectF &obstacle: obstacles) {
+            const QRectF box = obstacle.adjusted(-MARGIN, -MARGIN, MARGIN, MARGIN);
+            const QRectF inner = box.adjusted(1e-6, 1e-6, -1e-6, -1e-6);
+            if (inner.contains(from) || inner.contains(to)) continue;
+            obstacles[keep++] = box;
+        }
+        obstacles.resize(keep);
+
+        QVector<QPointF> points;
+        if (search(from, startDir, to, endDir, region, obstacles, points)) {
+            points.prepend(start.point);
+            points.append(end.point);
+            return simplify(points);
+        }
+    }
+    return elbow(start, end);
+}
+
+QVector<QPointF> ConnectorRouter::elbow(const Endpoint &start, const Endpoint &end) {
+    const int startDir = exitDirection(start);
+    const int endDir = exitDirection(end);
+    const QPointF from = stubPoint(start, startDir);
+    const QPointF to = stubPoint(end, endDir);
+
+    // 从水平方向引出时先水平走到中线，否则先竖直走
+    const bool horizontal = startDir >= 0 ? startDir < 2
+                                          : endDir >= 0 ? endDir < 2
+                                                        : qAbs(to.x() - from.x()) >= qAbs(to.y() - from.y());
+    QVector<QPointF> points;
+    points << start.point << from;
+    if (horizontal) {
+        const qreal middle = (from.x() + to.x()) / 2;
+        points << QPointF(middle, from.y()) << QPointF(middle, to.y());
+    } else {
+        const qreal middle = (from.y() + to.y()) / 2;
+        points << QPointF(from.x(), middle) << QPointF(to.x(), middle);
+    }
+    points << to << end.point;
+    return simplify(points);
+}
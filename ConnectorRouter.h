@@ -0,0 +1,38 @@
+﻿#ifndef CONNECTORROUTER_H
+#define CONNECTORROUTER_H
+
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+#include <functional>
+#include <vector>
+
+// 正交连线路由：在障碍物（图形外接矩形）之间寻找只由水平和竖直线段组成的折线。
+// 候选坐标取障碍物外扩后的边界和两个端点所在的坐标，它们的交点构成稀疏的正交可见性图，
+// 在图上用A*搜索长度加拐弯惩罚最小的路径，顶点和边只在搜索经过时生成。
+// 只查询端点附近区域内的障碍物，找不到路径时扩大区域重试
+class ConnectorRouter {
+public:
+    // 连线端点：绑定到图形时从图形边界上最近的一侧垂直引出
+    struct Endpoint {
+        QPointF point;
+        QRectF box;                                    // 所绑定图形的外接矩形，为空表示自由端点
+    };
+
+    // 查询与区域相交的障碍物，追加到obstacles中
+    using ObstacleQuery = std::function<void(const QRectF &region, std::vector<QRectF> &obstacles)>;
+
+    // 返回从start到end的折线（包含两个端点），找不到时返回elbow的结果
+    static QVector<QPointF> route(const Endpoint &start, const Endpoint &end, const ObstacleQuery &query);
+
+    // 不考虑障碍物的正交折线，用于路由完成之前的临时显示
+    static QVector<QPointF> elbow(const Endpoint &start, const Endpoint &end);
+
+    static constexpr qreal MARGIN = 10.0;              // 连线与障碍物之间保持的距离
+    static constexpr qreal STUB = 20.0;                // 从图形引出的第一段的最短长度
+    static constexpr qreal BEND_PENALTY = 40.0;        // 每个拐弯折算的长度
+    static constexpr qreal REGION_MARGIN = 120.0;      // 搜索区域在端点外接矩形之外扩展的距离
+    static const int MAX_ATTEMPTS = 3;                 // 搜索区域每次扩大一倍，最多尝试的次数
+};
+
+#endif // CONNECTORROUTER_H
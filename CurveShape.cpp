@@ -0,0 +1,58 @@
+﻿#include "CurveShape.h"
+#include <QLineF>
+#include <QtMath>
+
+namespace {
+    // 第segment段的两个控制点：切线方向取前后两个锚点的连线，两端的锚点以自身代替缺少的邻点
+    void controlPoints(const QVector<QPointF> &anchors, int segment, QPointF &c1, QPointF &c2) {
+        const int last = anchors.size() - 1;
+        const QPointF &p0 = anchors[qMax(segment - 1, 0)];
+        const QPointF &p1 = anchors[segment];
+        const QPointF &p2 = anchors[segment + 1];
+        const QPointF &p3 = anchors[qMin(segment + 2, last)];
+        c1 = p1 + (p2 - p0) / 6.0;
+        c2 = p2 - (p3 - p1) / 6.0;
+    }
+}
+
+CurveShape::CurveShape(const QPointF &start, const QPointF &end, const QVector<QPointF> &waypoints)
+        : WaypointLineShape(start, end, waypoints) {}
+
+QVector<QPointF> CurveShape::bezierPoints(const QVector<QPointF> &anchors) {
+    QVector<QPointF> points;
+    if (anchors.isEmpty()) {
+        return points;
+    }
+    points.reserve(anchors.size() * 3 - 2);
+    points.append(anchors.first());
+    for (int i = 0; i + 1 < anchors.size(); ++i) {
+        QPointF c1, c2;
+        controlPoints(anchors, i, c1, c2);
+        points << c1 << c2 << anchors[i + 1];
+    }
+    return points;
+}
+
+void CurveShape::flattenSegment(const QVector<QPointF> &anchors, int segment, QVector<QPointF> &out) const {
+    const QPointF &p0 = anchors[segment];
+    const QPointF &p3 = anchors[segment + 1];
+    QPointF p1, p2;
+    controlPoints(anchors, segment, p1, p2);
+
+    // 控制多边形的长度是曲线长度的上界，按它确定细分数
+    const qreal length = QLineF(p0, p1).length() + QLineF(p1, p2).length() + QLineF(p2, p3).length();
+    const int steps = qBound(1, qCeil(length / FLATTEN_STEP), static_cast<int>(MAX_SEGMENT_STEPS));
+    for (int i = 1; i < steps; ++i) {
+        const qreal t = qreal(i) / steps;
+        const qreal u = 1 - t;
+        out.append(p0 * (u * u * u) + p1 * (3 * u * u * t) + p2 * (3 * u * t * t) + p3 * (t * t * t));
+    }
+    out.append(p3);
+}
+
+// 深拷贝
+ShapeBase *CurveShape::clone() const {
+    CurveShape *curve = new CurveShape(*this);
+    curve->setUuid(this->getUuid());     // 复制UUID
+    return curve;
+}
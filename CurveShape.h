@@ -0,0 +1,27 @@
+﻿#ifndef CURVESHAPE_H
+#define CURVESHAPE_H
+
+#include "WaypointLineShape.h"
+
+// 曲线连线：平滑地经过所有中间点，相邻锚点之间为一段三次贝塞尔曲线。
+// 控制点由相邻锚点按Catmull-Rom方式推出，用户只需编辑中间点
+class CurveShape : public WaypointLineShape {
+public:
+    CurveShape(const QPointF &start, const QPointF &end, const QVector<QPointF> &waypoints = QVector<QPointF>());
+
+    ShapeBase *clone() const override;
+
+    QString getShapeType() const override { return "Curve"; }
+
+    // 锚点对应的贝塞尔曲线点列：p0, c1, c2, p1, c1, c2, p2 ...（每段两个控制点），曲线位于该点列的凸包内
+    static QVector<QPointF> bezierPoints(const QVector<QPointF> &anchors);
+
+    static constexpr qreal FLATTEN_STEP = 6.0;          // 展平时每一小段的大致长度
+    static const int MAX_SEGMENT_STEPS = 64;            // 每段曲线最多展平的小段数
+
+protected:
+    void flattenSegment(const QVector<QPointF> &anchors, int segment, QVector<QPointF> &out) const override;
+
+};
+
+#endif // CURVESHAPE_H
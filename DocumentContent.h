@@ -0,0 +1,45 @@
+﻿#ifndef DOCUMENTCONTENT_H
+#define DOCUMENTCONTENT_H
+
+#include "ShapeBase.h"
+#include <QColor>
+#include <QSize>
+#include <vector>
+#include <functional>
+
+// 加载进度回调：参数为进度百分比（0-100），返回false表示用户取消加载
+using ProgressCallback = std::function<bool(int percent)>;
+
+// 脱离绘图区域的文档内容。后台加载时先解析到这里，成功后再整体交换到绘图区域，失败时不影响当前文档
+struct DocumentContent {
+    std::vector<ShapeBase *> shapes;                       // 图形数组（按图层顺序）
+    QColor backgroundColor = Qt::white;                    // 页面背景颜色
+    QSize pageSize;                                        // 页面大小，无效表示文件中没有记录
+
+    DocumentContent() = default;
+
+    DocumentContent(const DocumentContent &) = delete;               // 禁止拷贝构造
+
+    DocumentContent &operator=(const DocumentContent &) = delete;    // 禁止赋值构造
+
+    ~DocumentContent() {
+        for (auto shape: shapes) {
+            delete shape;
+        }
+        shapes.clear();
+    }
+
+    std::vector<ShapeBase *> takeShapes() {                // 转移图形的所有权
+        std::vector<ShapeBase *> result;
+        result.swap(shapes);
+        return result;
+    }
+};
+
+// 在工作线程中执行的加载任务
+using DocumentLoadTask = std::function<bool(DocumentContent &content, const ProgressCallback &progress)>;
+
+// 在工作线程中执行的保存任务，参数是保存开始时文档的快照
+using DocumentSaveTask = std::function<bool(const DocumentContent &snapshot)>;
+
+#endif // DOCUMENTCONTENT_H
@@ -1,12 +1,12 @@
 ﻿#include "DrawArea.h"
-#include "RectShape.h"
-#include "EllipseShape.h"
-#include "DiamondShape.h"
-#include "PentagonShape.h"
-#include "HexagonShape.h"
-#include "ArrowShape.h"
-#include "LineShape.h"
+#include "ShapeFactory.h"
+#include "NativeDocument.h"
+#include "SvgDocument.h"
+#include "HierarchicalLayout.h"
+#include "FrameProfiler.h"
+#include "Tracer.h"
 #include <QPainter>
+#include <QPainterPath>
 #include <QPaintEvent>
 #include <QMimeData>
 #include <QDropEvent>
@@ -14,6 +14,7 @@
 #include <QContextMenuEvent>
 #include <QKeyEvent>
 #include <QResizeEvent>
+#include <QScrollBar>
 #include <QWheelEvent>
 #include <QtMath>
 #include <QApplication>
@@ -21,23 +22,44 @@
 #include <QMessageBox>
 #include <QXmlStreamWriter>
 #include <QXmlStreamReader>
+#include <QProgressDialog>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QEventLoop>
+#include <QTimer>
+#include <QSaveFile>
+#include <QElapsedTimer>
+#include <QDialog>
+#include <QScreen>
+#include <QWindow>
+#include <QDialogButtonBox>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <QJsonDocument>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <limits>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <QDebug>
 #include <iostream>
 #include <memory>
 
 DrawArea::DrawArea(QWidget *parent)
-        : QWidget(parent), currentBackgroundColor(Qt::white), resizingHandle(-1), draggingLineHandle(-1) {
-    setMouseTracking(true);                                    // 启用鼠标跟踪功能
-    setAutoFillBackground(true);                               // 设置自动填充绘图区域背景
-    setAcceptDrops(true);                                      // 启用拖拽功能
+        : QAbstractScrollArea(parent), currentBackgroundColor(Qt::white), resizingHandle(-1), draggingLineHandle(-1) {
+    viewport()->setMouseTracking(true);                        // 启用鼠标跟踪功能（鼠标事件发给视口）
+    viewport()->setBackgroundRole(QPalette::Window);           // 页面以外的区域使用窗口背景色
+    viewport()->setAutoFillBackground(true);                   // 设置自动填充绘图区域背景
+    viewport()->setAcceptDrops(true);                          // 启用拖拽功能
     setFocusPolicy(Qt::StrongFocus);                            // 设置焦点策略为StrongFocus，使得组件具有键盘焦点
     setFocus();                                                // 设置焦点
-    setFixedSize(2000, 1800);                                  // 设置绘图区域固定大小
 
     m_pageSize = QSize(1050, 1500);                             // 初始化页面大小
 
-    textEdit = new MyTextEdit(this);                           // 创建自定义的多行文本编辑框
+    textEdit = new MyTextEdit(viewport());                     // 创建自定义的多行文本编辑框（随视口内容滚动）
     textEdit->setFont(QFont("Arial", 12));
     textEdit->hide();                                          // 隐藏多行文本编辑框
     // 绑定多行文本编辑框的编辑完成信号
@@ -45,13 +67,44 @@ DrawArea::DrawArea(QWidget *parent)
         if (editingShape) {
             editingShape->setText(textEdit->toPlainText());    // 将多行文本编辑框的内容赋给当前选中的图形
             textEdit->hide();
+            markShapeDirty(editingShape);
             editingShape = nullptr;                            // 重置编辑的图形指针
-            update();
+            commitEdit();
+            updateScene();
         }
     });
+
+    connect(&saveWatcher, &QFutureWatcher<bool>::finished, this, &DrawArea::onSaveFinished);
+    connect(&forceLayoutWatcher, &QFutureWatcher<bool>::finished, this, &DrawArea::onForceLayoutBatchFinished);
+
+    lazyLoadTimer.setInterval(0);                              // 事件循环空闲时继续构造图形
+    connect(&lazyLoadTimer, &QTimer::timeout, this, &DrawArea::streamLazyShapes);
+    routeTimer.setInterval(0);                                 // 事件循环空闲时继续计算连线路径
+    connect(&routeTimer, &QTimer::timeout, this, &DrawArea::routePendingConnectors);
+    moveTimer.setSingleShot(true);
+    refineTimer.setSingleShot(true);
+    sceneRectTimer.setSingleShot(true);
+    sceneRectTimer.setInterval(0);
+    connect(&sceneRectTimer, &QTimer::timeout, this, &DrawArea::updateSceneRect);
+    connect(&refineTimer, &QTimer::timeout, this, &DrawArea::refineDraft);
+    connect(&moveTimer, &QTimer::timeout, this, &DrawArea::flushPendingMove);
+    overviewTimer.setSingleShot(true);
+    connect(&overviewTimer, &QTimer::timeout, this, &DrawArea::refreshOverview);
+#ifdef FLOWCHART_PROFILER
+    profilerTimer.setInterval(FrameProfiler::REFRESH_INTERVAL_MS);
+    connect(&profilerTimer, &QTimer::timeout, this, [this]() {
+        updateScene(FrameProfiler::instance().refreshRect(scrollOffset()));   // 只重绘面板所在区域
+    });
+#endif
+
+    journal.start(QString(), shapes, currentBackgroundColor, m_pageSize);
+    updateSceneRect();
 }
 
 DrawArea::~DrawArea() {
+    saveWatcher.waitForFinished();                // 不能在写文件的过程中退出
+    forceLayoutWatcher.waitForFinished();         // 工作线程仍在使用预览中的布局
+    journal.discard();                            // 正常退出，不需要崩溃恢复
     for (auto shape: shapes) {
         delete shape;                             // 释放每个图形的内存，这里会调用图形各自的析构函数
     }
@@ -61,14 +114,17 @@ DrawArea::~DrawArea() {
 void DrawArea::setCurrentBackgroundColor(const QColor &color) {
     currentBackgroundColor = color;
     isModified = true;                           // 设置文档已被修改
-    update();
+    journal.commitDocument(currentBackgroundColor, m_pageSize);
+    updateScene();
 }
 
 void DrawArea::setPageSize(const QSize &size) {
     if (m_pageSize != size) {
         m_pageSize = size;
         isModified = true;
-        update();
+        journal.commitDocument(currentBackgroundColor, m_pageSize);
+        updateSceneRect();
+        updateScene();
         emit pageSizeChanged(size);
     }
 }
@@ -77,7 +133,7 @@ void DrawArea::setPageOrientation(bool isLandscape) {
     if (m_isLandscape != isLandscape) {
         m_isLandscape = isLandscape;
         isModified = true;
-        update();
+        updateScene();
         emit pageOrientationChanged(isLandscape);
     }
 }
@@ -89,7 +145,7 @@ QSize DrawArea::getPageSizeInPixels() const {
 void DrawArea::setGridVisible(bool visible) {
     if (m_gridVisible != visible) {
         m_gridVisible = visible;
-        update();
+        updateScene();
         emit gridVisibilityChanged(visible);
     }
 }
@@ -106,12 +162,12 @@ void DrawArea::drawGrid(QPainter &painter, const QRect &pageRect) {
         painter.setClipRect(pageRect);          // 设置剪裁区域为页面区域
         painter.setPen(QPen(Qt::gray, 1, Qt::SolidLine));
 
-        for (int y = 0; y < height(); y += 10) {
-            painter.drawLine(0, y, width(), y);
+        for (int y = pageRect.top(); y <= pageRect.bottom(); y += 10) {
+            painter.drawLine(pageRect.left(), y, pageRect.right(), y);
         }
 
-        for (int x = 0; x < width(); x += 10) {
-            painter.drawLine(x, 0, x, height());
+        for (int x = pageRect.left(); x <= pageRect.right(); x += 10) {
+            painter.drawLine(x, pageRect.top(), x, pageRect.bottom());
         }
         painter.restore();
     }
@@ -149,11 +205,197 @@ void DrawArea::clearSelection() {
 }
 
 void DrawArea::paintEvent(QPaintEvent *event) {
-    Q_UNUSED(event);                                 // 不使用event参数，避免编译器警告
+    TRACE_SCOPE("DrawArea::paintEvent", "paint");
+    PROFILE_FRAME_BEGIN();
+    const QPoint offset = scrollOffset();
+    const QRect exposed = event->rect().translated(offset);     // 暴露区域的场景坐标
+    if (lazyDocument) {
+        materializeLazyRegion(exposed);              // 即将绘制的区域优先构造
+    }
+
+    QPainter painter(viewport());
+    painter.translate(-offset);                      // 之后都按场景坐标绘制
+    painter.setRenderHint(QPainter::Antialiasing, !draftActive);   // 开启抗锯齿（草稿绘制时关闭）
+    if (draftActive) {
+        draftRegion += event->region().translated(offset);   // 交互停止后重绘
+    }
+
+    if (isRegionSelecting && !sceneCache.isNull()) {
+        // 区域选择期间场景不变，直接从缓存中拷贝暴露区域，只重绘覆盖层
+        qreal dpr = sceneCache.devicePixelRatio();
+        QRectF source(QPointF(exposed.topLeft() - sceneCacheOrigin) * dpr, QSizeF(exposed.size()) * dpr);
+        painter.drawPixmap(QRectF(exposed), sceneCache, source);
+    } else if (dragSprite) {
+        drawDragSprite(painter, exposed);
+    } else {
+        paintScene(painter, exposed, nullptr, draftActive);   // 只有视口的重绘使用草稿质量
+
+        // 绘制当前鼠标悬停所在图形的磁力点
+        drawMagneticPoints(painter);
+
+        // 绘制线吸附图形命中的磁力点
+        if (isMagneticActive) {
+            painter.save();
+            painter.setPen(QPen(Qt::red, 2));
+            painter.setBrush(Qt::red);
+            painter.drawEllipse(lastMagneticPoint, 6, 6);
+            painter.restore();
+        }
+    }
+
+    // 绘制区域选择覆盖层
+    drawRegionSelectionOverlay(painter);
+
+    const qint64 latency = hasPendingMove ? -1 : inputLatency.markFrame();   // 合并的移动尚未处理时，这一帧还没有反映输入
+    if (latency >= 0 && Tracer::isEnabled()) {
+        const qint64 end = Tracer::now();
+        Tracer::record("input latency", "latency", end - latency, end, QString());
+    }
+
+#ifdef FLOWCHART_PROFILER
+    PROFILE_UNDO_MEMORY(estimateUndoMemory());
+    PROFILE_FRAME_END(exposed);
+    FrameProfiler::instance().drawOverlay(painter, offset);   // 面板不计入本帧耗时
+#endif
+}
+
+namespace {
+    // 访问std::stack底层容器，用于遍历撤销栈
+    template<typename Stack>
+    const typename Stack::container_type &stackContainer(const Stack &stack) {
+        struct Access : Stack {
+            static const typename Stack::container_type &get(const Stack &s) { return s.*&Access::c; }
+        };
+        return Access::get(stack);
+    }
+}
+
+MemoryReport DrawArea::memoryReport() const {
+    MemoryReport report;
+    // 先统计当前文档，撤销状态中与文档共享的文本和点集不再重复计算
+    report.addShapes("document", shapes, true);
+    if (lazyDocument) {
+        report.addCount("document", "pending", lazyDocument->pendingCount());
+        report.addBytes("document", "reader", lazyDocument->indexBytes());
+        report.addBytes("document", "mapped file", lazyDocument->mappedBytes());
+    }
+
+    report.addCount("undo", "states", static_cast<qint64>(undoStack.size()));
+    for (const auto &state: stackContainer(undoStack)) {
+        report.addShapes("undo", state->shapes);
+    }
+    report.addCount("redo", "states", static_cast<qint64>(redoStack.size()));
+    for (const auto &state: stackContainer(redoStack)) {
+        report.addShapes("redo", state->shapes);
+    }
+
+    std::vector<ShapeBase *> clipboard;
+    for (const auto &shape: clipboardShapes) {
+        clipboard.push_back(shape.get());
+    }
+    report.addShapes("clipboard", clipboard);
+
+    std::vector<ShapeBase *> saved;
+    saved.reserve(saveClones.size());
+    for (const auto &entry: saveClones) {
+        saved.push_back(entry.second.get());
+    }
+    report.addShapes("save snapshot", saved);
+
+    report.addBytes("caches", "scene cache", sceneCache.isNull() ? 0
+            : static_cast<qint64>(sceneCache.width()) * sceneCache.height() * sceneCache.depth() / 8);
+    if (dragSprite) {
+        qint64 spriteBytes = 0;
+        for (const QPixmap *pixmap: {&dragSprite->background, &dragSprite->sprite}) {
+            spriteBytes += static_cast<qint64>(pixmap->width()) * pixmap->height() * pixmap->depth() / 8;
+        }
+        report.addBytes("caches", "drag sprite", spriteBytes);
+    }
+    report.addBytes("caches", "lasso mask", static_cast<qint64>(lassoMask.bytesPerLine()) * lassoMask.height());
+    report.addBytes("caches", "spatial index", static_cast<qint64>(spatialIndex.memoryUsage()));
+    report.addBytes("caches", "overview tiles", overview.memoryUsage());
+    report.addBytes("caches", "region preview", static_cast<qint64>(
+            regionPreview.bucket_count() * sizeof(void *)
+            + regionPreview.size() * (sizeof(std::pair<ShapeBase *const, QRectF>) + 2 * sizeof(void *))));
+    return report;
+}
+
+void DrawArea::showMemoryReport() {
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Memory Report"));
+    dialog.resize(520, 560);
+
+    auto text = new QPlainTextEdit(&dialog);
+    text->setReadOnly(true);
+    QFont font("Consolas");
+    font.setStyleHint(QFont::Monospace);
+    text->setFont(font);
+
+    auto buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+    QPushButton *refreshButton = buttons->addButton(tr("Refresh"), QDialogButtonBox::ActionRole);
+    QPushButton *exportButton = buttons->addButton(tr("Export JSON..."), QDialogButtonBox::ActionRole);
+
+    auto layout = new QVBoxLayout(&dialog);
+    layout->addWidget(text);
+    layout->addWidget(buttons);
+
+    auto refresh = [this, text]() {
+        text->setPlainText(memoryReport().toText());
+    };
+    connect(refreshButton, &QPushButton::clicked, &dialog, refresh);
+    connect(exportButton, &QPushButton::clicked, &dialog, [this, &dialog]() {
+        QString filePath = QFileDialog::getSaveFileName(&dialog, tr("Export Memory Report"), QString(), tr("JSON (*.json)"));
+        if (filePath.isEmpty()) return;
+        QSaveFile file(filePath);
+        if (!file.open(QIODevice::WriteOnly)
+            || file.write(QJsonDocument(memoryReport().toJson()).toJson()) < 0 || !file.commit()) {
+            QMessageBox::warning(&dialog, tr("Flowchart"), tr("The file could not be saved."));
+        }
+    });
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+    refresh();
+    dialog.exec();
+}
+
+#ifdef FLOWCHART_PROFILER
+namespace {
+    qint64 estimateStateMemory(const ShapeState &state) {
+        if (state.memoryBytes < 0) {
+            qint64 bytes = sizeof(ShapeState) + static_cast<qint64>(state.shapes.capacity() * sizeof(ShapeBase *));
+            for (const ShapeBase *shape: state.shapes) {
+                bytes += MemoryReport::shapeUsage(shape).total();
+            }
+            state.memoryBytes = bytes;                 // 撤销栈中的状态不会再改变，估算一次即可
+        }
+        return state.memoryBytes;
+    }
+}
+
+void DrawArea::setProfilerOverlayVisible(bool visible) {
+    FrameProfiler::instance().setOverlayVisible(visible);
+    if (visible) {
+        profilerTimer.start();
+    } else {
+        profilerTimer.stop();
+    }
+    updateScene();
+}
 
-    QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing);   // 开启抗锯齿
+qint64 DrawArea::estimateUndoMemory() const {
+    qint64 bytes = 0;
+    for (const auto &state: stackContainer(undoStack)) {
+        bytes += estimateStateMemory(*state);
+    }
+    for (const auto &state: stackContainer(redoStack)) {
+        bytes += estimateStateMemory(*state);
+    }
+    return bytes;
+}
+#endif
 
+void DrawArea::paintScene(QPainter &painter, const QRect &exposed, const std::unordered_set<const ShapeBase *> *excluded,
+                          bool draft) {
     QRect pageRect = QRect(50, 50, m_pageSize.width(), m_pageSize.height());   // 相对于绘图区域偏移(50, 50)绘制页面
     painter.save();
     painter.fillRect(pageRect, currentBackgroundColor);
@@ -164,35 +406,684 @@ void DrawArea::paintEvent(QPaintEvent *event) {
     // 绘制网格
     drawGrid(painter, pageRect);
 
-    painter.setClipRect(pageRect);
+    painter.save();
+    // 控制点、线宽和线段文本会超出外接矩形，判断可见性时适当放宽（页面以外的图形同样绘制）
+    QRectF visibleRect = QRectF(exposed).adjusted(-PAINT_MARGIN, -PAINT_MARGIN, PAINT_MARGIN, PAINT_MARGIN);
+    PROFILE_SHAPE_COUNT(shapes.size());
     for (auto shape: shapes) {
+        if (!shape->boundingRect().intersects(visibleRect)) continue;      // 跳过不在暴露区域内的图形
+        if (excluded && excluded->count(shape)) continue;
+        PROFILE_SHAPE_DRAWN();
+        TRACE_SCOPE_DETAIL("draw", "shape", shape->getShapeType());
         painter.save();
-        shape->draw(painter);      // 绘制图形
+        shape->draw(painter, draft);      // 绘制图形
         painter.restore();
     }
+    painter.restore();
+}
 
-    // 绘制当前鼠标悬停所在图形的磁力点
-    drawMagneticPoints(painter);
+QPoint DrawArea::scrollOffset() const {
+    return QPoint(horizontalScrollBar()->value(), verticalScrollBar()->value());
+}
 
-    // 绘制线吸附图形命中的磁力点
-    if (isMagneticActive) {
-        painter.save();
-        painter.setPen(QPen(Qt::red, 2));
-        painter.setBrush(Qt::red);
-        painter.drawEllipse(lastMagneticPoint, 6, 6);
-        painter.restore();
+void DrawArea::updateSceneRect() {
+    // 页面在场景中位于(50, 50)，场景范围至少包含页面及其四周的空白
+    QRect bounds = QRect(50, 50, m_pageSize.width(), m_pageSize.height())
+            .adjusted(-SCENE_MARGIN, -SCENE_MARGIN, SCENE_MARGIN, SCENE_MARGIN);
+    ensureSpatialIndex();
+    if (!spatialIndex.isEmpty()) {
+        bounds |= spatialIndex.extent().toAlignedRect().adjusted(-SCENE_MARGIN, -SCENE_MARGIN, SCENE_MARGIN, SCENE_MARGIN);
+    }
+    if (lazyDocument) {
+        bounds |= lazyDocument->bounds().toAlignedRect().adjusted(-SCENE_MARGIN, -SCENE_MARGIN, SCENE_MARGIN, SCENE_MARGIN);
+    }
+    if (bounds != m_sceneRect) {
+        m_sceneRect = bounds;
+        updateScrollBars();
+        emit viewChanged();
+    }
+}
+
+void DrawArea::updateScrollBars() {
+    const QSize view = viewport()->size();
+    horizontalScrollBar()->setRange(m_sceneRect.left(), qMax(m_sceneRect.left(), m_sceneRect.right() + 1 - view.width()));
+    horizontalScrollBar()->setPageStep(view.width());
+    horizontalScrollBar()->setSingleStep(SCROLL_STEP);
+    verticalScrollBar()->setRange(m_sceneRect.top(), qMax(m_sceneRect.top(), m_sceneRect.bottom() + 1 - view.height()));
+    verticalScrollBar()->setPageStep(view.height());
+    verticalScrollBar()->setSingleStep(SCROLL_STEP);
+}
+
+void DrawArea::centerOn(const QPointF &pos) {
+    const QPointF topLeft = pos - QPointF(viewport()->width(), viewport()->height()) / 2;
+    horizontalScrollBar()->setValue(qRound(topLeft.x()));
+    verticalScrollBar()->setValue(qRound(topLeft.y()));
+}
+
+void DrawArea::scrollContentsBy(int dx, int dy) {
+    finishDragSprite();                              // 拖动位图和区域选择缓存只覆盖原来的视口
+    if (isRegionSelecting) {
+        renderSceneCache();
+    }
+    noteInteraction();                               // 新露出的区域先以草稿质量绘制
+    viewport()->scroll(dx, dy);                      // 平移已绘制的像素（包括文本编辑框），只重绘新露出的区域
+    emit viewChanged();
+}
+
+void DrawArea::renderSceneCache() {
+    qreal dpr = devicePixelRatioF();
+    sceneCache = QPixmap(viewport()->size() * dpr);
+    sceneCache.setDevicePixelRatio(dpr);
+    sceneCache.fill(viewport()->palette().color(viewport()->backgroundRole()));
+    sceneCacheOrigin = scrollOffset();
+
+    QPainter painter(&sceneCache);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.translate(-sceneCacheOrigin);
+    paintScene(painter, visibleSceneRect());
+}
+
+void DrawArea::beginDragSprite(const std::vector<ShapeBase *> &moving) {
+    TRACE_SCOPE_DETAIL("DrawArea::beginDragSprite", "paint", QString::number(moving.size()));
+    std::unique_ptr<DragSprite> drag(new DragSprite);
+    drag->moving = moving;
+
+    // 被拖动的图形、两端都连在它们上面的线段随位图平移；只有一端相连的线段会被拉伸，拖动期间以预览线代替
+    std::unordered_set<const ShapeBase *> movingSet(moving.begin(), moving.end());
+    std::unordered_set<const ShapeBase *> excluded = movingSet;
+    std::vector<ShapeBase *> spriteShapes;                // 按图层顺序
+    QRectF spriteBounds;
+    for (ShapeBase *shape: shapes) {
+        bool inSprite = movingSet.count(shape) > 0;
+        if (!inSprite) {
+            auto line = dynamic_cast<LineBaseShape *>(shape);
+            if (!line) continue;
+            const bool startAttached = movingSet.count(line->getEndPointBinding(0).targetShape) > 0;
+            const bool endAttached = movingSet.count(line->getEndPointBinding(1).targetShape) > 0;
+            if (!startAttached && !endAttached) continue;
+            excluded.insert(line);
+            if (startAttached && endAttached) {
+                inSprite = true;
+            } else {
+                QLineF band = startAttached ? QLineF(line->getEnd(), line->getStart()) : QLineF(line->getStart(), line->getEnd());
+                drag->rubberBands.push_back(band);
+                drag->rubberBounds |= QRectF(band.p1(), band.p2()).normalized();
+            }
+        }
+        if (inSprite) {
+            spriteShapes.push_back(shape);
+            spriteBounds |= shape->boundingRect();
+        }
+    }
+
+    const qreal dpr = devicePixelRatioF();
+    const QRect visible = visibleSceneRect();
+    drag->background = QPixmap(visible.size() * dpr);
+    drag->background.setDevicePixelRatio(dpr);
+    drag->background.fill(viewport()->palette().color(viewport()->backgroundRole()));
+    drag->backgroundOrigin = visible.topLeft();
+    {
+        QPainter painter(&drag->background);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.translate(-drag->backgroundOrigin);
+        paintScene(painter, visible, &excluded);
+    }
+
+    // 控制点和线宽会超出外接矩形；视口以外的部分看不到，不需要渲染
+    const QRect spriteRect = spriteBounds.adjusted(-PAINT_MARGIN, -PAINT_MARGIN, PAINT_MARGIN, PAINT_MARGIN)
+            .toAlignedRect() & visible;
+    drag->origin = spriteRect.topLeft();
+    drag->sprite = QPixmap(spriteRect.size() * dpr);
+    drag->sprite.setDevicePixelRatio(dpr);
+    drag->sprite.fill(Qt::transparent);
+    {
+        QPainter painter(&drag->sprite);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.translate(-drag->origin);
+        for (ShapeBase *shape: spriteShapes) {
+            painter.save();
+            shape->draw(painter, false);
+            painter.restore();
+        }
+    }
+    dragSprite = std::move(drag);
+}
+
+void DrawArea::moveDragSprite(const QPointF &offset) {
+    const QSizeF spriteSize = QSizeF(dragSprite->sprite.size()) / dragSprite->sprite.devicePixelRatio();
+    auto covered = [this, &spriteSize]() {                 // 位图和预览线当前覆盖的区域
+        return QRectF(dragSprite->origin + dragSprite->offset, spriteSize)
+               | dragSprite->rubberBounds | dragSprite->rubberBounds.translated(dragSprite->offset);
+    };
+    QRectF dirty = covered();
+    dragSprite->offset += offset;
+    dirty |= covered();
+    updateScene(dirty.toAlignedRect().adjusted(-2, -2, 2, 2));
+}
+
+void DrawArea::drawDragSprite(QPainter &painter, const QRect &exposed) {
+    const qreal dpr = dragSprite->background.devicePixelRatio();
+    const QRectF source(QPointF(exposed.topLeft() - dragSprite->backgroundOrigin) * dpr, QSizeF(exposed.size()) * dpr);
+    painter.drawPixmap(QRectF(exposed), dragSprite->background, source);
+
+    painter.save();
+    painter.drawPixmap(dragSprite->origin + dragSprite->offset, dragSprite->sprite);
+    painter.setPen(QPen(Qt::gray, 1, Qt::DashLine));
+    for (const QLineF &band: dragSprite->rubberBands) {
+        painter.drawLine(band.p1(), band.p2() + dragSprite->offset);
+    }
+    painter.restore();
+}
+
+void DrawArea::finishDragSprite() {
+    if (!dragSprite) {
+        return;
+    }
+    std::unique_ptr<DragSprite> drag = std::move(dragSprite);
+    updateScene();
+    if (drag->offset.isNull()) {
+        return;
+    }
+    TRACE_SCOPE_DETAIL("DrawArea::finishDragSprite", "input", QString::number(drag->moving.size()));
+    QRectF changedArea;
+    for (ShapeBase *shape: drag->moving) {
+        changedArea |= shape->boundingRect();
+        shape->moveBy(drag->offset.x(), drag->offset.y());
+        changedArea |= shape->boundingRect();
+        markShapeDirty(shape);
+    }
+    updateAllLineBindings();
+    invalidateSpatialIndex();
+    rerouteConnectors(changedArea);
+}
+
+void DrawArea::setDraftRenderingEnabled(bool enabled) {
+    draftEnabled = enabled;
+    if (!enabled) {
+        refineDraft();
+    }
+}
+
+void DrawArea::noteInteraction() {
+    if (!draftEnabled || shapes.size() < static_cast<size_t>(draftShapeThreshold)) {
+        return;
+    }
+    draftActive = true;
+    refineTimer.start(draftIdleDelay);               // 每次交互都重新计时
+}
+
+void DrawArea::refineDraft() {
+    TRACE_SCOPE("DrawArea::refineDraft", "paint");
+    refineTimer.stop();
+    draftActive = false;
+    if (!draftRegion.isEmpty()) {
+        updateScene(draftRegion);
+        draftRegion = QRegion();
+    }
+}
+
+void DrawArea::ensureSpatialIndex() {
+    if (!spatialIndexDirty) return;
+    orthogonalLineCount = 0;                         // 图形集合和走线方式的改变都会使索引失效，重建时重新统计
+    for (auto shape: shapes) {
+        auto line = dynamic_cast<LineBaseShape *>(shape);
+        if (line && line->getRouting() == LineBaseShape::Orthogonal) {
+            ++orthogonalLineCount;
+        }
+    }
+    if (overviewEnabled && !overviewDirtyAll) {
+        spatialIndex.rebuild(shapes, &overviewDirty);   // 同时得到概览图需要重绘的区域
+        if (overviewDirty.size() > OVERVIEW_DIRTY_LIMIT) {
+            overviewDirty.clear();
+            overviewDirtyAll = true;
+        }
+    } else {
+        spatialIndex.rebuild(shapes);
+    }
+    spatialIndexDirty = false;
+}
+
+void DrawArea::setOverviewEnabled(bool enabled) {
+    if (overviewEnabled == enabled) return;
+    overviewEnabled = enabled;
+    overviewDirty.clear();
+    if (enabled) {
+        overviewDirtyAll = true;                     // 关闭期间没有记录变化
+        overviewTimer.start(0);
+    } else {
+        overviewTimer.stop();
+        overview.clear();
+    }
+}
+
+void DrawArea::updateSpatialIndex(ShapeBase *shape) {
+    if (spatialIndexDirty) return;                   // 之后会整体重建
+    QRectF before;
+    if (!spatialIndex.update(shape, shape->boundingRect(), &before)) {
+        invalidateSpatialIndex();
+        return;
+    }
+    markOverviewDirty(before);
+    markOverviewDirty(shape->boundingRect());
+}
+
+void DrawArea::markOverviewDirty(const QRectF &rect) {
+    if (!overviewEnabled) return;
+    if (!overviewDirtyAll) {
+        overviewDirty.push_back(rect.adjusted(-1, -1, 1, 1));
+        if (overviewDirty.size() > OVERVIEW_DIRTY_LIMIT) {
+            overviewDirty.clear();
+            overviewDirtyAll = true;
+        }
     }
+    scheduleOverviewUpdate();
+}
+
+void DrawArea::refreshOverview() {
+    if (isDragging || isResizing || draggingLine || dragSprite) {
+        overviewTimer.start(OVERVIEW_DELAY_MS);      // 连续编辑期间不更新，松开鼠标后再更新
+        return;
+    }
+    TRACE_SCOPE("DrawArea::refreshOverview", "paint");
+    updateSceneRect();                               // 同时重建空间索引，收集变化的区域
+    overview.setScene(m_sceneRect, QRectF(50, 50, m_pageSize.width(), m_pageSize.height()),
+                      currentBackgroundColor, viewport()->palette().color(viewport()->backgroundRole()));
+    if (overviewDirtyAll) {
+        overview.invalidateAll();
+    } else {
+        for (const QRectF &rect: overviewDirty) {
+            overview.invalidate(rect);
+        }
+    }
+    overviewDirty.clear();
+    overviewDirtyAll = false;
+    if (!overview.isDirty()) return;
+
+    const bool done = overview.update([this](const QRectF &rect) { return spatialIndex.query(rect); },
+                                      OVERVIEW_BUDGET_MS);
+    emit overviewChanged();
+    if (!done) {
+        overviewTimer.start(0);                      // 剩余的瓦片在事件循环空闲时继续绘制
+    }
+}
+
+void DrawArea::routeConnector(LineBaseShape *line) {
+    // 障碍物为区域内除连线以外的图形，通过空间索引查询，代价只与附近的图形数量有关
+    auto query = [this](const QRectF &region, std::vector<QRectF> &obstacles) {
+        for (ShapeBase *shape: spatialIndex.query(region)) {
+            if (!dynamic_cast<LineBaseShape *>(shape)) {
+                obstacles.push_back(shape->boundingRect());
+            }
+        }
+    };
+    line->setRoute(ConnectorRouter::route(line->routeEndpoint(0), line->routeEndpoint(1), query));
+    saveDirty.insert(line);                       // 路径不写入日志，但导出的SVG和PNG按路径绘制
+}
+
+void DrawArea::rerouteConnectors(const QRectF &area) {
+    if (area.isEmpty()) {
+        return;
+    }
+    ensureSpatialIndex();
+    if (orthogonalLineCount == 0) {                  // 大多数文档没有正交连线，不需要查询
+        return;
+    }
+    // 端点绑定在区域边界上的连线也要包含在内
+    const qreal margin = ConnectorRouter::MARGIN + ConnectorRouter::STUB;
+    for (ShapeBase *shape: spatialIndex.query(area.adjusted(-margin, -margin, margin, margin))) {
+        auto line = dynamic_cast<LineBaseShape *>(shape);
+        if (line && line->getRouting() == LineBaseShape::Orthogonal) {
+            pendingRoutes.insert(line);
+        }
+    }
+    routePendingConnectors();
+}
+
+void DrawArea::queueConnectorRoutes(bool all) {
+    for (auto shape: shapes) {
+        auto line = dynamic_cast<LineBaseShape *>(shape);
+        if (line && line->getRouting() == LineBaseShape::Orthogonal && (all || line->needsRoute())) {
+            pendingRoutes.insert(line);
+        }
+    }
+    if (!pendingRoutes.empty()) {
+        routeTimer.start();
+    }
+}
+
+void DrawArea::routePendingConnectors() {
+    if (pendingRoutes.empty()) {
+        routeTimer.stop();
+        return;
+    }
+    TRACE_SCOPE("DrawArea::routePendingConnectors", "layout");
+
+    // 计算路径只查询非连线图形，它们的外接矩形不会改变；连线的新外接矩形逐条更新到空间索引
+    ensureSpatialIndex();
+    QElapsedTimer budget;
+    budget.start();
+    auto it = pendingRoutes.begin();
+    while (it != pendingRoutes.end() && budget.elapsed() < ROUTE_BUDGET_MS) {
+        LineBaseShape *line = *it;
+        it = pendingRoutes.erase(it);
+        const QRectF before = line->boundingRect();
+        routeConnector(line);
+        if (line->boundingRect() != before) {
+            updateSpatialIndex(line);
+        }
+    }
+    updateScene();
+
+    if (pendingRoutes.empty()) {
+        routeTimer.stop();
+    } else if (!routeTimer.isActive()) {
+        routeTimer.start();
+    }
+}
+
+void DrawArea::setSelectedConnectorRouting(LineBaseShape::Routing routing) {
+    std::vector<LineBaseShape *> lines;
+    for (auto shape: collectSelectedShapes()) {
+        auto line = dynamic_cast<LineBaseShape *>(shape);
+        if (line && line->getRouting() != routing && !dynamic_cast<WaypointLineShape *>(line)) {   // 折线/曲线连线按中间点走线
+            lines.push_back(line);
+        }
+    }
+    if (lines.empty()) return;
+
+    saveToUndoStack();
+    ensureSpatialIndex();
+    for (auto line: lines) {
+        line->setRouting(routing);
+        pendingRoutes.erase(line);
+        if (routing == LineBaseShape::Orthogonal) {
+            routeConnector(line);                        // 用户直接操作的连线立即计算
+        }
+        markShapeDirty(line);
+    }
+    invalidateSpatialIndex();
+    isModified = true;
+    commitEdit();
+    updateScene();
+}
+
+namespace {
+    // a中不属于b的部分，最多拆成四个矩形
+    void subtractRect(const QRectF &a, const QRectF &b, std::vector<QRectF> &out) {
+        QRectF common = a.intersected(b);
+        if (common.isEmpty()) {
+            out.push_back(a);
+            return;
+        }
+        if (a.top() < common.top()) out.emplace_back(QPointF(a.left(), a.top()), QPointF(a.right(), common.top()));
+        if (common.bottom() < a.bottom()) out.emplace_back(QPointF(a.left(), common.bottom()), QPointF(a.right(), a.bottom()));
+        if (a.left() < common.left()) out.emplace_back(QPointF(a.left(), common.top()), QPointF(common.left(), common.bottom()));
+        if (common.right() < a.right()) out.emplace_back(QPointF(common.right(), common.top()), QPointF(a.right(), common.bottom()));
+    }
+
+    // 分离轴判定凸多边形（线段或三角形）与矩形是否相交：依次投影到两个坐标轴和各条边的法线上
+    bool convexIntersectsRect(const QPointF *points, int count, const QRectF &rect) {
+        const QPointF corners[4] = {rect.topLeft(), rect.topRight(), rect.bottomRight(), rect.bottomLeft()};
+        auto separated = [&](const QPointF &axis) {
+            qreal minA = std::numeric_limits<qreal>::max(), maxA = std::numeric_limits<qreal>::lowest();
+            for (int i = 0; i < count; ++i) {
+                qreal d = QPointF::dotProduct(points[i], axis);
+                minA = qMin(minA, d);
+                maxA = qMax(maxA, d);
+            }
+            qreal minB = std::numeric_limits<qreal>::max(), maxB = std::numeric_limits<qreal>::lowest();
+            for (const QPointF &corner: corners) {
+                qreal d = QPointF::dotProduct(corner, axis);
+                minB = qMin(minB, d);
+                maxB = qMax(maxB, d);
+            }
+            return maxA < minB || maxB < minA;
+        };
+        if (separated(QPointF(1, 0)) || separated(QPointF(0, 1))) return false;
+        for (int i = 0; i < count; ++i) {
+            QPointF edge = points[(i + 1) % count] - points[i];
+            if (separated(QPointF(-edge.y(), edge.x()))) return false;
+        }
+        return true;
+    }
+}
+
+void DrawArea::beginRegionSelection(const QPointF &pos) {
+    isRegionSelecting = true;
+    regionOrigin = pos;
+    marqueeRect = QRectF(pos, pos);
+    lassoPolygon.clear();
+    lassoPolygon << pos;
+    lassoMask = QImage();
+    regionPreview.clear();
+    regionPreviewBounds = QRectF();
+
+    ensureSpatialIndex();
+    renderSceneCache();                      // 选择期间只重绘覆盖层，场景从缓存拷贝
+    updateScene();
+}
+
+void DrawArea::updateRegionSelection(const QPointF &pos) {
+    QRectF oldBounds = regionOverlayBounds();
+    bool removed = false;
+
+    if (regionSelectTool == RegionSelectTool::Rectangle) {
+        // 只有新旧矩形之差覆盖到的图形可能改变选中状态
+        QRectF previous = marqueeRect;
+        marqueeRect = QRectF(regionOrigin, pos).normalized();
+        std::vector<QRectF> changed;
+        if (previous.isNull()) {
+            changed.push_back(marqueeRect);
+        } else {
+            subtractRect(previous, marqueeRect, changed);
+            subtractRect(marqueeRect, previous, changed);
+        }
+        for (const QRectF &strip: changed) {
+            removed |= refreshRegionPreview(strip.adjusted(-1, -1, 1, 1));
+        }
+    } else {
+        // 忽略过近的采样点，控制套索顶点数量
+        if (QLineF(lassoPolygon.last(), pos).length() < LASSO_SAMPLE_STEP) return;
+        lassoPolygon << pos;
+        if (lassoPolygon.size() >= 3) {
+            // 新增顶点只改变（起点，上一个顶点，新顶点）三角形内的区域
+            QPolygonF triangle;
+            triangle << lassoPolygon.first() << lassoPolygon[lassoPolygon.size() - 2] << pos;
+            extendLassoMask(triangle);
+            removed = refreshRegionPreview(triangle.boundingRect().adjusted(-1, -1, 1, 1), triangle);
+        }
+    }
+
+    if (removed) {
+        regionPreviewBounds = QRectF();
+        for (const auto &entry: regionPreview) {
+            regionPreviewBounds = regionPreviewBounds.united(entry.second);
+        }
+    }
+
+    // 只刷新新旧覆盖层覆盖的区域
+    QRectF dirty = oldBounds.united(regionOverlayBounds());
+    updateScene(dirty.toAlignedRect().adjusted(-2, -2, 2, 2));
+}
+
+void DrawArea::finishRegionSelection() {
+    if (!regionPreview.empty()) {
+        for (const auto &entry: regionPreview) {
+            entry.first->setSelected(true);
+        }
+        // 当前图形取预览中图层最高的一个
+        for (auto it = shapes.rbegin(); it != shapes.rend(); ++it) {
+            if (regionPreview.count(*it)) {
+                selectedShape = *it;
+                break;
+            }
+        }
+    }
+
+    isRegionSelecting = false;
+    sceneCache = QPixmap();                  // 释放缓存
+    lassoMask = QImage();
+    lassoPolygon.clear();
+    regionPreview.clear();
+    regionPreviewBounds = QRectF();
+}
+
+bool DrawArea::refreshRegionPreview(const QRectF &area, const QPolygonF &triangle) {
+    bool removed = false;
+    // 通过空间索引只取外接矩形与变化区域相交的候选图形，其余图形的判定结果不变
+    for (ShapeBase *shape: spatialIndex.query(area)) {
+        QRectF bounds = shape->boundingRect();
+        if (!triangle.isEmpty() && !convexIntersectsRect(triangle.constData(), 3, bounds.adjusted(-1, -1, 1, 1))) continue;
+
+        bool hit = regionHit(shape, bounds);
+        auto it = regionPreview.find(shape);
+        if (hit && it == regionPreview.end()) {
+            regionPreview.emplace(shape, bounds);
+            regionPreviewBounds = regionPreviewBounds.united(bounds);
+        } else if (!hit && it != regionPreview.end()) {
+            regionPreview.erase(it);
+            removed = true;
+        }
+    }
+    return removed;
+}
+
+bool DrawArea::regionHit(ShapeBase *shape, const QRectF &bounds) const {
+    bool requireAll = (regionSelectMode == RegionSelectMode::Contains);
+    bool isRect = (regionSelectTool == RegionSelectTool::Rectangle);
+    QRectF area = isRect ? marqueeRect : lassoPolygon.boundingRect();
+
+    // 先比较外接矩形，完全分离时不必取轮廓
+    if (!area.adjusted(-1, -1, 1, 1).intersects(bounds.adjusted(-1, -1, 1, 1))) return false;
+
+    if (isRect) {
+        if (marqueeRect.contains(bounds)) return true;
+        // 外接矩形可能宽或高为0（水平/垂直线段），因此逐点判断包含关系
+        QPolygonF outline = shape->outline();
+        bool inside = true;
+        for (const QPointF &pt: outline) {
+            if (!marqueeRect.contains(pt)) {
+                inside = false;
+                break;
+            }
+        }
+        if (inside) return true;
+        if (requireAll) return false;
+        for (int i = 0, n = outline.size(); i < n; ++i) {
+            const QPointF segment[2] = {outline[i], outline[(i + 1) % n]};
+            if (convexIntersectsRect(segment, 2, marqueeRect)) return true;
+        }
+        return outline.containsPoint(marqueeRect.center(), Qt::OddEvenFill);   // 选择框完全位于图形内部
+    }
+
+    if (lassoPolygon.size() < 3 || lassoMask.isNull()) return false;
+    if (lassoCovers(shape->outline(), requireAll)) return true;
+    return !requireAll && shape->containPoint(lassoPolygon.first());   // 套索完全位于图形内部
+}
+
+void DrawArea::extendLassoMask(const QPolygonF &triangle) {
+    // 偶奇规则下套索每增加一个顶点，填充区域就与新增的三角形做一次异或，因此掩码可以持续复用
+    QRect needed = triangle.boundingRect().toAlignedRect().adjusted(-1, -1, 1, 1);
+    QRect maskRect(lassoMaskOrigin, lassoMask.size());
+    if (lassoMask.isNull() || !maskRect.contains(needed)) {
+        // 掩码放不下时留出余量重新分配，避免每个采样点都扩大一次
+        QRect grown = (lassoMask.isNull() ? needed : maskRect.united(needed))
+                .adjusted(-LASSO_MASK_PADDING, -LASSO_MASK_PADDING, LASSO_MASK_PADDING, LASSO_MASK_PADDING);
+        QImage mask(grown.size(), QImage::Format_ARGB32_Premultiplied);
+        mask.fill(Qt::transparent);
+        if (!lassoMask.isNull()) {
+            QPainter copy(&mask);
+            copy.setCompositionMode(QPainter::CompositionMode_Source);
+            copy.drawImage(lassoMaskOrigin - grown.topLeft(), lassoMask);
+        }
+        lassoMask = mask;
+        lassoMaskOrigin = grown.topLeft();
+    }
+
+    QPainter painter(&lassoMask);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(Qt::black);
+    painter.setCompositionMode(QPainter::CompositionMode_Xor);
+    painter.translate(-lassoMaskOrigin);
+    painter.drawPolygon(triangle);
+}
+
+bool DrawArea::lassoMaskHit(const QPointF &point) const {
+    int x = qFloor(point.x()) - lassoMaskOrigin.x();
+    int y = qFloor(point.y()) - lassoMaskOrigin.y();
+    if (x < 0 || y < 0 || x >= lassoMask.width() || y >= lassoMask.height()) return false;
+    return reinterpret_cast<const QRgb *>(lassoMask.constScanLine(y))[x] != 0;
+}
+
+bool DrawArea::lassoCovers(const QPolygonF &outline, bool requireAll) const {
+    const int n = outline.size();
+    if (n == 0) return false;
+
+    // 沿图形轮廓按固定步长采样，每个采样点只需一次掩码查询
+    for (int i = 0; i < n; ++i) {
+        QPointF a = outline[i];
+        QPointF b = outline[(i + 1) % n];
+        int steps = qMax(1, qCeil(QLineF(a, b).length() / LASSO_SAMPLE_STEP));
+        for (int k = 0; k < steps; ++k) {
+            bool hit = lassoMaskHit(a + (b - a) * (qreal(k) / steps));
+            if (requireAll && !hit) return false;
+            if (!requireAll && hit) return true;
+        }
+    }
+    return requireAll;
+}
+
+QRectF DrawArea::regionOverlayBounds() const {
+    QRectF bounds = (regionSelectTool == RegionSelectTool::Rectangle) ? marqueeRect : lassoPolygon.boundingRect();
+    return bounds.united(regionPreviewBounds);
+}
+
+void DrawArea::drawRegionSelectionOverlay(QPainter &painter) {
+    if (!isRegionSelecting) return;
+
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    QColor accent(0, 120, 215);
+
+    // 预览即将被选中的图形
+    if (!regionPreview.empty()) {
+        std::vector<QRectF> rects;
+        rects.reserve(regionPreview.size());
+        for (const auto &entry: regionPreview) {
+            rects.push_back(entry.second);
+        }
+        painter.setPen(QPen(accent, 1));
+        painter.setBrush(Qt::NoBrush);
+        painter.drawRects(rects.data(), static_cast<int>(rects.size()));
+    }
+
+    // 包含模式使用实线，相交模式使用虚线
+    painter.setPen(QPen(accent, 1, regionSelectMode == RegionSelectMode::Contains ? Qt::SolidLine : Qt::DashLine));
+    painter.setBrush(QColor(accent.red(), accent.green(), accent.blue(), 40));
+    if (regionSelectTool == RegionSelectTool::Rectangle) {
+        painter.drawRect(marqueeRect);
+    } else {
+        painter.drawPolygon(lassoPolygon);
+    }
+    painter.restore();
 }
 
 void DrawArea::mousePressEvent(QMouseEvent *event) {
+    flushPendingMove();
+    TRACE_SCOPE("DrawArea::mousePressEvent", "input");
+    PROFILE_INPUT();
+    PROFILE_SCOPE(MouseEvent);
+    inputLatency.markInput(event->timestamp());
     setFocus();                 // 设置控件按压为焦点
-    QPointF pos = event->pos();
+    QPointF pos = mapToScene(event->pos());
     isDragging = false;
     isResizing = false;
     resizingHandle = -1;
     isClicked = true;           // 默认是单击状态
 
-    saveToUndoStack();          // 保存按压之前的状态到撤销栈
+    // 单击、框选不修改图形，等到第一次真正移动或缩放时再保存撤销状态，
+    // 避免每次点击都构造按需读取的剩余图形或接受正在预览的布局
+    undoSnapshotPending = true;
 
     // 判断图形是否多选
     int selectedCount = 0;
@@ -207,6 +1098,7 @@ void DrawArea::mousePressEvent(QMouseEvent *event) {
         bool ctrlOrShift = (event->modifiers() & Qt::ControlModifier) || (event->modifiers() & Qt::ShiftModifier);
         bool clickedOnSelected = false;      // 记录是否点击到图形
 
+        PROFILE_SCOPE(HitTest);              // 计时到左键处理结束
         // 从后往前遍历，后添加的图形越在上层
         for (auto it = shapes.rbegin(); it != shapes.rend(); ++it) {
             ShapeBase *shape = *it;
@@ -216,15 +1108,16 @@ void DrawArea::mousePressEvent(QMouseEvent *event) {
             if (shape->isSelected()) {
                 int handle = shape->hitHandle(pos);      // 获取选中图形的控制点
                 if (handle >= 0) {
-                    if (dynamic_cast<LineBaseShape *>(shape)) {              // 判断是否为线段类型
-                        draggingLine = static_cast<LineBaseShape *>(shape);
-                        draggingLineHandle = (handle == 0 ? 0 : 1);          // 判断控制点是起点还是终点，并设置为拖动控制点
+                    auto line = dynamic_cast<LineBaseShape *>(shape);       // 判断是否为线段类型
+                    if (line && line->endPointOfHandle(handle) >= 0) {      // 中间点按缩放处理，不参与吸附
+                        draggingLine = line;
+                        draggingLineHandle = line->endPointOfHandle(handle); // 判断控制点是起点还是终点，并设置为拖动控制点
                     }
                     selectedShape = shape;              // 设置选中的图形为当前图形
                     isResizing = true;
                     resizingHandle = handle;
                     lastMousePos = pos;
-                    update();
+                    updateScene();
                     emitSelectionChanged();
                     return;
                 }
@@ -251,20 +1144,23 @@ void DrawArea::mousePressEvent(QMouseEvent *event) {
                 isDragging = true;
                 lastMousePos = pos;
                 hoveredShape = nullptr;      // 取消图形悬停状态
-                update();
+                updateScene();
                 emitSelectionChanged();
                 return;
             }
         }
 
-        // 点中空白区域，取消所有选中状态
+        // 点中空白区域，取消所有选中状态（按住Ctrl或Shift时保留），并开始区域选择
         if (!clickedOnSelected) {
-            clearSelection();
+            if (!ctrlOrShift) {
+                clearSelection();
+            }
             hoveredShape = nullptr;
-            update();
+            beginRegionSelection(pos);
             emitSelectionChanged();
         }
     } else if (event->button() == Qt::RightButton) {        // 处理右键按压
+        PROFILE_SCOPE(HitTest);
         for (auto it = shapes.rbegin(); it != shapes.rend(); ++it) {
             ShapeBase *shape = *it;
             if (!shape) continue;
@@ -275,22 +1171,75 @@ void DrawArea::mousePressEvent(QMouseEvent *event) {
                 clearSelection();
                 selectedShape = shape;
                 shape->setSelected(true);
-                update();
+                updateScene();
                 emitSelectionChanged();
                 return;
             }
         }
 
         clearSelection();
-        update();
+        updateScene();
         emitSelectionChanged();
     }
 }
 
 void DrawArea::mouseMoveEvent(QMouseEvent *event) {
+    PROFILE_INPUT();
+    if (!hasPendingMove) {
+        pendingMoveTimestamp = event->timestamp();
+    }
+    pendingMovePos = mapToScene(event->pos());
+    hasPendingMove = true;
+    if (!moveCoalescing) {
+        flushPendingMove();
+    } else if (!moveTimer.isActive()) {
+        // 距离上次处理已超过一个刷新间隔时，等队列中已有的移动事件取完后立即处理
+        const qint64 wait = lastMoveFrame.isValid() ? frameIntervalMs() - lastMoveFrame.elapsed() : 0;
+        moveTimer.start(static_cast<int>(qMax<qint64>(0, wait)));
+    }
+}
+
+void DrawArea::setMoveCoalescingEnabled(bool enabled) {
+    moveCoalescing = enabled;
+    if (!enabled) {
+        flushPendingMove();
+    }
+}
+
+void DrawArea::flushPendingMove() {
+    if (!hasPendingMove) {
+        return;
+    }
+    moveTimer.stop();
+    hasPendingMove = false;
+    lastMoveFrame.start();
+    sceneUpdateRequested = false;
+    processMouseMove(pendingMovePos);
+    if (sceneUpdateRequested) {
+        // 只有引起重绘的移动才计入延迟，悬停图形不变等没有重绘的移动会让之后无关的一帧记录很长的延迟
+        inputLatency.markInput(pendingMoveTimestamp);
+    }
+}
+
+int DrawArea::frameIntervalMs() const {
+    const QWindow *handle = window()->windowHandle();
+    const QScreen *screen = handle ? handle->screen() : QGuiApplication::primaryScreen();
+    const qreal rate = screen ? screen->refreshRate() : 0;
+    return rate >= 1 ? qMax(1, qRound(1000.0 / rate)) : 16;
+}
+
+void DrawArea::processMouseMove(const QPointF &pos) {
+    TRACE_SCOPE("DrawArea::mouseMoveEvent", "input");
+    PROFILE_SCOPE(MouseEvent);
+    // 第一次真正修改图形之前保存按下鼠标时的状态（拖动线段端点时isResizing同样为true）
+    if ((isResizing || isDragging) && undoSnapshotPending && pos != lastMousePos) {
+        undoSnapshotPending = false;
+        saveToUndoStack();
+    }
+
     // 如果是正在拖动的线段
     if (draggingLine) {
-        QPointF mousePos = event->pos();
+        const QPointF &mousePos = pos;
         QPointF nearestPt;                                      // 最接近的点
         ShapeBase *nearestShape = nullptr;                      // 最接近的图形
         int nearestIndex = -1;                                  // 最接近的图形磁力点索引
@@ -320,23 +1269,38 @@ void DrawArea::mouseMoveEvent(QMouseEvent *event) {
             draggingLine->clearEndPointBinding(draggingLineHandle);
             isMagneticActive = false;        // 设置磁吸状态为未吸附状态
         }
-        update();
+        markShapeDirty(draggingLine);
+        noteInteraction();
+        if (draggingLine->getRouting() == LineBaseShape::Orthogonal) {
+            ensureSpatialIndex();
+            routeConnector(draggingLine);
+        }
+        updateSpatialIndex(draggingLine);
+        updateScene();
+        return;
+    }
+
+    // 正在进行区域选择
+    if (isRegionSelecting) {
+        updateRegionSelection(pos);
         return;
     }
 
     // 判断鼠标是否移动到图形上，并且图形为未选中状态
-    QPointF pos = event->pos();
     ShapeBase *newHovered = nullptr;
-    for (ShapeBase *shape: shapes) {
-        if (shape->boundingRect().contains(pos) && shape->isSelected() == false) {
-            newHovered = shape;
-            break;
+    {
+        PROFILE_SCOPE(HitTest);
+        for (ShapeBase *shape: shapes) {
+            if (shape->boundingRect().contains(pos) && shape->isSelected() == false) {
+                newHovered = shape;
+                break;
+            }
         }
     }
 
     if (hoveredShape != newHovered) {
         hoveredShape = newHovered;         // 设置该图形为鼠标悬停状态
-        update();
+        updateScene();
     }
 
     // 如果移动距离超过阈值，则认为拖动，设置单击为false
@@ -347,34 +1311,73 @@ void DrawArea::mouseMoveEvent(QMouseEvent *event) {
     // 图形缩放
     if (isResizing) {
         QPointF offset = pos - lastMousePos;
+        QRectF changedArea = selectedShape->boundingRect();
         selectedShape->resizeBy(offset.x(), offset.y(), resizingHandle);
+        changedArea |= selectedShape->boundingRect();
+        markShapeDirty(selectedShape);
+        updateSpatialIndex(selectedShape);
         isModified = true;
         lastMousePos = pos;
+        noteInteraction();
         updateAllLineBindings();
-        update();
+        rerouteConnectors(changedArea);
+        updateScene();
     } else if (isDragging) {            // 图形移动
         QPointF offset = pos - lastMousePos;
+        if (!dragSprite && fromMultiSelected && !offset.isNull()) {
+            std::vector<ShapeBase *> moving = collectSelectedShapes();
+            if (moving.size() >= DRAG_SPRITE_THRESHOLD) {
+                beginDragSprite(moving);
+            }
+        }
+        if (dragSprite) {               // 位图拖动只平移位图，松开鼠标时再移动图形
+            moveDragSprite(offset);
+            isModified = true;
+            lastMousePos = pos;
+            return;
+        }
+        QRectF changedArea;             // 被移动图形移动前后占据的区域，只有经过这里的连线需要重新计算路径
 
         // 移动所有选中的图形
         if (fromMultiSelected) {
             for (auto shape: shapes) {
                 if (shape->isSelected()) {
+                    changedArea |= shape->boundingRect();
                     shape->moveBy(offset.x(), offset.y());
+                    changedArea |= shape->boundingRect();
+                    markShapeDirty(shape);
+                    updateSpatialIndex(shape);
                 }
             }
         } else if (selectedShape) {    // 移动当前选中的图形
+            changedArea |= selectedShape->boundingRect();
             selectedShape->moveBy(offset.x(), offset.y());
+            changedArea |= selectedShape->boundingRect();
+            markShapeDirty(selectedShape);
+            updateSpatialIndex(selectedShape);
         }
 
         isModified = true;
         lastMousePos = pos;
-        updateAllLineBindings();      // 更新所有线段的绑定点
-        update();
+        noteInteraction();
+        updateAllLineBindings();      // 更新所有线段的绑定点，端点移动的线段同时更新空间索引
+        rerouteConnectors(changedArea);
+        updateScene();
     }
 }
 
 void DrawArea::mouseReleaseEvent(QMouseEvent *event) {
+    flushPendingMove();
+    TRACE_SCOPE("DrawArea::mouseReleaseEvent", "input");
+    PROFILE_INPUT();
+    PROFILE_SCOPE(MouseEvent);
+    inputLatency.markInput(event->timestamp());
     if (event->button() == Qt::LeftButton) {
+        finishDragSprite();                // 把位图拖动的位移应用到图形上
+        if (isRegionSelecting) {
+            finishRegionSelection();       // 提交区域选择结果
+        }
+
         if (draggingLine) {
             draggingLine = nullptr;        // 将指向正在拖动的线段指针设置为空指针
             draggingLineHandle = -1;
@@ -392,7 +1395,9 @@ void DrawArea::mouseReleaseEvent(QMouseEvent *event) {
         isResizing = false;
         fromMultiSelected = false;
         isClicked = false;
-        update();
+        undoSnapshotPending = false;
+        commitEdit();                      // 拖动、缩放结束后记录一次编辑
+        updateScene();
         emitSelectionChanged();
     }
 }
@@ -405,36 +1410,24 @@ void DrawArea::dragEnterEvent(QDragEnterEvent *event) {
 }
 
 void DrawArea::dropEvent(QDropEvent *event) {
-    QPointF pos = event->pos();
+    QPointF pos = mapToScene(event->pos());
     saveToUndoStack();             // 保存拖拽前的状态到撤销栈
 
     QString type = event->mimeData()->text();     // 从拖放事件的MIME数据中提取文本内容
-    ShapeBase *shape = nullptr;
-    if (type == "Rect") {
-        shape = new RectShape(QRectF(pos, QSizeF(80, 80)));
-    } else if (type == "Ellipse") {
-        shape = new EllipseShape(QRectF(pos, QSizeF(80, 80)));
-    } else if (type == "Diamond") {
-        shape = new DiamondShape(QRectF(pos, QSizeF(80, 80)));
-    } else if (type == "Pentagon") {
-        shape = new PentagonShape(QRectF(pos, QSizeF(80, 80)));
-    } else if (type == "Hexagon") {
-        shape = new HexagonShape(QRectF(pos, QSizeF(80, 80)));
-    } else if (type == "Arrow") {
-        shape = new ArrowShape(pos, pos + QPointF(80, 0));
-    } else if (type == "Line") {
-        shape = new LineShape(pos, pos + QPointF(80, 0));
-    }
+    ShapeBase *shape = ShapeFactory::createDefaultShape(type, pos);
 
     if (shape) {
         shapes.push_back(shape);        // 将拖入的图形添加到图形数组中
+        invalidateSpatialIndex();
+        rerouteConnectors(shape->boundingRect());     // 新图形成为附近连线的障碍物
 
         // 取消所有图形选中状态，设置当前图形选中
         clearSelection();
         shape->setSelected(true);
         selectedShape = shape;
         isModified = true;
-        update();
+        commitEdit();
+        updateScene();
         emitSelectionChanged();
     }
 
@@ -442,19 +1435,22 @@ void DrawArea::dropEvent(QDropEvent *event) {
 }
 
 void DrawArea::mouseDoubleClickEvent(QMouseEvent *event) {
-    QPointF pos = event->pos();
-    saveToUndoStack();                   // 保存当前状态到撤销栈中
+    flushPendingMove();
+    TRACE_SCOPE("DrawArea::mouseDoubleClickEvent", "input");
+    QPointF pos = mapToScene(event->pos());
 
+    PROFILE_SCOPE(HitTest);
     for (auto it = shapes.rbegin(); it != shapes.rend(); ++it) {
         ShapeBase *shape = *it;
         if (!shape) continue;
 
         if (shape->containPoint(pos)) {
+            saveToUndoStack();                   // 开始编辑文本之前保存当前状态到撤销栈中
             editingShape = shape;                // 设置当前图形为正在编辑的图形
             QRectF rect = shape->boundingRect();
 
             // 创建文本框但不立即显示
-            textEdit->setGeometry(rect.toRect());                                 // 设置编辑框位置和大小
+            textEdit->setGeometry(rect.toRect().translated(-scrollOffset()));     // 设置编辑框位置和大小（视口坐标）
             textEdit->setText(shape->getText());                                  // 填充图形中的现有文本
             textEdit->setStyleSheet("MyTextEdit { border: none; background-color: transparent;}");  // 透明无边框样式
             textEdit->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);         // 禁用纵向滚动条
@@ -468,6 +1464,8 @@ void DrawArea::mouseDoubleClickEvent(QMouseEvent *event) {
 }
 
 void DrawArea::contextMenuEvent(QContextMenuEvent *event) {
+    flushPendingMove();
+    const QPointF pos = mapToScene(event->pos());
     QMenu menu(this);
     if (selectedShape) {
         QAction *copyAct = menu.addAction(tr("copy"));
@@ -485,7 +1483,20 @@ void DrawArea::contextMenuEvent(QContextMenuEvent *event) {
         QAction *deleteAct = menu.addAction(tr("delete"));
         deleteAct->setShortcut(QKeySequence::Delete);
 
-        pasteAct->setEnabled(clipboardShape != nullptr);            // 剪切板不为空时才启用粘贴
+        // 折线/曲线连线：在控制点上右键删除中间点，在线上其他位置右键插入中间点
+        QAction *addWaypointAct = nullptr;
+        QAction *removeWaypointAct = nullptr;
+        auto waypointLine = dynamic_cast<WaypointLineShape *>(selectedShape);
+        if (waypointLine) {
+            menu.addSeparator();
+            if (waypointLine->waypointAt(pos) >= 0) {
+                removeWaypointAct = menu.addAction(tr("removeWaypoint"));
+            } else {
+                addWaypointAct = menu.addAction(tr("addWaypoint"));
+            }
+        }
+
+        pasteAct->setEnabled(!clipboardShapes.empty());            // 剪切板不为空时才启用粘贴
         QAction *chosen = menu.exec(event->globalPos());            // 在指定位置显示菜单并获取用户选择（通常是鼠标右键点击位置）
         if (!chosen) return;
         if (chosen == copyAct) {
@@ -493,11 +1504,13 @@ void DrawArea::contextMenuEvent(QContextMenuEvent *event) {
         } else if (chosen == cutAct) {
             cutSelectedShape();
         } else if (chosen == pasteAct) {
-            pasteShape(event->pos());
+            pasteShape(pos);
         } else if (chosen == duplicateAct) {
             duplicateSelectedShape();
         } else if (chosen == deleteAct) {
             deleteSelectedShape();
+        } else if (chosen == addWaypointAct || chosen == removeWaypointAct) {
+            editWaypoint(waypointLine, pos, chosen == removeWaypointAct);
         }
     } else {
         // 空白区域右键菜单
@@ -512,7 +1525,7 @@ void DrawArea::contextMenuEvent(QContextMenuEvent *event) {
 
         undoAct->setEnabled(!undoStack.empty());
         redoAct->setEnabled(!redoStack.empty());
-        pasteHereAct->setEnabled(clipboardShape != nullptr);
+        pasteHereAct->setEnabled(!clipboardShapes.empty());
         selectAllAct->setEnabled(!shapes.empty());
 
         QAction *chosen = menu.exec(event->globalPos());
@@ -522,94 +1535,189 @@ void DrawArea::contextMenuEvent(QContextMenuEvent *event) {
         } else if (chosen == redoAct) {
             redo();
         } else if (chosen == pasteHereAct) {
-            pasteShape(event->pos());
+            pasteShape(pos);
         } else if (chosen == selectAllAct) {
             selectAll();
         }
     }
 }
 
+void DrawArea::editWaypoint(WaypointLineShape *line, const QPointF &pos, bool remove) {
+    saveToUndoStack();
+    QRectF changedArea = line->boundingRect();
+    if (remove) {
+        line->removeWaypoint(line->waypointAt(pos));
+    } else {
+        line->insertWaypoint(pos);
+    }
+    changedArea |= line->boundingRect();
+
+    markShapeDirty(line);
+    isModified = true;
+    invalidateSpatialIndex();
+    rerouteConnectors(changedArea);
+    commitEdit();
+    updateScene();
+}
+
 void DrawArea::copySelectedShape() {
-    if (!selectedShape) return;
+    if (!canCopy()) return;
     saveToUndoStack();
-    clipboardShape.reset(selectedShape->clone());
+    copySelectionToClipboard();
 }
 
 void DrawArea::cutSelectedShape() {
-    if (!selectedShape) return;
-    saveToUndoStack();
-    clipboardShape.reset(selectedShape->clone());
-    deleteSelectedShape();
+    if (!canCut()) return;
+    saveToUndoStack();                                // 剪切只产生一条撤销记录
+    copySelectionToClipboard();
+    eraseShapes(collectSelectedShapes());
 }
 
 void DrawArea::pasteShape(const QPointF &pos) {
-    if (!clipboardShape) return;                      // 剪切板没有内容，直接退出
+    if (clipboardShapes.empty()) return;              // 剪切板没有内容，直接退出
     saveToUndoStack();
 
-    ShapeBase *newShape = clipboardShape->clone();    // 从剪切板拷贝图形
+    // 从剪切板拷贝图形，组内线段的绑定关系指向新的副本
+    std::vector<ShapeBase *> source;
+    source.reserve(clipboardShapes.size());
+    for (const auto &shape: clipboardShapes) {
+        source.push_back(shape.get());
+    }
+    std::vector<ShapeBase *> newShapes = ShapeFactory::cloneShapes(source);
+
+    // 以整组图形的外接矩形为基准，粘贴时偏移一点，避免与原图形重叠
+    QRectF groupRect;
+    for (auto shape: newShapes) {
+        groupRect = groupRect.united(shape->boundingRect());
+    }
+    qreal dx = pos.x() - groupRect.x() + 20;
+    qreal dy = pos.y() - groupRect.y() + 20;
 
-    // 粘贴时偏移一点，避免与原图形重叠
-    newShape->moveBy(pos.x() - newShape->boundingRect().x() + 20,
-                     pos.y() - newShape->boundingRect().y() + 20);
-    shapes.push_back(newShape);                      // 将新图形添加到图形数组中
     clearSelection();                                 // 清空图形选中状态
-    newShape->setSelected(true);
-    selectedShape = newShape;
-    isModified = true;                               // 设置文档已被修改
-    update();
+    shapes.reserve(shapes.size() + newShapes.size());
+    for (auto shape: newShapes) {
+        shape->setUuid(QUuid::createUuid());          // 副本是新的图形，不能与原图形共用UUID
+        shape->moveBy(dx, dy);
+        shape->setSelected(true);
+        shapes.push_back(shape);                      // 将新图形添加到图形数组中
+    }
+    selectedShape = newShapes.back();
+    invalidateSpatialIndex();
+    isModified = true;                                // 设置文档已被修改
+    commitEdit();
+    updateScene();
     emitSelectionChanged();
 }
 
 void DrawArea::duplicateSelectedShape() {
-    if (!selectedShape) return;
+    std::vector<ShapeBase *> selected = collectSelectedShapes();
+    if (selected.empty()) return;
     saveToUndoStack();
-    ShapeBase *newShape = selectedShape->clone();
 
-    // 复用时偏移一点，避免与原图形重叠
-    newShape->moveBy(20, 20);
-    shapes.push_back(newShape);
+    ShapeBase *oldSelected = selectedShape;
+    std::vector<ShapeBase *> newShapes = ShapeFactory::cloneShapes(selected);
+
     clearSelection();
-    newShape->setSelected(true);
-    selectedShape = newShape;
+    shapes.reserve(shapes.size() + newShapes.size());
+    for (size_t i = 0; i < newShapes.size(); ++i) {
+        ShapeBase *newShape = newShapes[i];
+        newShape->setUuid(QUuid::createUuid());
+        newShape->moveBy(20, 20);                     // 复用时偏移一点，避免与原图形重叠
+        newShape->setSelected(true);
+        shapes.push_back(newShape);
+        if (selected[i] == oldSelected) {
+            selectedShape = newShape;                 // 当前选中图形切换为对应的副本
+        }
+    }
+    if (!selectedShape) {
+        selectedShape = newShapes.back();
+    }
+    invalidateSpatialIndex();
     isModified = true;
-    update();
+    commitEdit();
+    updateScene();
     emitSelectionChanged();
 }
 
 void DrawArea::deleteSelectedShape() {
-    if (!selectedShape) return;
+    std::vector<ShapeBase *> selected = collectSelectedShapes();
+    if (selected.empty()) return;
     saveToUndoStack();
+    eraseShapes(selected);
+}
 
-    // 先解除所有绑定到该图形的线条
+std::vector<ShapeBase *> DrawArea::collectSelectedShapes() const {
+    std::vector<ShapeBase *> selected;
     for (auto shape: shapes) {
-        if (auto line = dynamic_cast<LineBaseShape *>(shape)) {
-            auto startBinding = line->getEndPointBinding(0);
-            // 如果该线条的起点绑定的是当前选中的图形，则解除绑定
-            if (startBinding.targetShape == selectedShape) {
-                line->clearEndPointBinding(0);
-            }
-            // 如果该线条的终点绑定的是当前选中的图形，则解除绑定
-            auto endBinding = line->getEndPointBinding(1);
-            if (endBinding.targetShape == selectedShape) {
-                line->clearEndPointBinding(1);
-            }
+        if (shape->isSelected()) {
+            selected.push_back(shape);
         }
     }
+    return selected;
+}
 
-    auto it = std::find(shapes.begin(), shapes.end(), selectedShape);     // 在图形数组中寻找当前选中的图形
-    if (it != shapes.end()) {
-        delete *it;                          // 释放迭代器指向的图形对象内存
-        shapes.erase(it);                    // 从容器中移除该迭代器
-        selectedShape = nullptr;
-        isModified = true;
-        update();
+void DrawArea::copySelectionToClipboard() {
+    std::vector<ShapeBase *> copies = ShapeFactory::cloneShapes(collectSelectedShapes());
+    clipboardShapes.clear();
+    clipboardShapes.reserve(copies.size());
+    for (auto shape: copies) {
+        shape->setSelected(false);
+        clipboardShapes.emplace_back(shape);
+    }
+}
 
-        emitSelectionChanged();
-        emit deleteSelectedShapeChanged();
+void DrawArea::eraseShapes(const std::vector<ShapeBase *> &targets) {
+    if (targets.empty()) return;
+
+    // 待删除图形的查找表，解绑和压缩都只需O(1)查询
+    std::unordered_set<const ShapeBase *> doomed(targets.begin(), targets.end());
+
+    // 单次遍历：释放被删除的图形，解除剩余线条指向被删除图形的绑定，并原地压缩数组
+    QRectF changedArea;                      // 被删除图形占据的区域，经过这里的连线可以走更短的路径
+    size_t keep = 0;
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        ShapeBase *shape = shapes[i];
+        if (doomed.count(shape)) {
+            changedArea |= shape->boundingRect();
+            if (auto line = dynamic_cast<LineBaseShape *>(shape)) {
+                pendingRoutes.erase(line);
+            }
+            delete shape;                    // 这里只比较指针，不再解引用已释放的图形
+            continue;
+        }
+        if (auto line = dynamic_cast<LineBaseShape *>(shape)) {
+            for (int j = 0; j < 2; ++j) {
+                if (doomed.count(line->getEndPointBinding(j).targetShape)) {
+                    line->clearEndPointBinding(j);
+                    markShapeDirty(line);
+                }
+            }
+        }
+        shapes[keep++] = shape;
+    }
+    shapes.resize(keep);
+    invalidateSpatialIndex();
+    rerouteConnectors(changedArea);
+
+    // 重置可能指向已删除图形的指针
+    if (doomed.count(hoveredShape)) hoveredShape = nullptr;
+    if (doomed.count(draggingLine)) draggingLine = nullptr;
+    if (doomed.count(editingShape)) {
+        editingShape = nullptr;
+        textEdit->hide();
     }
+    clearSelection();
+    isModified = true;
+    commitEdit();
+    updateScene();
+
+    emitSelectionChanged();
+    emit deleteSelectedShapeChanged();
 }
 
 void DrawArea::keyPressEvent(QKeyEvent *event) {
+    flushPendingMove();
+    finishDragSprite();
     if (!selectedShape && event->matches(QKeySequence::Paste)) {
         pasteShape(QPointF(500, 500));
         return;
@@ -632,26 +1740,41 @@ void DrawArea::keyPressEvent(QKeyEvent *event) {
         deleteSelectedShape();
     } else if (event->matches(QKeySequence::SelectAll)) {
         selectAll();
+    } else if (forcePreview && (event->key() == Qt::Key_Return || event->key() == Qt::Key_Enter)) {
+        acceptForceLayout();
+    } else if (forcePreview && event->key() == Qt::Key_Escape) {
+        cancelForceLayout();
     }
 }
 
 void DrawArea::resizeEvent(QResizeEvent *event) {
-    QWidget::resizeEvent(event);     // 确保基础功能正常
-    update();                        // 在窗口大小变化时触发界面重绘
+    QAbstractScrollArea::resizeEvent(event);     // 确保基础功能正常
+    finishDragSprite();              // 场景缓存的大小已经失效
+    updateScrollBars();              // 视口大小改变后滚动范围随之改变
+    updateScene();                   // 在窗口大小变化时触发界面重绘
+    emit viewChanged();
 }
 
 void DrawArea::enterEvent(QEvent *event) {
-    setMouseTracking(true);         // 启用鼠标跟踪
-    QWidget::enterEvent(event);
+    viewport()->setMouseTracking(true);          // 启用鼠标跟踪
+    QAbstractScrollArea::enterEvent(event);
 }
 
 void DrawArea::leaveEvent(QEvent *event) {
+    flushPendingMove();
     hoveredShape = nullptr;
-    update();
-    QWidget::leaveEvent(event);
+    updateScene();
+    QAbstractScrollArea::leaveEvent(event);
 }
 
 void DrawArea::saveToUndoStack() {
+    TRACE_SCOPE("DrawArea::saveToUndoStack", "undo");
+    PROFILE_SCOPE(UndoSnapshot);
+    finishDragSprite();                              // 拖动中的位移先应用到图形上
+    finishLazyLoad();                                // 撤销状态需要包含完整的文档
+    acceptForceLayout();                             // 预览中的布局在其他编辑之前生效
+    ++documentGeneration;
+
     // 保存当前状态
     undoStack.push(createCurrentState());
 
@@ -675,39 +1798,47 @@ void DrawArea::redo() {
 std::unique_ptr<ShapeState> DrawArea::createCurrentState() const {
     auto state = std::make_unique<ShapeState>();
 
-    // 深拷贝所有图形
-    for (auto shape: shapes) {
-        ShapeBase *cloned = shape->clone();
-        state->shapes.push_back(cloned);
-        if (shape == selectedShape) {
-            state->selectedShapeId = shape->getUuid();     // 记录当前选中图形的唯一标识（UUID）
-        }
+    // 深拷贝所有图形，线段绑定重定向到副本
+    state->shapes = ShapeFactory::cloneShapes(shapes);
+    if (selectedShape) {
+        state->selectedShapeId = selectedShape->getUuid();     // 记录当前选中图形的唯一标识（UUID）
     }
     return state;
 }
 
 void DrawArea::restoreState(const ShapeState *state) {
-    // 清理当前所有图形
+    // 从保存的状态中深拷贝图形，与当前图形比较后只把内容不同的图形写入日志
+    std::vector<ShapeBase *> restored = ShapeFactory::cloneShapes(state->shapes);
+    journal.markChanged(shapes, restored);
+
+    // 清理当前所有图形，恢复的副本与原图形UUID相同，保存快照的副本不能再按地址沿用
+    ++documentGeneration;
+    pendingRoutes.clear();
+    saveClones.clear();
+    saveDirty.clear();
     for (auto shape: shapes) {
         delete shape;
     }
-    shapes.clear();
+    shapes.swap(restored);
     selectedShape = nullptr;
 
-    // 从保存的状态中深拷贝图形
-    for (auto shape: state->shapes) {
-        ShapeBase *cloned = shape->clone();
+    hoveredShape = nullptr;
+    draggingLine = nullptr;
+
+    for (auto cloned: shapes) {
         if (cloned->getUuid() == state->selectedShapeId) {
             selectedShape = cloned;
             selectedShape->setSelected(true);
         }
-        shapes.push_back(cloned);
     }
 
     // 恢复绑定关系
     updateAllLineBindings();
+    invalidateSpatialIndex();
+    queueConnectorRoutes(false);                  // 副本中保存了路径，只重新计算已过期的
+    commitEdit();
 
-    update();
+    updateScene();
     isModified = true;
     emitSelectionChanged();
 }
@@ -720,6 +1851,12 @@ void DrawArea::clearState(ShapeState &state) {
 }
 
 void DrawArea::restoreFromUndoStack() {
+    TRACE_SCOPE("DrawArea::undo", "undo");
+    finishDragSprite();
+    if (forcePreview) {                           // 预览中撤销只放弃预览
+        cancelForceLayout();
+        return;
+    }
     if (undoStack.empty()) return;                // 边界检查：撤销栈为空则退出
 
     // 保存当前状态到重做栈
@@ -735,6 +1872,9 @@ void DrawArea::restoreFromUndoStack() {
 }
 
 void DrawArea::restoreFromRedoStack() {
+    TRACE_SCOPE("DrawArea::redo", "undo");
+    finishDragSprite();
+    cancelForceLayout();
     if (redoStack.empty()) return;
 
     // 保存当前状态到撤销栈
@@ -748,6 +1888,14 @@ void DrawArea::restoreFromRedoStack() {
     emitSelectionChanged();
 }
 
+void DrawArea::notifyShapeChanged(ShapeBase *shape) {
+    markOverviewDirty(shape->boundingRect());   // 只修改颜色时外接矩形不变，空间索引比较不出来
+    markShapeDirty(shape);
+    isModified = true;
+    commitEdit();
+    updateScene();
+}
+
 bool DrawArea::canDelete() const {
     if (selectedShape != nullptr) {
         return true;
@@ -797,15 +1945,160 @@ bool DrawArea::canMoveDown() const {
 }
 
 void DrawArea::selectAll() {
+    finishLazyLoad();
     for (auto shape: shapes) {
         shape->setSelected(true);
     }
 
     fromMultiSelected = true;
-    update();
+    updateScene();
     emitSelectionChanged();
 }
 
+void DrawArea::autoLayoutHierarchical() {
+    finishLazyLoad();                                // 布局需要完整的文档
+    acceptForceLayout();
+    LayoutGraph graph = LayoutGraph::build(shapes);
+    if (graph.nodes.size() < 2) {
+        return;
+    }
+
+    // 工作线程只读取graph中的矩形和边。布局期间进度框阻止编辑，但仍然确认文档没有改变，
+    // 否则graph.nodes中的图形可能已经被删除
+    const quint64 generation = documentGeneration;
+    std::vector<QPointF> positions;
+    bool cancelled = false;
+    bool ok = runBackgroundTask(tr("Arranging shapes..."), [&graph, &positions](const ProgressCallback &progress) {
+        return HierarchicalLayout::compute(graph, positions, progress);
+    }, cancelled);
+    if (ok && generation == documentGeneration) {
+        applyLayout(graph, positions);
+    }
+}
+
+void DrawArea::applyLayout(const LayoutGraph &graph, const std::vector<QPointF> &positions) {
+    saveToUndoStack();
+
+    std::vector<QPointF> original;
+    original.reserve(graph.rects.size());
+    for (const QRectF &rect: graph.rects) {
+        original.push_back(rect.topLeft());
+    }
+    for (auto shape: moveLayoutNodes(graph, original, positions)) {
+        markShapeDirty(shape);
+    }
+
+    isModified = true;
+    commitEdit();
+    emitSelectionChanged();
+}
+
+std::vector<ShapeBase *> DrawArea::moveLayoutNodes(const LayoutGraph &graph, const std::vector<QPointF> &from,
+                                                   const std::vector<QPointF> &to) {
+    std::vector<ShapeBase *> changed;
+    std::unordered_set<ShapeBase *> moved;
+    for (size_t i = 0; i < graph.nodes.size(); ++i) {
+        const QPointF delta = to[i] - from[i];
+        if (delta.isNull()) continue;
+        graph.nodes[i]->moveBy(delta.x(), delta.y());
+        moved.insert(graph.nodes[i]);
+        changed.push_back(graph.nodes[i]);
+    }
+
+    // 只更新绑定到被移动图形上的线段端点
+    if (!moved.empty()) {
+        for (auto shape: shapes) {
+            auto line = dynamic_cast<LineBaseShape *>(shape);
+            if (!line) continue;
+            bool lineChanged = false;
+            for (int i = 0; i < 2; ++i) {
+                if (moved.count(line->getEndPointBinding(i).targetShape)) {
+                    line->updateEndPointByBinding(i);
+                    lineChanged = true;
+                }
+            }
+            if (lineChanged) {
+                changed.push_back(line);
+            }
+        }
+        invalidateSpatialIndex();
+        queueConnectorRoutes(false);
+        updateScene();
+    }
+    return changed;
+}
+
+void DrawArea::startForceLayout() {
+    if (forcePreview) {
+        return;
+    }
+    finishLazyLoad();
+    LayoutGraph graph = LayoutGraph::build(shapes);
+    if (graph.nodes.size() < 2) {
+        return;
+    }
+
+    ForceLayout layout(graph);
+    std::vector<QPointF> shown;
+    shown.reserve(graph.rects.size());
+    for (const QRectF &rect: graph.rects) {
+        shown.push_back(rect.topLeft());
+    }
+    forcePreview.reset(new ForceLayoutPreview{std::move(graph), std::move(layout), std::move(shown)});
+    emit forceLayoutPreviewChanged(true);
+    runForceLayoutBatch();
+}
+
+void DrawArea::runForceLayoutBatch() {
+    // 迭代在工作线程中进行，界面线程只在每帧结束时移动图形，预览期间可以滚动、缩放和使用菜单
+    ForceLayout *layout = &forcePreview->layout;
+    forceLayoutWatcher.setFuture(QtConcurrent::run([layout]() {
+        return layout->step(FORCE_LAYOUT_FRAME_MS);
+    }));
+}
+
+void DrawArea::onForceLayoutBatchFinished() {
+    if (!forcePreview || forceLayoutWatcher.isRunning()) {
+        return;                                      // 预览已经结束
+    }
+    std::vector<QPointF> positions = forcePreview->layout.positions();
+    moveLayoutNodes(forcePreview->graph, forcePreview->shown, positions);
+    forcePreview->shown.swap(positions);
+    if (!forceLayoutWatcher.future().result()) {
+        runForceLayoutBatch();
+    }
+}
+
+std::unique_ptr<DrawArea::ForceLayoutPreview> DrawArea::stopForceLayout() {
+    if (!forcePreview) {
+        return nullptr;
+    }
+    forceLayoutWatcher.waitForFinished();            // 一帧的迭代很快结束
+    std::unique_ptr<ForceLayoutPreview> preview = std::move(forcePreview);
+
+    std::vector<QPointF> original;
+    original.reserve(preview->graph.rects.size());
+    for (const QRectF &rect: preview->graph.rects) {
+        original.push_back(rect.topLeft());
+    }
+    moveLayoutNodes(preview->graph, preview->shown, original);
+    emit forceLayoutPreviewChanged(false);
+    return preview;
+}
+
+void DrawArea::acceptForceLayout() {
+    if (!forcePreview) {
+        return;
+    }
+    // 采用当前显示的一帧，先移回原位置再整体应用，撤销时回到预览前的状态
+    std::unique_ptr<ForceLayoutPreview> preview = stopForceLayout();
+    applyLayout(preview->graph, preview->shown);
+}
+
+void DrawArea::cancelForceLayout() {
+    stopForceLayout();
+}
+
 void DrawArea::emitSelectionChanged() {
     bool hasSelection = false;
     for (auto shape: shapes) {
@@ -827,7 +2120,10 @@ void DrawArea::moveSelectedShapeToTop() {
             auto shape = std::move(*it);                // 转移指针所有权
             shapes.erase(it);                           // 从数组中删除当前图形
             shapes.push_back(std::move(shape));         // 移动到末尾
-            update();
+            invalidateSpatialIndex();              // 空间索引按图层顺序返回结果
+            markOverviewDirty(selectedShape->boundingRect());
+            commitEdit();
+            updateScene();
             emit shapeOrderChanged();
             break;
         }
@@ -843,7 +2139,10 @@ void DrawArea::moveSelectedShapeToBottom() {
             auto shape = std::move(*it);
             shapes.erase(it);
             shapes.insert(shapes.begin(), std::move(shape));   // 插入到最前面
-            update();
+            invalidateSpatialIndex();              // 空间索引按图层顺序返回结果
+            markOverviewDirty(selectedShape->boundingRect());
+            commitEdit();
+            updateScene();
             emit shapeOrderChanged();
             break;
         }
@@ -860,7 +2159,10 @@ void DrawArea::moveSelectedShapeUp() {
 
             // 交换当前指针和下一个指针
             std::iter_swap(it, it + 1);
-            update();
+            invalidateSpatialIndex();              // 空间索引按图层顺序返回结果
+            markOverviewDirty(selectedShape->boundingRect());
+            commitEdit();
+            updateScene();
             emit shapeOrderChanged();
             break;
         }
@@ -877,7 +2179,10 @@ void DrawArea::moveSelectedShapeDown() {
 
             // 交换当前指针和前一个指针
             std::iter_swap(it, it - 1);
-            update();
+            invalidateSpatialIndex();              // 空间索引按图层顺序返回结果
+            markOverviewDirty(selectedShape->boundingRect());
+            commitEdit();
+            updateScene();
             emit shapeOrderChanged();
             break;
         }
@@ -892,15 +2197,17 @@ bool DrawArea::newFile() {
     clearAll();                           // 清空所有图形和状态
     setCurrentFilePath(QString());        // 重置文件路径
     isModified = false;
+    journal.start(QString(), shapes, currentBackgroundColor, m_pageSize);
     return true;
 }
 
 bool DrawArea::openFile() {
     if (!maybeSave()) return false;
 
-    QString filePath = QFileDialog::getOpenFileName(this, tr("Open File"), QString(), tr("SVG (*.svg)"));
+    QString filePath = QFileDialog::getOpenFileName(this, tr("Open File"), QString(),
+                                                    tr("Flowchart (*.fcd *.svg *.svgz);;Flowchart Document (*.fcd);;SVG (*.svg *.svgz)"));
     if (!filePath.isEmpty()) {
-        return loadFromSvg(filePath);
+        return loadFile(filePath);
     }
 
     return false;
@@ -911,15 +2218,22 @@ bool DrawArea::saveFile() {
         return saveAsFile();
     }
 
-    return saveToSvg(currentFilePath);        // 当前文件路径不为空时，保存为SVG文件
+    return saveDocument(currentFilePath);     // 当前文件路径不为空时，按文件后缀保存
 }
 
 bool DrawArea::saveAsFile() {
-    QString filePath = QFileDialog::getSaveFileName(this, tr("Save File"), QString(), tr("SVG (*.svg);;PNG (*.png)"));
+    QString filePath = QFileDialog::getSaveFileName(this, tr("Save File"), QString(),
+                                                    tr("Flowchart Document (*.fcd);;SVG (*.svg);;Compressed SVG (*.svgz);;PNG (*.png)"));
     if (!filePath.isEmpty()) {
-        if (filePath.endsWith(".svg", Qt::CaseInsensitive)) {
+        if (filePath.endsWith(QString(".") + NativeDocument::FILE_SUFFIX, Qt::CaseInsensitive)) {
+            lastSaveFormat = NativeDocument::FILE_SUFFIX;
+            return saveToNative(filePath);
+        } else if (filePath.endsWith(".svg", Qt::CaseInsensitive)) {
             lastSaveFormat = "svg";
             return saveToSvg(filePath);
+        } else if (SvgDocument::isCompressedFileName(filePath)) {
+            lastSaveFormat = "svgz";
+            return saveToSvg(filePath);
         } else if (filePath.endsWith(".png", Qt::CaseInsensitive)) {
             lastSaveFormat = "png";
             return saveToPng(filePath);
@@ -948,219 +2262,465 @@ bool DrawArea::exportToSvg() {
 }
 
 void DrawArea::clearAll() {
+    dragSprite.reset();
+    cancelLazyLoad();
+    cancelForceLayout();
+    routeTimer.stop();
+    pendingRoutes.clear();
+    saveClones.clear();
+    saveDirty.clear();
+    ++documentGeneration;
     for (auto shape: shapes) {
         delete shape;
     }
 
     shapes.clear();
     selectedShape = nullptr;
+    hoveredShape = nullptr;
+    invalidateSpatialIndex();
+    overviewDirtyAll = true;                     // 新文档的图形可能复用已释放图形的地址
     currentFilePath.clear();
     isModified = false;
-    update();
+    scheduleSceneRectUpdate();
+    updateScene();
 }
 
 bool DrawArea::saveToSvg(const QString &filePath) {
-    QFile file(filePath);
-    // 以只写和文本模式打开文件
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        return false;
+    const QSize canvasSize(m_pageSize.width() + 100, m_pageSize.height() + 100);   // 没有图形时导出页面及四周的空白
+    const int level = compressionLevel;
+    return startSave(filePath, [filePath, canvasSize, level](const DocumentContent &snapshot) {
+        // 后缀为.svgz时压缩保存
+        return SvgDocument::save(filePath, snapshot.shapes, snapshot.backgroundColor, canvasSize, level);
+    }, true);
+}
+
+bool DrawArea::saveToNative(const QString &filePath) {
+    return startSave(filePath, [filePath](const DocumentContent &snapshot) {
+        return NativeDocument::save(filePath, snapshot.shapes, snapshot.backgroundColor, snapshot.pageSize);
+    }, true);
+}
+
+namespace {
+    // 后台保存的快照。图形副本由绘图区域和快照共同持有，保存线程只读取
+    struct SaveSnapshot {
+        std::vector<std::shared_ptr<ShapeBase>> owners;
+        DocumentContent content;                             // content.shapes只引用owners中的副本
+
+        ~SaveSnapshot() { content.takeShapes(); }            // 副本由owners释放
+    };
+}
+
+std::vector<std::shared_ptr<ShapeBase>> DrawArea::snapshotShapes() {
+    TRACE_SCOPE("DrawArea::snapshotShapes", "io");
+    std::unordered_map<const ShapeBase *, std::shared_ptr<ShapeBase>> clones;
+    clones.reserve(shapes.size());
+    std::vector<std::shared_ptr<ShapeBase>> result;
+    result.reserve(shapes.size());
+    for (auto shape: shapes) {
+        // 同一地址上可能是删除后新建的图形，UUID不同时不能沿用旧的副本
+        auto it = saveClones.find(shape);
+        std::shared_ptr<ShapeBase> cloned;
+        if (it != saveClones.end() && !saveDirty.count(shape) && it->second->getUuid() == shape->getUuid()) {
+            cloned = it->second;
+        } else {
+            cloned.reset(shape->clone());
+        }
+        clones.emplace(shape, cloned);
+        result.push_back(std::move(cloned));
     }
 
-    QXmlStreamWriter writer(&file);                  // 创建XML写入器，绑定到已打开的文件
-    writer.setAutoFormatting(true);                  // 设置自动格式化
-    writer.writeStartDocument();                     // 写入文档头，标识这是一个XML文档
-    writer.writeStartElement("svg");                 // 写入<svg> 标签，定义SVG根元素
-    writer.writeAttribute("xmlns", "http://www.w3.org/2000/svg");    // 设置命名空间（必须）
-    writer.writeAttribute("width", QString::number(width()));        // 设置SVG画布尺寸
-    writer.writeAttribute("height", QString::number(height()));
+    // 目标图形可能重新复制过，线段绑定每次都重定向到本次快照中的副本，目标不在文档中时解除绑定
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        auto line = dynamic_cast<const LineBaseShape *>(shapes[i]);
+        if (!line) continue;
+        auto cloned = static_cast<LineBaseShape *>(result[i].get());
+        for (int end = 0; end < 2; ++end) {
+            const LineBaseShape::EndPointBinding binding = line->getEndPointBinding(end);
+            cloned->clearEndPointBinding(end);
+            auto target = binding.targetShape ? clones.find(binding.targetShape) : clones.end();
+            if (target != clones.end()) {
+                cloned->setEndPointBinding(end, target->second.get(), binding.magneticIndex);
+            }
+        }
+    }
 
-    // 序列化所有图形
-    serializeToXml(writer);
-    writer.writeEndElement();                        // 结束<svg>标签，结束SVG根元素
-    writer.writeEndDocument();                       // 结束XML文档
+    saveClones.swap(clones);
+    saveDirty.clear();
+    return result;
+}
 
-    setCurrentFilePath(filePath);                    // 设置当前文件路径
-    isModified = false;                              // 文件保存成功，修改标志位设为false
+bool DrawArea::startSave(const QString &filePath, const DocumentSaveTask &task, bool updatesDocument) {
+    TRACE_SCOPE_DETAIL("DrawArea::startSave", "io", filePath);
+    finishPendingSave();                             // 同一时间只进行一次保存，保证文件按顺序写入
+    finishDragSprite();
+    finishLazyLoad();
+    acceptForceLayout();
+
+    // 界面线程中只复制修改过的图形，序列化和写文件都在工作线程中完成，期间可以继续编辑
+    auto snapshot = std::make_shared<SaveSnapshot>();
+    snapshot->owners = snapshotShapes();
+    snapshot->content.shapes.reserve(snapshot->owners.size());
+    for (const auto &cloned: snapshot->owners) {
+        snapshot->content.shapes.push_back(cloned.get());
+    }
+    snapshot->content.backgroundColor = currentBackgroundColor;
+    snapshot->content.pageSize = m_pageSize;
+
+    pendingSave.reset(new PendingSave{filePath, updatesDocument});
+    if (updatesDocument) {
+        isModified = false;                          // 保存期间的编辑会重新设置修改标志
+    }
+    saveWatcher.setFuture(QtConcurrent::run([task, snapshot, filePath]() {
+        TRACE_SCOPE_DETAIL("save", "io", filePath);
+        return task(snapshot->content);
+    }));
     return true;
 }
 
-bool DrawArea::saveToPng(const QString &filePath) {
-    QPixmap pixmap(m_pageSize);                             // 创建一个透明画布
-    pixmap.fill(Qt::transparent);
+void DrawArea::onSaveFinished() {
+    if (!pendingSave) {                              // 已经在finishPendingSave中处理过
+        return;
+    }
+    std::unique_ptr<PendingSave> save = std::move(pendingSave);
+    lastSaveSucceeded = saveWatcher.future().result();
 
-    QPainter painter(&pixmap);
-    painter.setRenderHint(QPainter::Antialiasing);          // 创建一个画笔抗锯齿
+    if (!lastSaveSucceeded) {
+        if (save->updatesDocument) {
+            isModified = true;                       // 快照没有写入文件，文档仍未保存
+        }
+        QMessageBox::warning(this, tr("Flowchart"), tr("The file could not be saved."));
+        return;
+    }
 
-    QRect pageRect = QRect(0, 0, m_pageSize.width(), m_pageSize.height());
-    painter.fillRect(pageRect, currentBackgroundColor);
-    // 绘制所有图形
-    for (auto shape: shapes) {
-        painter.save();
-        shape->draw(painter);
-        painter.restore();
+    if (save->updatesDocument) {
+        setCurrentFilePath(save->filePath);          // 设置当前文件路径
+        // 保存期间没有新的编辑时，文件与当前文档一致，可以直接作为日志基准
+        journal.start(save->filePath, shapes, currentBackgroundColor, m_pageSize, !isModified);
     }
-    return pixmap.save(filePath, "PNG");
 }
 
-void DrawArea::serializeToXml(QXmlStreamWriter &writer) {
-    writer.writeAttribute("backgroundColor", currentBackgroundColor.name());     // 写入背景颜色
-    writer.writeStartElement("shapes");                                          // 写入<shapes>
+bool DrawArea::finishPendingSave() {
+    if (!pendingSave) {
+        return lastSaveSucceeded;
+    }
+    TRACE_SCOPE("DrawArea::finishPendingSave", "io");          // 等待后台保存，界面在此期间阻塞
 
-    for (auto shape: shapes) {
-        writer.writeStartElement("shape");                                       // 写入<shape>
-        writer.writeAttribute("type", shape->getShapeType());                    // 写入图形类型type
-        if (shape == nullptr) continue;
-
-        // 保存基本属性
-        if (LineBaseShape *line = dynamic_cast<LineBaseShape *>(shape)) {
-            writer.writeAttribute("startX", QString::number(line->getStart().x()));
-            writer.writeAttribute("startY", QString::number(line->getStart().y()));
-            writer.writeAttribute("endX", QString::number(line->getEnd().x()));
-            writer.writeAttribute("endY", QString::number(line->getEnd().y()));
-        } else {
-            writer.writeAttribute("x", QString::number(shape->boundingRect().x()));
-            writer.writeAttribute("y", QString::number(shape->boundingRect().y()));
-            writer.writeAttribute("width", QString::number(shape->boundingRect().width()));
-            writer.writeAttribute("height", QString::number(shape->boundingRect().height()));
-            writer.writeAttribute("rotation", QString::number(shape->getRotation()));
-        }
+    QEventLoop loop;
+    connect(&saveWatcher, &QFutureWatcher<bool>::finished, &loop, &QEventLoop::quit);
 
-        // 保存样式属性
-        writer.writeAttribute("penWidth", QString::number(shape->getPenWidth()));
-        writer.writeAttribute("borderColor", shape->getBorderColor().name());
-        writer.writeAttribute("fillColor", shape->getFillColor().name());
-        writer.writeAttribute("borderStyle", QString::number(shape->getBorderStyle()));
+    QProgressDialog dialog(tr("Saving document..."), QString(), 0, 0, this);
+    dialog.setWindowModality(Qt::WindowModal);                    // 等待期间禁止编辑
+    dialog.setMinimumDuration(0);                                 // 立即显示，否则进度框出现之前的输入会进入下面的事件循环
+    dialog.setValue(0);
+    dialog.show();
+
+    if (!saveWatcher.isFinished()) {
+        loop.exec();
+    }
+    dialog.reset();
 
-        // 保存文本属性
-        writer.writeAttribute("text", shape->getText());
-        writer.writeAttribute("fontFamily", shape->getFontFamily());
-        writer.writeAttribute("fontSize", QString::number(shape->getFontSize()));
-        writer.writeAttribute("fontBold", QString::number(shape->isFontBold()));
-        writer.writeAttribute("fontItalic", QString::number(shape->isFontItalic()));
-        writer.writeAttribute("fontUnderline", QString::number(shape->isFontUnderline()));
-        writer.writeAttribute("fontColor", shape->getFontColor().name());
-        writer.writeAttribute("textAlignment", QString::number(shape->getTextAlignment()));
+    saveWatcher.waitForFinished();
+    onSaveFinished();                                             // 完成信号可能还没有送达
+    return lastSaveSucceeded;
+}
 
-        writer.writeEndElement();                                    // 结束<shape>
+bool DrawArea::saveDocument(const QString &filePath) {
+    if (filePath.endsWith(QString(".") + NativeDocument::FILE_SUFFIX, Qt::CaseInsensitive)) {
+        return saveToNative(filePath);
     }
-    writer.writeEndElement();                                        // 结束<shapes>
+    return saveToSvg(filePath);
+}
+
+bool DrawArea::saveToPng(const QString &filePath) {
+    return startSave(filePath, [filePath](const DocumentContent &snapshot) {
+        // 页面在场景中位于(50, 50)。图片大小为页面大小，页面位于图片原点；有图形位于页面以外时扩大到包含这些图形
+        const QRect pageRect(QPoint(50, 50), snapshot.pageSize);
+        QRectF bounds(pageRect);
+        for (auto shape: snapshot.shapes) {
+            const QRectF shapeBounds = shape->boundingRect();
+            if (!bounds.contains(shapeBounds)) {
+                bounds |= shapeBounds.adjusted(-PAINT_MARGIN, -PAINT_MARGIN, PAINT_MARGIN, PAINT_MARGIN);
+            }
+        }
+        const QRect imageRect = bounds.toAlignedRect();
+
+        // QPixmap只能在界面线程中使用，工作线程中绘制到QImage
+        QImage image(imageRect.size(), QImage::Format_ARGB32_Premultiplied);    // 创建一个透明画布
+        image.fill(Qt::transparent);
+
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::Antialiasing);          // 创建一个画笔抗锯齿
+        painter.translate(-imageRect.topLeft());       // 之后按场景坐标绘制
+        painter.fillRect(pageRect, snapshot.backgroundColor);
+        // 绘制所有图形
+        for (auto shape: snapshot.shapes) {
+            TRACE_SCOPE_DETAIL("draw", "shape", shape->getShapeType());
+            painter.save();
+            shape->draw(painter, false);              // 导出始终使用完整质量
+            painter.restore();
+        }
+        painter.end();
+
+        TRACE_SCOPE("encode png", "io");
+        QSaveFile file(filePath);
+        return file.open(QIODevice::WriteOnly) && image.save(&file, "PNG") && file.commit();
+    }, false);                                                  // 导出图片不改变当前文档
 }
 
 bool DrawArea::loadFromSvg(const QString &filePath) {
-    QFile file(filePath);
-    // 以只读和文本模式打开文件
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    TRACE_SCOPE_DETAIL("DrawArea::loadFromSvg", "io", filePath);
+    DocumentContent content;
+    bool ok = runBackgroundLoad([filePath](DocumentContent &result, const ProgressCallback &progress) {
+        return SvgDocument::load(filePath, result, progress);    // 自动识别gzip压缩的文件
+    }, content);
+
+    if (!ok) {                                    // 解析失败或取消时保留当前文档
         return false;
     }
+    applyDocument(content, filePath);
+    return true;
+}
 
-    QXmlStreamReader reader(&file);                                // 创建一个XML读取器
-    clearAll();
-
-    while (!reader.atEnd()) {
-        reader.readNext();                                         // 读取下一个元素
-        if (reader.isStartElement()) {
-            if (reader.name() == "svg") {
-                QString bgColor = reader.attributes().value("backgroundColor").toString();   // 读取背景颜色
-                if (!bgColor.isEmpty()) {
-                    currentBackgroundColor = QColor(bgColor);
-                }
-                continue;
-            } else if (reader.name() == "shapes") {
-                continue;
-            } else if (reader.name() == "shape") {                 // 读取<shape>
-                if (!deserializeFromXml(reader)) {
-                    return false;
-                }
-            }
-        }
+bool DrawArea::runBackgroundLoad(const DocumentLoadTask &task, DocumentContent &content) {
+    bool cancelled = false;
+    bool ok = runBackgroundTask(tr("Loading document..."), [&task, &content](const ProgressCallback &progress) {
+        return task(content, progress);
+    }, cancelled);
+    if (!ok && !cancelled) {
+        QMessageBox::warning(this, tr("Flowchart"), tr("The file could not be opened."));
     }
-    if (reader.hasError()) {                                      // 读取失败
+    return ok;
+}
+
+bool DrawArea::runBackgroundTask(const QString &label, const std::function<bool(const ProgressCallback &)> &task,
+                                 bool &wasCancelled) {
+    if (backgroundTaskRunning) {                                  // 等待期间的定时器不能再启动另一个加载或布局
+        wasCancelled = true;
         return false;
     }
+    backgroundTaskRunning = true;
+
+    std::atomic<int> progressValue(0);
+    std::atomic<bool> cancelled(false);
+    ProgressCallback progress = [&progressValue, &cancelled](int percent) {
+        progressValue.store(percent);
+        return !cancelled.load();
+    };
+
+    // 任务在工作线程中只处理独立的数据，界面线程只负责显示进度
+    QFutureWatcher<bool> watcher;
+    QEventLoop loop;
+    connect(&watcher, &QFutureWatcher<bool>::finished, &loop, &QEventLoop::quit);
+    watcher.setFuture(QtConcurrent::run([&task, &progress]() {
+        return task(progress);
+    }));
+
+    QProgressDialog dialog(label, tr("Cancel"), 0, 100, this);
+    dialog.setWindowModality(Qt::WindowModal);                    // 执行期间禁止编辑当前文档
+    dialog.setMinimumDuration(0);                                 // 立即显示，否则进度框出现之前的输入会进入下面的事件循环
+    connect(&dialog, &QProgressDialog::canceled, this, [&cancelled]() {
+        cancelled.store(true);
+    });
+
+    QTimer timer;
+    timer.setInterval(50);
+    connect(&timer, &QTimer::timeout, &dialog, [&dialog, &progressValue]() {
+        dialog.setValue(progressValue.load());
+    });
+    timer.start();
+    dialog.setValue(0);
+    dialog.show();
+
+    if (!watcher.isFinished()) {
+        loop.exec();                                              // 等待期间界面保持响应
+    }
+    timer.stop();
+    dialog.reset();
+    backgroundTaskRunning = false;
+
+    wasCancelled = cancelled.load();
+    return watcher.future().result() && !wasCancelled;
+}
+
+void DrawArea::applyDocument(DocumentContent &content, const QString &filePath, bool recovered) {
+    TRACE_SCOPE("DrawArea::applyDocument", "io");
+    clearAll();
+    shapes = content.takeShapes();
+    currentBackgroundColor = content.backgroundColor;
+    if (content.pageSize.isValid() && content.pageSize != m_pageSize) {
+        m_pageSize = content.pageSize;
+        m_isLandscape = m_pageSize.width() > m_pageSize.height();
+        emit pageSizeChanged(m_pageSize);
+        emit pageOrientationChanged(m_isLandscape);
+    }
+    invalidateSpatialIndex();
+
+    // 撤销/重做记录属于旧文档，一并清空
+    while (!undoStack.empty()) undoStack.pop();
+    while (!redoStack.empty()) redoStack.pop();
+    emit undoStateChanged();
+    emit redoStateChanged();
 
     setCurrentFilePath(filePath);
-    isModified = false;
-    update();
-    return true;
+    isModified = recovered;                           // 恢复的内容尚未保存
+    journal.start(filePath, shapes, currentBackgroundColor, m_pageSize, !recovered);
+    queueConnectorRoutes(true);                       // 文件中只保存走线方式，路径在空闲时计算
+    updateSceneRect();
+    updateScene();
+    emitSelectionChanged();
 }
 
-bool DrawArea::deserializeFromXml(QXmlStreamReader &reader) {
-    QString type = reader.attributes().value("type").toString();       // 获取当前XML元素的type属性值
-    ShapeBase *shape = nullptr;
-
-    if (type == "Rect") {
-        shape = new RectShape(QRectF(
-                reader.attributes().value("x").toDouble(),
-                reader.attributes().value("y").toDouble(),
-                reader.attributes().value("width").toDouble(),
-                reader.attributes().value("height").toDouble()
-        ));
-    } else if (type == "Ellipse") {
-        shape = new EllipseShape(QRectF(
-                reader.attributes().value("x").toDouble(),
-                reader.attributes().value("y").toDouble(),
-                reader.attributes().value("width").toDouble(),
-                reader.attributes().value("height").toDouble()
-        ));
-    } else if (type == "Diamond") {
-        shape = new DiamondShape(QRectF(
-                reader.attributes().value("x").toDouble(),
-                reader.attributes().value("y").toDouble(),
-                reader.attributes().value("width").toDouble(),
-                reader.attributes().value("height").toDouble()
-        ));
-    } else if (type == "Pentagon") {
-        shape = new PentagonShape(QRectF(
-                reader.attributes().value("x").toDouble(),
-                reader.attributes().value("y").toDouble(),
-                reader.attributes().value("width").toDouble(),
-                reader.attributes().value("height").toDouble()
-        ));
-    } else if (type == "Hexagon") {
-        shape = new HexagonShape(QRectF(
-                reader.attributes().value("x").toDouble(),
-                reader.attributes().value("y").toDouble(),
-                reader.attributes().value("width").toDouble(),
-                reader.attributes().value("height").toDouble()
-        ));
-    } else if (type == "Line") {
-        shape = new LineShape(QPointF(
-                reader.attributes().value("startX").toDouble(),
-                reader.attributes().value("startY").toDouble()
-        ), QPointF(
-                reader.attributes().value("endX").toDouble(),
-                reader.attributes().value("endY").toDouble()
-        ));
-    } else if (type == "Arrow") {
-        shape = new ArrowShape(QPointF(
-                reader.attributes().value("startX").toDouble(),
-                reader.attributes().value("startY").toDouble()
-        ), QPointF(
-                reader.attributes().value("endX").toDouble(),
-                reader.attributes().value("endY").toDouble()
-        ));
+bool DrawArea::loadFile(const QString &filePath) {
+    if (NativeDocument::isNativeFile(filePath)) {
+        return loadFromNative(filePath);
     }
+    return loadFromSvg(filePath);
+}
 
-    if (shape) {
-        shape->setRotation(reader.attributes().value("rotation").toDouble());
-        shape->setPenWidth(reader.attributes().value("penWidth").toInt());
-        shape->setBorderColor(QColor(reader.attributes().value("borderColor").toString()));
-        shape->setFillColor(QColor(reader.attributes().value("fillColor").toString()));
-        shape->setBorderStyle(static_cast<Qt::PenStyle>(reader.attributes().value("borderStyle").toInt()));
-
-        shape->setText(reader.attributes().value("text").toString());
-        shape->setFontFamily(reader.attributes().value("fontFamily").toString());
-        shape->setFontSize(reader.attributes().value("fontSize").toInt());
-        shape->setFontBold(reader.attributes().value("fontBold").toInt());
-        shape->setFontItalic(reader.attributes().value("fontItalic").toInt());
-        shape->setFontUnderline(reader.attributes().value("fontUnderline").toInt());
-        shape->setFontColor(QColor(reader.attributes().value("fontColor").toString()));
-        shape->setTextAlignment(static_cast<Qt::Alignment>(reader.attributes().value("textAlignment").toInt()));
-
-        shapes.push_back(shape);
+bool DrawArea::loadFromNative(const QString &filePath) {
+    TRACE_SCOPE_DETAIL("DrawArea::loadFromNative", "io", filePath);
+    // 大文档只读取目录，图形按区域逐步构造
+    std::unique_ptr<NativeDocumentReader> reader(new NativeDocumentReader);
+    if (reader->open(filePath) && reader->shapeCount() >= LAZY_LOAD_THRESHOLD) {
+        DocumentContent content;
+        content.backgroundColor = reader->backgroundColor();
+        content.pageSize = reader->pageSize();
+        applyDocument(content, filePath);
+        startLazyLoad(std::move(reader));
         return true;
     }
-    return false;
+    reader.reset();
+
+    DocumentContent content;
+    bool ok = runBackgroundLoad([filePath](DocumentContent &result, const ProgressCallback &progress) {
+        return NativeDocument::load(filePath, result, progress);
+    }, content);
+
+    if (!ok) {                                    // 读取失败或取消时保留当前文档
+        return false;
+    }
+    applyDocument(content, filePath);
+    return true;
+}
+
+void DrawArea::startLazyLoad(std::unique_ptr<NativeDocumentReader> reader) {
+    lazyDocument = std::move(reader);
+    lazyShapeIndex.clear();
+
+    // 先构造当前可见区域内的图形，之后的绘制和交互不需要等待其余图形
+    materializeLazyRegion(visibleSceneRect());
+    updateSceneRect();                               // 尚未构造的图形也计入场景范围
+    updateScene();
+    lazyLoadTimer.start();
+}
+
+void DrawArea::materializeLazyRegion(const QRectF &rect) {
+    if (!lazyDocument) {
+        return;
+    }
+    TRACE_SCOPE("DrawArea::materializeLazyRegion", "io");
+    std::vector<quint32> created;
+    lazyDocument->materializeRegion(rect.adjusted(-PAINT_MARGIN, -PAINT_MARGIN, PAINT_MARGIN, PAINT_MARGIN), created);
+    insertLazyShapes(created);
+}
+
+void DrawArea::insertLazyShapes(const std::vector<quint32> &indices) {
+    if (indices.empty()) {
+        return;
+    }
+
+    // 只需要与序号不小于第一个新图形的已有图形合并。按文件顺序分批构造时，
+    // 这部分只有提前构造的可见区域图形，合并的代价与批次大小相当
+    auto tail = std::lower_bound(lazyShapeIndex.begin(), lazyShapeIndex.end(), indices.front());
+    const size_t start = static_cast<size_t>(tail - lazyShapeIndex.begin());
+    std::vector<quint32> merged;
+    merged.reserve(lazyShapeIndex.size() - start + indices.size());
+    std::merge(tail, lazyShapeIndex.end(), indices.begin(), indices.end(), std::back_inserter(merged));
+
+    lazyShapeIndex.resize(start);
+    shapes.resize(start);
+    for (quint32 index: merged) {
+        lazyShapeIndex.push_back(index);
+        shapes.push_back(lazyDocument->shapeAt(index));
+    }
+    invalidateSpatialIndex();
+    // 不需要重绘：可见区域的分块已在绘制前构造，分批构造的图形都在可见区域之外
+}
+
+void DrawArea::streamLazyShapes() {
+    if (!lazyDocument) {
+        lazyLoadTimer.stop();
+        return;
+    }
+    TRACE_SCOPE("DrawArea::streamLazyShapes", "io");
+
+    QElapsedTimer budget;
+    budget.start();
+    std::vector<quint32> created;
+    while (lazyDocument->pendingCount() > 0 && budget.elapsed() < LAZY_LOAD_BUDGET_MS) {
+        lazyDocument->materializeNext(256, created);
+    }
+    insertLazyShapes(created);
+
+    if (lazyDocument->pendingCount() == 0) {
+        finishLazyLoad();
+    }
+}
+
+void DrawArea::finishLazyLoad() {
+    if (!lazyDocument) {
+        return;
+    }
+
+    lazyLoadTimer.stop();
+    if (lazyDocument->pendingCount() > 0) {
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        std::vector<quint32> created;
+        lazyDocument->materializeNext(lazyDocument->pendingCount(), created);
+        insertLazyShapes(created);
+        QApplication::restoreOverrideCursor();
+    }
+    lazyDocument.reset();
+    std::vector<quint32>().swap(lazyShapeIndex);
+
+    // 文档完整之后才能以文件为基准记录操作日志
+    journal.start(currentFilePath, shapes, currentBackgroundColor, m_pageSize, !isModified);
+    queueConnectorRoutes(true);
+}
+
+void DrawArea::cancelLazyLoad() {
+    lazyLoadTimer.stop();
+    lazyDocument.reset();
+    std::vector<quint32>().swap(lazyShapeIndex);
+}
+
+void DrawArea::recoverUnsavedChanges() {
+    const QStringList journals = OperationJournal::pendingRecoveries();
+    if (journals.isEmpty()) {
+        return;
+    }
+
+    const QString journalPath = journals.first();        // 只恢复最近的一次，其余的保留到下次启动
+    QMessageBox::StandardButton answer = QMessageBox::question(
+            this, tr("Recover"),
+            tr("Flowchart did not exit normally last time.\nDo you want to recover the unsaved changes?"),
+            QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes);
+    if (answer != QMessageBox::Yes) {
+        OperationJournal::remove(journalPath);
+        return;
+    }
+
+    DocumentContent content;
+    QString documentPath;
+    bool ok = runBackgroundLoad([journalPath, &documentPath](DocumentContent &result, const ProgressCallback &progress) {
+        return OperationJournal::recover(journalPath, result, documentPath, progress);
+    }, content);
+
+    if (!ok) {                                           // 恢复失败时保留日志文件，便于手动处理
+        return;
+    }
+    applyDocument(content, documentPath, true);
+    OperationJournal::remove(journalPath);
 }
 
 void DrawArea::setCurrentFilePath(const QString &filePath) {
@@ -1169,6 +2729,9 @@ void DrawArea::setCurrentFilePath(const QString &filePath) {
 }
 
 bool DrawArea::maybeSave() {
+    // 先等待正在进行的保存，保存失败时文档仍为已修改状态
+    finishPendingSave();
+
     // 检查当前文件是否被修改
     if (isModified) {
         QMessageBox msgBox(this);           // 弹出消息对话框，提示用户保存文件
@@ -1185,7 +2748,7 @@ bool DrawArea::maybeSave() {
         int ret = msgBox.exec();           // 显示一个模态对话框，并阻塞当前线程直到用户做出选择
 
         if (ret == QMessageBox::Save) {
-            return saveFile();
+            return saveFile() && finishPendingSave();   // 接下来会清空或关闭文档，需要等待保存完成
         } else if (ret == QMessageBox::Cancel) {
             return false;
         }
@@ -1194,6 +2757,7 @@ bool DrawArea::maybeSave() {
 }
 
 void DrawArea::updateAllLineBindings() {
+    PROFILE_SCOPE(LineBindings);
     for (auto shape: shapes) {
         if (auto line = dynamic_cast<LineBaseShape *>(shape)) {       // 判断图形是否为线段类型
             for (int i = 0; i < 2; ++i) {
@@ -1207,10 +2771,17 @@ void DrawArea::updateAllLineBindings() {
                             break;
                         }
                     }
-                    if (targetExists)
+                    if (targetExists) {
+                        QPointF before = i == 0 ? line->getStart() : line->getEnd();
                         line->updateEndPointByBinding(i);     // 更新绑定的端点
-                    else
+                        if (before != (i == 0 ? line->getStart() : line->getEnd())) {
+                            markShapeDirty(line);
+                            updateSpatialIndex(line);
+                        }
+                    } else {
                         line->clearEndPointBinding(i);        // 清除绑定
+                        markShapeDirty(line);
+                    }
                 }
             }
         }
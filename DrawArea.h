@@ -2,24 +2,43 @@
 #define DRAWAREA_H
 
 #include "LineBaseShape.h"
+#include "WaypointLineShape.h"
 #include "MyTextEdit.h"
-#include <QWidget>
+#include "SpatialIndex.h"
+#include "DocumentContent.h"
+#include "OperationJournal.h"
+#include "NativeDocument.h"
+#include "LayoutGraph.h"
+#include "ForceLayout.h"
+#include "MemoryReport.h"
+#include "InputLatency.h"
+#include "TilePyramid.h"
+#include <QAbstractScrollArea>
 #include <QPointF>
 #include <vector>
 #include <QMenu>
 #include <QAction>
 #include <memory>
 #include <stack>
+#include <unordered_map>
+#include <unordered_set>
 #include <QFileDialog>
 #include <QXmlStreamWriter>
 #include <QXmlStreamReader>
-#include <QSvgGenerator>
 #include <QSvgRenderer>
+#include <QPixmap>
+#include <QImage>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QElapsedTimer>
 
 // 存储所有图形状态
 struct ShapeState {
     std::vector<ShapeBase *> shapes;                       //  图形数组
     QUuid selectedShapeId;                                 //  当前选中的图形Uuid
+#ifdef FLOWCHART_PROFILER
+    mutable qint64 memoryBytes = -1;                       //  性能面板估算的内存占用，-1表示尚未估算
+#endif
 
     ShapeState() = default;
 
@@ -35,10 +54,22 @@ struct ShapeState {
     }
 };
 
-class DrawArea : public QWidget {
+// 绘图区域：场景坐标系没有固定大小，范围随页面和图形的外接矩形增长；
+// 控件只绘制视口内的部分，滚动时平移视口中已绘制的像素，只重绘新露出的区域
+class DrawArea : public QAbstractScrollArea {
     Q_OBJECT
 
 public:
+    enum class RegionSelectTool {                               // 区域选择工具
+        Rectangle,                                              // 矩形框选
+        Lasso                                                   // 自由套索
+    };
+
+    enum class RegionSelectMode {                               // 区域选择判定方式
+        Contains,                                               // 图形完全位于区域内才选中
+        Intersects                                              // 图形与区域相交即选中
+    };
+
     DrawArea(QWidget *parent = nullptr);
 
     ~DrawArea();
@@ -57,6 +88,48 @@ public:
 
     bool getGridVisible() const { return m_gridVisible; }       // 获取网格可见性
 
+#ifdef FLOWCHART_PROFILER
+    void setProfilerOverlayVisible(bool visible);               // 显示或隐藏性能面板
+#endif
+
+    void setRegionSelectTool(RegionSelectTool tool) { regionSelectTool = tool; }      // 设置区域选择工具
+
+    RegionSelectTool getRegionSelectTool() const { return regionSelectTool; }         // 获取区域选择工具
+
+    void setRegionSelectMode(RegionSelectMode mode) { regionSelectMode = mode; }      // 设置区域选择判定方式
+
+    RegionSelectMode getRegionSelectMode() const { return regionSelectMode; }         // 获取区域选择判定方式
+
+    void setDraftRenderingEnabled(bool enabled);                                   // 设置连续交互期间是否使用草稿绘制
+
+    bool isDraftRenderingEnabled() const { return draftEnabled; }
+
+    void setDraftIdleDelay(int ms) { draftIdleDelay = qMax(0, ms); }               // 设置交互停止多久后以完整质量重绘
+
+    int getDraftIdleDelay() const { return draftIdleDelay; }
+
+    void setDraftShapeThreshold(int count) { draftShapeThreshold = qMax(0, count); }   // 设置使用草稿绘制的最少图形数量
+
+    int getDraftShapeThreshold() const { return draftShapeThreshold; }
+
+    void setCompressionLevel(int level) { compressionLevel = level; }              // 设置.svgz文件的压缩级别
+
+    int getCompressionLevel() const { return compressionLevel; }                   // 获取.svgz文件的压缩级别
+
+    QPointF mapToScene(const QPoint &pos) const { return pos + scrollOffset(); }    // 视口坐标 -> 场景坐标
+
+    QPoint mapFromScene(const QPointF &pos) const { return (pos - scrollOffset()).toPoint(); }   // 场景坐标 -> 视口坐标
+
+    QRect sceneRect() const { return m_sceneRect; }                                // 可滚动的场景范围（页面和所有图形）
+
+    QRect visibleSceneRect() const { return viewport()->rect().translated(scrollOffset()); }   // 视口当前显示的场景区域
+
+    void centerOn(const QPointF &pos);                                             // 滚动使pos位于视口中心
+
+    void setOverviewEnabled(bool enabled);                                         // 概览图显示时才维护瓦片金字塔，关闭时释放瓦片
+
+    const TilePyramid &overviewTiles() const { return overview; }                 // 概览图使用的瓦片金字塔
+
     ShapeBase *getSelectedShape() const { return selectedShape; }                  // 获取当前选中的图形
 
     const std::vector<ShapeBase *> &getAllShapes() const { return shapes; }        // 获取所有图形
@@ -75,17 +148,25 @@ public:
 
     bool loadFromSvg(const QString &filePath);                  // 从SVG文件中加载图形
 
+    bool loadFromNative(const QString &filePath);               // 从原生二进制文件中加载图形
+
+    bool loadFile(const QString &filePath);                     // 根据文件内容自动选择格式加载
+
+    void finishLazyLoad();                                      // 立即构造按需读取中剩余的全部图形（编辑、保存、录制和回放前调用）
+
+    bool maybeSave();                                           // 文档已修改时询问是否保存，返回false表示取消
+
     bool canUndo() const { return !undoStack.empty(); }         // 是否可撤销
 
     bool canRedo() const { return !redoStack.empty(); }         // 是否可重做
 
-    bool canCopy() const { return selectedShape != nullptr; }   // 是否可复制
+    bool canCopy() const { return canDelete(); }                // 是否可复制
 
-    bool canPaste() const { return clipboardShape != nullptr; } // 是否可粘贴
+    bool canPaste() const { return !clipboardShapes.empty(); }  // 是否可粘贴
 
-    bool canDuplicate() const { return selectedShape != nullptr; } // 是否可复用
+    bool canDuplicate() const { return canDelete(); }           // 是否可复用
 
-    bool canCut() const { return selectedShape != nullptr; }    // 是否可剪切
+    bool canCut() const { return canDelete(); }                 // 是否可剪切
 
     bool canDelete() const;                                     // 是否可删除
 
@@ -97,6 +178,18 @@ public:
 
     bool canMoveDown() const;                                   // 是否可下移
 
+    void notifyShapeChanged(ShapeBase *shape);                  // 图形属性在外部被修改后调用，记录修改并刷新
+
+    void recoverUnsavedChanges();                               // 检查上次异常退出遗留的日志并询问是否恢复
+
+    MemoryReport memoryReport() const;                          // 按子系统和图形类型估算内存占用
+
+    void showMemoryReport();                                    // 显示内存占用报告，可导出为JSON
+
+    InputLatency::Stats inputLatencyStats() const { return inputLatency.stats(); }   // 最近输入事件到画面更新的延迟
+
+    void setMoveCoalescingEnabled(bool enabled);                // 是否按刷新间隔合并鼠标移动（全速回放时关闭，逐个处理录制的移动）
+
 signals:
     void selectionChanged(bool hasSelection);                   // 图形选中状态改变信号
 
@@ -116,6 +209,12 @@ signals:
 
     void deleteSelectedShapeChanged();                          // 删除选中图形并且图形选中状态改变信号
 
+    void forceLayoutPreviewChanged(bool active);                // 力导向布局预览开始或结束信号
+
+    void viewChanged();                                         // 视口显示的场景区域或场景范围改变信号
+
+    void overviewChanged();                                     // 概览图的瓦片更新信号
+
 public slots:
     void moveSelectedShapeToTop();                              // 移动选中图形到顶层对应的槽函数
 
@@ -141,6 +240,16 @@ public slots:
 
     void deleteSelectedShape();                                 // 删除选中图形对应的槽函数
 
+    void autoLayoutHierarchical();                              // 分层自动布局（选中两个以上图形时只布局选中的图形）
+
+    void startForceLayout();                                    // 开始力导向布局的动画预览
+
+    void acceptForceLayout();                                   // 接受预览中的布局，作为一次撤销
+
+    void cancelForceLayout();                                   // 放弃预览，图形回到原来的位置
+
+    void setSelectedConnectorRouting(LineBaseShape::Routing routing);   // 设置选中连线的走线方式
+
 protected:
     void paintEvent(QPaintEvent *event) override;                  // 绘制事件
 
@@ -166,7 +275,33 @@ protected:
 
     void leaveEvent(QEvent *event) override;                       // 鼠标离开控件事件
 
+    void scrollContentsBy(int dx, int dy) override;                // 滚动视口
+
 private:
+    QPoint scrollOffset() const;                                   // 视口左上角的场景坐标
+
+    void updateScene() { sceneUpdateRequested = true; viewport()->update(); }   // 重绘整个视口
+
+    void updateScene(const QRect &rect) {                          // 重绘场景中的rect
+        sceneUpdateRequested = true;
+        viewport()->update(rect.translated(-scrollOffset()));
+    }
+
+    void updateScene(const QRegion &region) {
+        sceneUpdateRequested = true;
+        viewport()->update(region.translated(-scrollOffset()));
+    }
+
+    void scheduleSceneRectUpdate() { sceneRectTimer.start(); }     // 图形增删或移动后，在事件循环空闲时更新场景范围
+
+    void updateSceneRect();                                        // 根据页面和图形的外接矩形更新场景范围和滚动条
+
+    void updateScrollBars();                                       // 根据场景范围和视口大小设置滚动条
+
+    void paintScene(QPainter &painter, const QRect &exposed,
+                    const std::unordered_set<const ShapeBase *> *excluded = nullptr,
+                    bool draft = false);                           // 绘制页面、网格和图形（只绘制与暴露区域相交的图形），跳过excluded中的图形，draft为true时以草稿质量绘制
+
     void drawGrid(QPainter &painter, const QRect &pageRect);       // 绘制网格
 
     void drawRotationButton(QPainter &painter, ShapeBase *shape);  // 绘制旋转按钮
@@ -175,8 +310,70 @@ private:
 
     void drawMagneticPoints(QPainter &painter);           // 绘制磁力点
 
+    void processMouseMove(const QPointF &pos);            // 处理合并后的一次鼠标移动
+
+    void flushPendingMove();                              // 立即处理尚未处理的鼠标移动（其他输入事件之前调用，保持事件顺序）
+
+    int frameIntervalMs() const;                          // 屏幕刷新间隔
+
     void updateAllLineBindings();                         // 更新所有线段端点与图形的绑定关系
 
+    void invalidateSpatialIndex() { spatialIndexDirty = true; scheduleOverviewUpdate(); }   // 图形集合或几何发生变化后标记空间索引失效
+
+    void ensureSpatialIndex();                            // 空间索引失效时重建
+
+    void updateSpatialIndex(ShapeBase *shape);            // 图形移动或缩放后只更新它在空间索引中的外接矩形（索引已失效时不做处理）
+
+    void scheduleOverviewUpdate() {                       // 图形变化后稍后更新概览图
+        if (overviewEnabled && !overviewTimer.isActive()) overviewTimer.start(OVERVIEW_DELAY_MS);
+    }
+
+    void markOverviewDirty(const QRectF &rect);           // 标记概览图中需要重绘的区域（外接矩形不变的样式和图层修改）
+
+    void refreshOverview();                               // 把变化的区域提交给瓦片金字塔并重绘，每次不超过OVERVIEW_BUDGET_MS
+
+    void routeConnector(LineBaseShape *line);             // 绕开周围的图形重新计算一条正交连线的路径（调用前需确保空间索引有效）
+
+    void rerouteConnectors(const QRectF &area);           // 重新计算与area相交的正交连线，超出时间预算的部分留到空闲时处理
+
+    void queueConnectorRoutes(bool all);                  // 把需要计算路径的正交连线加入队列，all为false时只加入路径已过期的连线
+
+    void routePendingConnectors();                        // 计算队列中的连线路径，每次不超过ROUTE_BUDGET_MS
+
+    void beginRegionSelection(const QPointF &pos);        // 开始框选/套索选择
+
+    void updateRegionSelection(const QPointF &pos);       // 更新选择区域并刷新预览
+
+    void finishRegionSelection();                         // 结束区域选择，提交预览结果
+
+    bool refreshRegionPreview(const QRectF &area, const QPolygonF &triangle = QPolygonF());  // 重新判定选择区域变化部分内的候选图形，返回是否有图形移出预览
+
+    bool regionHit(ShapeBase *shape, const QRectF &bounds) const;   // 判断图形是否被当前选择区域选中
+
+    void extendLassoMask(const QPolygonF &triangle);      // 将套索新增的三角形异或到命中掩码
+
+    bool lassoMaskHit(const QPointF &point) const;        // 判断点是否落在套索掩码内
+
+    bool lassoCovers(const QPolygonF &outline, bool requireAll) const;   // 沿轮廓采样判断图形与套索的包含/相交关系
+
+    QRectF regionOverlayBounds() const;                   // 选择区域和预览覆盖层的外接矩形
+
+    void drawRegionSelectionOverlay(QPainter &painter);   // 在覆盖层上绘制选择区域和预览
+
+    void renderSceneCache();                              // 将当前场景渲染到缓存位图
+
+    void beginDragSprite(const std::vector<ShapeBase *> &moving);   // 把被拖动的图形和相连的线段渲染为位图，之后拖动只平移位图
+
+    void moveDragSprite(const QPointF &offset);           // 平移拖动位图并重绘经过的区域
+
+    void drawDragSprite(QPainter &painter, const QRect &exposed);   // 绘制不含被拖动图形的场景缓存、拖动位图和单端相连的线段预览
+
+    void finishDragSprite();                              // 把累计的位移应用到图形上并结束位图拖动
+
+    void noteInteraction();                               // 连续交互（拖动、缩放、滚动）中调用，切换到草稿绘制并推迟精细重绘
+
+    void refineDraft();                                   // 交互停止后以完整质量重绘草稿绘制过的区域
+
     void clearSelection();                                // 清除图形选择状态
 
     void emitSelectionChanged();                          // 触发选择状态改变
@@ -195,17 +392,72 @@ private:
 
     void clearAll();                                      // 清空所有图形
 
+    std::vector<ShapeBase *> collectSelectedShapes() const;                        // 按图层顺序收集所有选中的图形
+
+    void copySelectionToClipboard();                      // 将所有选中的图形拷贝到剪贴板
+
+    void eraseShapes(const std::vector<ShapeBase *> &targets);   // 单次遍历删除一组图形，并解除指向它们的线段绑定
+
+    void editWaypoint(WaypointLineShape *line, const QPointF &pos, bool remove);   // 在pos处插入中间点，或删除pos处的中间点
+
     bool saveToSvg(const QString &filePath);              // 保存为svg
 
     bool saveToPng(const QString &filePath);              // 保存为png
 
-    void serializeToXml(QXmlStreamWriter &writer);        // 序列化到xml
+    bool saveToNative(const QString &filePath);           // 保存为原生二进制格式
+
+    bool saveDocument(const QString &filePath);           // 根据文件后缀选择保存格式
+
+    bool startSave(const QString &filePath, const DocumentSaveTask &task,
+                   bool updatesDocument);                 // 生成文档快照并在工作线程中保存，updatesDocument表示保存后文件成为当前文档
+
+    std::vector<std::shared_ptr<ShapeBase>> snapshotShapes();   // 生成保存快照的图形副本，只复制上次快照以来修改过的图形
+
+    void onSaveFinished();                                // 后台保存完成后更新文件路径和修改状态
+
+    void startLazyLoad(std::unique_ptr<NativeDocumentReader> reader);   // 先构造可见区域的图形，其余的在空闲时分批构造
+
+    void materializeLazyRegion(const QRectF &rect);       // 构造rect内尚未构造的图形
+
+    void insertLazyShapes(const std::vector<quint32> &indices);   // 把新构造的图形按文件顺序合并到图形数组
+
+    void streamLazyShapes();                              // 空闲时构造一批图形，每次不超过LAZY_LOAD_BUDGET_MS
+
+    void cancelLazyLoad();                                // 放弃尚未构造的图形
 
-    bool deserializeFromXml(QXmlStreamReader &reader);    // 从xml解序列化
+    bool runBackgroundLoad(const DocumentLoadTask &task, DocumentContent &content);   // 在工作线程中加载文档并显示可取消的进度
+
+    bool runBackgroundTask(const QString &label, const std::function<bool(const ProgressCallback &)> &task,
+                           bool &wasCancelled);              // 在工作线程中执行任务，等待期间显示可取消的进度
+
+    void applyLayout(const LayoutGraph &graph, const std::vector<QPointF> &positions);   // 将节点移动到布局结果的位置并更新相连的线段，作为一次撤销
+
+    std::vector<ShapeBase *> moveLayoutNodes(const LayoutGraph &graph, const std::vector<QPointF> &from,
+                                             const std::vector<QPointF> &to);   // 将节点从from移动到to，返回移动过的节点和线段
+
+    void runForceLayoutBatch();                           // 在工作线程中执行一帧的力导向迭代
+
+    void onForceLayoutBatchFinished();                    // 显示一帧的迭代结果，未收敛时继续下一帧
+
+    struct ForceLayoutPreview;
+    std::unique_ptr<ForceLayoutPreview> stopForceLayout();   // 结束预览并把节点移回原位置，返回预览的状态
+
+    void applyDocument(DocumentContent &content, const QString &filePath,
+                       bool recovered = false);                 // 将加载完成的文档整体交换到绘图区域，recovered表示内容来自崩溃恢复
+
+    void markShapeDirty(const ShapeBase *shape) {         // 图形内容已修改：下次提交写入操作日志，下次保存重新复制
+        journal.markDirty(shape);
+        saveDirty.insert(shape);
+    }
+
+    void commitEdit() {                                   // 一次编辑完成后写入操作日志
+        journal.commit(shapes);
+        scheduleSceneRectUpdate();
+    }
 
     void setCurrentFilePath(const QString &filePath);     // 设置当前文件路径
 
-    bool maybeSave();                                     // 是否保存文件
+    bool finishPendingSave();                             // 等待正在进行的后台保存完成，返回保存是否成功
 
 private:
     QColor currentBackgroundColor;                        // 当前页面背景颜色
@@ -220,6 +472,7 @@ private:
     QPointF lastMousePos;
     bool isDragging = false;                              // 是否在拖动
     bool isResizing = false;                              // 是否在调整大小
+    bool undoSnapshotPending = false;                     // 按下鼠标后尚未保存撤销状态，第一次真正修改图形时保存
     int resizingHandle;                                   // 正在调整图形的控制点
 
     MyTextEdit *textEdit;                                 // 编辑图形时的文本框
@@ -231,20 +484,136 @@ private:
     bool m_isLandscape = false;                           // 页面是否为横向
     bool m_gridVisible = false;                           // 是否显示网格
 
-    std::unique_ptr<ShapeBase> clipboardShape;            // 剪贴板
+    std::vector<std::unique_ptr<ShapeBase>> clipboardShapes;   // 剪贴板（支持多个图形）
     std::stack<std::unique_ptr<ShapeState>> undoStack;    // 撤销栈
     std::stack<std::unique_ptr<ShapeState>> redoStack;    // 重做栈
 
     QString currentFilePath;                              // 当前文件路径
     bool isModified = false;                              // 文件是否被修改
+    quint64 documentGeneration = 0;                       // 编辑、撤销或清空图形时递增，后台任务据此判断结果是否过期
     QString lastSaveFormat;                               // 当前文件保存格式
 
+    // 正在进行的后台保存
+    struct PendingSave {
+        QString filePath;
+        bool updatesDocument;
+    };
+    QFutureWatcher<bool> saveWatcher;
+    std::unique_ptr<PendingSave> pendingSave;             // 为空表示没有正在进行的保存
+    bool lastSaveSucceeded = true;
+    // 上次保存快照中每个图形的副本。副本生成后不再修改（只重定向线段绑定，此时没有正在进行的保存），
+    // 下次保存时未修改的图形直接沿用，界面线程的复制量与修改量成正比
+    std::unordered_map<const ShapeBase *, std::shared_ptr<ShapeBase>> saveClones;
+    std::unordered_set<const ShapeBase *> saveDirty;      // 上次生成快照以来内容改变的图形
+
+    bool backgroundTaskRunning = false;                   // 是否正在等待后台加载或布局，期间拒绝再次开始
+
+    // 大文档的按需读取，读取完成前不允许编辑，因此图形数组始终按文件顺序排列
+    std::unique_ptr<NativeDocumentReader> lazyDocument;   // 为空表示没有正在进行的按需读取
+    std::vector<quint32> lazyShapeIndex;                  // 图形数组中每个图形在文件中的序号
+    QTimer lazyLoadTimer;
+
+    // 等待计算路径的正交连线，计算完成前显示不考虑障碍物的临时折线
+    std::unordered_set<LineBaseShape *> pendingRoutes;
+    QTimer routeTimer;
+
+    // 力导向布局的动画预览，预览期间节点的移动不记录到撤销栈和操作日志
+    struct ForceLayoutPreview {
+        LayoutGraph graph;                                // 节点原来的位置保存在graph.rects中
+        ForceLayout layout;
+        std::vector<QPointF> shown;                       // 节点当前显示位置的左上角
+    };
+    std::unique_ptr<ForceLayoutPreview> forcePreview;     // 为空表示没有正在预览的布局
+    QFutureWatcher<bool> forceLayoutWatcher;              // 正在执行的一帧迭代，返回是否已收敛
+
     int draggingLineHandle;                               // 正在拖动线段的控制点
     // 存储连接图形的线段指针（这里将线段的放大缩小也视为拖动线段，因为只移动一个点，不是整个图形拖动）
     LineBaseShape *draggingLine = nullptr;
     QPointF lastMagneticPoint;                            // 最近的磁力点
     bool isMagneticActive = false;                        // 是否激活自动吸附
 
+    OperationJournal journal;                             // 崩溃恢复用的操作日志
+
+    SpatialIndex spatialIndex;                            // 图形空间索引
+    bool spatialIndexDirty = true;                        // 空间索引是否需要重建
+    int orthogonalLineCount = 0;                          // 正交连线的数量，重建空间索引时统计
+
+    RegionSelectTool regionSelectTool = RegionSelectTool::Rectangle;   // 当前区域选择工具
+    RegionSelectMode regionSelectMode = RegionSelectMode::Contains;    // 当前区域选择判定方式
+
+    int compressionLevel = GzipDevice::Balanced;          // 保存.svgz时的压缩级别（1-9）
+    bool isRegionSelecting = false;                       // 是否正在进行区域选择
+    QPointF regionOrigin;                                 // 区域选择起点
+    QRectF marqueeRect;                                   // 矩形选择框
+    QPolygonF lassoPolygon;                               // 套索路径
+    QImage lassoMask;                                     // 套索光栅化掩码
+    QPoint lassoMaskOrigin;                               // 套索掩码左上角在场景中的位置
+    std::unordered_map<ShapeBase *, QRectF> regionPreview;   // 即将被选中的图形及其外接矩形
+    QRectF regionPreviewBounds;                           // 所有预览矩形的外接矩形
+    QPixmap sceneCache;                                   // 区域选择期间的场景缓存（视口内的部分）
+    QPoint sceneCacheOrigin;                              // 场景缓存左上角的场景坐标
+
+    QRect m_sceneRect;                                    // 可滚动的场景范围
+    QTimer sceneRectTimer;
+    static const int SCENE_MARGIN = 50;                   // 场景范围在页面和图形外留出的空白
+    static const int SCROLL_STEP = 20;                    // 滚动条单步滚动的距离
+
+    static constexpr qreal PAINT_MARGIN = 40.0;           // 可见性判断时外接矩形的扩展量
+    static constexpr qreal LASSO_SAMPLE_STEP = 4.0;       // 套索顶点和轮廓采样的最小间距
+    static const int LASSO_MASK_PADDING = 256;            // 套索掩码扩大时四周预留的余量
+    static constexpr quint32 LAZY_LOAD_THRESHOLD = 20000; // 图形数量达到该值的.fcd文档按需读取
+    static constexpr qint64 LAZY_LOAD_BUDGET_MS = 8;      // 每次空闲构造图形的时间上限
+    static const int FORCE_LAYOUT_FRAME_MS = 30;          // 力导向布局每帧迭代的时间上限
+    static constexpr qint64 ROUTE_BUDGET_MS = 4;          // 每次鼠标移动或空闲时计算连线路径的时间上限
+
+    // 鼠标移动的合并：高回报率的鼠标每帧会产生多个移动事件，只记录最新位置，每个刷新间隔最多处理一次
+    bool moveCoalescing = true;                           // 是否合并鼠标移动
+    bool hasPendingMove = false;                          // 是否有尚未处理的鼠标移动
+    QPointF pendingMovePos;                               // 最新的鼠标位置
+    ulong pendingMoveTimestamp = 0;                       // 合并的移动中最早一个的时间戳
+    bool sceneUpdateRequested = false;                    // 处理移动期间是否请求了重绘
+    QTimer moveTimer;                                     // 到下一个刷新间隔时处理鼠标移动
+    QElapsedTimer lastMoveFrame;                          // 上次处理鼠标移动的时间
+    InputLatency inputLatency;                            // 输入事件到绘制完成的延迟
+
+    // 位图拖动：拖动大量图形时不逐个移动图形，而是平移预先渲染的位图，松开鼠标时才移动图形
+    struct DragSprite {
+        std::vector<ShapeBase *> moving;                  // 松开鼠标时需要移动的图形
+        QPixmap background;                               // 不含被拖动图形及相连线段的场景（视口内的部分）
+        QPoint backgroundOrigin;                          // background左上角的场景坐标
+        QPixmap sprite;                                   // 被拖动的图形和两端都连在它们上面的线段
+        QPointF origin;                                   // 位图左上角的场景坐标
+        QPointF offset;                                   // 累计位移
+        std::vector<QLineF> rubberBands;                  // 只有一端相连的线段：固定端 -> 相连端（拖动前的位置）
+        QRectF rubberBounds;                              // 所有固定端和相连端的外接矩形
+    };
+    std::unique_ptr<DragSprite> dragSprite;               // 为空表示没有正在进行的位图拖动
+    static const int DRAG_SPRITE_THRESHOLD = 50;          // 一次拖动的图形数量达到该值时使用位图拖动
+
+    // 渐进绘制：连续交互期间关闭抗锯齿、使用实线和文本占位条，停止交互draftIdleDelay毫秒后重绘这些区域
+    bool draftEnabled = true;                             // 是否启用草稿绘制
+    int draftIdleDelay = 200;                             // 停止交互后等待多久以完整质量重绘（毫秒）
+    int draftShapeThreshold = 2000;                       // 图形少于该数量时完整绘制已经足够快，不使用草稿绘制
+    bool draftActive = false;                             // 当前是否处于草稿绘制
+    QRegion draftRegion;                                  // 以草稿质量绘制过、等待重绘的区域（场景坐标）
+    QTimer refineTimer;
+
+    // 概览图：变化的区域来自空间索引重建前后的比较和逐个图形的索引更新，瓦片在空闲时按时间预算增量重绘，拖动等连续编辑期间暂停
+    TilePyramid overview;
+    bool overviewEnabled = false;                         // 概览图是否显示
+    std::vector<QRectF> overviewDirty;                    // 尚未提交给瓦片金字塔的变化区域（场景坐标）
+    bool overviewDirtyAll = false;                        // 变化太多或无法比较时全部重绘
+    QTimer overviewTimer;
+    static const int OVERVIEW_DELAY_MS = 100;             // 图形变化后等待多久开始更新概览图
+    static constexpr qint64 OVERVIEW_BUDGET_MS = 4;       // 每次更新概览图的时间上限
+    static const size_t OVERVIEW_DIRTY_LIMIT = 4096;      // 变化区域超过该数量时全部重绘
+
+#ifdef FLOWCHART_PROFILER
+    qint64 estimateUndoMemory() const;                    // 估算撤销栈和重做栈占用的内存
+
+    QTimer profilerTimer;                                 // 定时刷新性能面板
+#endif
+
 };
 
 #endif  // DRAWAREA_H
\ No newline at end of file
@@ -0,0 +1,227 @@
+﻿#include "ForceLayout.h"
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtMath>
+#include <atomic>
+#include <limits>
+
+namespace {
+    const qreal EDGE_GAP = 60.0;                      // 理想边长在节点平均尺寸之上增加的间距
+    const qreal MIN_CELL_SIZE = 0.01;                 // 单元小于该值时不再细分，重合的节点放在同一个叶子中
+    const qreal MIN_DISTANCE2 = 1e-6;
+
+    // 重合的节点之间按编号取一个固定方向推开，保证结果可重复
+    QPointF separationDirection(int body) {
+        const qreal angle = body * 2.399963;          // 黄金角，相邻编号的方向尽量分散
+        return QPointF(qCos(angle), qSin(angle));
+    }
+
+    inline qreal lengthSquared(const QPointF &p) {
+        return p.x() * p.x() + p.y() * p.y();
+    }
+}
+
+ForceLayout::ForceLayout(const LayoutGraph &graph) : m_edges(graph.edges) {
+    const size_t count = graph.rects.size();
+    m_centers.reserve(count);
+    m_sizes.reserve(count);
+    qreal averageSize = 0;
+    for (const QRectF &rect: graph.rects) {
+        m_centers.push_back(rect.center());
+        m_sizes.push_back(rect.size());
+        m_center += rect.center();
+        averageSize += (rect.width() + rect.height()) / 2;
+    }
+    m_displacement.resize(count);
+    m_leafOf.resize(count, -1);
+
+    if (count >= 2) {
+        m_center /= count;
+        m_k = averageSize / count + EDGE_GAP;
+        m_temperature = m_k * 2;
+    }
+}
+
+bool ForceLayout::step(int maxMilliseconds) {
+    QElapsedTimer timer;
+    timer.start();
+    while (!isConverged()) {
+        iterate();
+        if (timer.elapsed() >= maxMilliseconds) break;
+    }
+    return isConverged();
+}
+
+std::vector<QPointF> ForceLayout::positions() const {
+    std::vector<QPointF> result;
+    result.reserve(m_centers.size());
+    for (size_t i = 0; i < m_centers.size(); ++i) {
+        result.push_back(m_centers[i] - QPointF(m_sizes[i].width() / 2, m_sizes[i].height() / 2));
+    }
+    return result;
+}
+
+void ForceLayout::iterate() {
+    const int count = static_cast<int>(m_centers.size());
+    buildTree();
+
+    // 排斥力和引力只读取坐标和四叉树，每个节点写自己的位移，可以分块并行
+    std::atomic<int> nextChunk(0);
+    const int chunkCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    auto computeNextChunk = [&]() {
+        const int chunk = nextChunk.fetch_add(1);
+        if (chunk >= chunkCount) {
+            return false;
+        }
+        const int end = qMin(count, (chunk + 1) * CHUNK_SIZE);
+        for (int i = chunk * CHUNK_SIZE; i < end; ++i) {
+            // 引力大小为GRAVITY·d²/k，孤立节点停在与图规模相称的距离上
+            const QPointF toCenter = m_center - m_centers[i];
+            m_displacement[i] = repulsion(i) + toCenter * (GRAVITY * qSqrt(lengthSquared(toCenter)) / m_k);
+        }
+        return true;
+    };
+
+    QVector<QFuture<void>> helpers;
+    if (count > PARALLEL_THRESHOLD) {
+        const int helperCount = qMin(chunkCount, QThread::idealThreadCount()) - 1;
+        for (int i = 0; i < helperCount; ++i) {
+            helpers.append(QtConcurrent::run([&computeNextChunk]() {
+                while (computeNextChunk()) {}
+            }));
+        }
+    }
+    while (computeNextChunk()) {}
+    for (QFuture<void> &helper: helpers) {
+        helper.waitForFinished();
+    }
+
+    // 连线的吸引力：大小为d²/k
+    for (const auto &edge: m_edges) {
+        const QPointF delta = m_centers[edge.second] - m_centers[edge.first];
+        const qreal distance = qSqrt(lengthSquared(delta));
+        if (distance <= 0) continue;
+        const QPointF force = delta * (distance / m_k);
+        m_displacement[edge.first] += force;
+        m_displacement[edge.second] -= force;
+    }
+
+    // 每个节点的位移不超过当前温度
+    for (int i = 0; i < count; ++i) {
+        const qreal length = qSqrt(lengthSquared(m_displacement[i]));
+        if (length > m_temperature) {
+            m_displacement[i] *= m_temperature / length;
+        }
+        m_centers[i] += m_displacement[i];
+    }
+    m_temperature *= COOLING;
+    ++m_iteration;
+}
+
+void ForceLayout::buildTree() {
+    m_cells.clear();
+    if (m_centers.empty()) {
+        return;
+    }
+
+    qreal left = std::numeric_limits<qreal>::max();
+    qreal top = left;
+    qreal right = -left;
+    qreal bottom = -left;
+    for (const QPointF &center: m_centers) {
+        left = qMin(left, center.x());
+        top = qMin(top, center.y());
+        right = qMax(right, center.x());
+        bottom = qMax(bottom, center.y());
+    }
+
+    Cell root;
+    root.origin = QPointF(left, top);
+    root.size = qMax(qMax(right - left, bottom - top), MIN_CELL_SIZE) * 1.001;   // 保证最右下的点也落在根单元内
+    m_cells.reserve(m_centers.size() * 2);
+    m_cells.push_back(root);
+    for (int i = 0; i < static_cast<int>(m_centers.size()); ++i) {
+        insert(i);
+    }
+}
+
+int ForceLayout::childFor(int cell, const QPointF &point) {
+    const qreal half = m_cells[cell].size / 2;
+    const QPointF origin = m_cells[cell].origin;
+    const int quadrant = (point.x() >= origin.x() + half ? 1 : 0) + (point.y() >= origin.y() + half ? 2 : 0);
+    if (m_cells[cell].children[quadrant] < 0) {
+        Cell child;
+        child.origin = QPointF(origin.x() + (quadrant & 1 ? half : 0), origin.y() + (quadrant & 2 ? half : 0));
+        child.size = half;
+        m_cells.push_back(child);                     // 可能使引用失效，之后通过索引访问
+        m_cells[cell].children[quadrant] = static_cast<int>(m_cells.size()) - 1;
+    }
+    return m_cells[cell].children[quadrant];
+}
+
+void ForceLayout::insert(int body) {
+    const QPointF point = m_centers[body];
+    int cell = 0;
+    for (;;) {
+        m_cells[cell].mass += 1;
+        m_cells[cell].sum += point;
+        if (m_cells[cell].leaf) {
+            if (m_cells[cell].body < 0) {             // 空叶子
+                m_cells[cell].body = body;
+                m_leafOf[body] = cell;
+                return;
+            }
+            if (m_cells[cell].size < MIN_CELL_SIZE) { // 与已有节点重合
+                m_leafOf[body] = cell;
+                return;
+            }
+
+            // 分裂叶子，原有的节点移到子单元中
+            const int existing = m_cells[cell].body;
+            m_cells[cell].body = -1;
+            m_cells[cell].leaf = false;
+            const int child = childFor(cell, m_centers[existing]);
+            m_cells[child].mass = 1;
+            m_cells[child].sum = m_centers[existing];
+            m_cells[child].body = existing;
+            m_leafOf[existing] = child;
+        }
+        cell = childFor(cell, point);
+    }
+}
+
+QPointF ForceLayout::repulsion(int body) const {
+    const QPointF point = m_centers[body];
+    const qreal k2 = m_k * m_k;
+    QPointF force;
+
+    int stack[256];                                   // 四叉树深度受MIN_CELL_SIZE限制，每层最多净增3个单元
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Cell &cell = m_cells[stack[--top]];
+        qreal mass = cell.mass;
+        QPointF sum = cell.sum;
+        if (cell.leaf && m_leafOf[body] == &cell - m_cells.data()) {
+            mass -= 1;                                // 排除自身
+            sum -= point;
+        }
+        if (mass <= 0) continue;
+
+        QPointF delta = point - sum / mass;
+        qreal distance2 = lengthSquared(delta);
+        if (cell.leaf || cell.size * cell.size < THETA * THETA * distance2) {
+            if (distance2 < MIN_DISTANCE2) {
+                delta = separationDirection(body);
+                distance2 = 1;
+            }
+            force += delta * (k2 * mass / distance2); // 大小为k²/d
+        } else {
+            for (int child: cell.children) {
+                if (child >= 0 && top < 256) stack[top++] = child;
+            }
+        }
+    }
+    return force;
+}
@@ -0,0 +1,67 @@
+﻿#ifndef FORCELAYOUT_H
+#define FORCELAYOUT_H
+
+#include "LayoutGraph.h"
+#include <QPointF>
+#include <QSizeF>
+#include <vector>
+
+// 力导向布局（Fruchterman-Reingold），适用于没有明显方向的图：连线两端的节点互相吸引，
+// 所有节点两两排斥，再加一个指向初始中心的弱引力防止不相连的部分漂走。
+// 排斥力用Barnes-Hut四叉树近似，每次迭代O(n log n)，节点较多时分块在多个线程中计算。
+// 从节点当前位置开始迭代，每次迭代的最大位移（温度）逐步降低直到收敛。
+// step可以在工作线程中调用，调用期间不能在其他线程读取结果
+class ForceLayout {
+public:
+    explicit ForceLayout(const LayoutGraph &graph);
+
+    bool step(int maxMilliseconds);                   // 迭代直到用完时间预算或收敛，返回是否已收敛
+
+    bool isConverged() const { return m_temperature < MIN_TEMPERATURE; }
+
+    int iterationCount() const { return m_iteration; }
+
+    std::vector<QPointF> positions() const;           // 每个节点当前的左上角坐标
+
+    static constexpr qreal THETA = 0.8;               // 单元边长与距离之比小于该值时把单元当作一个质点
+    static constexpr qreal COOLING = 0.97;            // 每次迭代后温度的衰减系数
+    static constexpr qreal MIN_TEMPERATURE = 0.5;     // 最大位移小于半个像素时认为已收敛
+    static constexpr qreal GRAVITY = 0.1;             // 指向初始中心的引力系数（相对于连线的吸引力）
+    static const int PARALLEL_THRESHOLD = 1000;       // 节点数超过该值时多线程计算排斥力
+    static const int CHUNK_SIZE = 256;                // 每个线程每次领取的节点数
+
+private:
+    // 四叉树单元，子单元按索引存放在m_cells中
+    struct Cell {
+        QPointF origin;                               // 左上角
+        qreal size = 0;                               // 边长
+        qreal mass = 0;                               // 包含的节点数
+        QPointF sum;                                  // 包含的节点坐标之和，除以mass为质心
+        int children[4] = {-1, -1, -1, -1};
+        int body = -1;                                // 叶子中的第一个节点，-1表示空叶子
+        bool leaf = true;
+    };
+
+    void iterate();                                   // 执行一次迭代
+
+    void buildTree();                                 // 根据当前坐标重建四叉树
+
+    void insert(int body);
+
+    int childFor(int cell, const QPointF &point);     // 返回点所在的子单元，不存在时创建
+
+    QPointF repulsion(int body) const;                // 其他所有节点对body的排斥力
+
+    std::vector<QPointF> m_centers;                   // 节点中心
+    std::vector<QSizeF> m_sizes;
+    std::vector<std::pair<int, int>> m_edges;
+    std::vector<QPointF> m_displacement;              // 本次迭代的位移
+    std::vector<Cell> m_cells;
+    std::vector<int> m_leafOf;                        // 每个节点所在的叶子单元
+    QPointF m_center;                                 // 初始布局的中心
+    qreal m_k = 0;                                    // 理想边长
+    qreal m_temperature = 0;
+    int m_iteration = 0;
+};
+
+#endif // FORCELAYOUT_H
@@ -0,0 +1,148 @@
+﻿#include "FrameProfiler.h"
+
+#ifdef FLOWCHART_PROFILER
+
+#include <QPainter>
+#include <QFontMetrics>
+#include <QStringList>
+#include <algorithm>
+
+namespace {
+    const int PADDING = 8;
+    const int LINE_HEIGHT = 16;
+    const int TEXT_LINES = 7;
+    const int BAR_WIDTH = 160;
+    const int LABEL_WIDTH = 56;
+    const int OVERLAY_MARGIN = 10;                     // 面板与可见区域左上角的距离
+
+    // 帧耗时直方图的分组上限（毫秒），最后一组不设上限
+    const double BUCKET_LIMITS[] = {4, 8, 16, 33, 66};
+    const int BUCKET_COUNT = sizeof(BUCKET_LIMITS) / sizeof(BUCKET_LIMITS[0]) + 1;
+
+    QString milliseconds(qint64 nanoseconds) {
+        return QString::number(nanoseconds / 1e6, 'f', 2) + " ms";
+    }
+}
+
+FrameProfiler FrameProfiler::s_instance;
+
+void FrameProfiler::markInput() {
+    if (!m_inputPending) {
+        m_inputTimer.start();
+        m_inputPending = true;
+    }
+}
+
+void FrameProfiler::endFrame(const QRect &exposed) {
+    const qint64 paint = m_frameTimer.nsecsElapsed();
+    const bool overlayOnly = m_visible && !m_refreshRect.isEmpty() && m_refreshRect.contains(exposed);
+    m_refreshRect = QRect();
+    if (overlayOnly) {
+        // 面板自身的刷新不计入；在此之前的输入没有引起重绘，不再等待
+        m_current.total = 0;
+        m_current.drawn = 0;
+        m_inputPending = false;
+        return;
+    }
+
+    m_current.paint = paint;
+    if (m_inputPending) {
+        m_current.inputLatency = m_inputTimer.nsecsElapsed();
+        m_inputPending = false;
+    }
+    m_last = m_current;
+    m_current = Frame();
+
+    m_history[m_historyPos] = paint;
+    m_historyPos = (m_historyPos + 1) % m_history.size();
+}
+
+QSize FrameProfiler::overlaySize() const {
+    return QSize(PADDING * 2 + LABEL_WIDTH + BAR_WIDTH + 40, PADDING * 2 + (TEXT_LINES + BUCKET_COUNT) * LINE_HEIGHT + 4);
+}
+
+QRect FrameProfiler::refreshRect(const QPoint &origin) {
+    const QRect rect(origin + QPoint(OVERLAY_MARGIN, OVERLAY_MARGIN), overlaySize());
+    m_refreshRect = m_overlayRect.isEmpty() ? rect : rect.united(m_overlayRect);
+    return m_refreshRect;
+}
+
+void FrameProfiler::setOverlayVisible(bool visible) {
+    m_visible = visible;
+    if (!visible) {
+        m_overlayRect = QRect();
+    }
+}
+
+void FrameProfiler::drawOverlay(QPainter &painter, const QPoint &origin) {
+    if (!m_visible) return;
+
+    const QRect rect(origin + QPoint(OVERLAY_MARGIN, OVERLAY_MARGIN), overlaySize());
+    m_overlayRect = rect;
+
+    // 统计直方图和平均、最大帧耗时
+    int buckets[BUCKET_COUNT] = {};
+    qint64 sum = 0;
+    qint64 worst = 0;
+    int frames = 0;
+    for (qint64 paint: m_history) {
+        if (paint < 0) continue;
+        const double ms = paint / 1e6;
+        const int bucket = static_cast<int>(std::upper_bound(BUCKET_LIMITS, BUCKET_LIMITS + BUCKET_COUNT - 1, ms)
+                                            - BUCKET_LIMITS);
+        ++buckets[bucket];
+        sum += paint;
+        worst = qMax(worst, paint);
+        ++frames;
+    }
+
+    const Frame &f = m_last;
+    QStringList lines;
+    lines << "paint " + milliseconds(f.paint) + "  avg " + milliseconds(frames ? sum / frames : 0)
+             + "  max " + milliseconds(worst)
+          << QString("shapes drawn %1 / skipped %2").arg(f.drawn).arg(f.total - f.drawn)
+          << "hit test " + milliseconds(f.sections[HitTest])
+          << "line bindings " + milliseconds(f.sections[LineBindings])
+          << "undo snapshot " + milliseconds(f.sections[UndoSnapshot])
+          << "mouse events " + milliseconds(f.sections[MouseEvent]) + "  input->frame "
+             + (f.inputLatency >= 0 ? milliseconds(f.inputLatency) : QString("-"))
+          << "undo memory " + QString::number(m_undoMemory / (1024.0 * 1024.0), 'f', 1) + " MB";
+
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(QColor(0, 0, 0, 190));
+    painter.drawRect(rect);
+
+    QFont font("Consolas");
+    font.setStyleHint(QFont::Monospace);
+    font.setPixelSize(12);
+    painter.setFont(font);
+    painter.setPen(Qt::white);
+    int y = rect.top() + PADDING;
+    for (const QString &line: lines) {
+        painter.drawText(QRect(rect.left() + PADDING, y, rect.width() - PADDING * 2, LINE_HEIGHT),
+                         Qt::AlignLeft | Qt::AlignVCenter, line);
+        y += LINE_HEIGHT;
+    }
+
+    // 帧耗时直方图：超过16ms（低于60帧）的分组用红色
+    y += 4;
+    const int maxCount = qMax(1, *std::max_element(buckets, buckets + BUCKET_COUNT));
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        const QString label = i < BUCKET_COUNT - 1 ? QString("<%1ms").arg(BUCKET_LIMITS[i])
+                                                   : QString(">%1ms").arg(BUCKET_LIMITS[BUCKET_COUNT - 2]);
+        painter.setPen(Qt::white);
+        painter.drawText(QRect(rect.left() + PADDING, y, LABEL_WIDTH, LINE_HEIGHT), Qt::AlignLeft | Qt::AlignVCenter,
+                         label);
+        const int width = buckets[i] * BAR_WIDTH / maxCount;
+        painter.fillRect(QRect(rect.left() + PADDING + LABEL_WIDTH, y + 3, width, LINE_HEIGHT - 6),
+                         i < 3 ? QColor(80, 200, 120) : QColor(230, 80, 70));
+        painter.drawText(QRect(rect.left() + PADDING + LABEL_WIDTH + width + 4, y, 40, LINE_HEIGHT),
+                         Qt::AlignLeft | Qt::AlignVCenter, QString::number(buckets[i]));
+        y += LINE_HEIGHT;
+    }
+    painter.restore();
+}
+
+#endif // FLOWCHART_PROFILER
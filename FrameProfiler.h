@@ -0,0 +1,119 @@
+﻿#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+// 帧耗时和热点路径的性能面板。使用 -DFLOWCHART_ENABLE_PROFILER=ON 编译时才启用，
+// 未启用时下面的宏全部展开为空，插桩不产生任何代码
+#ifdef FLOWCHART_PROFILER
+
+#include <QElapsedTimer>
+#include <QRect>
+#include <QPoint>
+#include <QSize>
+#include <vector>
+
+class QPainter;
+
+class FrameProfiler {
+public:
+    enum Section {                                     // 计时的热点路径，两次绘制之间的耗时累加到下一帧
+        HitTest,                                       // 遍历图形做命中测试（containPoint等）
+        LineBindings,                                  // updateAllLineBindings
+        UndoSnapshot,                                  // saveToUndoStack
+        MouseEvent,                                    // 鼠标事件处理
+        SectionCount
+    };
+
+    static FrameProfiler &instance() { return s_instance; }
+
+    void addTime(Section section, qint64 nanoseconds) { m_current.sections[section] += nanoseconds; }
+
+    void markInput();                                  // 收到输入事件，记录到下一帧绘制完成的延迟
+
+    void setShapeCount(int count) { m_current.total += count; }
+
+    void countDrawn() { ++m_current.drawn; }
+
+    void setUndoMemory(qint64 bytes) { m_undoMemory = bytes; }
+
+    void beginFrame() { m_frameTimer.start(); }
+
+    void endFrame(const QRect &exposed);               // 结束一帧；只重绘面板本身的帧不计入统计
+
+    void drawOverlay(QPainter &painter, const QPoint &origin);   // 在origin处绘制最近一帧的统计和帧耗时直方图
+
+    QRect refreshRect(const QPoint &origin);           // 面板刷新时需要重绘的区域（上次和本次的位置）
+
+    bool isOverlayVisible() const { return m_visible; }
+
+    void setOverlayVisible(bool visible);
+
+    static const int HISTORY_SIZE = 240;               // 直方图统计最近的帧数
+    static const int REFRESH_INTERVAL_MS = 250;        // 面板的刷新间隔
+
+private:
+    struct Frame {
+        qint64 paint = 0;                              // 以下时间单位均为纳秒
+        qint64 sections[SectionCount] = {};
+        qint64 inputLatency = -1;                      // -1表示这一帧之前没有输入事件
+        int total = 0;                                 // 参与可见性判断的图形数
+        int drawn = 0;
+    };
+
+    QSize overlaySize() const;
+
+    static FrameProfiler s_instance;
+
+    Frame m_current;                                   // 正在累计的一帧
+    Frame m_last;                                      // 最近完成的一帧，面板显示它
+    std::vector<qint64> m_history = std::vector<qint64>(HISTORY_SIZE, -1);   // 最近的帧绘制耗时（环形），-1为空位
+    size_t m_historyPos = 0;
+    QElapsedTimer m_frameTimer;
+    QElapsedTimer m_inputTimer;
+    bool m_inputPending = false;
+    qint64 m_undoMemory = 0;                           // 撤销/重做栈的估算内存（字节）
+    bool m_visible = false;
+    QRect m_overlayRect;                               // 面板上次绘制的位置
+    QRect m_refreshRect;                               // 最近一次面板刷新请求重绘的区域
+};
+
+// 在作用域结束时把耗时累加到section
+class ProfileScope {
+public:
+    explicit ProfileScope(FrameProfiler::Section section) : m_section(section) { m_timer.start(); }
+
+    ~ProfileScope() { FrameProfiler::instance().addTime(m_section, m_timer.nsecsElapsed()); }
+
+    ProfileScope(const ProfileScope &) = delete;
+
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    FrameProfiler::Section m_section;
+    QElapsedTimer m_timer;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(section) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(FrameProfiler::section)
+#define PROFILE_INPUT() FrameProfiler::instance().markInput()
+#define PROFILE_SHAPE_COUNT(count) FrameProfiler::instance().setShapeCount(static_cast<int>(count))
+#define PROFILE_SHAPE_DRAWN() FrameProfiler::instance().countDrawn()
+#define PROFILE_UNDO_MEMORY(bytes) do { \
+        if (FrameProfiler::instance().isOverlayVisible()) FrameProfiler::instance().setUndoMemory(bytes); \
+    } while (0)
+#define PROFILE_FRAME_BEGIN() FrameProfiler::instance().beginFrame()
+#define PROFILE_FRAME_END(exposed) FrameProfiler::instance().endFrame(exposed)
+
+#else
+
+#define PROFILE_SCOPE(section)
+#define PROFILE_INPUT()
+#define PROFILE_SHAPE_COUNT(count)
+#define PROFILE_SHAPE_DRAWN()
+#define PROFILE_UNDO_MEMORY(bytes)
+#define PROFILE_FRAME_BEGIN()
+#define PROFILE_FRAME_END(exposed)
+
+#endif // FLOWCHART_PROFILER
+
+#endif // FRAMEPROFILER_H
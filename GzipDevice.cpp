@@ -0,0 +1,157 @@
+﻿#include "GzipDevice.h"
+#include <zlib.h>
+#include <cstring>
+#include <limits>
+
+namespace {
+    const int BUFFER_SIZE = 64 * 1024;
+    const int WINDOW_BITS = 15;                     // 最大窗口（32KB）
+    const int GZIP_HEADER = 16;                     // deflateInit2中加16表示写gzip头
+    const int AUTO_HEADER = 32;                     // inflateInit2中加32表示自动识别gzip/zlib头
+
+    uInt clampSize(qint64 size) {
+        return static_cast<uInt>(qMin<qint64>(size, std::numeric_limits<uInt>::max()));
+    }
+}
+
+GzipDevice::GzipDevice(QIODevice *device, int level, QObject *parent)
+        : QIODevice(parent), m_device(device), m_level(level), m_stream(new z_stream_s) {
+}
+
+GzipDevice::~GzipDevice() {
+    close();
+}
+
+bool GzipDevice::open(OpenMode mode) {
+    const OpenMode access = mode & ReadWrite;
+    if (isOpen() || !m_device || (access != ReadOnly && access != WriteOnly)) {
+        return false;                               // 压缩流不能同时读写
+    }
+    if (!(m_device->openMode() & access)) {
+        return false;
+    }
+
+    std::memset(m_stream.get(), 0, sizeof(z_stream_s));
+    const int ret = access == ReadOnly
+                    ? inflateInit2(m_stream.get(), WINDOW_BITS + AUTO_HEADER)
+                    : deflateInit2(m_stream.get(), m_level, Z_DEFLATED, WINDOW_BITS + GZIP_HEADER, 8,
+                                   Z_DEFAULT_STRATEGY);
+    if (ret != Z_OK) {
+        return false;
+    }
+
+    m_buffer.resize(BUFFER_SIZE);
+    m_streamEnd = false;
+    m_failed = false;
+    return QIODevice::open(access | Unbuffered);   // 已有自己的缓冲区，避免QIODevice再缓冲一次
+}
+
+void GzipDevice::close() {
+    if (!isOpen()) {
+        return;
+    }
+    if (openMode() & WriteOnly) {
+        if (!m_failed && !deflateInput(nullptr, 0, Z_FINISH)) {
+            m_failed = true;
+        }
+        deflateEnd(m_stream.get());
+    } else {
+        inflateEnd(m_stream.get());
+    }
+    m_buffer.clear();
+    QIODevice::close();
+}
+
+qint64 GzipDevice::size() const {
+    return m_device ? m_device->size() : 0;
+}
+
+qint64 GzipDevice::pos() const {
+    if (!m_device || !isOpen()) {
+        return 0;
+    }
+    // 已读入缓冲区但尚未解压的数据不计入进度
+    return (openMode() & ReadOnly) ? m_device->pos() - m_stream->avail_in : m_device->pos();
+}
+
+bool GzipDevice::atEnd() const {
+    return !isOpen() || ((m_streamEnd || m_failed) && QIODevice::bytesAvailable() == 0);
+}
+
+bool GzipDevice::isGzip(QIODevice *device) {
+    const QByteArray magic = device->peek(2);
+    return magic.size() == 2 && static_cast<uchar>(magic[0]) == 0x1f && static_cast<uchar>(magic[1]) == 0x8b;
+}
+
+qint64 GzipDevice::readData(char *data, qint64 maxSize) {
+    if (m_failed) {
+        return -1;
+    }
+    if (m_streamEnd || maxSize <= 0) {
+        return 0;
+    }
+
+    const uInt capacity = clampSize(maxSize);
+    m_stream->next_out = reinterpret_cast<Bytef *>(data);
+    m_stream->avail_out = capacity;
+    while (m_stream->avail_out > 0 && !m_streamEnd) {
+        if (m_stream->avail_in == 0) {
+            const qint64 count = m_device->read(m_buffer.data(), m_buffer.size());
+            if (count <= 0) {                       // 压缩数据在流结束之前被截断
+                m_failed = true;
+                break;
+            }
+            m_stream->next_in = reinterpret_cast<Bytef *>(m_buffer.data());
+            m_stream->avail_in = static_cast<uInt>(count);
+        }
+
+        const int ret = inflate(m_stream.get(), Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            m_streamEnd = true;
+        } else if (ret != Z_OK) {
+            m_failed = true;
+            setErrorString(QString::fromLatin1(m_stream->msg ? m_stream->msg : "corrupt gzip data"));
+            break;
+        }
+    }
+
+    const qint64 produced = capacity - m_stream->avail_out;
+    return produced == 0 && m_failed ? -1 : produced;
+}
+
+qint64 GzipDevice::writeData(const char *data, qint64 maxSize) {
+    // 每次最多交给zlib uInt能表示的长度
+    for (qint64 written = 0; written < maxSize;) {
+        const uInt size = clampSize(maxSize - written);
+        if (!deflateInput(data + written, size, Z_NO_FLUSH)) {
+            return -1;
+        }
+        written += size;
+    }
+    return maxSize;
+}
+
+bool GzipDevice::deflateInput(const char *data, qint64 size, int flush) {
+    if (m_failed) {
+        return false;
+    }
+
+    m_stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    m_stream->avail_in = static_cast<uInt>(size);
+    do {
+        // 输出缓冲区写满说明还有压缩数据没有取出
+        m_stream->next_out = reinterpret_cast<Bytef *>(m_buffer.data());
+        m_stream->avail_out = static_cast<uInt>(m_buffer.size());
+        if (deflate(m_stream.get(), flush) == Z_STREAM_ERROR) {
+            m_failed = true;
+            return false;
+        }
+        const qint64 have = m_buffer.size() - m_stream->avail_out;
+        if (have > 0 && m_device->write(m_buffer.constData(), have) != have) {
+            m_failed = true;
+            setErrorString(m_device->errorString());
+            return false;
+        }
+    } while (m_stream->avail_out == 0);
+    return true;
+}
@@ -0,0 +1,56 @@
+﻿#ifndef GZIPDEVICE_H
+#define GZIPDEVICE_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include <memory>
+
+struct z_stream_s;
+
+// gzip压缩流，包装另一个设备（文件），读写时逐块压缩/解压，不需要把整个文件放到内存中。
+// 只支持只读或只写方式打开，打开和关闭时不会打开或关闭被包装的设备
+class GzipDevice : public QIODevice {
+public:
+    enum CompressionLevel {
+        Fastest = 1,                       // 速度优先
+        Balanced = 6,                      // zlib默认级别
+        Smallest = 9                       // 体积优先
+    };
+
+    explicit GzipDevice(QIODevice *device, int level = Balanced, QObject *parent = nullptr);
+
+    ~GzipDevice() override;
+
+    bool open(OpenMode mode) override;
+
+    void close() override;                 // 写入模式下结束压缩流并写出剩余数据
+
+    bool isSequential() const override { return true; }
+
+    qint64 size() const override;          // 被包装设备的大小（压缩后），用于计算读取进度
+
+    qint64 pos() const override;           // 被包装设备中已读取的位置（压缩后）
+
+    bool atEnd() const override;
+
+    bool hasError() const { return m_failed; }   // 压缩数据损坏或写入失败
+
+    static bool isGzip(QIODevice *device); // 根据文件头判断设备中是否为gzip数据（不改变读取位置）
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    bool deflateInput(const char *data, qint64 size, int flush);   // 压缩一段数据并写入被包装的设备
+
+    QIODevice *m_device;
+    int m_level;
+    std::unique_ptr<z_stream_s> m_stream;
+    QByteArray m_buffer;                   // 压缩数据缓冲区
+    bool m_streamEnd = false;              // 读取时已到达压缩流末尾
+    bool m_failed = false;
+};
+
+#endif // GZIPDEVICE_H
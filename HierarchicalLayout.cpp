@@ -0,0 +1,370 @@
+﻿#include "HierarchicalLayout.h"
+#include <QtMath>
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+
+namespace {
+    const qreal DUMMY_WIDTH = 10.0;                   // 虚拟节点占用的宽度
+
+    // 分层后的图：前n个顶点为原节点，之后为虚拟节点，边只连接相邻两层
+    struct LayeredGraph {
+        std::vector<int> layer;
+        std::vector<qreal> width;
+        std::vector<std::vector<int>> up;             // 上一层的邻居
+        std::vector<std::vector<int>> down;           // 下一层的邻居
+        std::vector<std::vector<int>> layers;         // 每层的顶点，按当前顺序
+        std::vector<int> order;                       // 顶点在所在层中的位置
+
+        int addVertex(int layerIndex, qreal w) {
+            layer.push_back(layerIndex);
+            width.push_back(w);
+            up.emplace_back();
+            down.emplace_back();
+            order.push_back(0);
+            return static_cast<int>(layer.size()) - 1;
+        }
+
+        void addEdge(int u, int v) {
+            down[u].push_back(v);
+            up[v].push_back(u);
+        }
+    };
+
+    // 去掉自环和重复边，再把深度优先搜索中的回边反转，得到无环的边集
+    std::vector<std::pair<int, int>> removeCycles(int n, const std::vector<std::pair<int, int>> &edges) {
+        std::vector<std::vector<int>> out(n);
+        std::unordered_set<quint64> seen;
+        for (const auto &edge: edges) {
+            if (edge.first == edge.second) continue;
+            if (seen.insert((quint64(quint32(edge.first)) << 32) | quint32(edge.second)).second) {
+                out[edge.first].push_back(edge.second);
+            }
+        }
+
+        std::vector<char> state(n, 0);                // 0：未访问，1：在搜索栈中，2：已完成
+        std::vector<std::pair<int, int>> result;
+        std::unordered_set<quint64> kept;
+        auto keep = [&](int u, int v) {
+            if (kept.insert((quint64(quint32(u)) << 32) | quint32(v)).second) {
+                result.emplace_back(u, v);
+            }
+        };
+
+        std::vector<std::pair<int, size_t>> stack;    // 非递归搜索，避免长链导致栈溢出
+        for (int root = 0; root < n; ++root) {
+            if (state[root] != 0) continue;
+            state[root] = 1;
+            stack.emplace_back(root, 0);
+            while (!stack.empty()) {
+                const int u = stack.back().first;
+                if (stack.back().second < out[u].size()) {
+                    const int v = out[u][stack.back().second++];
+                    if (state[v] == 1) {
+                        keep(v, u);                   // 回边反转
+                    } else {
+                        keep(u, v);
+                        if (state[v] == 0) {
+                            state[v] = 1;
+                            stack.emplace_back(v, 0);
+                        }
+                    }
+                } else {
+                    state[u] = 2;
+                    stack.pop_back();
+                }
+            }
+        }
+        return result;
+    }
+
+    // 最长路径分层，之后把只有出边的节点下移到紧靠其最上方的后继，缩短边的跨度
+    std::vector<int> assignLayers(int n, const std::vector<std::pair<int, int>> &edges) {
+        std::vector<std::vector<int>> out(n);
+        std::vector<int> inDegree(n, 0);
+        for (const auto &edge: edges) {
+            out[edge.first].push_back(edge.second);
+            ++inDegree[edge.second];
+        }
+
+        std::vector<int> topo;
+        topo.reserve(n);
+        std::vector<int> remaining = inDegree;
+        for (int v = 0; v < n; ++v) {
+            if (remaining[v] == 0) topo.push_back(v);
+        }
+        std::vector<int> layer(n, 0);
+        for (size_t i = 0; i < topo.size(); ++i) {
+            const int u = topo[i];
+            for (int v: out[u]) {
+                layer[v] = qMax(layer[v], layer[u] + 1);
+                if (--remaining[v] == 0) topo.push_back(v);
+            }
+        }
+
+        for (auto it = topo.rbegin(); it != topo.rend(); ++it) {
+            const int u = *it;
+            if (inDegree[u] != 0 || out[u].empty()) continue;
+            int lowest = std::numeric_limits<int>::max();
+            for (int v: out[u]) lowest = qMin(lowest, layer[v]);
+            layer[u] = lowest - 1;
+        }
+        return layer;
+    }
+
+    void renumber(LayeredGraph &g, int l) {
+        const std::vector<int> &vertices = g.layers[l];
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            g.order[vertices[i]] = static_cast<int>(i);
+        }
+    }
+
+    // 按相邻层邻居位置的平均值（重心）重新排列一层，没有邻居的顶点保持原位置
+    void sortLayer(LayeredGraph &g, int l, bool useUp) {
+        std::vector<std::pair<double, int>> keys;
+        keys.reserve(g.layers[l].size());
+        for (int v: g.layers[l]) {
+            const std::vector<int> &neighbours = useUp ? g.up[v] : g.down[v];
+            double key = g.order[v];
+            if (!neighbours.empty()) {
+                double sum = 0;
+                for (int w: neighbours) sum += g.order[w];
+                key = sum / neighbours.size();
+            }
+            keys.emplace_back(key, v);
+        }
+        std::stable_sort(keys.begin(), keys.end(), [](const std::pair<double, int> &a, const std::pair<double, int> &b) {
+            return a.first < b.first;
+        });
+        for (size_t i = 0; i < keys.size(); ++i) {
+            g.layers[l][i] = keys[i].second;
+        }
+        renumber(g, l);
+    }
+
+    // 第l层与第l+1层之间的边交叉数：按上端位置排序后统计下端位置的逆序对（树状数组）
+    qint64 countCrossings(const LayeredGraph &g, int l) {
+        std::vector<std::pair<int, int>> edges;
+        for (int u: g.layers[l]) {
+            for (int v: g.down[u]) edges.emplace_back(g.order[u], g.order[v]);
+        }
+        std::sort(edges.begin(), edges.end());
+
+        const size_t size = g.layers[l + 1].size();
+        std::vector<int> tree(size + 1, 0);
+        qint64 crossings = 0;
+        qint64 inserted = 0;
+        for (const auto &edge: edges) {
+            int notGreater = 0;
+            for (size_t i = static_cast<size_t>(edge.second) + 1; i > 0; i -= i & (~i + 1)) notGreater += tree[i];
+            crossings += inserted - notGreater;
+            for (size_t i = static_cast<size_t>(edge.second) + 1; i <= size; i += i & (~i + 1)) ++tree[i];
+            ++inserted;
+        }
+        return crossings;
+    }
+
+    qint64 totalCrossings(const LayeredGraph &g) {
+        qint64 total = 0;
+        for (int l = 0; l + 1 < static_cast<int>(g.layers.size()); ++l) {
+            total += countCrossings(g, l);
+        }
+        return total;
+    }
+
+    qreal spacing(int n, int a, int b) {      // 与虚拟节点之间只保留一半间距
+        return (a < n && b < n) ? HierarchicalLayout::NODE_SPACING : HierarchicalLayout::NODE_SPACING / 2;
+    }
+
+    // 每个顶点向邻居中心靠拢：从左向右和从右向左各求一个满足间距的解，取平均值（仍满足间距约束）
+    void placeLayer(const LayeredGraph &g, int n, int l, bool useUp, std::vector<qreal> &x) {
+        const std::vector<int> &vertices = g.layers[l];
+        const size_t count = vertices.size();
+        if (count == 0) return;
+
+        std::vector<qreal> desired(count);
+        for (size_t i = 0; i < count; ++i) {
+            const int v = vertices[i];
+            const std::vector<int> &neighbours = useUp ? g.up[v] : g.down[v];
+            desired[i] = x[v];
+            if (!neighbours.empty()) {
+                qreal sum = 0;
+                for (int w: neighbours) sum += x[w] + g.width[w] / 2;
+                desired[i] = sum / neighbours.size() - g.width[v] / 2;
+            }
+        }
+
+        std::vector<qreal> left(count), right(count);
+        left[0] = desired[0];
+        for (size_t i = 1; i < count; ++i) {
+            const int a = vertices[i - 1], b = vertices[i];
+            left[i] = qMax(desired[i], left[i - 1] + g.width[a] + spacing(n, a, b));
+        }
+        right[count - 1] = desired[count - 1];
+        for (size_t i = count - 1; i > 0; --i) {
+            const int a = vertices[i - 1], b = vertices[i];
+            right[i - 1] = qMin(desired[i - 1], right[i] - g.width[a] - spacing(n, a, b));
+        }
+        for (size_t i = 0; i < count; ++i) {
+            x[vertices[i]] = (left[i] + right[i]) / 2;
+        }
+    }
+}
+
+bool HierarchicalLayout::compute(const LayoutGraph &graph, std::vector<QPointF> &positions,
+                                 const ProgressCallback &progress) {
+    const int n = static_cast<int>(graph.rects.size());
+    positions.assign(n, QPointF());
+    if (n == 0) {
+        return true;
+    }
+    auto report = [&progress](int percent) {
+        return !progress || progress(percent);
+    };
+
+    // 1. 消除环并分层
+    const std::vector<std::pair<int, int>> edges = removeCycles(n, graph.edges);
+    std::vector<char> connected(n, 0);
+    for (const auto &edge: edges) {
+        connected[edge.first] = connected[edge.second] = 1;
+    }
+    const std::vector<int> layerOf = assignLayers(n, edges);
+    if (!report(10)) return false;
+
+    // 2. 建立分层图，长边拆分为经过虚拟节点的短边
+    LayeredGraph g;
+    int layerCount = 0;
+    for (int v = 0; v < n; ++v) {
+        g.addVertex(connected[v] ? layerOf[v] : -1, graph.rects[v].width());
+        if (connected[v]) layerCount = qMax(layerCount, layerOf[v] + 1);
+    }
+    for (const auto &edge: edges) {
+        int previous = edge.first;
+        for (int l = layerOf[edge.first] + 1; l < layerOf[edge.second]; ++l) {
+            const int dummy = g.addVertex(l, DUMMY_WIDTH);
+            g.addEdge(previous, dummy);
+            previous = dummy;
+        }
+        g.addEdge(previous, edge.second);
+    }
+
+    // 初始顺序取深度优先搜索的访问顺序，相连的节点彼此靠近
+    g.layers.assign(layerCount, std::vector<int>());
+    const int vertexCount = static_cast<int>(g.layer.size());
+    std::vector<char> visited(vertexCount, 0);
+    std::vector<int> stack;
+    for (int root = 0; root < vertexCount; ++root) {
+        if (visited[root] || g.layer[root] < 0 || !g.up[root].empty()) continue;
+        stack.push_back(root);
+        while (!stack.empty()) {
+            const int v = stack.back();
+            stack.pop_back();
+            if (visited[v]) continue;
+            visited[v] = 1;
+            g.layers[g.layer[v]].push_back(v);
+            for (auto it = g.down[v].rbegin(); it != g.down[v].rend(); ++it) {
+                if (!visited[*it]) stack.push_back(*it);
+            }
+        }
+    }
+    for (int l = 0; l < layerCount; ++l) {
+        renumber(g, l);
+    }
+
+    // 3. 上下交替按重心排序，保留交叉数最少的排列
+    std::vector<std::vector<int>> bestLayers = g.layers;
+    qint64 bestCrossings = totalCrossings(g);
+    for (int sweep = 0; sweep < ORDERING_SWEEPS && bestCrossings > 0; ++sweep) {
+        if (sweep % 2 == 0) {
+            for (int l = 1; l < layerCount; ++l) sortLayer(g, l, true);
+        } else {
+            for (int l = layerCount - 2; l >= 0; --l) sortLayer(g, l, false);
+        }
+        const qint64 crossings = totalCrossings(g);
+        if (crossings < bestCrossings) {
+            bestCrossings = crossings;
+            bestLayers = g.layers;
+        }
+        if (!report(10 + 60 * (sweep + 1) / ORDERING_SWEEPS)) return false;
+    }
+    g.layers.swap(bestLayers);
+    for (int l = 0; l < layerCount; ++l) {
+        renumber(g, l);
+    }
+
+    // 4. 计算横坐标：先紧密排列，再交替向上下层邻居的中心靠拢
+    std::vector<qreal> x(vertexCount, 0);
+    for (int l = 0; l < layerCount; ++l) {
+        qreal cursor = 0;
+        int previous = -1;
+        for (int v: g.layers[l]) {
+            if (previous >= 0) cursor += spacing(n, previous, v);
+            x[v] = cursor;
+            cursor += g.width[v];
+            previous = v;
+        }
+    }
+    for (int sweep = 0; sweep < PLACEMENT_SWEEPS; ++sweep) {
+        if (sweep % 2 == 0) {
+            for (int l = 1; l < layerCount; ++l) placeLayer(g, n, l, true, x);
+        } else {
+            for (int l = layerCount - 2; l >= 0; --l) placeLayer(g, n, l, false, x);
+        }
+        if (!report(70 + 25 * (sweep + 1) / PLACEMENT_SWEEPS)) return false;
+    }
+
+    // 纵坐标：每层高度取层内最高的节点，节点在层内垂直居中
+    std::vector<qreal> layerHeight(layerCount, 0);
+    for (int v = 0; v < n; ++v) {
+        if (connected[v]) layerHeight[layerOf[v]] = qMax(layerHeight[layerOf[v]], graph.rects[v].height());
+    }
+    std::vector<qreal> layerTop(layerCount, 0);
+    qreal bottom = 0;
+    for (int l = 0; l < layerCount; ++l) {
+        layerTop[l] = bottom;
+        bottom += layerHeight[l] + LAYER_SPACING;
+    }
+
+    qreal minX = std::numeric_limits<qreal>::max();
+    qreal maxX = -minX;
+    for (int v = 0; v < n; ++v) {
+        if (!connected[v]) continue;
+        const QRectF &rect = graph.rects[v];
+        positions[v] = QPointF(x[v], layerTop[layerOf[v]] + (layerHeight[layerOf[v]] - rect.height()) / 2);
+        minX = qMin(minX, x[v]);
+        maxX = qMax(maxX, x[v] + rect.width());
+    }
+    if (minX > maxX) {                                 // 没有任何连线
+        minX = maxX = 0;
+        bottom = 0;
+    }
+
+    // 5. 没有连线的节点按网格排在下方
+    std::vector<int> isolated;
+    for (int v = 0; v < n; ++v) {
+        if (!connected[v]) isolated.push_back(v);
+    }
+    if (!isolated.empty()) {
+        const int columns = qMax(1, qCeil(qSqrt(static_cast<qreal>(isolated.size()))));
+        qreal rowTop = bottom;
+        for (size_t start = 0; start < isolated.size(); start += columns) {
+            const size_t end = qMin(isolated.size(), start + columns);
+            qreal cursor = minX;
+            qreal rowHeight = 0;
+            for (size_t i = start; i < end; ++i) {
+                const QRectF &rect = graph.rects[isolated[i]];
+                positions[isolated[i]] = QPointF(cursor, rowTop);
+                cursor += rect.width() + NODE_SPACING;
+                rowHeight = qMax(rowHeight, rect.height());
+            }
+            rowTop += rowHeight + LAYER_SPACING;
+        }
+    }
+
+    // 布局整体的左上角与原节点的外接矩形对齐
+    const QPointF offset = graph.bounds().topLeft() - QPointF(minX, 0);
+    for (QPointF &position: positions) {
+        position += offset;
+    }
+    return report(100);
+}
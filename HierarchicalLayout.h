@@ -0,0 +1,27 @@
+﻿#ifndef HIERARCHICALLAYOUT_H
+#define HIERARCHICALLAYOUT_H
+
+#include "LayoutGraph.h"
+#include "DocumentContent.h"
+#include <QPointF>
+#include <vector>
+
+// 分层布局（Sugiyama方法），适用于自上而下的流程图：
+// 1. 反转深度优先搜索中的回边，消除环；
+// 2. 按最长路径分层，跨越多层的边拆分为经过虚拟节点的短边；
+// 3. 按重心上下交替排序每层节点，保留交叉数最少的排列；
+// 4. 每个节点向相邻层邻居的中心靠拢，同时保持层内顺序和间距。
+// 没有连线的节点按网格排在分层结果下方。可在工作线程中调用
+class HierarchicalLayout {
+public:
+    // 计算每个节点新的左上角坐标，布局整体的左上角与原节点的外接矩形对齐。progress返回false时取消
+    static bool compute(const LayoutGraph &graph, std::vector<QPointF> &positions,
+                        const ProgressCallback &progress = ProgressCallback());
+
+    static constexpr qreal NODE_SPACING = 40.0;       // 同层相邻节点的水平间距
+    static constexpr qreal LAYER_SPACING = 60.0;      // 相邻层的垂直间距
+    static const int ORDERING_SWEEPS = 12;            // 排序时上下扫描的次数
+    static const int PLACEMENT_SWEEPS = 8;            // 计算坐标时的迭代次数
+};
+
+#endif // HIERARCHICALLAYOUT_H
@@ -0,0 +1,64 @@
+﻿#include "InputLatency.h"
+#include <algorithm>
+#include <cmath>
+
+InputLatency::InputLatency() {
+    m_clock.start();
+}
+
+void InputLatency::markInput(ulong timestamp) {
+    const qint64 now = m_clock.nsecsElapsed();
+    qint64 eventTime = now;
+    if (timestamp != 0) {
+        const qint64 offset = now / 1000000 - static_cast<qint64>(timestamp);
+        if (!m_hasOffset || offset < m_clockOffset) {
+            m_clockOffset = offset;                    // 目前最快送达的事件
+            m_hasOffset = true;
+        }
+        eventTime = std::min(now, (static_cast<qint64>(timestamp) + m_clockOffset) * 1000000);
+    }
+    if (m_pendingInput < 0 || eventTime < m_pendingInput) {
+        m_pendingInput = eventTime;
+    }
+}
+
+qint64 InputLatency::markFrame() {
+    if (m_pendingInput < 0) {
+        return -1;
+    }
+    const qint64 latency = m_clock.nsecsElapsed() - m_pendingInput;
+    m_pendingInput = -1;
+    if (m_samples.size() < HISTORY_SIZE) {
+        m_samples.push_back(latency);
+    } else {
+        m_samples[m_next] = latency;
+    }
+    m_next = (m_next + 1) % HISTORY_SIZE;
+    return latency;
+}
+
+InputLatency::Stats InputLatency::stats() const {
+    Stats result;
+    if (m_samples.empty()) {
+        return result;
+    }
+    std::vector<qint64> sorted = m_samples;
+    std::sort(sorted.begin(), sorted.end());
+    // 最近秩百分位数
+    auto percentile = [&sorted](double p) {
+        const size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+        return sorted[std::max<size_t>(rank, 1) - 1] / 1e6;
+    };
+    result.count = static_cast<int>(sorted.size());
+    result.p50 = percentile(50);
+    result.p90 = percentile(90);
+    result.p99 = percentile(99);
+    result.max = sorted.back() / 1e6;
+    return result;
+}
+
+void InputLatency::reset() {
+    m_pendingInput = -1;
+    m_samples.clear();
+    m_next = 0;
+}
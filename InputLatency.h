@@ -0,0 +1,42 @@
+﻿#ifndef INPUTLATENCY_H
+#define INPUTLATENCY_H
+
+#include <QElapsedTimer>
+#include <vector>
+
+// 输入延迟统计：从输入事件的时间戳到反映该事件的一帧绘制完成的时间。
+// 事件时间戳来自窗口系统，时钟与QElapsedTimer不同，用观察到的（接收时间 - 时间戳）最小值作为两个时钟的差，
+// 即假设最快的一次事件没有排队；时间戳为0的事件（程序合成的事件）从接收时开始计时。
+// 两帧之间的多个输入只记录最早的一个，因此统计的是用户看到画面响应的最长等待
+class InputLatency {
+public:
+    struct Stats {
+        int count = 0;                                 // 以下时间单位均为毫秒
+        double p50 = 0;
+        double p90 = 0;
+        double p99 = 0;
+        double max = 0;
+    };
+
+    InputLatency();
+
+    void markInput(ulong timestamp);                   // 收到输入事件，timestamp为QInputEvent::timestamp()
+
+    qint64 markFrame();                                // 一帧绘制完成，返回本帧的输入延迟（纳秒），之前没有输入时返回-1
+
+    Stats stats() const;                               // 最近HISTORY_SIZE帧的统计
+
+    void reset();
+
+    static const int HISTORY_SIZE = 1024;
+
+private:
+    QElapsedTimer m_clock;
+    qint64 m_clockOffset = 0;                          // 时间戳（毫秒）换算到m_clock的差值
+    bool m_hasOffset = false;
+    qint64 m_pendingInput = -1;                        // 尚未绘制的最早输入的时间（m_clock纳秒），-1表示没有
+    std::vector<qint64> m_samples;                     // 环形缓冲区（纳秒）
+    size_t m_next = 0;
+};
+
+#endif // INPUTLATENCY_H
@@ -0,0 +1,162 @@
+﻿#include "InputRecorder.h"
+#include "DrawArea.h"
+#include "NativeDocument.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QKeyEvent>
+#include <QMouseEvent>
+
+namespace {
+    const char *const FORMAT_NAME = "flowchart-input";
+    const int FORMAT_VERSION = 1;
+
+    struct TypeName {
+        QEvent::Type type;
+        const char *name;
+    };
+
+    const TypeName TYPE_NAMES[] = {
+            {QEvent::MouseButtonPress,    "press"},
+            {QEvent::MouseButtonRelease,  "release"},
+            {QEvent::MouseButtonDblClick, "doubleclick"},
+            {QEvent::MouseMove,           "move"},
+            {QEvent::KeyPress,            "keypress"},
+            {QEvent::KeyRelease,          "keyrelease"},
+            {QEvent::Leave,               "leave"}
+    };
+
+    const char *typeName(QEvent::Type type) {
+        for (const TypeName &entry: TYPE_NAMES) {
+            if (entry.type == type) return entry.name;
+        }
+        return nullptr;
+    }
+
+    QEvent::Type typeOf(const QString &name) {
+        for (const TypeName &entry: TYPE_NAMES) {
+            if (name == entry.name) return entry.type;
+        }
+        return QEvent::None;
+    }
+}
+
+bool InputRecorder::start(DrawArea *area, const QString &filePath) {
+    stop();
+    area->finishLazyLoad();                          // 快照必须是完整的文档，而不只是已经构造的图形
+    if (!NativeDocument::save(snapshotPath(filePath), area->getAllShapes(), area->getCurrentBackgroundColor(),
+                              area->getPageSizeInPixels())) {
+        return false;
+    }
+
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    QJsonObject header;
+    header["format"] = FORMAT_NAME;
+    header["version"] = FORMAT_VERSION;
+    header["document"] = QFileInfo(snapshotPath(filePath)).fileName();
+    m_file.write(QJsonDocument(header).toJson(QJsonDocument::Compact) + '\n');
+
+    m_area = area;
+    m_area->installEventFilter(this);                // 键盘事件和离开事件
+    m_area->viewport()->installEventFilter(this);    // 鼠标事件
+    m_clock.start();
+    return true;
+}
+
+void InputRecorder::stop() {
+    if (!m_area) return;
+    m_area->removeEventFilter(this);
+    m_area->viewport()->removeEventFilter(this);
+    m_area = nullptr;
+    m_file.close();
+}
+
+QString InputRecorder::snapshotPath(const QString &filePath) {
+    const QFileInfo info(filePath);
+    return info.path() + "/" + info.completeBaseName() + "." + NativeDocument::FILE_SUFFIX;
+}
+
+bool InputRecorder::eventFilter(QObject *watched, QEvent *event) {
+    const char *name = typeName(event->type());
+    auto mouse = dynamic_cast<QMouseEvent *>(event);
+    if (!name || watched != (mouse ? static_cast<QObject *>(m_area->viewport()) : m_area)) {
+        return QObject::eventFilter(watched, event);
+    }
+
+    // 每个事件写一行，程序异常退出时已录制的部分仍然可用
+    QJsonObject record;
+    record["t"] = m_clock.nsecsElapsed() / 1e6;
+    record["type"] = name;
+    if (mouse) {
+        const QPointF pos = m_area->mapToScene(QPoint(0, 0)) + mouse->localPos();   // 场景坐标，与回放时的滚动位置无关
+        record["x"] = pos.x();
+        record["y"] = pos.y();
+        record["button"] = static_cast<int>(mouse->button());
+        record["buttons"] = static_cast<int>(mouse->buttons());
+        record["modifiers"] = static_cast<int>(mouse->modifiers());
+    } else if (auto key = dynamic_cast<QKeyEvent *>(event)) {
+        record["key"] = key->key();
+        record["modifiers"] = static_cast<int>(key->modifiers());
+        record["text"] = key->text();
+        record["repeat"] = key->isAutoRepeat();
+    }
+    m_file.write(QJsonDocument(record).toJson(QJsonDocument::Compact) + '\n');
+    m_file.flush();
+    return QObject::eventFilter(watched, event);
+}
+
+bool InputRecorder::read(const QString &filePath, QString &documentPath, std::vector<Event> &events) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QJsonObject header = QJsonDocument::fromJson(file.readLine()).object();
+    if (header["format"].toString() != FORMAT_NAME || header["version"].toInt() > FORMAT_VERSION) {
+        return false;
+    }
+    documentPath = QFileInfo(filePath).dir().filePath(header["document"].toString());
+
+    events.clear();
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        if (line.isEmpty()) continue;
+        const QJsonObject record = QJsonDocument::fromJson(line).object();
+        Event event;
+        event.type = typeOf(record["type"].toString());
+        if (event.type == QEvent::None) {
+            return false;
+        }
+        event.time = record["t"].toDouble();
+        event.pos = QPointF(record["x"].toDouble(), record["y"].toDouble());
+        event.button = record["button"].toInt();
+        event.buttons = record["buttons"].toInt();
+        event.modifiers = record["modifiers"].toInt();
+        event.key = record["key"].toInt();
+        event.text = record["text"].toString();
+        event.autoRepeat = record["repeat"].toBool();
+        events.push_back(event);
+    }
+    return true;
+}
+
+std::unique_ptr<QEvent> InputRecorder::createEvent(const Event &event, const QPointF &pos) {
+    const Qt::KeyboardModifiers modifiers(event.modifiers);
+    switch (event.type) {
+        case QEvent::MouseButtonPress:
+        case QEvent::MouseButtonRelease:
+        case QEvent::MouseButtonDblClick:
+        case QEvent::MouseMove:
+            return std::unique_ptr<QEvent>(new QMouseEvent(event.type, pos, static_cast<Qt::MouseButton>(event.button),
+                                                           Qt::MouseButtons(event.buttons), modifiers));
+        case QEvent::KeyPress:
+        case QEvent::KeyRelease:
+            return std::unique_ptr<QEvent>(new QKeyEvent(event.type, event.key, modifiers, event.text, event.autoRepeat));
+        default:
+            return std::unique_ptr<QEvent>(new QEvent(event.type));
+    }
+}
@@ -0,0 +1,56 @@
+﻿#ifndef INPUTRECORDER_H
+#define INPUTRECORDER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QFile>
+#include <QPointF>
+#include <QString>
+#include <memory>
+#include <vector>
+
+class DrawArea;
+
+// 绘图区域输入事件的录制：开始时把当前文档保存为同名的.fcd快照，之后绘图区域收到的鼠标和键盘事件
+// 连同时间戳逐行以JSON写入文件（第一行为文件头）。回放工具先打开快照，再按顺序把事件发送给绘图区域。
+// 只录制发给绘图区域本身的事件，文本编辑框中的输入和弹出菜单中的操作不录制
+class InputRecorder : public QObject {
+public:
+    struct Event {
+        double time = 0;                               // 开始录制以来的毫秒数
+        QEvent::Type type = QEvent::None;
+        QPointF pos;                                   // 场景坐标
+        int button = 0;
+        int buttons = 0;
+        int modifiers = 0;
+        int key = 0;
+        QString text;
+        bool autoRepeat = false;
+    };
+
+    explicit InputRecorder(QObject *parent = nullptr) : QObject(parent) {}
+
+    bool start(DrawArea *area, const QString &filePath);   // 保存文档快照并开始录制，失败返回false
+
+    void stop();
+
+    bool isRecording() const { return m_area != nullptr; }
+
+    // 读取录制文件，documentPath为文档快照的完整路径
+    static bool read(const QString &filePath, QString &documentPath, std::vector<Event> &events);
+
+    static std::unique_ptr<QEvent> createEvent(const Event &event, const QPointF &pos);   // 由记录重新构造事件，pos为鼠标事件的视口坐标
+
+    static QString snapshotPath(const QString &filePath);               // 录制文件对应的文档快照路径
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    DrawArea *m_area = nullptr;
+    QFile m_file;
+    QElapsedTimer m_clock;
+};
+
+#endif // INPUTRECORDER_H
@@ -0,0 +1,41 @@
+﻿#include "LayoutGraph.h"
+#include "LineBaseShape.h"
+#include <unordered_map>
+
+LayoutGraph LayoutGraph::build(const std::vector<ShapeBase *> &shapes) {
+    int selectedNodes = 0;
+    for (auto shape: shapes) {
+        if (shape->isSelected() && !dynamic_cast<LineBaseShape *>(shape)) {
+            ++selectedNodes;
+        }
+    }
+    const bool selectedOnly = selectedNodes >= 2;
+
+    LayoutGraph graph;
+    std::unordered_map<const ShapeBase *, int> nodeIndex;
+    for (auto shape: shapes) {
+        if (dynamic_cast<LineBaseShape *>(shape) || (selectedOnly && !shape->isSelected())) continue;
+        nodeIndex.emplace(shape, static_cast<int>(graph.nodes.size()));
+        graph.nodes.push_back(shape);
+        graph.rects.push_back(shape->boundingRect());
+    }
+
+    for (auto shape: shapes) {
+        auto line = dynamic_cast<LineBaseShape *>(shape);
+        if (!line) continue;
+        auto from = nodeIndex.find(line->getEndPointBinding(0).targetShape);
+        auto to = nodeIndex.find(line->getEndPointBinding(1).targetShape);
+        if (from != nodeIndex.end() && to != nodeIndex.end() && from->second != to->second) {
+            graph.edges.emplace_back(from->second, to->second);
+        }
+    }
+    return graph;
+}
+
+QRectF LayoutGraph::bounds() const {
+    QRectF result;
+    for (const QRectF &rect: rects) {
+        result = result.united(rect);
+    }
+    return result;
+}
@@ -0,0 +1,22 @@
+﻿#ifndef LAYOUTGRAPH_H
+#define LAYOUTGRAPH_H
+
+#include "ShapeBase.h"
+#include <QRectF>
+#include <vector>
+#include <utility>
+
+// 自动布局的输入：节点为多边形图形，边为两端都绑定到节点的线段。
+// 在界面线程中从图形生成，布局算法在工作线程中只读取矩形和边，不访问图形本身
+struct LayoutGraph {
+    std::vector<ShapeBase *> nodes;                    // 节点对应的图形，只在界面线程中使用
+    std::vector<QRectF> rects;                         // 节点当前的外接矩形
+    std::vector<std::pair<int, int>> edges;            // 线段起点所在节点 -> 终点所在节点
+
+    // 选中的节点不少于两个时只布局选中的图形，否则布局全部图形
+    static LayoutGraph build(const std::vector<ShapeBase *> &shapes);
+
+    QRectF bounds() const;                             // 所有节点的外接矩形
+};
+
+#endif // LAYOUTGRAPH_H
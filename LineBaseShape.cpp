@@ -7,10 +7,13 @@ LineBaseShape::LineBaseShape(const QPointF &start, const QPointF &end)
         : m_start(start), m_end(end) {}
 
 bool LineBaseShape::containPoint(const QPointF &point) const {
-    // 1. 创建一条从起点到终点的路径
+    // 1. 创建一条从起点到终点的路径（正交走线时为折线）
+    const QVector<QPointF> points = pathPoints();
     QPainterPath path;
-    path.moveTo(m_start);  // 路径起点
-    path.lineTo(m_end);    // 路径终点（直线段）
+    path.moveTo(points.first());                 // 路径起点
+    for (int i = 1; i < points.size(); ++i) {
+        path.lineTo(points[i]);
+    }
 
     // 2. 创建一个“笔触”工具，设置检测宽度
     QPainterPathStroker stroker;
@@ -23,16 +26,22 @@ bool LineBaseShape::containPoint(const QPointF &point) const {
 void LineBaseShape::moveBy(qreal dx, qreal dy) {
     m_start += QPointF(dx, dy);
     m_end += QPointF(dx, dy);
+    for (QPointF &point: m_route) {              // 整体平移时路径仍然有效
+        point += QPointF(dx, dy);
+    }
 }
 
 QRectF LineBaseShape::boundingRect() const {
-    return QRectF(m_start, m_end).normalized();
+    if (m_routing == Straight) {
+        return QRectF(m_start, m_end).normalized();
+    }
+    return QPolygonF(pathPoints()).boundingRect();
 }
 
 QVector<QPointF> LineBaseShape::calculateHandles() const {
     QVector<QPointF> handles;
     handles << m_start
-            << (m_start + m_end) / 2
+            << pathMidPoint()
             << m_end;
 
     return handles;
@@ -114,4 +123,70 @@ void LineBaseShape::updateEndPointByBinding(int index) {
         return;
     }
     setEndPoint(index, points[binding.magneticIndex]);       // 设置端点位置
+}
+
+void LineBaseShape::setRouting(Routing routing) {
+    m_routing = routing;
+    if (routing == Straight) {
+        m_route.clear();
+    }
+}
+
+bool LineBaseShape::needsRoute() const {
+    return m_routing == Orthogonal
+           && (m_route.size() < 2 || m_route.first() != m_start || m_route.last() != m_end);
+}
+
+ConnectorRouter::Endpoint LineBaseShape::routeEndpoint(int index) const {
+    ConnectorRouter::Endpoint endpoint;
+    endpoint.point = index == 0 ? m_start : m_end;
+    const ShapeBase *target = getEndPointBinding(index).targetShape;
+    if (target && !dynamic_cast<const LineBaseShape *>(target)) {
+        endpoint.box = target->boundingRect();
+    }
+    return endpoint;
+}
+
+QVector<QPointF> LineBaseShape::pathPoints() const {
+    if (m_routing == Straight) {
+        return {m_start, m_end};
+    }
+    if (needsRoute()) {                                      // 还没有重新路由，先显示不绕开障碍物的折线
+        QVector<QPointF> points = ConnectorRouter::elbow(routeEndpoint(0), routeEndpoint(1));
+        return points.size() >= 2 ? points : QVector<QPointF>{m_start, m_end};
+    }
+    return m_route;
+}
+
+QPointF LineBaseShape::pathMidPoint() const {
+    const QVector<QPointF> points = pathPoints();
+    qreal total = 0;
+    for (int i = 1; i < points.size(); ++i) {
+        total += QLineF(points[i - 1], points[i]).length();
+    }
+
+    qreal remaining = total / 2;
+    for (int i = 1; i < points.size(); ++i) {
+        const qreal length = QLineF(points[i - 1], points[i]).length();
+        if (remaining <= length && length > 0) {
+            return points[i - 1] + (points[i] - points[i - 1]) * (remaining / length);
+        }
+        remaining -= length;
+    }
+    return (m_start + m_end) / 2;
+}
+
+void LineBaseShape::drawText(QPainter &painter, bool draft) {
+    if (m_text.isEmpty()) {
+        return;
+    }
+    painter.save();
+    QPointF mid = pathMidPoint();
+    QRectF rect(mid.x() - 40, mid.y() - 15, 80, 30);
+
+    painter.setPen(QPen(m_fontColor));
+    QFont font(m_font);
+    painter.setFont(font);
+    drawShapeText(painter, rect, m_textAlignment, draft);
+    painter.restore();
 }
\ No newline at end of file
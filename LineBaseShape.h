@@ -2,6 +2,7 @@
 #define LINEBASESHAPE_H
 
 #include "ShapeBase.h"
+#include "ConnectorRouter.h"
 #include <QLineF>
 
 class LineBaseShape : public ShapeBase {
@@ -15,6 +16,12 @@ public:
                 : targetShape(shape), magneticIndex(index) {}
     };
 
+    // 连线的走线方式
+    enum Routing {
+        Straight = 0,                                       // 起点到终点的直线
+        Orthogonal = 1                                      // 绕开图形的水平/竖直折线
+    };
+
     LineBaseShape(const QPointF &start, const QPointF &end);
 
     virtual ~LineBaseShape() {};
@@ -25,12 +32,16 @@ public:
 
     QRectF boundingRect() const override;
 
+    QPolygonF outline() const override { return QPolygonF(pathPoints()); }
+
     QVector<QPointF> calculateHandles() const override;
 
     int hitHandle(const QPointF &point) const override;
 
     void resizeBy(qreal dx, qreal dy, int handleIndex) override;
 
+    virtual int endPointOfHandle(int handleIndex) const { return handleIndex == 0 ? 0 : 1; }   // 控制点对应的端点，-1表示不是端点
+
     bool isShapeCanRotate() const override { return false; }
 
     QVector<QPointF> getMagneticPoints() const override;
@@ -49,11 +60,24 @@ public:
     EndPointBinding getEndPointBinding(int index) const;                // 根据索引获取端点与图形的绑定关系
     void updateEndPointByBinding(int index);                            // 根据绑定关系更新端点位置
 
+    void setRouting(Routing routing);                                   // 设置走线方式，改为直线时清除已计算的路径
+    Routing getRouting() const { return m_routing; }
+    void setRoute(const QVector<QPointF> &route) { m_route = route; }   // 设置计算好的折线（包含起点和终点）
+    bool needsRoute() const;                                            // 正交走线且路径与当前端点不一致
+    ConnectorRouter::Endpoint routeEndpoint(int index) const;           // 路由用的端点信息（含所绑定图形的外接矩形）
+
+    virtual QVector<QPointF> pathPoints() const;   // 实际显示的折线：直线为两个端点；正交走线的路径过期时为临时折线
+    QPointF pathMidPoint() const;                  // 折线长度一半处的点，用于放置文本和移动控制点
+
 protected:
+    void drawText(QPainter &painter, bool draft);                           // 在折线中点绘制文本
+
     QPointF m_start;
     QPointF m_end;
     EndPointBinding startBinding;                                // 线段起点的绑定信息
     EndPointBinding endBinding;                                  // 线段终点的绑定信息
+    Routing m_routing = Straight;
+    QVector<QPointF> m_route;                                    // 最近一次计算的正交路径，端点改变后失效
 
 };
 
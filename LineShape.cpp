@@ -3,27 +3,21 @@
 
 LineShape::LineShape(const QPointF &start, const QPointF &end) : LineBaseShape(start, end) {}
 
-void LineShape::draw(QPainter &painter) {
+void LineShape::draw(QPainter &painter, bool draft) {
     painter.save();
 
-    painter.setPen(QPen(m_borderColor, m_penWidth, m_borderStyle));
-    painter.drawLine(m_start, m_end);
-
-    if (!m_text.isEmpty()) {
-        painter.save();
-        QPointF mid = (m_start + m_end) / 2;
-        QRectF rect(mid.x() - 40, mid.y() - 15, 80, 30);
-
-        painter.setPen(QPen(m_fontColor));
-        QFont font(m_font);
-        painter.setFont(font);
-        painter.drawText(rect, m_textAlignment, m_text);
-        painter.restore();
+    painter.setPen(QPen(m_borderColor, m_penWidth, penStyle(m_borderStyle, draft)));
+    if (m_routing == Straight) {
+        painter.drawLine(m_start, m_end);
+    } else {
+        painter.drawPolyline(QPolygonF(pathPoints()));
     }
 
+    drawText(painter, draft);
+
     if (m_selected) {
         painter.save();
-        painter.setPen(QPen(Qt::blue, 1, Qt::DashLine));
+        painter.setPen(QPen(Qt::blue, 1, penStyle(Qt::DashLine, draft)));
         painter.setBrush(Qt::white);
 
         // 绘制控制点
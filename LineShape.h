@@ -7,7 +7,7 @@ class LineShape : public LineBaseShape {
 public:
     LineShape(const QPointF &start, const QPointF &end);
 
-    void draw(QPainter &painter) override;
+    void draw(QPainter &painter, bool draft) override;
 
     ShapeBase *clone() const override;
 
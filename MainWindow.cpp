@@ -6,6 +6,11 @@
 #include <QVBoxLayout>
 #include <QGridLayout>
 #include <QAction>
+#include <QActionGroup>
+#include <QTimer>
+#include <QCloseEvent>
+#include <QFileDialog>
+#include <QMessageBox>
 
 MainWindow::MainWindow(QWidget* parent)
 	: QMainWindow(parent)
@@ -15,14 +20,10 @@ MainWindow::MainWindow(QWidget* parent)
 
 	setStyleSheet("QMainWindow { background-color:  #F1F3F4; }");
 
-	// 绘图区域
+	// 绘图区域（自带滚动条，场景范围随图形增长）
 	drawArea = new DrawArea(this);
-	QScrollArea* drawScroll = new QScrollArea(this);
-	drawScroll->setWidget(drawArea);
-	drawScroll->setWidgetResizable(true);
-	drawScroll->setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
-	drawScroll->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
-	setCentralWidget(drawScroll);
+	inputRecorder = new InputRecorder(this);
+	setCentralWidget(drawArea);
 
 	// 菜单栏和工具栏
 	setupMenuBar();
@@ -45,6 +46,22 @@ MainWindow::MainWindow(QWidget* parent)
 	connect(moveBottomAction, &QAction::triggered, drawArea, &DrawArea::moveSelectedShapeToBottom);
 	connect(moveUpAction, &QAction::triggered, drawArea, &DrawArea::moveSelectedShapeUp);
 	connect(moveDownAction, &QAction::triggered, drawArea, &DrawArea::moveSelectedShapeDown);
+	connect(hierarchicalLayoutAction, &QAction::triggered, drawArea, &DrawArea::autoLayoutHierarchical);
+	connect(forceLayoutAction, &QAction::triggered, drawArea, &DrawArea::startForceLayout);
+	connect(acceptLayoutAction, &QAction::triggered, drawArea, &DrawArea::acceptForceLayout);
+	connect(cancelLayoutAction, &QAction::triggered, drawArea, &DrawArea::cancelForceLayout);
+	// 预览期间只能接受或放弃，不能再开始新的预览
+	connect(drawArea, &DrawArea::forceLayoutPreviewChanged, this, [this](bool active) {
+		forceLayoutAction->setEnabled(!active);
+		acceptLayoutAction->setEnabled(active);
+		cancelLayoutAction->setEnabled(active);
+		});
+	connect(orthogonalRoutingAction, &QAction::triggered, drawArea, [this]() {
+		drawArea->setSelectedConnectorRouting(LineBaseShape::Orthogonal);
+		});
+	connect(straightRoutingAction, &QAction::triggered, drawArea, [this]() {
+		drawArea->setSelectedConnectorRouting(LineBaseShape::Straight);
+		});
     // 图形顺序改变时更新工具栏和状态栏
 	connect(drawArea, &DrawArea::shapeOrderChanged, this, &MainWindow::updateActions);
 
@@ -124,28 +141,28 @@ MainWindow::MainWindow(QWidget* parent)
 	connect(propertyPanel, &PropertyPanel::borderColorChanged, this, [this](const QColor& color) {
 		if (auto shape = drawArea->getSelectedShape()) {
 			shape->setBorderColor(color);
-			drawArea->update();
+			drawArea->notifyShapeChanged(shape);
 		}
 		});
 
 	connect(propertyPanel, &PropertyPanel::borderWidthChanged, this, [this](int width) {
 		if (auto shape = drawArea->getSelectedShape()) {
 			shape->setPenWidth(width);
-			drawArea->update();
+			drawArea->notifyShapeChanged(shape);
 		}
 		});
 
 	connect(propertyPanel, &PropertyPanel::borderStyleChanged, this, [this](Qt::PenStyle style) {
 		if (auto shape = drawArea->getSelectedShape()) {
 			shape->setBorderStyle(style);
-			drawArea->update();
+			drawArea->notifyShapeChanged(shape);
 		}
 		});
 
 	connect(propertyPanel, &PropertyPanel::fillColorChanged, this, [this](const QColor& color) {
 		if (auto shape = drawArea->getSelectedShape()) {
 			shape->setFillColor(color);
-			drawArea->update();
+			drawArea->notifyShapeChanged(shape);
 		}
 		});
 
@@ -153,49 +170,49 @@ MainWindow::MainWindow(QWidget* parent)
 	connect(propertyPanel, &PropertyPanel::fontColorChanged, this, [this](const QColor& color) {
 		if (auto shape = drawArea->getSelectedShape()) {
 			shape->setFontColor(color);
-			drawArea->update();
+			drawArea->notifyShapeChanged(shape);
 		}
 		});
 
 	connect(propertyPanel, &PropertyPanel::fontSizeChanged, this, [this](int size) {
 		if (auto shape = drawArea->getSelectedShape()) {
 			shape->setFontSize(size);
-			drawArea->update();
+			drawArea->notifyShapeChanged(shape);
 		}
 		});
 
 	connect(propertyPanel, &PropertyPanel::fontFamilyChanged, this, [this](const QString& family) {
 		if (auto shape = drawArea->getSelectedShape()) {
 			shape->setFontFamily(family);
-			drawArea->update();
+			drawArea->notifyShapeChanged(shape);
 		}
 		});
 
 	connect(propertyPanel, &PropertyPanel::textBoldChanged, this, [this](bool bold) {
 		if (auto shape = drawArea->getSelectedShape()) {
 			shape->setFontBold(bold);
-			drawArea->update();
+			drawArea->notifyShapeChanged(shape);
 		}
 		});
 
 	connect(propertyPanel, &PropertyPanel::textItalicChanged, this, [this](bool italic) {
 		if (auto shape = drawArea->getSelectedShape()) {
 			shape->setFontItalic(italic);
-			drawArea->update();
+			drawArea->notifyShapeChanged(shape);
 		}
 		});
 
 	connect(propertyPanel, &PropertyPanel::textUnderlineChanged, this, [this](bool underline) {
 		if (auto shape = drawArea->getSelectedShape()) {
 			shape->setFontUnderline(underline);
-			drawArea->update();
+			drawArea->notifyShapeChanged(shape);
 		}
 		});
 
 	connect(propertyPanel, &PropertyPanel::textAlignmentChanged, this, [this](Qt::Alignment alignment) {
 		if (auto shape = drawArea->getSelectedShape()) {
 			shape->setTextAlignment(alignment);
-			drawArea->update();
+			drawArea->notifyShapeChanged(shape);
 		}
 		});
 
@@ -207,10 +224,21 @@ MainWindow::MainWindow(QWidget* parent)
 
     // 根据是否有图形被选中，更新属性面板状态
 	connect(drawArea, &DrawArea::selectionChanged, propertyPanel, &PropertyPanel::updatePanel);
+
+	// 窗口显示后检查上次是否异常退出
+	QTimer::singleShot(0, drawArea, &DrawArea::recoverUnsavedChanges);
 }
 
 MainWindow::~MainWindow() {}
 
+void MainWindow::closeEvent(QCloseEvent *event) {
+	if (drawArea->maybeSave()) {
+		event->accept();
+	} else {
+		event->ignore();
+	}
+}
+
 void MainWindow::setupMenuBar()
 {
 	// 文件
@@ -222,6 +250,26 @@ void MainWindow::setupMenuBar()
 	saveAsFileAction = fileMenu->addAction(tr("Save As"));   // 另存为
 	exportPngAction = fileMenu->addAction(tr("Export PNG"));
 	exportSvgAction = fileMenu->addAction(tr("Export SVG"));
+
+	// 保存.svgz文件时的压缩级别
+	fileMenu->addSeparator();
+	QMenu* compressionMenu = fileMenu->addMenu(tr("SVGZ Compression"));
+	QActionGroup* compressionGroup = new QActionGroup(this);
+	const QList<QPair<QString, int>> compressionLevels = {
+		{tr("Fastest"), GzipDevice::Fastest},
+		{tr("Balanced"), GzipDevice::Balanced},
+		{tr("Smallest"), GzipDevice::Smallest}
+	};
+	for (const auto& level : compressionLevels) {
+		QAction* levelAction = compressionMenu->addAction(level.first);
+		levelAction->setCheckable(true);
+		levelAction->setChecked(drawArea->getCompressionLevel() == level.second);
+		compressionGroup->addAction(levelAction);
+		const int value = level.second;
+		connect(levelAction, &QAction::triggered, this, [this, value]() {
+			drawArea->setCompressionLevel(value);
+			});
+	}
 	newFileAction->setIcon(QIcon(":/images/new.png"));
 	openFileAction->setIcon(QIcon(":/images/open.png"));
 	saveFileAction->setIcon(QIcon(":/images/save.png"));
@@ -262,6 +310,87 @@ void MainWindow::setupMenuBar()
 	connect(gridVisibleAction, &QAction::triggered, drawArea, &DrawArea::setGridVisible);
 	connect(drawArea, &DrawArea::gridVisibilityChanged, gridVisibleAction, &QAction::setChecked);
 
+	// 概览小地图（停靠窗口在setupDockWidgets中创建）
+	overviewAction = viewMenu->addAction(tr("Overview"));
+	overviewAction->setCheckable(true);
+	overviewAction->setChecked(true);
+
+#ifdef FLOWCHART_PROFILER
+	// 性能面板：帧耗时、热点路径耗时和撤销栈内存
+	QAction* profilerAction = viewMenu->addAction(tr("Performance Overlay"));
+	profilerAction->setCheckable(true);
+	connect(profilerAction, &QAction::toggled, this, [this](bool checked) {
+		drawArea->setProfilerOverlayVisible(checked);
+		});
+#endif
+
+	// 渐进绘制：拖动、缩放和滚动期间先以草稿质量绘制，停止后再以完整质量重绘
+	QMenu* qualityMenu = viewMenu->addMenu(tr("Draft While Interacting"));
+	QAction* draftAction = qualityMenu->addAction(tr("Enabled"));
+	draftAction->setCheckable(true);
+	draftAction->setChecked(drawArea->isDraftRenderingEnabled());
+	connect(draftAction, &QAction::toggled, this, [this](bool checked) {
+		drawArea->setDraftRenderingEnabled(checked);
+		});
+	qualityMenu->addSeparator();
+	QActionGroup* refineDelayGroup = new QActionGroup(this);
+	for (int delay : {100, 200, 500}) {
+		QAction* delayAction = qualityMenu->addAction(tr("Refine After %1 ms").arg(delay));
+		delayAction->setCheckable(true);
+		delayAction->setChecked(drawArea->getDraftIdleDelay() == delay);
+		refineDelayGroup->addAction(delayAction);
+		connect(delayAction, &QAction::triggered, this, [this, delay]() {
+			drawArea->setDraftIdleDelay(delay);
+			});
+	}
+	qualityMenu->addSeparator();
+	QActionGroup* draftThresholdGroup = new QActionGroup(this);
+	for (int count : {0, 500, 2000, 10000}) {
+		QAction* thresholdAction = qualityMenu->addAction(count == 0 ? tr("For All Documents") : tr("From %1 Shapes").arg(count));
+		thresholdAction->setCheckable(true);
+		thresholdAction->setChecked(drawArea->getDraftShapeThreshold() == count);
+		draftThresholdGroup->addAction(thresholdAction);
+		connect(thresholdAction, &QAction::triggered, this, [this, count]() {
+			drawArea->setDraftShapeThreshold(count);
+			});
+	}
+
+	// 区域选择：在空白处按下左键拖动进行框选或套索选择
+	viewMenu->addSeparator();
+	QMenu* selectToolMenu = viewMenu->addMenu(tr("Selection Tool"));
+	QActionGroup* selectToolGroup = new QActionGroup(this);
+	QAction* rectSelectAction = selectToolMenu->addAction(tr("Rectangle"));
+	QAction* lassoSelectAction = selectToolMenu->addAction(tr("Lasso"));
+	rectSelectAction->setCheckable(true);
+	lassoSelectAction->setCheckable(true);
+	selectToolGroup->addAction(rectSelectAction);
+	selectToolGroup->addAction(lassoSelectAction);
+	rectSelectAction->setChecked(drawArea->getRegionSelectTool() == DrawArea::RegionSelectTool::Rectangle);
+	lassoSelectAction->setChecked(drawArea->getRegionSelectTool() == DrawArea::RegionSelectTool::Lasso);
+	connect(rectSelectAction, &QAction::triggered, this, [this]() {
+		drawArea->setRegionSelectTool(DrawArea::RegionSelectTool::Rectangle);
+		});
+	connect(lassoSelectAction, &QAction::triggered, this, [this]() {
+		drawArea->setRegionSelectTool(DrawArea::RegionSelectTool::Lasso);
+		});
+
+	QMenu* selectModeMenu = viewMenu->addMenu(tr("Selection Mode"));
+	QActionGroup* selectModeGroup = new QActionGroup(this);
+	QAction* containsModeAction = selectModeMenu->addAction(tr("Fully Contained"));
+	QAction* intersectsModeAction = selectModeMenu->addAction(tr("Intersecting"));
+	containsModeAction->setCheckable(true);
+	intersectsModeAction->setCheckable(true);
+	selectModeGroup->addAction(containsModeAction);
+	selectModeGroup->addAction(intersectsModeAction);
+	containsModeAction->setChecked(drawArea->getRegionSelectMode() == DrawArea::RegionSelectMode::Contains);
+	intersectsModeAction->setChecked(drawArea->getRegionSelectMode() == DrawArea::RegionSelectMode::Intersects);
+	connect(containsModeAction, &QAction::triggered, this, [this]() {
+		drawArea->setRegionSelectMode(DrawArea::RegionSelectMode::Contains);
+		});
+	connect(intersectsModeAction, &QAction::triggered, this, [this]() {
+		drawArea->setRegionSelectMode(DrawArea::RegionSelectMode::Intersects);
+		});
+
 	// 排列
 	QMenu* arrangeMenu = menuBar()->addMenu(tr("Arrange"));
 	moveTopAction = new QAction(tr("Move Top"));
@@ -277,9 +406,39 @@ void MainWindow::setupMenuBar()
 	arrangeMenu->addAction(moveBottomAction);
 	arrangeMenu->addAction(moveUpAction);
 	arrangeMenu->addAction(moveDownAction);
+	arrangeMenu->addSeparator();
+	hierarchicalLayoutAction = arrangeMenu->addAction(tr("Hierarchical Layout"));
+	forceLayoutAction = arrangeMenu->addAction(tr("Force-Directed Layout"));
+	acceptLayoutAction = arrangeMenu->addAction(tr("Accept Layout"));
+	cancelLayoutAction = arrangeMenu->addAction(tr("Cancel Layout"));
+	acceptLayoutAction->setEnabled(false);
+	cancelLayoutAction->setEnabled(false);
+	arrangeMenu->addSeparator();
+	orthogonalRoutingAction = arrangeMenu->addAction(tr("Orthogonal Connectors"));
+	straightRoutingAction = arrangeMenu->addAction(tr("Straight Connectors"));
+
+	// 其他：录制绘图区域的输入事件，用input_replay回放以复现性能问题
+	QMenu* otherMenu = menuBar()->addMenu(tr("Other"));
+	QAction* recordInputAction = otherMenu->addAction(tr("Record Input"));
+	recordInputAction->setCheckable(true);
+	connect(recordInputAction, &QAction::toggled, this, [this, recordInputAction](bool checked) {
+		if (!checked) {
+			inputRecorder->stop();
+			return;
+		}
+		QString filePath = QFileDialog::getSaveFileName(this, tr("Record Input"), QString(), tr("Input Recording (*.jsonl)"));
+		if (filePath.isEmpty() || !inputRecorder->start(drawArea, filePath)) {
+			if (!filePath.isEmpty()) {
+				QMessageBox::warning(this, tr("Flowchart"), tr("The recording could not be started."));
+			}
+			QSignalBlocker blocker(recordInputAction);
+			recordInputAction->setChecked(false);
+		}
+		});
 
-	menuBar()->addMenu(tr("Other"));
-	menuBar()->addMenu(tr("Help"));
+	QMenu* helpMenu = menuBar()->addMenu(tr("Help"));
+	QAction* memoryReportAction = helpMenu->addAction(tr("Memory Report..."));
+	connect(memoryReportAction, &QAction::triggered, drawArea, &DrawArea::showMemoryReport);
 }
 
 void MainWindow::setupToolBar()
@@ -326,6 +485,18 @@ void MainWindow::setupDockWidgets()
 	rightDock->setFixedWidth(280);
 	rightDock->setFeatures(QDockWidget::NoDockWidgetFeatures);  // 禁用停靠窗口功能
 	addDockWidget(Qt::RightDockWidgetArea, rightDock);
+
+	// 概览小地图：默认位于属性面板下方，可以关闭、移动或浮动
+	minimap = new MinimapWidget(drawArea, this);
+	QDockWidget* overviewDock = new QDockWidget(tr("Overview"), this);
+	overviewDock->setWidget(minimap);
+	overviewDock->setFeatures(QDockWidget::DockWidgetClosable | QDockWidget::DockWidgetMovable | QDockWidget::DockWidgetFloatable);
+	addDockWidget(Qt::RightDockWidgetArea, overviewDock);
+	splitDockWidget(rightDock, overviewDock, Qt::Vertical);
+	connect(overviewAction, &QAction::toggled, overviewDock, &QDockWidget::setVisible);
+	connect(overviewDock, &QDockWidget::visibilityChanged, this, [this, overviewDock]() {
+		overviewAction->setChecked(!overviewDock->isHidden());     // 只跟随关闭按钮，窗口最小化时不改变
+		});
 }
 
 void MainWindow::updateActions()
@@ -5,6 +5,8 @@
 #include "DrawArea.h"
 #include "ShapeLibraryWidget.h"
 #include "PropertyPanel.h"
+#include "MinimapWidget.h"
+#include "InputRecorder.h"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -14,6 +16,9 @@ public:
 
     ~MainWindow();
 
+protected:
+    void closeEvent(QCloseEvent *event) override;       // 关闭前询问保存并等待后台保存完成
+
 private slots:
     void updateActions();                // 更新菜单栏和工具栏的部分action状态
 
@@ -21,6 +26,8 @@ private:
     ShapeLibraryWidget *shapeLibrary;    // 图形库
     DrawArea *drawArea;                  // 绘图区域
     PropertyPanel *propertyPanel;        // 属性面板
+    MinimapWidget *minimap;              // 概览小地图
+    InputRecorder *inputRecorder;        // 输入事件录制
 
     QAction *newFileAction;              // 新建文件
     QAction *openFileAction;             // 打开文件
@@ -45,6 +52,13 @@ private:
     QAction *moveBottomAction;           // 移动到最下层
     QAction *moveUpAction;               // 上移一层
     QAction *moveDownAction;             // 下移一层
+    QAction *hierarchicalLayoutAction;   // 分层自动布局
+    QAction *forceLayoutAction;          // 力导向布局预览
+    QAction *acceptLayoutAction;         // 接受布局预览
+    QAction *cancelLayoutAction;         // 放弃布局预览
+    QAction *orthogonalRoutingAction;    // 选中连线改为正交走线
+    QAction *straightRoutingAction;      // 选中连线改为直线
+    QAction *overviewAction;             // 显示或隐藏概览小地图
 
     void setupMenuBar();                 // 菜单栏
     void setupToolBar();                 // 工具栏
@@ -0,0 +1,221 @@
+﻿#include "MemoryReport.h"
+#include "ShapeFactory.h"
+#include "RectShape.h"
+#include "EllipseShape.h"
+#include "DiamondShape.h"
+#include "PentagonShape.h"
+#include "HexagonShape.h"
+#include "LineShape.h"
+#include "ArrowShape.h"
+#include "PolylineShape.h"
+#include "CurveShape.h"
+#include <QJsonArray>
+#include <QDateTime>
+
+namespace {
+    size_t objectSize(ShapeFactory::TypeCode code) {
+        switch (code) {
+            case ShapeFactory::Rect: return sizeof(RectShape);
+            case ShapeFactory::Ellipse: return sizeof(EllipseShape);
+            case ShapeFactory::Diamond: return sizeof(DiamondShape);
+            case ShapeFactory::Pentagon: return sizeof(PentagonShape);
+            case ShapeFactory::Hexagon: return sizeof(HexagonShape);
+            case ShapeFactory::Line: return sizeof(LineShape);
+            case ShapeFactory::Arrow: return sizeof(ArrowShape);
+            case ShapeFactory::Polyline: return sizeof(PolylineShape);
+            case ShapeFactory::Curve: return sizeof(CurveShape);
+            default: return sizeof(ShapeBase);
+        }
+    }
+
+    // 隐式共享的缓冲区：data为空或已计算过时返回0
+    qint64 sharedBuffer(const void *data, qint64 payload, std::unordered_set<const void *> *seen) {
+        if (!data || payload == 0) return 0;
+        if (seen && !seen->insert(data).second) return 0;
+        return static_cast<qint64>(sizeof(QArrayData)) + payload;
+    }
+
+    qint64 pointBuffer(const QVector<QPointF> &points, std::unordered_set<const void *> *seen) {
+        return sharedBuffer(points.constData(), points.capacity() * static_cast<qint64>(sizeof(QPointF)), seen);
+    }
+
+    QJsonObject usageJson(const MemoryReport::Usage &usage) {
+        QJsonObject object;
+        object["shapes"] = usage.shapes;
+        object["objects"] = usage.objects;
+        object["text"] = usage.text;
+        object["geometry"] = usage.geometry;
+        object["fonts"] = usage.fonts;
+        object["total"] = usage.total();
+        return object;
+    }
+
+    QString formatBytes(qint64 bytes) {
+        if (bytes < 1024) return QString("%1 B").arg(bytes);
+        if (bytes < 1024 * 1024) return QString("%1 KB").arg(bytes / 1024.0, 0, 'f', 1);
+        return QString("%1 MB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+    }
+}
+
+MemoryReport::Usage &MemoryReport::Usage::operator+=(const Usage &other) {
+    shapes += other.shapes;
+    objects += other.objects;
+    text += other.text;
+    geometry += other.geometry;
+    fonts += other.fonts;
+    return *this;
+}
+
+MemoryReport::Usage MemoryReport::measure(const ShapeBase *shape, std::unordered_set<const void *> *seen) {
+    Usage usage;
+    usage.shapes = 1;
+    usage.objects = static_cast<qint64>(objectSize(ShapeFactory::typeCode(shape->getShapeType())));
+    usage.fonts = sizeof(QFont);
+
+    const QString text = shape->getText();
+    usage.text = sharedBuffer(text.constData(), (text.capacity() + 1) * static_cast<qint64>(sizeof(QChar)), seen);
+
+    if (auto line = dynamic_cast<const WaypointLineShape *>(shape)) {
+        usage.geometry = pointBuffer(line->getWaypoints(), seen) + pointBuffer(line->pathPoints(), seen);
+    } else if (auto line = dynamic_cast<const LineBaseShape *>(shape)) {
+        if (line->getRouting() == LineBaseShape::Orthogonal && !line->needsRoute()) {
+            usage.geometry = pointBuffer(line->pathPoints(), seen);          // 计算好的路径
+        }
+    } else {
+        usage.geometry = pointBuffer(shape->outline(), seen);
+    }
+    return usage;
+}
+
+MemoryReport::Usage MemoryReport::shapeUsage(const ShapeBase *shape) {
+    return measure(shape, nullptr);
+}
+
+void MemoryReport::addShapes(const QString &subsystem, const std::vector<ShapeBase *> &shapes, bool countTypes) {
+    Subsystem &target = this->subsystem(subsystem);
+    if (shapes.empty()) return;
+
+    // 超过SAMPLE_LIMIT时等间隔抽样，结果按抽样比例放大
+    const size_t step = (shapes.size() + SAMPLE_LIMIT - 1) / SAMPLE_LIMIT;
+    const double scale = static_cast<double>(step);
+    if (step > 1) m_sampled = true;
+
+    Usage sampled;
+    std::map<QString, Usage> sampledTypes;
+    for (size_t i = 0; i < shapes.size(); i += step) {
+        const Usage usage = measure(shapes[i], &m_seen);
+        sampled += usage;
+        if (countTypes) {
+            sampledTypes[shapes[i]->getShapeType()] += usage;
+        }
+    }
+
+    auto scaled = [scale](const Usage &usage) {
+        Usage result;
+        result.shapes = qRound64(usage.shapes * scale);
+        result.objects = qRound64(usage.objects * scale);
+        result.text = qRound64(usage.text * scale);
+        result.geometry = qRound64(usage.geometry * scale);
+        result.fonts = qRound64(usage.fonts * scale);
+        return result;
+    };
+    Usage total = scaled(sampled);
+    total.shapes = static_cast<qint64>(shapes.size());
+    target.usage += total;
+    for (const auto &type: sampledTypes) {
+        m_types[type.first] += scaled(type.second);
+    }
+}
+
+void MemoryReport::addBytes(const QString &subsystem, const QString &item, qint64 bytes) {
+    this->subsystem(subsystem).bytes.emplace_back(item, bytes);
+}
+
+void MemoryReport::addCount(const QString &subsystem, const QString &item, qint64 count) {
+    this->subsystem(subsystem).counts.emplace_back(item, count);
+}
+
+qint64 MemoryReport::totalBytes() const {
+    qint64 total = 0;
+    for (const Subsystem &subsystem: m_subsystems) {
+        total += subsystem.usage.total();
+        for (const auto &item: subsystem.bytes) {
+            total += item.second;
+        }
+    }
+    return total;
+}
+
+QJsonObject MemoryReport::toJson() const {
+    QJsonObject subsystems;
+    for (const Subsystem &subsystem: m_subsystems) {
+        QJsonObject object = usageJson(subsystem.usage);
+        qint64 total = subsystem.usage.total();
+        for (const auto &item: subsystem.bytes) {
+            object[item.first] = item.second;
+            total += item.second;
+        }
+        for (const auto &item: subsystem.counts) {
+            object[item.first] = item.second;
+        }
+        object["total"] = total;
+        subsystems[subsystem.name] = object;
+    }
+
+    QJsonObject types;
+    for (const auto &type: m_types) {
+        types[type.first] = usageJson(type.second);
+    }
+
+    QJsonObject root;
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["sampled"] = m_sampled;
+    root["total"] = totalBytes();
+    root["subsystems"] = subsystems;
+    root["shape_types"] = types;
+    return root;
+}
+
+QString MemoryReport::toText() const {
+    QString text;
+    const QString row("%1 %2\n");
+    for (const Subsystem &subsystem: m_subsystems) {
+        const Usage &usage = subsystem.usage;
+        qint64 total = usage.total();
+        for (const auto &item: subsystem.bytes) {
+            total += item.second;
+        }
+        text += QString("%1: %2\n").arg(subsystem.name, formatBytes(total));
+        for (const auto &item: subsystem.counts) {
+            text += row.arg(QString("  %1").arg(item.first), -16).arg(item.second);
+        }
+        if (usage.shapes > 0) {
+            text += row.arg("  shapes", -16).arg(usage.shapes);
+            text += row.arg("  objects", -16).arg(formatBytes(usage.objects));
+            text += row.arg("  text", -16).arg(formatBytes(usage.text));
+            text += row.arg("  geometry", -16).arg(formatBytes(usage.geometry));
+            text += row.arg("  fonts", -16).arg(formatBytes(usage.fonts));
+        }
+        for (const auto &item: subsystem.bytes) {
+            text += row.arg(QString("  %1").arg(item.first), -16).arg(formatBytes(item.second));
+        }
+    }
+
+    if (!m_types.empty()) {
+        text += "\ndocument by shape type:\n";
+        for (const auto &type: m_types) {
+            text += QString("  %1 %2 %3\n").arg(type.first, -14).arg(type.second.shapes, 10)
+                    .arg(formatBytes(type.second.total()), 12);
+        }
+    }
+    text += QString("\ntotal: %1%2\n").arg(formatBytes(totalBytes()), m_sampled ? " (sampled)" : "");
+    return text;
+}
+
+MemoryReport::Subsystem &MemoryReport::subsystem(const QString &name) {
+    for (Subsystem &subsystem: m_subsystems) {
+        if (subsystem.name == name) return subsystem;
+    }
+    m_subsystems.push_back(Subsystem{name, Usage(), {}, {}});
+    return m_subsystems.back();
+}
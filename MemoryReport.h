@@ -0,0 +1,66 @@
+﻿#ifndef MEMORYREPORT_H
+#define MEMORYREPORT_H
+
+#include "ShapeBase.h"
+#include <QString>
+#include <QJsonObject>
+#include <map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// 内存占用估算：按子系统（文档、撤销/重做栈、剪贴板、缓存）和图形类型汇总字节数。
+// 图形副本之间共享的文本和点集缓冲区（Qt隐式共享）只计算一次；图形数量超过SAMPLE_LIMIT的集合按固定步长抽样后按比例放大，
+// 生成报告的代价与图形总数基本无关，可以在正式版本中随时调用
+class MemoryReport {
+public:
+    struct Usage {
+        qint64 shapes = 0;                             // 图形数量
+        qint64 objects = 0;                            // 图形对象本身
+        qint64 text = 0;                               // 文本缓冲区
+        qint64 geometry = 0;                           // 多边形顶点、中间点和连线路径
+        qint64 fonts = 0;                              // QFont句柄（字体数据在图形之间共享，不计入）
+
+        qint64 total() const { return objects + text + geometry + fonts; }
+
+        Usage &operator+=(const Usage &other);
+    };
+
+    void addShapes(const QString &subsystem, const std::vector<ShapeBase *> &shapes,
+                   bool countTypes = false);           // 统计一组图形，countTypes为true时同时计入按类型的统计
+
+    void addBytes(const QString &subsystem, const QString &item, qint64 bytes);    // 计入图形之外的内存，如缓存
+
+    void addCount(const QString &subsystem, const QString &item, qint64 count);    // 附加的计数，如撤销状态数
+
+    qint64 totalBytes() const;
+
+    bool isSampled() const { return m_sampled; }
+
+    QJsonObject toJson() const;
+
+    QString toText() const;                            // 供对话框显示的文本表格
+
+    static Usage shapeUsage(const ShapeBase *shape);   // 单个图形的估算（不区分共享的缓冲区）
+
+    static const size_t SAMPLE_LIMIT = 4096;           // 每组图形最多检查的数量
+
+private:
+    struct Subsystem {
+        QString name;
+        Usage usage;
+        std::vector<std::pair<QString, qint64>> bytes;  // 图形之外的内存
+        std::vector<std::pair<QString, qint64>> counts;
+    };
+
+    Subsystem &subsystem(const QString &name);         // 按添加顺序保存，不存在时添加
+
+    static Usage measure(const ShapeBase *shape, std::unordered_set<const void *> *seen);
+
+    std::vector<Subsystem> m_subsystems;
+    std::map<QString, Usage> m_types;                  // 图形类型 -> 文档中该类型的占用
+    std::unordered_set<const void *> m_seen;           // 已计算过的共享缓冲区
+    bool m_sampled = false;
+};
+
+#endif // MEMORYREPORT_H
@@ -0,0 +1,89 @@
+﻿#include "MinimapWidget.h"
+#include <QMouseEvent>
+#include <QHideEvent>
+#include <QShowEvent>
+#include <QPainter>
+
+MinimapWidget::MinimapWidget(DrawArea *drawArea, QWidget *parent) : QWidget(parent), m_drawArea(drawArea) {
+    setMinimumSize(120, 90);
+    setCursor(Qt::PointingHandCursor);
+    // 瓦片更新或视口滚动时重绘，重绘只是绘制几个瓦片，代价与图形数量无关
+    connect(m_drawArea, &DrawArea::overviewChanged, this, QOverload<>::of(&QWidget::update));
+    connect(m_drawArea, &DrawArea::viewChanged, this, QOverload<>::of(&QWidget::update));
+}
+
+QRectF MinimapWidget::targetRect() const {
+    const QRectF scene = m_drawArea->sceneRect();
+    const QRectF bounds = QRectF(rect()).adjusted(4, 4, -4, -4);
+    if (scene.isEmpty() || bounds.isEmpty()) {
+        return QRectF();
+    }
+    const qreal scale = qMin(bounds.width() / scene.width(), bounds.height() / scene.height());
+    QRectF target(0, 0, scene.width() * scale, scene.height() * scale);
+    target.moveCenter(bounds.center());
+    return target;
+}
+
+QPointF MinimapWidget::mapToScene(const QPoint &pos) const {
+    const QRectF scene = m_drawArea->sceneRect();
+    const QRectF target = targetRect();
+    if (target.isEmpty()) {
+        return scene.center();
+    }
+    const qreal scale = scene.width() / target.width();
+    return scene.topLeft() + (QPointF(pos) - target.topLeft()) * scale;
+}
+
+void MinimapWidget::paintEvent(QPaintEvent *) {
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().color(QPalette::Mid));
+    const QRectF target = targetRect();
+    if (target.isEmpty()) return;
+
+    // 瓦片的场景范围可能比绘图区域的稍旧，按瓦片自己的范围绘制
+    const QRectF tileScene = m_drawArea->overviewTiles().sceneRect();
+    const QRectF scene = m_drawArea->sceneRect();
+    const qreal scale = target.width() / scene.width();
+    painter.fillRect(target, m_drawArea->viewport()->palette().color(m_drawArea->viewport()->backgroundRole()));
+    if (!tileScene.isEmpty()) {
+        const QRectF tileTarget(target.topLeft() + (tileScene.topLeft() - scene.topLeft()) * scale,
+                                tileScene.size() * scale);
+        painter.save();
+        painter.setClipRect(target);
+        m_drawArea->overviewTiles().draw(painter, tileTarget);
+        painter.restore();
+    }
+
+    // 视口当前显示的区域
+    const QRectF visible = m_drawArea->visibleSceneRect();
+    const QRectF viewRect(target.topLeft() + (visible.topLeft() - scene.topLeft()) * scale, visible.size() * scale);
+    painter.setPen(QPen(QColor(255, 75, 0), 1.5));
+    painter.setBrush(QColor(255, 75, 0, 30));
+    painter.drawRect(viewRect.intersected(target));
+}
+
+void MinimapWidget::mousePressEvent(QMouseEvent *event) {
+    if (event->button() == Qt::LeftButton) {
+        m_drawArea->centerOn(mapToScene(event->pos()));
+    }
+}
+
+void MinimapWidget::mouseMoveEvent(QMouseEvent *event) {
+    if (event->buttons() & Qt::LeftButton) {
+        m_drawArea->centerOn(mapToScene(event->pos()));
+    }
+}
+
+void MinimapWidget::showEvent(QShowEvent *event) {
+    if (!event->spontaneous()) {                        // 窗口最小化后恢复时瓦片仍然保留
+        m_drawArea->setOverviewEnabled(true);
+    }
+    QWidget::showEvent(event);
+}
+
+void MinimapWidget::hideEvent(QHideEvent *event) {
+    if (!event->spontaneous()) {
+        m_drawArea->setOverviewEnabled(false);
+    }
+    QWidget::hideEvent(event);
+}
@@ -0,0 +1,35 @@
+﻿#ifndef MINIMAPWIDGET_H
+#define MINIMAPWIDGET_H
+
+#include "DrawArea.h"
+#include <QWidget>
+
+// 概览小地图：用绘图区域维护的瓦片金字塔显示整个场景，并标出视口当前显示的区域，点击或拖动时滚动到对应位置
+class MinimapWidget : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit MinimapWidget(DrawArea *drawArea, QWidget *parent = nullptr);
+
+    QSize sizeHint() const override { return QSize(240, 180); }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+    void mousePressEvent(QMouseEvent *event) override;
+
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+    void showEvent(QShowEvent *event) override;         // 显示时开始维护瓦片
+
+    void hideEvent(QHideEvent *event) override;         // 隐藏时停止维护并释放瓦片
+
+private:
+    QRectF targetRect() const;                          // 场景在控件中的显示区域（保持宽高比居中）
+
+    QPointF mapToScene(const QPoint &pos) const;        // 控件坐标 -> 场景坐标
+
+    DrawArea *m_drawArea;
+};
+
+#endif // MINIMAPWIDGET_H
@@ -0,0 +1,666 @@
+﻿#include "NativeDocument.h"
+#include "ShapeFactory.h"
+#include "PolygonShape.h"
+#include "LineBaseShape.h"
+#include "CurveShape.h"
+#include "Tracer.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QHash>
+#include <QByteArray>
+#include <QTransform>
+#include <QtMath>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <unordered_map>
+
+const char *const NativeDocument::FILE_SUFFIX = "fcd";
+
+namespace {
+    const char MAGIC[4] = {'F', 'C', 'D', 'B'};
+    const quint32 FORMAT_VERSION = 3;                    // 版本2增加空间目录，版本3增加中间点表，仍可读取旧版本
+    const quint32 V1_HEADER_SIZE = 88;
+    const quint32 V2_HEADER_SIZE = 112;
+    const quint32 BYTE_ORDER_MARK = 0x01020304;          // 读到其他值说明字节序不一致
+    const quint32 NO_INDEX = 0xFFFFFFFFu;
+
+    // 以下结构体直接按内存布局写入文件，字段顺序保证自然对齐且没有隐式填充
+    struct FileHeader {
+        char magic[4];
+        quint32 version;
+        quint32 byteOrderMark;
+        quint32 shapeCount;
+        quint32 styleCount;
+        quint32 fontCount;
+        quint32 stringCount;
+        quint32 backgroundColor;                         // QRgb
+        qint32 pageWidth;
+        qint32 pageHeight;
+        quint64 shapeOffset;
+        quint64 styleOffset;
+        quint64 fontOffset;
+        quint64 stringIndexOffset;
+        quint64 stringDataOffset;
+        quint64 fileSize;
+        quint64 chunkOffset;                             // 以下为版本2新增的空间目录
+        quint64 chunkIndexOffset;
+        quint32 chunkCount;
+        quint32 chunkIndexCount;
+        quint64 pointOffset;                             // 以下为版本3新增的中间点表
+        quint32 pointCount;
+        quint32 reserved;
+    };
+
+    struct PointRange {
+        quint32 first;                                   // 在中间点表中的起始位置
+        quint32 count;
+    };
+
+    struct ShapeEntry {
+        double geometry[4];                              // 多边形：x, y, width, height；线段：startX, startY, endX, endY
+        union {
+            double rotation;                             // 多边形的旋转角
+            PointRange waypoints;                        // 折线/曲线连线的中间点（线段没有旋转角，旧文件中此处为0）
+        };
+        quint32 styleIndex;
+        quint32 fontIndex;
+        quint32 textIndex;                               // NO_INDEX表示无文本
+        qint32 startTarget;                              // 线段起点绑定的图形序号，-1表示未绑定
+        qint32 endTarget;                                // 线段终点绑定的图形序号
+        quint8 type;                                     // ShapeFactory::TypeCode
+        qint8 startMagnetic;
+        qint8 endMagnetic;
+        quint8 routing;                                  // LineBaseShape::Routing，旧文件中此处为0（直线）
+    };
+
+    struct PointEntry {                                  // 与图形几何一样使用双精度，保存后重新读取不改变中间点
+        double x;
+        double y;
+    };
+
+    struct StyleEntry {
+        quint32 borderColor;
+        quint32 fillColor;
+        qint32 penWidth;
+        qint32 borderStyle;
+    };
+
+    struct FontEntry {
+        quint32 familyIndex;
+        qint32 pointSize;
+        quint32 fontColor;
+        quint32 alignment;
+        quint8 bold;
+        quint8 italic;
+        quint8 underline;
+        quint8 reserved;
+        quint32 reserved2;
+    };
+
+    struct StringEntry {
+        quint32 offset;                                  // 在字符串数据段中的UTF-16偏移
+        quint32 length;                                  // UTF-16长度
+    };
+
+    struct ChunkEntry {
+        double bounds[4];                                // 成员图形的外接矩形：x, y, width, height
+        quint32 first;                                   // 在成员序号表中的起始位置
+        quint32 count;
+    };
+
+    static_assert(sizeof(FileHeader) == 128, "unexpected FileHeader layout");
+    static_assert(sizeof(ShapeEntry) == 64, "unexpected ShapeEntry layout");
+    static_assert(sizeof(StyleEntry) == 16, "unexpected StyleEntry layout");
+    static_assert(sizeof(FontEntry) == 24, "unexpected FontEntry layout");
+    static_assert(sizeof(StringEntry) == 8, "unexpected StringEntry layout");
+    static_assert(sizeof(ChunkEntry) == 40, "unexpected ChunkEntry layout");
+    static_assert(sizeof(PointEntry) == 16, "unexpected PointEntry layout");
+
+    bool hasWaypoints(quint8 type) {
+        return type == ShapeFactory::Polyline || type == ShapeFactory::Curve;
+    }
+
+    // 折线/曲线连线的锚点：起点、中间点、终点
+    QVector<QPointF> entryAnchors(const ShapeEntry &entry, const PointEntry *points) {
+        QVector<QPointF> anchors;
+        anchors.reserve(static_cast<int>(entry.waypoints.count) + 2);
+        anchors.append(QPointF(entry.geometry[0], entry.geometry[1]));
+        for (quint32 i = 0; i < entry.waypoints.count; ++i) {
+            const PointEntry &point = points[entry.waypoints.first + i];
+            anchors.append(QPointF(point.x, point.y));
+        }
+        anchors.append(QPointF(entry.geometry[2], entry.geometry[3]));
+        return anchors;
+    }
+
+    const qreal CHUNK_CELL_SIZE = 512.0;                 // 空间目录按图形中心所在的网格分块
+    const qreal CHUNK_MARGIN = 50.0;                     // 分块外接矩形的扩展量（线宽、控制点和线段文本）
+
+    // 根据记录计算图形的外接矩形，多边形按旋转后的矩形计算，曲线按贝塞尔控制点的凸包计算
+    QRectF entryBounds(const ShapeEntry &entry, const PointEntry *points) {
+        if (hasWaypoints(entry.type) && entry.waypoints.count > 0) {
+            QVector<QPointF> anchors = entryAnchors(entry, points);
+            if (entry.type == ShapeFactory::Curve) {
+                anchors = CurveShape::bezierPoints(anchors);
+            }
+            return QPolygonF(anchors).boundingRect();
+        }
+        if (ShapeFactory::isLineType(static_cast<ShapeFactory::TypeCode>(entry.type))) {
+            return QRectF(QPointF(entry.geometry[0], entry.geometry[1]),
+                          QPointF(entry.geometry[2], entry.geometry[3])).normalized();
+        }
+        const QRectF rect(entry.geometry[0], entry.geometry[1], entry.geometry[2], entry.geometry[3]);
+        if (entry.rotation == 0.0) {
+            return rect;
+        }
+        QTransform transform;
+        transform.translate(rect.center().x(), rect.center().y());
+        transform.rotate(entry.rotation);
+        transform.translate(-rect.center().x(), -rect.center().y());
+        return transform.mapRect(rect);
+    }
+
+    // 生成空间目录：按图形中心所在的网格分块，块内成员按文件顺序排列
+    void buildChunks(const ShapeEntry *entries, quint32 count, const PointEntry *points,
+                     std::vector<ChunkEntry> &chunks, std::vector<quint32> &chunkIndex) {
+        std::map<std::pair<qint64, qint64>, std::vector<quint32>> cells;   // (行, 列) -> 成员序号
+        for (quint32 i = 0; i < count; ++i) {
+            const QPointF center = entryBounds(entries[i], points).center();
+            cells[{qFloor(center.y() / CHUNK_CELL_SIZE), qFloor(center.x() / CHUNK_CELL_SIZE)}].push_back(i);
+        }
+
+        chunks.reserve(cells.size());
+        chunkIndex.reserve(count);
+        for (const auto &cell: cells) {
+            qreal left = std::numeric_limits<qreal>::max(), top = left;
+            qreal right = -left, bottom = -left;
+            for (quint32 i: cell.second) {
+                const QRectF bounds = entryBounds(entries[i], points);
+                left = qMin(left, bounds.left());
+                top = qMin(top, bounds.top());
+                right = qMax(right, bounds.right());
+                bottom = qMax(bottom, bounds.bottom());
+            }
+
+            ChunkEntry chunk;
+            std::memset(&chunk, 0, sizeof(chunk));
+            chunk.bounds[0] = left - CHUNK_MARGIN;
+            chunk.bounds[1] = top - CHUNK_MARGIN;
+            chunk.bounds[2] = right - left + 2 * CHUNK_MARGIN;
+            chunk.bounds[3] = bottom - top + 2 * CHUNK_MARGIN;
+            chunk.first = static_cast<quint32>(chunkIndex.size());
+            chunk.count = static_cast<quint32>(cell.second.size());
+            chunks.push_back(chunk);
+            chunkIndex.insert(chunkIndex.end(), cell.second.begin(), cell.second.end());
+        }
+    }
+
+    // 对表项去重，返回表项序号
+    template<typename Entry>
+    quint32 internEntry(const Entry &entry, std::vector<Entry> &table, QHash<QByteArray, quint32> &lookup) {
+        QByteArray key(reinterpret_cast<const char *>(&entry), sizeof(Entry));
+        auto it = lookup.constFind(key);
+        if (it != lookup.constEnd()) return it.value();
+        quint32 index = static_cast<quint32>(table.size());
+        table.push_back(entry);
+        lookup.insert(key, index);
+        return index;
+    }
+
+    // 判断某个段是否完整地落在文件内
+    bool sectionFits(quint64 offset, quint64 count, quint64 entrySize, quint64 fileSize) {
+        if (offset > fileSize) return false;
+        return count <= (fileSize - offset) / entrySize;
+    }
+
+    template<typename T>
+    bool writeTable(QIODevice &file, const std::vector<T> &table) {
+        if (table.empty()) return true;
+        qint64 bytes = static_cast<qint64>(table.size() * sizeof(T));
+        return file.write(reinterpret_cast<const char *>(table.data()), bytes) == bytes;
+    }
+}
+
+bool NativeDocument::save(const QString &filePath, const std::vector<ShapeBase *> &shapes,
+                          const QColor &backgroundColor, const QSize &pageSize) {
+    TRACE_SCOPE_DETAIL("NativeDocument::save", "io", filePath);
+    std::vector<ShapeEntry> shapeTable;
+    std::vector<StyleEntry> styleTable;
+    std::vector<FontEntry> fontTable;
+    std::vector<StringEntry> stringTable;
+    std::vector<PointEntry> pointTable;
+    QString stringData;
+    QHash<QByteArray, quint32> styleLookup;
+    QHash<QByteArray, quint32> fontLookup;
+    QHash<QString, quint32> stringLookup;
+
+    // 图形指针 -> 序号，用于记录线段绑定
+    std::unordered_map<const ShapeBase *, qint32> shapeIndex;
+    shapeIndex.reserve(shapes.size());
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        shapeIndex.emplace(shapes[i], static_cast<qint32>(i));
+    }
+
+    // 文本和字体名称写入同一个字符串表，相同字符串只保存一次
+    auto internString = [&](const QString &str) -> quint32 {
+        auto it = stringLookup.constFind(str);
+        if (it != stringLookup.constEnd()) return it.value();
+        quint32 index = static_cast<quint32>(stringTable.size());
+        stringTable.push_back({static_cast<quint32>(stringData.size()), static_cast<quint32>(str.size())});
+        stringData.append(str);
+        stringLookup.insert(str, index);
+        return index;
+    };
+
+    shapeTable.reserve(shapes.size());
+    for (const ShapeBase *shape: shapes) {
+        ShapeEntry entry;
+        std::memset(&entry, 0, sizeof(entry));
+        entry.type = ShapeFactory::typeCode(shape->getShapeType());
+        entry.rotation = shape->getRotation();
+        entry.startTarget = -1;
+        entry.endTarget = -1;
+        entry.startMagnetic = -1;
+        entry.endMagnetic = -1;
+
+        if (auto line = dynamic_cast<const LineBaseShape *>(shape)) {
+            entry.geometry[0] = line->getStart().x();
+            entry.geometry[1] = line->getStart().y();
+            entry.geometry[2] = line->getEnd().x();
+            entry.geometry[3] = line->getEnd().y();
+            entry.routing = static_cast<quint8>(line->getRouting());
+            if (auto waypointLine = dynamic_cast<const WaypointLineShape *>(line)) {
+                entry.waypoints.first = static_cast<quint32>(pointTable.size());
+                entry.waypoints.count = static_cast<quint32>(waypointLine->getWaypoints().size());
+                for (const QPointF &point: waypointLine->getWaypoints()) {
+                    pointTable.push_back({point.x(), point.y()});
+                }
+            }
+
+            for (int i = 0; i < 2; ++i) {
+                auto binding = line->getEndPointBinding(i);
+                auto it = shapeIndex.find(binding.targetShape);
+                if (it == shapeIndex.end() || binding.magneticIndex < 0 || binding.magneticIndex > 127) continue;
+                if (i == 0) {
+                    entry.startTarget = it->second;
+                    entry.startMagnetic = static_cast<qint8>(binding.magneticIndex);
+                } else {
+                    entry.endTarget = it->second;
+                    entry.endMagnetic = static_cast<qint8>(binding.magneticIndex);
+                }
+            }
+        } else {
+            auto polygon = dynamic_cast<const PolygonShape *>(shape);
+            QRectF rect = polygon ? polygon->getRect() : shape->boundingRect();
+            entry.geometry[0] = rect.x();
+            entry.geometry[1] = rect.y();
+            entry.geometry[2] = rect.width();
+            entry.geometry[3] = rect.height();
+        }
+
+        StyleEntry style;
+        std::memset(&style, 0, sizeof(style));
+        style.borderColor = shape->getBorderColor().rgba();
+        style.fillColor = shape->getFillColor().rgba();
+        style.penWidth = shape->getPenWidth();
+        style.borderStyle = static_cast<qint32>(shape->getBorderStyle());
+        entry.styleIndex = internEntry(style, styleTable, styleLookup);
+
+        FontEntry font;
+        std::memset(&font, 0, sizeof(font));
+        font.familyIndex = internString(shape->getFontFamily());
+        font.pointSize = shape->getFontSize();
+        font.fontColor = shape->getFontColor().rgba();
+        font.alignment = static_cast<quint32>(shape->getTextAlignment());
+        font.bold = shape->isFontBold();
+        font.italic = shape->isFontItalic();
+        font.underline = shape->isFontUnderline();
+        entry.fontIndex = internEntry(font, fontTable, fontLookup);
+
+        const QString text = shape->getText();
+        entry.textIndex = text.isEmpty() ? NO_INDEX : internString(text);
+
+        shapeTable.push_back(entry);
+    }
+
+    std::vector<ChunkEntry> chunkTable;
+    std::vector<quint32> chunkIndex;
+    buildChunks(shapeTable.data(), static_cast<quint32>(shapeTable.size()), pointTable.data(), chunkTable, chunkIndex);
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FORMAT_VERSION;
+    header.byteOrderMark = BYTE_ORDER_MARK;
+    header.shapeCount = static_cast<quint32>(shapeTable.size());
+    header.styleCount = static_cast<quint32>(styleTable.size());
+    header.fontCount = static_cast<quint32>(fontTable.size());
+    header.stringCount = static_cast<quint32>(stringTable.size());
+    header.chunkCount = static_cast<quint32>(chunkTable.size());
+    header.chunkIndexCount = static_cast<quint32>(chunkIndex.size());
+    header.pointCount = static_cast<quint32>(pointTable.size());
+    header.backgroundColor = backgroundColor.rgba();
+    header.pageWidth = pageSize.width();
+    header.pageHeight = pageSize.height();
+    // 成员序号表之前的各段大小都是8的倍数，依次排列即可保证每段8字节对齐；成员序号表只需4字节对齐，字符串数据只需2字节对齐
+    header.shapeOffset = sizeof(FileHeader);
+    header.styleOffset = header.shapeOffset + shapeTable.size() * sizeof(ShapeEntry);
+    header.fontOffset = header.styleOffset + styleTable.size() * sizeof(StyleEntry);
+    header.stringIndexOffset = header.fontOffset + fontTable.size() * sizeof(FontEntry);
+    header.chunkOffset = header.stringIndexOffset + stringTable.size() * sizeof(StringEntry);
+    header.pointOffset = header.chunkOffset + chunkTable.size() * sizeof(ChunkEntry);
+    header.chunkIndexOffset = header.pointOffset + pointTable.size() * sizeof(PointEntry);
+    header.stringDataOffset = header.chunkIndexOffset + chunkIndex.size() * sizeof(quint32);
+    header.fileSize = header.stringDataOffset + static_cast<quint64>(stringData.size()) * sizeof(QChar);
+
+    QSaveFile file(filePath);                  // 先写入临时文件，全部写完后再替换目标文件
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    qint64 stringBytes = static_cast<qint64>(stringData.size()) * static_cast<qint64>(sizeof(QChar));
+    bool ok = file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == static_cast<qint64>(sizeof(header))
+              && writeTable(file, shapeTable)
+              && writeTable(file, styleTable)
+              && writeTable(file, fontTable)
+              && writeTable(file, stringTable)
+              && writeTable(file, chunkTable)
+              && writeTable(file, pointTable)
+              && writeTable(file, chunkIndex)
+              && file.write(reinterpret_cast<const char *>(stringData.constData()), stringBytes) == stringBytes;
+    return ok && file.commit();                // 写入失败时不会改动原文件
+}
+
+bool NativeDocument::load(const QString &filePath, DocumentContent &content, const ProgressCallback &progress) {
+    TRACE_SCOPE_DETAIL("NativeDocument::load", "io", filePath);
+    NativeDocumentReader reader;
+    if (!reader.open(filePath)) {
+        return false;
+    }
+
+    // 按文件顺序构造全部图形，读取器在打开时已校验所有记录
+    std::vector<quint32> created;
+    const quint32 total = reader.shapeCount();
+    created.reserve(total);
+    while (reader.pendingCount() > 0) {
+        // 定期汇报进度并检查是否取消
+        if (progress && !progress(static_cast<int>(quint64(created.size()) * 100 / total))) {
+            for (quint32 index: created) {
+                delete reader.shapeAt(index);
+            }
+            return false;
+        }
+        reader.materializeNext(4096, created);
+    }
+
+    content.shapes.reserve(total);
+    for (quint32 i = 0; i < total; ++i) {
+        content.shapes.push_back(reader.shapeAt(i));
+    }
+    content.backgroundColor = reader.backgroundColor();
+    content.pageSize = reader.pageSize();
+    return true;
+}
+
+bool NativeDocument::isNativeFile(const QString &filePath) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    char magic[sizeof(MAGIC)];
+    return file.read(magic, sizeof(magic)) == sizeof(magic) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+NativeDocumentReader::~NativeDocumentReader() {
+    if (m_data) {
+        m_file.unmap(const_cast<uchar *>(m_data));
+    }
+}
+
+QRectF NativeDocumentReader::bounds() const {
+    QRectF result;
+    for (const Chunk &chunk: m_chunks) {
+        result |= chunk.bounds;
+    }
+    return result;
+}
+
+qint64 NativeDocumentReader::indexBytes() const {
+    qint64 bytes = static_cast<qint64>(m_chunks.capacity() * sizeof(Chunk) + m_chunkIndex.capacity() * sizeof(quint32)
+                                       + m_shapes.capacity() * sizeof(ShapeBase *)
+                                       + m_fonts.capacity() * sizeof(QFont) + m_fontColors.capacity() * sizeof(QRgb)
+                                       + m_alignments.capacity() * sizeof(quint32));
+    for (const auto &waiting: m_waiting) {
+        bytes += static_cast<qint64>(sizeof(waiting) + waiting.second.capacity() * sizeof(WaitingEnd));
+    }
+    return bytes;
+}
+
+bool NativeDocumentReader::open(const QString &filePath) {
+    TRACE_SCOPE_DETAIL("NativeDocumentReader::open", "io", filePath);
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const qint64 fileSize = m_file.size();
+    if (fileSize < static_cast<qint64>(V1_HEADER_SIZE)) {
+        return false;
+    }
+
+    m_data = m_file.map(0, fileSize);                  // 映射整个文件，之后按偏移直接读取记录
+    if (!m_data) {
+        return false;
+    }
+
+    // 版本1的文件头没有空间目录字段，版本2没有中间点表字段
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(&header, m_data, V1_HEADER_SIZE);
+    const quint64 size = static_cast<quint64>(fileSize);
+    const quint64 headerSize = header.version >= FORMAT_VERSION ? sizeof(FileHeader)
+                                                                : header.version == 2 ? V2_HEADER_SIZE : V1_HEADER_SIZE;
+    if (size >= headerSize) {
+        std::memcpy(&header, m_data, headerSize);
+    }
+    const bool hasChunks = header.version >= 2;
+    const bool hasPoints = header.version >= 3;
+    bool valid = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+                 && header.version >= 1 && header.version <= FORMAT_VERSION
+                 && size >= headerSize
+                 && header.byteOrderMark == BYTE_ORDER_MARK
+                 && header.fileSize == size
+                 && sectionFits(header.shapeOffset, header.shapeCount, sizeof(ShapeEntry), size)
+                 && sectionFits(header.styleOffset, header.styleCount, sizeof(StyleEntry), size)
+                 && sectionFits(header.fontOffset, header.fontCount, sizeof(FontEntry), size)
+                 && sectionFits(header.stringIndexOffset, header.stringCount, sizeof(StringEntry), size)
+                 && header.stringDataOffset <= size
+                 && header.stringDataOffset % sizeof(QChar) == 0
+                 && (!hasChunks || (sectionFits(header.chunkOffset, header.chunkCount, sizeof(ChunkEntry), size)
+                                    && sectionFits(header.chunkIndexOffset, header.chunkIndexCount, sizeof(quint32), size)
+                                    && header.chunkIndexCount == header.shapeCount))
+                 && (!hasPoints || (sectionFits(header.pointOffset, header.pointCount, sizeof(PointEntry), size)
+                                    && header.pointOffset % alignof(PointEntry) == 0));
+    if (!valid) {
+        return false;
+    }
+
+    m_shapeOffset = header.shapeOffset;
+    m_styleOffset = header.styleOffset;
+    m_styleCount = header.styleCount;
+    m_stringCount = header.stringCount;
+    m_stringIndexOffset = header.stringIndexOffset;
+    m_stringDataOffset = header.stringDataOffset;
+    m_charCount = (size - header.stringDataOffset) / sizeof(QChar);
+    m_pointOffset = header.pointOffset;
+    m_backgroundColor = QColor::fromRgba(header.backgroundColor);
+    m_pageSize = QSize(header.pageWidth, header.pageHeight);
+
+    // 打开时校验所有记录，之后构造图形不会失败
+    const ShapeEntry *entries = reinterpret_cast<const ShapeEntry *>(m_data + header.shapeOffset);
+    for (quint32 i = 0; i < header.shapeCount; ++i) {
+        ShapeEntry entry;
+        std::memcpy(&entry, entries + i, sizeof(entry));
+        if (entry.type < ShapeFactory::Rect || entry.type > (hasPoints ? ShapeFactory::Curve : ShapeFactory::Arrow)
+            || entry.styleIndex >= header.styleCount || entry.fontIndex >= header.fontCount) {
+            return false;
+        }
+        if (hasWaypoints(entry.type)
+            && static_cast<quint64>(entry.waypoints.first) + entry.waypoints.count > header.pointCount) {
+            return false;
+        }
+    }
+
+    m_fonts.reserve(header.fontCount);
+    for (quint32 i = 0; i < header.fontCount; ++i) {
+        FontEntry entry;
+        std::memcpy(&entry, m_data + header.fontOffset + i * sizeof(FontEntry), sizeof(entry));
+        QFont font(readString(entry.familyIndex), entry.pointSize > 0 ? entry.pointSize : -1, -1, entry.italic != 0);
+        font.setBold(entry.bold != 0);
+        font.setUnderline(entry.underline != 0);
+        m_fonts.push_back(font);
+        m_fontColors.push_back(entry.fontColor);
+        m_alignments.push_back(entry.alignment);
+    }
+
+    // 读取空间目录，版本1的文件在打开时生成
+    std::vector<ChunkEntry> chunks;
+    if (hasChunks) {
+        chunks.resize(header.chunkCount);
+        m_chunkIndex.resize(header.chunkIndexCount);
+        if (header.chunkCount > 0) {
+            std::memcpy(chunks.data(), m_data + header.chunkOffset, header.chunkCount * sizeof(ChunkEntry));
+        }
+        if (header.chunkIndexCount > 0) {
+            std::memcpy(m_chunkIndex.data(), m_data + header.chunkIndexOffset, header.chunkIndexCount * sizeof(quint32));
+        }
+    } else {
+        std::vector<ShapeEntry> copies(header.shapeCount);
+        if (header.shapeCount > 0) {
+            std::memcpy(copies.data(), entries, header.shapeCount * sizeof(ShapeEntry));
+        }
+        buildChunks(copies.data(), header.shapeCount, nullptr, chunks, m_chunkIndex);
+    }
+
+    m_chunks.reserve(chunks.size());
+    for (const ChunkEntry &chunk: chunks) {
+        if (static_cast<quint64>(chunk.first) + chunk.count > m_chunkIndex.size()) {
+            return false;
+        }
+        m_chunks.push_back({QRectF(chunk.bounds[0], chunk.bounds[1], chunk.bounds[2], chunk.bounds[3]),
+                            chunk.first, chunk.count, false});
+    }
+    for (quint32 index: m_chunkIndex) {
+        if (index >= header.shapeCount) {
+            return false;
+        }
+    }
+
+    m_shapes.assign(header.shapeCount, nullptr);
+    m_pending = header.shapeCount;
+    m_cursor = 0;
+    return true;
+}
+
+void NativeDocumentReader::materializeRegion(const QRectF &rect, std::vector<quint32> &created) {
+    const size_t begin = created.size();
+    for (Chunk &chunk: m_chunks) {
+        if (chunk.done || !chunk.bounds.intersects(rect)) continue;
+        for (quint32 i = chunk.first; i < chunk.first + chunk.count; ++i) {
+            const quint32 index = m_chunkIndex[i];
+            if (!m_shapes[index]) {
+                materialize(index);
+                created.push_back(index);
+            }
+        }
+        chunk.done = true;
+    }
+    std::sort(created.begin() + static_cast<std::ptrdiff_t>(begin), created.end());
+}
+
+void NativeDocumentReader::materializeNext(quint32 count, std::vector<quint32> &created) {
+    const quint32 total = shapeCount();
+    for (; count > 0 && m_cursor < total; ++m_cursor) {
+        if (!m_shapes[m_cursor]) {
+            materialize(m_cursor);
+            created.push_back(m_cursor);
+            --count;
+        }
+    }
+}
+
+void NativeDocumentReader::materialize(quint32 index) {
+    ShapeEntry entry;
+    std::memcpy(&entry, m_data + m_shapeOffset + index * sizeof(ShapeEntry), sizeof(entry));
+    auto code = static_cast<ShapeFactory::TypeCode>(entry.type);
+    ShapeBase *shape = nullptr;
+    if (ShapeFactory::isLineType(code)) {
+        shape = ShapeFactory::createLine(code, QPointF(entry.geometry[0], entry.geometry[1]),
+                                         QPointF(entry.geometry[2], entry.geometry[3]));
+        if (hasWaypoints(entry.type) && entry.waypoints.count > 0) {
+            const QVector<QPointF> anchors = entryAnchors(entry, reinterpret_cast<const PointEntry *>(m_data + m_pointOffset));
+            static_cast<WaypointLineShape *>(shape)->setWaypoints(anchors.mid(1, anchors.size() - 2));
+        }
+    } else {
+        shape = ShapeFactory::createShape(code, QRectF(entry.geometry[0], entry.geometry[1],
+                                                       entry.geometry[2], entry.geometry[3]));
+        if (entry.rotation != 0.0) {
+            shape->setRotation(entry.rotation);
+        }
+    }
+
+    StyleEntry style;
+    std::memcpy(&style, m_data + m_styleOffset + entry.styleIndex * sizeof(StyleEntry), sizeof(style));
+    shape->setBorderColor(QColor::fromRgba(style.borderColor));
+    shape->setFillColor(QColor::fromRgba(style.fillColor));
+    shape->setPenWidth(style.penWidth);
+    shape->setBorderStyle(static_cast<Qt::PenStyle>(style.borderStyle));
+
+    shape->setFont(m_fonts[entry.fontIndex]);
+    shape->setFontColor(QColor::fromRgba(m_fontColors[entry.fontIndex]));
+    shape->setTextAlignment(static_cast<Qt::Alignment>(m_alignments[entry.fontIndex]));
+    if (entry.textIndex != NO_INDEX) {
+        shape->setText(readString(entry.textIndex));
+    }
+
+    m_shapes[index] = shape;
+    --m_pending;
+
+    // 线段端点：目标已构造时直接连接，否则等目标构造时再连接
+    if (auto line = dynamic_cast<LineBaseShape *>(shape)) {
+        line->setRouting(entry.routing == LineBaseShape::Orthogonal ? LineBaseShape::Orthogonal
+                                                                     : LineBaseShape::Straight);
+        const qint32 targets[2] = {entry.startTarget, entry.endTarget};
+        const int magnetic[2] = {entry.startMagnetic, entry.endMagnetic};
+        for (int end = 0; end < 2; ++end) {
+            const qint32 target = targets[end];
+            if (target < 0 || static_cast<quint32>(target) >= shapeCount() || static_cast<quint32>(target) == index) {
+                continue;
+            }
+            if (m_shapes[target]) {
+                line->setEndPointBinding(end, m_shapes[target], magnetic[end]);
+            } else {
+                m_waiting[static_cast<quint32>(target)].push_back({index, end, magnetic[end]});
+            }
+        }
+    }
+
+    auto waiting = m_waiting.find(index);
+    if (waiting != m_waiting.end()) {
+        for (const WaitingEnd &end: waiting->second) {
+            static_cast<LineBaseShape *>(m_shapes[end.line])->setEndPointBinding(end.endPoint, shape, end.magneticIndex);
+        }
+        m_waiting.erase(waiting);
+    }
+}
+
+QString NativeDocumentReader::readString(quint32 index) const {
+    if (index >= m_stringCount) return QString();
+    StringEntry entry;
+    std::memcpy(&entry, m_data + m_stringIndexOffset + index * sizeof(StringEntry), sizeof(entry));
+    if (static_cast<quint64>(entry.offset) + entry.length > m_charCount) return QString();
+    const QChar *chars = reinterpret_cast<const QChar *>(m_data + m_stringDataOffset);
+    return QString(chars + entry.offset, static_cast<int>(entry.length));
+}
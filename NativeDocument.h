@@ -0,0 +1,109 @@
+﻿#ifndef NATIVEDOCUMENT_H
+#define NATIVEDOCUMENT_H
+
+#include "ShapeBase.h"
+#include "DocumentContent.h"
+#include <QString>
+#include <QColor>
+#include <QSize>
+#include <QRectF>
+#include <QFile>
+#include <QFont>
+#include <vector>
+#include <unordered_map>
+
+// 原生二进制文档格式（.fcd）
+// 文件由固定布局的段组成：文件头、图形记录表、样式表、字体表、字符串索引、空间目录和UTF-16字符串数据。
+// 读取时通过QFile::map映射整个文件，按偏移直接取出记录，不需要逐属性解析文本。
+// 空间目录（版本2）把图形按所在区域分块，记录每块的外接矩形和成员序号，可以只构造某个区域内的图形。
+// 中间点表（版本3）保存折线/曲线连线的中间点，记录中只保存其在表中的范围。
+class NativeDocument {
+public:
+    static bool save(const QString &filePath, const std::vector<ShapeBase *> &shapes,
+                     const QColor &backgroundColor, const QSize &pageSize);          // 保存为二进制文档
+
+    static bool load(const QString &filePath, DocumentContent &content,
+                     const ProgressCallback &progress = ProgressCallback());          // 读取二进制文档（可在工作线程中调用）
+
+    static bool isNativeFile(const QString &filePath);                               // 根据文件头判断是否为二进制文档
+
+    static const char *const FILE_SUFFIX;                                            // 文件后缀
+};
+
+// 按需读取.fcd文档：打开时只映射文件、校验记录并读取空间目录，图形在第一次需要时才构造。
+// 尚未构造的图形一直以紧凑记录的形式留在映射内存中。构造出的图形归调用者所有，
+// 读取器只保留指针用于连接之后才构造的线段端点，因此调用者在读取完成之前不能删除这些图形
+class NativeDocumentReader {
+public:
+    NativeDocumentReader() = default;
+
+    ~NativeDocumentReader();
+
+    NativeDocumentReader(const NativeDocumentReader &) = delete;               // 禁止拷贝构造
+
+    NativeDocumentReader &operator=(const NativeDocumentReader &) = delete;    // 禁止赋值构造
+
+    bool open(const QString &filePath);                      // 映射文件并校验，失败返回false
+
+    QColor backgroundColor() const { return m_backgroundColor; }
+
+    QSize pageSize() const { return m_pageSize; }
+
+    quint32 shapeCount() const { return static_cast<quint32>(m_shapes.size()); }
+
+    quint32 pendingCount() const { return m_pending; }      // 尚未构造的图形数量
+
+    void materializeRegion(const QRectF &rect, std::vector<quint32> &created);     // 构造与rect相交的分块中的图形，新图形的序号按升序追加到created
+
+    void materializeNext(quint32 count, std::vector<quint32> &created);            // 按文件顺序构造接下来最多count个图形
+
+    ShapeBase *shapeAt(quint32 index) const { return m_shapes[index]; }           // 已构造的图形，未构造时为空
+
+    QRectF bounds() const;                                                          // 所有图形（包括尚未构造的）的外接矩形
+
+    qint64 mappedBytes() const { return m_data ? m_file.size() : 0; }               // 映射的文件大小
+
+    qint64 indexBytes() const;                                                      // 目录、图形表等读取器自身的内存
+
+private:
+    struct Chunk {
+        QRectF bounds;
+        quint32 first;                                       // 在成员序号表中的起始位置
+        quint32 count;
+        bool done;                                           // 成员是否已全部构造
+    };
+
+    struct WaitingEnd {                                      // 等待目标图形构造的线段端点
+        quint32 line;
+        int endPoint;
+        int magneticIndex;
+    };
+
+    void materialize(quint32 index);                         // 构造一个图形并连接相关的线段端点
+
+    QString readString(quint32 index) const;                 // 从映射内存中按UTF-16拷贝字符串
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    QColor m_backgroundColor;
+    QSize m_pageSize;
+    quint64 m_shapeOffset = 0;
+    quint64 m_styleOffset = 0;
+    quint32 m_styleCount = 0;
+    std::vector<QFont> m_fonts;                              // 每种字体只构造一次，图形之间共享
+    std::vector<QRgb> m_fontColors;
+    std::vector<quint32> m_alignments;
+    quint32 m_stringCount = 0;
+    quint64 m_stringIndexOffset = 0;
+    quint64 m_stringDataOffset = 0;
+    quint64 m_charCount = 0;
+    quint64 m_pointOffset = 0;                               // 中间点表（版本3）
+    std::vector<Chunk> m_chunks;
+    std::vector<quint32> m_chunkIndex;                       // 各分块的成员序号（块内升序）
+    std::vector<ShapeBase *> m_shapes;                       // 按文件顺序，未构造为空
+    std::unordered_map<quint32, std::vector<WaitingEnd>> m_waiting;   // 目标图形序号 -> 等待它的线段端点
+    quint32 m_pending = 0;
+    quint32 m_cursor = 0;                                    // materializeNext的扫描位置
+};
+
+#endif // NATIVEDOCUMENT_H
@@ -0,0 +1,667 @@
+﻿#include "OperationJournal.h"
+#include "ShapeFactory.h"
+#include "PolygonShape.h"
+#include "LineBaseShape.h"
+#include "WaypointLineShape.h"
+#include "NativeDocument.h"
+#include "SvgDocument.h"
+#include "Tracer.h"
+#include <QtConcurrent>
+#include <QStandardPaths>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QLockFile>
+#include <QFile>
+#include <QDir>
+#include <QHash>
+#include <unordered_map>
+#include <cstring>
+
+namespace {
+    const char MAGIC[4] = {'F', 'C', 'J', 'N'};
+    const quint32 FORMAT_VERSION = 3;                   // 版本2的线段记录增加走线方式，版本3增加折线/曲线连线的中间点
+    const QDataStream::Version STREAM_VERSION = QDataStream::Qt_5_6;
+
+    enum RecordType : quint8 {
+        CommitRecord = 1,                            // 一次图形编辑
+        DocumentRecord = 2                           // 背景颜色、页面大小
+    };
+
+    enum EntryType : quint8 {
+        EndEntry = 0,
+        RunEntry = 1,                                // 沿用上一状态中连续的一段图形
+        ShapeEntry = 2                               // 新增或修改后的图形
+    };
+
+    // 日志头
+    struct Header {
+        QString documentPath;                        // 用户文档路径，新建文档为空
+        QString basePath;                            // 基准文件（用户文档或压缩时生成的快照），为空表示空文档
+        qint64 baseSize = 0;
+        qint64 baseModified = 0;                     // 基准文件修改时间，用于确认基准文件未被改动
+        QColor backgroundColor;
+        QSize pageSize;
+    };
+
+    QString recoveryDir() {
+        return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/recovery";
+    }
+
+    QString lockPath(const QString &journalPath) {
+        QFileInfo info(journalPath);
+        return info.absolutePath() + "/" + info.completeBaseName() + ".lock";
+    }
+
+    QString snapshotPath(const QString &journalPath, int generation) {
+        QFileInfo info(journalPath);
+        return QString("%1/%2.%3.%4").arg(info.absolutePath(), info.completeBaseName())
+                .arg(generation).arg(NativeDocument::FILE_SUFFIX);
+    }
+
+    // 删除日志对应的快照，keep指定需要保留的快照
+    void removeSnapshots(const QString &journalPath, const QString &keep = QString()) {
+        QFileInfo info(journalPath);
+        QDir dir(info.absolutePath());
+        const QStringList names = dir.entryList({info.completeBaseName() + ".*." + NativeDocument::FILE_SUFFIX},
+                                                QDir::Files);
+        for (const QString &name: names) {
+            const QString path = dir.filePath(name);
+            if (QFileInfo(path) != QFileInfo(keep)) {
+                QFile::remove(path);
+            }
+        }
+    }
+
+    bool readHeader(QDataStream &in, Header &header) {
+        char magic[4];
+        quint32 version = 0;
+        if (in.readRawData(magic, sizeof(magic)) != sizeof(magic) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+            return false;
+        }
+        in >> version;
+        if (version != FORMAT_VERSION) {
+            return false;
+        }
+        in >> header.documentPath >> header.basePath >> header.baseSize >> header.baseModified
+           >> header.backgroundColor >> header.pageSize;
+        return in.status() == QDataStream::Ok;
+    }
+
+    // 读取一条记录，文件末尾不完整的记录（写入过程中崩溃）视为结束
+    bool readRecord(QDataStream &in, QByteArray &payload) {
+        quint32 size = 0;
+        quint16 checksum = 0;
+        in >> size >> checksum;
+        if (in.status() != QDataStream::Ok || size == 0 || size > 256u * 1024 * 1024) {
+            return false;
+        }
+        payload.resize(static_cast<int>(size));
+        if (in.readRawData(payload.data(), payload.size()) != payload.size()) {
+            return false;
+        }
+        return qChecksum(payload.constData(), static_cast<uint>(payload.size())) == checksum;
+    }
+
+    // 写入图形内容（不含线段绑定）
+    void writeShape(QDataStream &out, const ShapeBase *shape) {
+        out << quint8(ShapeFactory::typeCode(shape->getShapeType()));
+        if (auto line = dynamic_cast<const LineBaseShape *>(shape)) {
+            out << line->getStart() << line->getEnd() << quint8(line->getRouting());
+            if (auto waypointLine = dynamic_cast<const WaypointLineShape *>(line)) {
+                out << waypointLine->getWaypoints();
+            }
+        } else {
+            out << static_cast<const PolygonShape *>(shape)->getRect() << shape->getRotation();
+        }
+        out << qint32(shape->getPenWidth()) << shape->getBorderColor() << shape->getFillColor()
+            << qint32(shape->getBorderStyle())
+            << shape->getText() << shape->getFont() << shape->getFontColor() << qint32(shape->getTextAlignment());
+    }
+
+    ShapeBase *readShape(QDataStream &in) {
+        quint8 type = 0;
+        in >> type;
+        const auto code = static_cast<ShapeFactory::TypeCode>(type);
+        ShapeBase *shape = nullptr;
+        if (ShapeFactory::isLineType(code)) {
+            QPointF start, end;
+            quint8 routing = LineBaseShape::Straight;
+            in >> start >> end >> routing;
+            shape = ShapeFactory::createLine(code, start, end);
+            if (auto line = dynamic_cast<LineBaseShape *>(shape)) {
+                line->setRouting(routing == LineBaseShape::Orthogonal ? LineBaseShape::Orthogonal
+                                                                      : LineBaseShape::Straight);
+            }
+            if (auto line = dynamic_cast<WaypointLineShape *>(shape)) {
+                QVector<QPointF> waypoints;
+                in >> waypoints;
+                line->setWaypoints(waypoints);
+            }
+        } else {
+            QRectF rect;
+            qreal rotation = 0;
+            in >> rect >> rotation;
+            shape = ShapeFactory::createShape(code, rect);
+            if (shape && rotation != 0.0) {
+                shape->setRotation(rotation);
+            }
+        }
+
+        qint32 penWidth, borderStyle, alignment;
+        QColor borderColor, fillColor, fontColor;
+        QString text;
+        QFont font;
+        in >> penWidth >> borderColor >> fillColor >> borderStyle >> text >> font >> fontColor >> alignment;
+        if (!shape || in.status() != QDataStream::Ok) {
+            delete shape;
+            return nullptr;
+        }
+
+        shape->setPenWidth(penWidth);
+        shape->setBorderColor(borderColor);
+        shape->setFillColor(fillColor);
+        shape->setBorderStyle(static_cast<Qt::PenStyle>(borderStyle));
+        shape->setText(text);
+        shape->setFont(font);
+        shape->setFontColor(fontColor);
+        shape->setTextAlignment(static_cast<Qt::Alignment>(alignment));
+        return shape;
+    }
+
+    // 图形内容的字节表示，线段绑定按目标图形的UUID比较
+    QByteArray contentKey(const ShapeBase *shape) {
+        QByteArray bytes;
+        QDataStream out(&bytes, QIODevice::WriteOnly);
+        out.setVersion(STREAM_VERSION);
+        writeShape(out, shape);
+        if (auto line = dynamic_cast<const LineBaseShape *>(shape)) {
+            for (int i = 0; i < 2; ++i) {
+                const LineBaseShape::EndPointBinding binding = line->getEndPointBinding(i);
+                out << (binding.targetShape ? binding.targetShape->getUuid() : QUuid()) << qint32(binding.magneticIndex);
+            }
+        }
+        return bytes;
+    }
+
+    // 在当前文档上重放一次编辑
+    bool replayCommit(QDataStream &in, std::vector<ShapeBase *> &shapes) {
+        quint32 oldCount = 0;
+        in >> oldCount;
+        if (oldCount != shapes.size()) {
+            return false;
+        }
+
+        struct PendingBinding {
+            size_t line;
+            int endPoint;
+            qint32 target;
+            qint32 magneticIndex;
+        };
+        std::vector<ShapeBase *> result;
+        std::vector<ShapeBase *> replacement(shapes.size(), nullptr);   // 旧图形 -> 修改后的新图形
+        std::vector<char> used(shapes.size(), 0);
+        std::vector<PendingBinding> bindings;
+        std::vector<ShapeBase *> created;
+        result.reserve(shapes.size());
+
+        bool ok = true;
+        while (ok) {
+            quint8 entry = EndEntry;
+            in >> entry;
+            if (in.status() != QDataStream::Ok) {
+                ok = false;
+            } else if (entry == EndEntry) {
+                break;
+            } else if (entry == RunEntry) {
+                quint32 start = 0, length = 0;
+                in >> start >> length;
+                ok = in.status() == QDataStream::Ok && static_cast<quint64>(start) + length <= shapes.size();
+                for (quint32 i = start; ok && i < start + length; ++i) {
+                    result.push_back(shapes[i]);
+                    used[i] = 1;
+                }
+            } else if (entry == ShapeEntry) {
+                qint32 replaces = -1;
+                in >> replaces;
+                ShapeBase *shape = readShape(in);
+                ok = shape != nullptr;
+                if (ok && dynamic_cast<LineBaseShape *>(shape)) {
+                    for (int i = 0; i < 2; ++i) {
+                        qint32 target, magneticIndex;
+                        in >> target >> magneticIndex;
+                        if (target >= 0) bindings.push_back({result.size(), i, target, magneticIndex});
+                    }
+                }
+                if (ok) {
+                    created.push_back(shape);
+                    if (replaces >= 0 && static_cast<size_t>(replaces) < shapes.size()) {
+                        replacement[replaces] = shape;
+                    }
+                    result.push_back(shape);
+                }
+            } else {
+                ok = false;
+            }
+        }
+
+        if (!ok) {
+            for (auto shape: created) {                                // 只释放本次新建的图形
+                delete shape;
+            }
+            return false;
+        }
+
+        // 沿用的线段若绑定到被修改的图形，改为绑定到新图形；绑定到被删除的图形则解除
+        std::unordered_map<const ShapeBase *, size_t> oldIndex;
+        oldIndex.reserve(shapes.size());
+        for (size_t i = 0; i < shapes.size(); ++i) {
+            oldIndex.emplace(shapes[i], i);
+        }
+        for (auto shape: result) {
+            if (auto line = dynamic_cast<LineBaseShape *>(shape)) {
+                for (int i = 0; i < 2; ++i) {
+                    const LineBaseShape::EndPointBinding binding = line->getEndPointBinding(i);
+                    if (!binding.targetShape) continue;
+                    auto it = oldIndex.find(binding.targetShape);
+                    if (it == oldIndex.end() || used[it->second]) continue;
+                    if (replacement[it->second]) {
+                        line->setEndPointBinding(i, replacement[it->second], binding.magneticIndex);
+                    } else {
+                        line->clearEndPointBinding(i);
+                    }
+                }
+            }
+        }
+        for (const PendingBinding &binding: bindings) {
+            if (binding.target < static_cast<qint32>(result.size())) {
+                static_cast<LineBaseShape *>(result[binding.line])->setEndPointBinding(
+                        binding.endPoint, result[binding.target], binding.magneticIndex);
+            }
+        }
+
+        for (size_t i = 0; i < shapes.size(); ++i) {
+            if (!used[i]) delete shapes[i];
+        }
+        shapes.swap(result);
+        return true;
+    }
+}
+
+// 日志文件只在写入线程中打开和写入
+struct OperationJournal::Sink {
+    QFile file;
+};
+
+OperationJournal::OperationJournal() {
+    m_writer.setMaxThreadCount(1);
+    m_writer.setExpiryTimeout(-1);
+}
+
+OperationJournal::~OperationJournal() {
+    m_writer.waitForDone();
+}
+
+void OperationJournal::start(const QString &documentPath, const std::vector<ShapeBase *> &shapes,
+                             const QColor &backgroundColor, const QSize &pageSize, bool saved) {
+    if (!m_lock) {
+        // 每个运行中的程序使用自己的日志，并用锁文件表明日志仍在使用
+        QDir().mkpath(recoveryDir());
+        m_sessionId = QUuid::createUuid().toString().mid(1, 36);
+        m_journalPath = recoveryDir() + "/" + m_sessionId + ".fcj";
+        m_lock.reset(new QLockFile(lockPath(m_journalPath)));
+        m_lock->setStaleLockTime(0);
+        m_active = m_lock->tryLock(0);
+    }
+    if (!m_active) {
+        return;
+    }
+
+    m_documentPath = documentPath;
+    m_backgroundColor = backgroundColor;
+    m_pageSize = pageSize;
+    resetView(shapes);
+    m_dirty.clear();
+
+    const QFileInfo info(documentPath);
+    const bool loadable = saved && info.isFile() && (NativeDocument::isNativeFile(documentPath)
+                                                     || info.suffix().compare("svg", Qt::CaseInsensitive) == 0
+                                                     || SvgDocument::isCompressedFileName(documentPath));
+    if (loadable || (saved && shapes.empty())) {
+        restart(loadable ? documentPath : QString(), nullptr, false);
+    } else {
+        compact(shapes, false);                 // 没有可作为基准的文件，以当前内容作为基准
+    }
+}
+
+void OperationJournal::markDirty(const ShapeBase *shape) {
+    if (m_active && shape) {
+        m_dirty.insert(shape);
+    }
+}
+
+void OperationJournal::markChanged(const std::vector<ShapeBase *> &previous, const std::vector<ShapeBase *> &current) {
+    if (!m_active) {
+        return;
+    }
+
+    QHash<QUuid, const ShapeBase *> previousById;
+    previousById.reserve(static_cast<int>(previous.size()));
+    for (auto shape: previous) {
+        previousById.insert(shape->getUuid(), shape);
+    }
+    for (auto shape: current) {
+        const ShapeBase *before = previousById.value(shape->getUuid(), nullptr);
+        if (before && contentKey(before) != contentKey(shape)) {
+            m_dirty.insert(shape);
+        }
+    }
+}
+
+void OperationJournal::commit(const std::vector<ShapeBase *> &shapes) {
+    TRACE_SCOPE("OperationJournal::commit", "journal");
+    if (!m_active) {
+        return;
+    }
+
+    // 顺序不变时图形与上一状态按下标一一对应，否则按UUID查找
+    bool sameOrder = shapes.size() == static_cast<size_t>(m_view.size());
+    for (size_t i = 0; sameOrder && i < shapes.size(); ++i) {
+        sameOrder = shapes[i]->getUuid() == m_view[static_cast<int>(i)];
+    }
+    QHash<QUuid, qint32> oldIndex;
+    if (!sameOrder) {
+        oldIndex.reserve(m_view.size());
+        for (int i = 0; i < m_view.size(); ++i) {
+            oldIndex.insert(m_view[i], i);
+        }
+    }
+
+    // 线段绑定记录为目标图形在新状态中的下标，只有写入线段时才需要建立查找表
+    std::unordered_map<const ShapeBase *, qint32> newIndex;
+    auto indexOf = [&](const ShapeBase *shape) -> qint32 {
+        if (!shape) return -1;
+        if (newIndex.empty()) {
+            newIndex.reserve(shapes.size());
+            for (size_t i = 0; i < shapes.size(); ++i) newIndex.emplace(shapes[i], static_cast<qint32>(i));
+        }
+        auto it = newIndex.find(shape);
+        return it == newIndex.end() ? -1 : it->second;
+    };
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(STREAM_VERSION);
+    out << quint8(CommitRecord) << quint32(m_view.size());
+
+    qint32 runStart = 0;
+    quint32 runLength = 0;
+    auto flushRun = [&]() {
+        if (runLength > 0) {
+            out << quint8(RunEntry) << quint32(runStart) << runLength;
+            runLength = 0;
+        }
+    };
+
+    bool wroteShape = false;
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        const ShapeBase *shape = shapes[i];
+        const qint32 old = sameOrder ? static_cast<qint32>(i) : oldIndex.value(shape->getUuid(), -1);
+        if (old >= 0 && !m_dirty.count(shape)) {
+            if (runLength > 0 && old == runStart + static_cast<qint32>(runLength)) {
+                ++runLength;
+            } else {
+                flushRun();
+                runStart = old;
+                runLength = 1;
+            }
+            continue;
+        }
+
+        flushRun();
+        out << quint8(ShapeEntry) << old;
+        writeShape(out, shape);
+        if (auto line = dynamic_cast<const LineBaseShape *>(shape)) {
+            for (int end = 0; end < 2; ++end) {
+                const LineBaseShape::EndPointBinding binding = line->getEndPointBinding(end);
+                out << indexOf(binding.targetShape) << qint32(binding.magneticIndex);
+            }
+        }
+        wroteShape = true;
+    }
+    flushRun();
+    out << quint8(EndEntry);
+    m_dirty.clear();
+
+    if (sameOrder && !wroteShape) {             // 没有任何变化（如只是单击选择）
+        return;
+    }
+    if (!sameOrder) {
+        resetView(shapes);
+    }
+    append(payload);
+
+    if (m_bytesSinceBase > COMPACT_BYTES) {
+        compact(shapes, true);
+    }
+}
+
+void OperationJournal::commitDocument(const QColor &backgroundColor, const QSize &pageSize) {
+    if (!m_active || (backgroundColor == m_backgroundColor && pageSize == m_pageSize)) {
+        return;
+    }
+    m_backgroundColor = backgroundColor;
+    m_pageSize = pageSize;
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(STREAM_VERSION);
+    out << quint8(DocumentRecord) << backgroundColor << pageSize;
+    append(payload);
+}
+
+void OperationJournal::discard() {
+    if (!m_active) {
+        return;
+    }
+    m_writer.waitForDone();
+    if (m_sink) {
+        m_sink->file.close();
+        m_sink.reset();
+    }
+    remove(m_journalPath);
+    m_lock->unlock();
+    m_lock.reset();
+    m_active = false;
+}
+
+QStringList OperationJournal::pendingRecoveries() {
+    QStringList result;
+    QDir dir(recoveryDir());
+    const QStringList names = dir.entryList({"*.fcj"}, QDir::Files, QDir::Time);
+    for (const QString &name: names) {
+        const QString path = dir.filePath(name);
+        QLockFile lock(lockPath(path));
+        lock.setStaleLockTime(0);               // 只有持有锁的进程已退出才视为遗留日志
+        if (!lock.tryLock(0)) {
+            continue;                           // 日志属于另一个正在运行的程序
+        }
+
+        // 只有记录或以快照为基准的日志才包含未保存的修改
+        QFile file(path);
+        Header header;
+        bool pending = false;
+        if (file.open(QIODevice::ReadOnly)) {
+            QDataStream in(&file);
+            in.setVersion(STREAM_VERSION);
+            pending = readHeader(in, header) && (!in.atEnd() || header.basePath != header.documentPath);
+            file.close();
+        }
+        lock.unlock();
+
+        if (pending) {
+            result << path;
+        } else {
+            remove(path);
+        }
+    }
+    return result;
+}
+
+bool OperationJournal::recover(const QString &journalPath, DocumentContent &content, QString &documentPath,
+                               const ProgressCallback &progress) {
+    QFile file(journalPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&file);
+    in.setVersion(STREAM_VERSION);
+    Header header;
+    if (!readHeader(in, header)) {
+        return false;
+    }
+
+    // 基准文件在崩溃后被修改过时无法按下标重放
+    if (!header.basePath.isEmpty()) {
+        const QFileInfo info(header.basePath);
+        if (!info.isFile() || info.size() != header.baseSize
+            || info.lastModified().toMSecsSinceEpoch() != header.baseModified) {
+            return false;
+        }
+        bool loaded = false;
+        if (NativeDocument::isNativeFile(header.basePath)) {
+            loaded = NativeDocument::load(header.basePath, content, progress);
+        } else {
+            loaded = SvgDocument::load(header.basePath, content, progress);
+        }
+        if (!loaded) {
+            return false;
+        }
+    }
+    content.backgroundColor = header.backgroundColor;
+    content.pageSize = header.pageSize;
+
+    QByteArray payload;
+    int replayed = 0;
+    while (readRecord(in, payload)) {
+        QDataStream record(payload);
+        record.setVersion(STREAM_VERSION);
+        quint8 type = 0;
+        record >> type;
+        if (type == CommitRecord) {
+            if (!replayCommit(record, content.shapes)) break;
+        } else if (type == DocumentRecord) {
+            record >> content.backgroundColor >> content.pageSize;
+        } else {
+            break;
+        }
+
+        if (progress && (++replayed & 255) == 0 && !progress(100)) {
+            return false;
+        }
+    }
+
+    documentPath = header.documentPath;
+    return true;
+}
+
+void OperationJournal::remove(const QString &journalPath) {
+    removeSnapshots(journalPath);
+    QFile::remove(journalPath);
+}
+
+void OperationJournal::compact(const std::vector<ShapeBase *> &shapes, bool continuing) {
+    // 在界面线程中只做深拷贝，快照的序列化和写入都在写入线程中完成
+    auto snapshot = std::make_shared<DocumentContent>();
+    snapshot->shapes = ShapeFactory::cloneShapes(shapes);
+    snapshot->backgroundColor = m_backgroundColor;
+    snapshot->pageSize = m_pageSize;
+    restart(QString(), snapshot, continuing);
+}
+
+void OperationJournal::restart(const QString &basePath, const std::shared_ptr<DocumentContent> &snapshot,
+                               bool continuing) {
+    const std::shared_ptr<Sink> previous = m_sink;
+    const std::shared_ptr<Sink> sink = std::make_shared<Sink>();
+    m_sink = sink;
+    m_bytesSinceBase = 0;
+
+    Header header;
+    header.documentPath = m_documentPath;
+    header.basePath = snapshot ? snapshotPath(m_journalPath, ++m_generation) : basePath;
+    header.backgroundColor = m_backgroundColor;
+    header.pageSize = m_pageSize;
+    const QString journalPath = m_journalPath;
+
+    QtConcurrent::run(&m_writer, [previous, sink, snapshot, header, journalPath, continuing]() mutable {
+        // 新的日志头提交之前旧日志保持打开；失败时旧日志仍然有效，压缩时之后的记录继续追加到旧日志
+        auto keepPrevious = [&]() {
+            if (previous) {
+                previous->file.close();
+            }
+            if (continuing && previous && !previous->file.fileName().isEmpty()) {
+                sink->file.setFileName(previous->file.fileName());
+                sink->file.open(QIODevice::WriteOnly | QIODevice::Append);
+            }
+        };
+        if (snapshot && !NativeDocument::save(header.basePath, snapshot->shapes,
+                                              snapshot->backgroundColor, snapshot->pageSize)) {
+            QFile::remove(header.basePath);
+            keepPrevious();
+            return;
+        }
+        if (!header.basePath.isEmpty()) {
+            const QFileInfo info(header.basePath);
+            header.baseSize = info.size();
+            header.baseModified = info.lastModified().toMSecsSinceEpoch();
+        }
+
+        // 新日志头整体替换旧日志，替换前崩溃时旧日志仍然有效
+        QSaveFile out(journalPath);
+        if (!out.open(QIODevice::WriteOnly)) {
+            keepPrevious();
+            return;
+        }
+        QDataStream stream(&out);
+        stream.setVersion(STREAM_VERSION);
+        stream.writeRawData(MAGIC, sizeof(MAGIC));
+        stream << FORMAT_VERSION << header.documentPath << header.basePath << header.baseSize << header.baseModified
+               << header.backgroundColor << header.pageSize;
+        if (previous) {
+            previous->file.close();             // 替换文件之前关闭旧日志（Windows不能替换打开的文件）
+        }
+        if (!out.commit()) {
+            keepPrevious();
+            return;
+        }
+
+        removeSnapshots(journalPath, header.basePath);
+        sink->file.setFileName(journalPath);
+        sink->file.open(QIODevice::WriteOnly | QIODevice::Append);
+    });
+}
+
+void OperationJournal::append(const QByteArray &payload) {
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(STREAM_VERSION);
+    out << quint32(payload.size()) << qChecksum(payload.constData(), static_cast<uint>(payload.size()));
+    out.writeRawData(payload.constData(), payload.size());
+    m_bytesSinceBase += record.size();
+
+    const std::shared_ptr<Sink> sink = m_sink;
+    QtConcurrent::run(&m_writer, [sink, record]() {
+        if (sink->file.isOpen()) {
+            sink->file.write(record);
+            sink->file.flush();
+        }
+    });
+}
+
+void OperationJournal::resetView(const std::vector<ShapeBase *> &shapes) {
+    m_view.resize(static_cast<int>(shapes.size()));
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        m_view[static_cast<int>(i)] = shapes[i]->getUuid();
+    }
+}
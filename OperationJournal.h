@@ -0,0 +1,88 @@
+﻿#ifndef OPERATIONJOURNAL_H
+#define OPERATIONJOURNAL_H
+
+#include "ShapeBase.h"
+#include "DocumentContent.h"
+#include <QString>
+#include <QStringList>
+#include <QColor>
+#include <QSize>
+#include <QUuid>
+#include <QVector>
+#include <QThreadPool>
+#include <memory>
+#include <vector>
+#include <unordered_set>
+
+class QLockFile;
+
+// 操作日志：崩溃恢复和增量自动保存
+// 日志文件以最近一次保存的文件（基准文件）为起点，之后每次提交的编辑只追加发生变化的图形，
+// 未变化的图形只记录为“沿用基准中第几个到第几个”的区间，因此写入量与改动量成正比。
+// 写文件在单独的线程中按顺序执行，不阻塞界面。日志超过COMPACT_BYTES时把当前文档完整保存为
+// 新的基准快照并重新开始日志。程序正常退出时删除日志，下次启动时遗留的日志即为崩溃前未保存的修改。
+class OperationJournal {
+public:
+    OperationJournal();
+
+    ~OperationJournal();
+
+    OperationJournal(const OperationJournal &) = delete;               // 禁止拷贝构造
+
+    OperationJournal &operator=(const OperationJournal &) = delete;    // 禁止赋值构造
+
+    // 以documentPath为基准重新开始日志（文档刚打开或刚保存）。
+    // 文档内容与该文件不一致（saved为false），或该文件不是可读取的文档时，以当前内容生成快照作为基准
+    void start(const QString &documentPath, const std::vector<ShapeBase *> &shapes,
+               const QColor &backgroundColor, const QSize &pageSize, bool saved = true);
+
+    void markDirty(const ShapeBase *shape);                        // 标记图形内容已修改，下次提交时写入
+
+    void markChanged(const std::vector<ShapeBase *> &previous,
+                     const std::vector<ShapeBase *> &current);     // 比较两组图形（按UUID对应），标记内容不同的图形
+
+    void commit(const std::vector<ShapeBase *> &shapes);          // 提交一次编辑，只写入变化部分
+
+    void commitDocument(const QColor &backgroundColor, const QSize &pageSize);   // 提交页面属性的修改
+
+    void discard();                                                // 正常关闭时删除日志和快照
+
+    static QStringList pendingRecoveries();                       // 上次异常退出遗留的日志（最新的在前）
+
+    static bool recover(const QString &journalPath, DocumentContent &content, QString &documentPath,
+                        const ProgressCallback &progress = ProgressCallback());   // 读取基准文件并重放日志，返回原文档路径
+
+    static void remove(const QString &journalPath);               // 删除遗留的日志及其快照
+
+    static const qint64 COMPACT_BYTES = 8 * 1024 * 1024;          // 日志超过该大小时生成新的快照
+
+private:
+    struct Sink;                                                   // 日志文件，只在写入线程中访问
+
+    // 在写入线程中保存快照（可选）并写入新的日志头。continuing为true表示之后的记录仍接在旧日志之后（压缩），
+    // 此时新的基准写入失败会继续追加到旧日志，而不是丢弃之后的记录
+    void restart(const QString &basePath, const std::shared_ptr<DocumentContent> &snapshot, bool continuing);
+
+    void compact(const std::vector<ShapeBase *> &shapes, bool continuing);   // 以当前内容生成快照作为新的基准
+
+    void append(const QByteArray &payload);                       // 在写入线程中追加一条记录
+
+    void resetView(const std::vector<ShapeBase *> &shapes);       // 记录当前的图形顺序
+
+    QThreadPool m_writer;                                          // 只有一个线程，保证记录按提交顺序写入
+    std::shared_ptr<Sink> m_sink;
+    std::unique_ptr<QLockFile> m_lock;                             // 持有锁表示日志属于正在运行的程序
+    QString m_sessionId;
+    QString m_journalPath;
+    QString m_documentPath;                                        // 用户文档路径，写入日志头供恢复时使用
+    int m_generation = 0;                                          // 快照编号，每次压缩递增
+
+    QVector<QUuid> m_view;                                         // 日志中最后一次记录的图形顺序
+    std::unordered_set<const ShapeBase *> m_dirty;                 // 自上次提交以来内容改变的图形
+    QColor m_backgroundColor;
+    QSize m_pageSize;
+    qint64 m_bytesSinceBase = 0;
+    bool m_active = false;
+};
+
+#endif // OPERATIONJOURNAL_H
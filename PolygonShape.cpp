@@ -4,11 +4,11 @@
 
 PolygonShape::PolygonShape(const QRectF &rect) : m_rect(rect.normalized()) {}
 
-void PolygonShape::draw(QPainter &painter) {
+void PolygonShape::draw(QPainter &painter, bool draft) {
     painter.save();
 
     // 绘制多边形
-    painter.setPen(QPen(m_borderColor, m_penWidth, m_borderStyle));
+    painter.setPen(QPen(m_borderColor, m_penWidth, penStyle(m_borderStyle, draft)));
     painter.setBrush(m_fillColor);
     painter.drawPolygon(m_polygon);
 
@@ -19,14 +19,14 @@ void PolygonShape::draw(QPainter &painter) {
         painter.setPen(QPen(m_fontColor));
         QFont font(m_font);
         painter.setFont(font);
-        painter.drawText(rect, m_textAlignment | Qt::TextWordWrap, m_text);
+        drawShapeText(painter, rect, m_textAlignment | Qt::TextWordWrap, draft);
         painter.restore();
     }
 
     if (m_selected) {
         painter.save();
         // 绘制外接矩形边框
-        painter.setPen(QPen(Qt::blue, 1, Qt::DashLine));
+        painter.setPen(QPen(Qt::blue, 1, penStyle(Qt::DashLine, draft)));
         painter.setBrush(Qt::NoBrush);
         painter.drawRect(boundingRect());
 
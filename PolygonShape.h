@@ -9,7 +9,7 @@ public:
 
     virtual ~PolygonShape() {};
 
-    void draw(QPainter &painter) override;
+    void draw(QPainter &painter, bool draft) override;
 
     bool containPoint(const QPointF &point) const override;
 
@@ -17,6 +17,8 @@ public:
 
     QRectF boundingRect() const override;
 
+    QPolygonF outline() const override { return m_polygon; }
+
     QVector<QPointF> calculateHandles() const override;
 
     int hitHandle(const QPointF &point) const override;
@@ -25,6 +27,8 @@ public:
 
     bool isShapeCanRotate() const override { return true; }
 
+    QRectF getRect() const { return m_rect; }            // 获取未旋转的外接矩形
+
 protected:
     virtual void updatePolygon() = 0;                    // 更新多边形的坐标点集合
 
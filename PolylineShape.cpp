@@ -0,0 +1,15 @@
+﻿#include "PolylineShape.h"
+
+PolylineShape::PolylineShape(const QPointF &start, const QPointF &end, const QVector<QPointF> &waypoints)
+        : WaypointLineShape(start, end, waypoints) {}
+
+void PolylineShape::flattenSegment(const QVector<QPointF> &anchors, int segment, QVector<QPointF> &out) const {
+    out.append(anchors[segment + 1]);
+}
+
+// 深拷贝
+ShapeBase *PolylineShape::clone() const {
+    PolylineShape *line = new PolylineShape(*this);
+    line->setUuid(this->getUuid());     // 复制UUID
+    return line;
+}
@@ -0,0 +1,20 @@
+﻿#ifndef POLYLINESHAPE_H
+#define POLYLINESHAPE_H
+
+#include "WaypointLineShape.h"
+
+// 折线连线：相邻锚点之间为直线段
+class PolylineShape : public WaypointLineShape {
+public:
+    PolylineShape(const QPointF &start, const QPointF &end, const QVector<QPointF> &waypoints = QVector<QPointF>());
+
+    ShapeBase *clone() const override;
+
+    QString getShapeType() const override { return "Polyline"; }
+
+protected:
+    void flattenSegment(const QVector<QPointF> &anchors, int segment, QVector<QPointF> &out) const override;
+
+};
+
+#endif // POLYLINESHAPE_H
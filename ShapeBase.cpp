@@ -46,3 +46,20 @@ void ShapeBase::normalizeAngle() {
         m_rotationAngle -= 360.0;
 }
 
+void ShapeBase::drawShapeText(QPainter &painter, const QRectF &rect, int flags, bool draft) const {
+    if (!draft) {
+        painter.drawText(rect, flags, m_text);
+        return;
+    }
+    // 按字号估算行高和字符宽度，每行画一个半透明的条，省去字体排版
+    const qreal lineHeight = m_font.pointSizeF() > 0 ? m_font.pointSizeF() * 1.6 : qMax(m_font.pixelSize(), 8) * 1.2;
+    const qreal textWidth = m_text.size() * lineHeight * 0.5;
+    const int lines = qBound(1, qCeil(textWidth / qMax<qreal>(rect.width(), 1)), qMax(1, qFloor(rect.height() / lineHeight)));
+    const qreal barWidth = qMin(textWidth, rect.width());
+    qreal y = rect.center().y() - lines * lineHeight / 2;
+    QColor color = m_fontColor;
+    color.setAlpha(90);
+    for (int i = 0; i < lines; ++i, y += lineHeight) {
+        painter.fillRect(QRectF(rect.center().x() - barWidth / 2, y + lineHeight * 0.25, barWidth, lineHeight * 0.5), color);
+    }
+}
@@ -6,6 +6,7 @@
 #include <QRectF>
 #include <QPointF>
 #include <QVector>
+#include <QPolygonF>
 #include <QUuid>
 
 class ShapeBase {
@@ -38,12 +39,14 @@ public:
 
     bool isSelected() const { return m_selected; }
 
-    virtual void draw(QPainter &painter) = 0;
+    // draft为true时以草稿质量绘制：虚线画成实线，文本不排版，只画出大致占据的位置。只有界面重绘会使用草稿质量
+    virtual void draw(QPainter &painter, bool draft) = 0;
 
     virtual bool containPoint(const QPointF &point) const = 0; // 判断某个点是否在图形中
     virtual void moveBy(qreal dx, qreal dy) = 0;               // 图形移动
 
     virtual QRectF boundingRect() const = 0;                   // 返回图形的边界矩形，可用于碰撞检测，判断两个图形是否相交
+    virtual QPolygonF outline() const = 0;                     // 返回图形的轮廓点集，可用于区域选择等精确几何判断
     virtual QVector<QPointF> calculateHandles() const = 0;     // 计算图形的控制点
 
     virtual int hitHandle(const QPointF &point) const = 0;     // 获取图形的控制点
@@ -123,6 +126,8 @@ protected:
     virtual void updateShape() {};                                                                             // 更新图形
     void normalizeAngle();                                                                                     // 角度归一化
     static QVector<QPointF> applyRotation(const QPointF &center, const QVector<QPointF> &points, qreal angle); // 应用旋转
+    static Qt::PenStyle penStyle(Qt::PenStyle style, bool draft) { return draft ? Qt::SolidLine : style; }    // 草稿绘制时使用实线
+    void drawShapeText(QPainter &painter, const QRectF &rect, int flags, bool draft) const;                   // 在rect中绘制文本，草稿绘制时只画占位条
 };
 
 #endif // SHAPEBASE_H
\ No newline at end of file
@@ -0,0 +1,128 @@
+﻿#include "ShapeFactory.h"
+#include "RectShape.h"
+#include "EllipseShape.h"
+#include "DiamondShape.h"
+#include "PentagonShape.h"
+#include "HexagonShape.h"
+#include "ArrowShape.h"
+#include "LineShape.h"
+#include "PolylineShape.h"
+#include "CurveShape.h"
+#include <unordered_map>
+
+ShapeFactory::TypeCode ShapeFactory::typeCode(const QString &type) {
+    if (type == "Rect") return Rect;
+    if (type == "Ellipse") return Ellipse;
+    if (type == "Diamond") return Diamond;
+    if (type == "Pentagon") return Pentagon;
+    if (type == "Hexagon") return Hexagon;
+    if (type == "Line") return Line;
+    if (type == "Arrow") return Arrow;
+    if (type == "Polyline") return Polyline;
+    if (type == "Curve") return Curve;
+    return Unknown;
+}
+
+QString ShapeFactory::typeName(TypeCode code) {
+    switch (code) {
+        case Rect:
+            return "Rect";
+        case Ellipse:
+            return "Ellipse";
+        case Diamond:
+            return "Diamond";
+        case Pentagon:
+            return "Pentagon";
+        case Hexagon:
+            return "Hexagon";
+        case Line:
+            return "Line";
+        case Arrow:
+            return "Arrow";
+        case Polyline:
+            return "Polyline";
+        case Curve:
+            return "Curve";
+        default:
+            return QString();
+    }
+}
+
+bool ShapeFactory::isLineType(TypeCode code) {
+    return code == Line || code == Arrow || code == Polyline || code == Curve;
+}
+
+ShapeBase *ShapeFactory::createShape(TypeCode code, const QRectF &rect) {
+    switch (code) {
+        case Rect:
+            return new RectShape(rect);
+        case Ellipse:
+            return new EllipseShape(rect);
+        case Diamond:
+            return new DiamondShape(rect);
+        case Pentagon:
+            return new PentagonShape(rect);
+        case Hexagon:
+            return new HexagonShape(rect);
+        default:
+            return nullptr;
+    }
+}
+
+ShapeBase *ShapeFactory::createLine(TypeCode code, const QPointF &start, const QPointF &end) {
+    switch (code) {
+        case Line:
+            return new LineShape(start, end);
+        case Arrow:
+            return new ArrowShape(start, end);
+        case Polyline:
+            return new PolylineShape(start, end);
+        case Curve:
+            return new CurveShape(start, end);
+        default:
+            return nullptr;
+    }
+}
+
+ShapeBase *ShapeFactory::createDefaultShape(const QString &type, const QPointF &pos) {
+    TypeCode code = typeCode(type);
+    if (code == Polyline) {
+        return new PolylineShape(pos, pos + QPointF(DEFAULT_SIZE, DEFAULT_SIZE), {pos + QPointF(DEFAULT_SIZE, 0)});
+    }
+    if (code == Curve) {
+        return new CurveShape(pos, pos + QPointF(DEFAULT_SIZE * 2, 0), {pos + QPointF(DEFAULT_SIZE, -DEFAULT_SIZE / 2)});
+    }
+    if (isLineType(code)) {
+        return createLine(code, pos, pos + QPointF(DEFAULT_SIZE, 0));
+    }
+    return createShape(code, QRectF(pos, QSizeF(DEFAULT_SIZE, DEFAULT_SIZE)));
+}
+
+std::vector<ShapeBase *> ShapeFactory::cloneShapes(const std::vector<ShapeBase *> &source) {
+    std::vector<ShapeBase *> clones;
+    clones.reserve(source.size());
+    std::unordered_map<const ShapeBase *, ShapeBase *> cloneMap;      // 原图形 -> 副本的查找表
+    cloneMap.reserve(source.size());
+
+    for (auto shape: source) {
+        ShapeBase *cloned = shape->clone();
+        cloneMap.emplace(shape, cloned);
+        clones.push_back(cloned);
+    }
+
+    // 线段绑定的图形也在本组中时重定向到对应副本，否则解除绑定，避免副本引用组外的图形
+    for (auto cloned: clones) {
+        if (auto line = dynamic_cast<LineBaseShape *>(cloned)) {
+            for (int i = 0; i < 2; ++i) {
+                auto binding = line->getEndPointBinding(i);
+                if (!binding.targetShape) continue;
+                auto it = cloneMap.find(binding.targetShape);
+                if (it != cloneMap.end())
+                    line->setEndPointBinding(i, it->second, binding.magneticIndex);
+                else
+                    line->clearEndPointBinding(i);
+            }
+        }
+    }
+    return clones;
+}
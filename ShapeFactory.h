@@ -0,0 +1,43 @@
+﻿#ifndef SHAPEFACTORY_H
+#define SHAPEFACTORY_H
+
+#include "ShapeBase.h"
+#include <QString>
+#include <QRectF>
+#include <QPointF>
+#include <vector>
+
+// 图形工厂：根据图形类型创建图形，供拖放、文件读写等场景复用
+class ShapeFactory {
+public:
+    enum TypeCode : quint8 {                 // 图形类型编码（写入二进制文件，数值不可更改）
+        Unknown = 0,
+        Rect = 1,
+        Ellipse = 2,
+        Diamond = 3,
+        Pentagon = 4,
+        Hexagon = 5,
+        Line = 6,
+        Arrow = 7,
+        Polyline = 8,
+        Curve = 9
+    };
+
+    static TypeCode typeCode(const QString &type);                   // 类型名称 -> 类型编码
+
+    static QString typeName(TypeCode code);                          // 类型编码 -> 类型名称
+
+    static bool isLineType(TypeCode code);                           // 是否为线段类图形
+
+    static ShapeBase *createShape(TypeCode code, const QRectF &rect);                          // 创建多边形类图形
+
+    static ShapeBase *createLine(TypeCode code, const QPointF &start, const QPointF &end);     // 创建线段类图形
+
+    static ShapeBase *createDefaultShape(const QString &type, const QPointF &pos);            // 在pos处创建默认尺寸的图形
+
+    static std::vector<ShapeBase *> cloneShapes(const std::vector<ShapeBase *> &source);      // 深拷贝一组图形，组内线段绑定重定向到副本
+
+    static constexpr qreal DEFAULT_SIZE = 80.0;                      // 默认图形尺寸
+};
+
+#endif // SHAPEFACTORY_H
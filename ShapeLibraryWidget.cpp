@@ -29,6 +29,8 @@ ShapeLibraryWidget::ShapeLibraryWidget(QWidget* parent) : QWidget(parent)
 	m_iconShapeMap.insert(":/images/hexagon.png", "Hexagon");
 	m_iconShapeMap.insert(":/images/arrow.png", "Arrow");
 	m_iconShapeMap.insert(":/images/line.png", "Line");
+	m_iconShapeMap.insert(":/images/polyline.png", "Polyline");
+	m_iconShapeMap.insert(":/images/curve.png", "Curve");
 	setupButtons(basicLayout, m_iconShapeMap);
 	mainLayout->addWidget(basicGroup);
 
@@ -0,0 +1,218 @@
+﻿#include "SpatialIndex.h"
+#include <QtMath>
+#include <algorithm>
+
+SpatialIndex::SpatialIndex(qreal cellSize) : m_cellSize(cellSize > 1.0 ? cellSize : 1.0) {}
+
+void SpatialIndex::clear() {
+    m_items.clear();
+    m_cells.clear();
+    m_oversized.clear();
+    m_indexOf.clear();
+    m_visitMark.clear();
+    m_visitStamp = 0;
+    m_extent = QRectF();
+    m_extentExact = true;
+}
+
+void SpatialIndex::rebuild(const std::vector<ShapeBase *> &shapes, std::vector<QRectF> *changed) {
+    // 按指针比较重建前后的外接矩形（旧的指针可能已经释放，只作为键使用）
+    std::unordered_map<const ShapeBase *, QRectF> previous;
+    if (changed) {
+        previous.reserve(m_items.size());
+        for (const Item &item: m_items) {
+            previous.emplace(item.shape, item.bounds);
+        }
+    }
+
+    clear();
+    m_items.reserve(shapes.size());
+    m_cells.reserve(shapes.size());
+    m_indexOf.reserve(shapes.size());
+    for (auto shape: shapes) {
+        insert(shape, shape->boundingRect());
+        if (!changed) continue;
+        const QRectF &bounds = m_items.back().bounds;
+        auto it = previous.find(shape);
+        if (it == previous.end()) {
+            changed->push_back(bounds);                      // 新增的图形
+        } else {
+            if (it->second != bounds) {
+                changed->push_back(it->second);
+                changed->push_back(bounds);
+            }
+            previous.erase(it);
+        }
+    }
+    if (changed) {
+        for (const auto &entry: previous) {
+            changed->push_back(entry.second);                // 删除的图形
+        }
+    }
+}
+
+quint64 SpatialIndex::cellKey(int cx, int cy) {
+    return (static_cast<quint64>(static_cast<quint32>(cx)) << 32) | static_cast<quint32>(cy);
+}
+
+int SpatialIndex::cellCoord(qreal v) const {
+    return static_cast<int>(qFloor(v / m_cellSize));
+}
+
+void SpatialIndex::insert(ShapeBase *shape, const QRectF &bounds) {
+    int index = static_cast<int>(m_items.size());
+    // 线段的外接矩形可能宽或高为0，这里统一扩展为至少1个像素，保证能命中单元格
+    QRectF rect = bounds.normalized().adjusted(-0.5, -0.5, 0.5, 0.5);
+    m_items.push_back({shape, rect});
+    m_visitMark.push_back(0);
+    m_indexOf[shape] = index;
+    m_extent = m_extent.isNull() ? rect : m_extent.united(rect);
+    addToCells(index);
+}
+
+bool SpatialIndex::update(const ShapeBase *shape, const QRectF &bounds, QRectF *previous) {
+    auto it = m_indexOf.find(shape);
+    if (it == m_indexOf.end()) return false;
+    const int index = it->second;
+    Item &item = m_items[index];
+    if (previous) *previous = item.bounds;
+
+    const QRectF rect = bounds.normalized().adjusted(-0.5, -0.5, 0.5, 0.5);
+    if (rect == item.bounds) return true;
+
+    // 原来位于范围边界上的图形移走后实际范围可能缩小，等到需要时再重新计算
+    const QRectF &old = item.bounds;
+    if (old.left() <= m_extent.left() || old.top() <= m_extent.top()
+        || old.right() >= m_extent.right() || old.bottom() >= m_extent.bottom()) {
+        m_extentExact = false;
+    }
+    removeFromCells(index);
+    item.bounds = rect;
+    m_extent = m_extent.united(rect);
+    addToCells(index);
+    return true;
+}
+
+QRectF SpatialIndex::extent() const {
+    if (!m_extentExact) {
+        m_extent = QRectF();
+        for (const Item &item: m_items) {
+            m_extent = m_extent.isNull() ? item.bounds : m_extent.united(item.bounds);
+        }
+        m_extentExact = true;
+    }
+    return m_extent;
+}
+
+void SpatialIndex::addToCells(int index) {
+    const QRectF &rect = m_items[index].bounds;
+    int x0 = cellCoord(rect.left()), x1 = cellCoord(rect.right());
+    int y0 = cellCoord(rect.top()), y1 = cellCoord(rect.bottom());
+    if (static_cast<qint64>(x1 - x0 + 1) * (y1 - y0 + 1) > MAX_CELLS_PER_ITEM) {
+        m_oversized.push_back(index);
+        return;
+    }
+
+    for (int cy = y0; cy <= y1; ++cy) {
+        for (int cx = x0; cx <= x1; ++cx) {
+            m_cells[cellKey(cx, cy)].push_back(index);
+        }
+    }
+}
+
+void SpatialIndex::removeFromCells(int index) {
+    // 查询结果按序号排序，单元格内的顺序无关紧要，用最后一个元素填补空位
+    auto erase = [index](std::vector<int> &list) {
+        auto it = std::find(list.begin(), list.end(), index);
+        if (it != list.end()) {
+            *it = list.back();
+            list.pop_back();
+        }
+    };
+
+    const QRectF &rect = m_items[index].bounds;
+    int x0 = cellCoord(rect.left()), x1 = cellCoord(rect.right());
+    int y0 = cellCoord(rect.top()), y1 = cellCoord(rect.bottom());
+    if (static_cast<qint64>(x1 - x0 + 1) * (y1 - y0 + 1) > MAX_CELLS_PER_ITEM) {
+        erase(m_oversized);
+        return;
+    }
+
+    for (int cy = y0; cy <= y1; ++cy) {
+        for (int cx = x0; cx <= x1; ++cx) {
+            auto it = m_cells.find(cellKey(cx, cy));
+            if (it == m_cells.end()) continue;
+            erase(it->second);
+            if (it->second.empty()) {
+                m_cells.erase(it);               // 查询遍历已占用的单元格时不再经过空单元格
+            }
+        }
+    }
+}
+
+void SpatialIndex::collect(int index, const QRectF &rect, std::vector<int> &hits) const {
+    if (m_visitMark[index] == m_visitStamp) return;          // 同一图形可能跨越多个单元格
+    m_visitMark[index] = m_visitStamp;
+    if (m_items[index].bounds.intersects(rect)) {
+        hits.push_back(index);
+    }
+}
+
+std::vector<ShapeBase *> SpatialIndex::query(const QRectF &rect) const {
+    std::vector<ShapeBase *> result;
+    if (m_items.empty()) return result;
+
+    QRectF area = rect.normalized().adjusted(-0.5, -0.5, 0.5, 0.5);
+    if (!area.intersects(m_extent)) return result;
+
+    // 新一轮查询，标记溢出时重置
+    if (++m_visitStamp == 0) {
+        std::fill(m_visitMark.begin(), m_visitMark.end(), 0);
+        m_visitStamp = 1;
+    }
+
+    std::vector<int> hits;
+    int x0 = cellCoord(qMax(area.left(), m_extent.left())), x1 = cellCoord(qMin(area.right(), m_extent.right()));
+    int y0 = cellCoord(qMax(area.top(), m_extent.top())), y1 = cellCoord(qMin(area.bottom(), m_extent.bottom()));
+    qint64 cellCount = static_cast<qint64>(x1 - x0 + 1) * (y1 - y0 + 1);
+
+    if (cellCount > static_cast<qint64>(m_cells.size())) {
+        // 查询区域覆盖的单元格多于已占用的单元格时，直接遍历已占用的单元格
+        for (const auto &cell: m_cells) {
+            int cx = static_cast<int>(static_cast<qint32>(cell.first >> 32));
+            int cy = static_cast<int>(static_cast<qint32>(cell.first & 0xffffffffu));
+            if (cx < x0 || cx > x1 || cy < y0 || cy > y1) continue;
+            for (int index: cell.second) collect(index, area, hits);
+        }
+    } else {
+        for (int cy = y0; cy <= y1; ++cy) {
+            for (int cx = x0; cx <= x1; ++cx) {
+                auto it = m_cells.find(cellKey(cx, cy));
+                if (it == m_cells.end()) continue;
+                for (int index: it->second) collect(index, area, hits);
+            }
+        }
+    }
+    for (int index: m_oversized) collect(index, area, hits);
+
+    // 序号即插入顺序，排序后按图层顺序返回
+    std::sort(hits.begin(), hits.end());
+    result.reserve(hits.size());
+    for (int index: hits) result.push_back(m_items[index].shape);
+    return result;
+}
+
+std::vector<ShapeBase *> SpatialIndex::queryPoint(const QPointF &point) const {
+    return query(QRectF(point, QSizeF(0, 0)));
+}
+
+size_t SpatialIndex::memoryUsage() const {
+    // 哈希表按每个节点一个指针和一个桶估算
+    size_t bytes = m_items.capacity() * sizeof(Item) + m_oversized.capacity() * sizeof(int)
+                   + m_visitMark.capacity() * sizeof(quint32) + m_cells.bucket_count() * sizeof(void *)
+                   + m_indexOf.bucket_count() * sizeof(void *) + m_indexOf.size() * (sizeof(void *) * 2 + sizeof(int));
+    for (const auto &cell: m_cells) {
+        bytes += sizeof(cell) + sizeof(void *) + cell.second.capacity() * sizeof(int);
+    }
+    return bytes;
+}
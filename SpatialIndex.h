@@ -0,0 +1,68 @@
+﻿#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include "ShapeBase.h"
+#include <QRectF>
+#include <QPointF>
+#include <vector>
+#include <unordered_map>
+
+// 基于均匀网格的空间索引，用于按区域快速查询候选图形，避免每次都遍历全部图形
+class SpatialIndex {
+public:
+    explicit SpatialIndex(qreal cellSize = 128.0);
+
+    void clear();                                                    // 清空索引
+
+    void rebuild(const std::vector<ShapeBase *> &shapes,
+                 std::vector<QRectF> *changed = nullptr);            // 按图层顺序重建索引，changed不为空时追加新增、删除和移动的图形前后的外接矩形
+
+    void insert(ShapeBase *shape, const QRectF &bounds);             // 插入一个图形（插入顺序即图层顺序）
+
+    bool update(const ShapeBase *shape, const QRectF &bounds,
+                QRectF *previous = nullptr);                         // 更新已索引图形的外接矩形（图层顺序不变），图形不在索引中时返回false
+
+    std::vector<ShapeBase *> query(const QRectF &rect) const;        // 查询外接矩形与rect相交的图形，按图层顺序返回
+
+    std::vector<ShapeBase *> queryPoint(const QPointF &point) const; // 查询外接矩形包含point的图形，按图层顺序返回
+
+    bool isEmpty() const { return m_items.empty(); }
+
+    size_t size() const { return m_items.size(); }
+
+    QRectF extent() const;                                           // 所有已索引图形的外接矩形
+
+    size_t memoryUsage() const;                                      // 索引占用的内存（字节）
+
+private:
+    struct Item {
+        ShapeBase *shape;
+        QRectF bounds;
+    };
+
+    static quint64 cellKey(int cx, int cy);                          // 网格坐标 -> 哈希键
+
+    int cellCoord(qreal v) const;                                    // 场景坐标 -> 网格坐标
+
+    void addToCells(int index);                                      // 把图形登记到外接矩形覆盖的单元格
+
+    void removeFromCells(int index);                                 // 从外接矩形覆盖的单元格中移除图形
+
+    void collect(int index, const QRectF &rect, std::vector<int> &hits) const;  // 去重并精确比较外接矩形
+
+private:
+    static constexpr int MAX_CELLS_PER_ITEM = 256;                   // 超过该单元格数的大图形单独存放
+
+    qreal m_cellSize;                                                // 单元格边长
+    std::vector<Item> m_items;                                       // 图形及其外接矩形
+    std::unordered_map<quint64, std::vector<int>> m_cells;           // 单元格 -> 图形序号
+    std::vector<int> m_oversized;                                    // 跨越过多单元格的图形序号
+    std::unordered_map<const ShapeBase *, int> m_indexOf;            // 图形 -> 序号
+    mutable QRectF m_extent;                                         // 更新图形后可能大于实际范围，查询时仍可用于裁剪
+    mutable bool m_extentExact = true;                               // 为false时extent()重新计算
+
+    mutable std::vector<quint32> m_visitMark;                        // 查询去重标记
+    mutable quint32 m_visitStamp = 0;
+};
+
+#endif // SPATIALINDEX_H
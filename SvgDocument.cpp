@@ -0,0 +1,897 @@
+﻿#include "SvgDocument.h"
+#include "ShapeFactory.h"
+#include "PolygonShape.h"
+#include "LineBaseShape.h"
+#include "CurveShape.h"
+#include "Tracer.h"
+#include <QXmlStreamWriter>
+#include <QXmlStreamReader>
+#include <QSaveFile>
+#include <QFile>
+#include <QtConcurrent>
+#include <QThread>
+#include <QHash>
+#include <QFont>
+#include <QTransform>
+#include <QtMath>
+#include <atomic>
+#include <unordered_map>
+
+const char *const SvgDocument::FC_NAMESPACE = "http://flowcharttool/ns/document/1";
+
+namespace {
+    const char *const SVG_NAMESPACE = "http://www.w3.org/2000/svg";
+    const qreal VIEW_MARGIN = 20.0;                   // 导出区域在图形外扩的边距
+    const qreal ARROW_SIZE = 20.0;                    // 与ArrowShape::drawArrowHead保持一致
+    const qreal LINE_HEIGHT = 1.2;                    // 多行文本的行高（em）
+
+    // 一个图形解析出的原始记录，构造图形所需的数据都已转换好
+    struct ShapeRecord {
+        ShapeFactory::TypeCode code = ShapeFactory::Unknown;
+        double geometry[4] = {0, 0, 0, 0};           // 多边形：x, y, width, height；线段：startX, startY, endX, endY
+        double rotation = 0;
+        int routing = 0;                             // 线段的走线方式，见LineBaseShape::Routing
+        QVector<QPointF> waypoints;                  // 折线/曲线连线的中间点
+        int penWidth = 0;
+        int borderStyle = 0;
+        int textAlignment = 0;
+        QColor borderColor;
+        QColor fillColor;
+        QColor fontColor;
+        QString text;
+        QFont font;
+    };
+
+    // 线段端点的绑定关系，图形全部构造完成后再按序号连接
+    struct PendingBinding {
+        size_t line;
+        int endPoint;                                // 0为起点，1为终点
+        int target;
+        int magneticIndex;
+    };
+
+    // 图形样式（边框、填充），导出时对应一个CSS类
+    struct ShapeStyle {
+        int penWidth = 2;
+        QColor borderColor = Qt::black;
+        QColor fillColor = Qt::white;
+        int borderStyle = Qt::SolidLine;
+    };
+
+    // 文本样式，导出时对应一个CSS类
+    struct TextStyle {
+        QFont font;
+        QColor color = Qt::black;
+        int alignment = Qt::AlignCenter;
+    };
+
+    QString number(qreal value) {                    // 绘制用坐标保留两位小数，减小文件体积
+        return QString::number(qRound64(value * 100.0) / 100.0);
+    }
+
+    QString exactNumber(qreal value) {               // 元数据中的几何信息需要精确还原
+        return QString::number(value, 'g', 12);
+    }
+
+    QString pointList(const QPolygonF &polygon) {
+        QString result;
+        for (const QPointF &pt: polygon) {
+            if (!result.isEmpty()) result += QLatin1Char(' ');
+            result += number(pt.x()) + QLatin1Char(',') + number(pt.y());
+        }
+        return result;
+    }
+
+    // Qt画笔样式对应的虚线模式（以线宽为单位）
+    QString dashArray(int borderStyle, int penWidth) {
+        QVector<int> pattern;
+        switch (borderStyle) {
+            case Qt::DashLine:
+                pattern = {4, 2};
+                break;
+            case Qt::DotLine:
+                pattern = {1, 2};
+                break;
+            case Qt::DashDotLine:
+                pattern = {4, 2, 1, 2};
+                break;
+            case Qt::DashDotDotLine:
+                pattern = {4, 2, 1, 2, 1, 2};
+                break;
+            default:
+                return QString();
+        }
+        QStringList parts;
+        for (int len: pattern) {
+            parts << QString::number(len * qMax(1, penWidth));
+        }
+        return parts.join(QLatin1Char(','));
+    }
+
+    // ---------------- 写入 ----------------
+
+    // 收集文档中用到的样式，相同样式只生成一个CSS类
+    class StyleTable {
+    public:
+        int shapeStyle(const ShapeBase *shape, bool hasArrowHead) {
+            ShapeStyle style;
+            style.penWidth = shape->getPenWidth();
+            style.borderColor = shape->getBorderColor();
+            style.fillColor = shape->getFillColor();
+            style.borderStyle = shape->getBorderStyle();
+
+            const QString key = QString::number(style.penWidth) + style.borderColor.name(QColor::HexArgb)
+                                + style.fillColor.name(QColor::HexArgb) + QString::number(style.borderStyle);
+            int index = m_shapeIndex.value(key, -1);
+            if (index < 0) {
+                index = static_cast<int>(m_shapeStyles.size());
+                m_shapeIndex.insert(key, index);
+                m_shapeStyles.push_back(style);
+                m_arrowHeads.push_back(false);
+            }
+            if (hasArrowHead) {
+                m_arrowHeads[index] = true;
+            }
+            return index;
+        }
+
+        int textStyle(const ShapeBase *shape) {
+            TextStyle style;
+            style.font = shape->getFont();
+            style.color = shape->getFontColor();
+            style.alignment = shape->getTextAlignment();
+
+            const QString key = style.font.key() + style.color.name(QColor::HexArgb) + QString::number(style.alignment);
+            int index = m_textIndex.value(key, -1);
+            if (index < 0) {
+                index = static_cast<int>(m_textStyles.size());
+                m_textIndex.insert(key, index);
+                m_textStyles.push_back(style);
+            }
+            return index;
+        }
+
+        QString css() const {
+            QString result;
+            for (size_t i = 0; i < m_shapeStyles.size(); ++i) {
+                const ShapeStyle &style = m_shapeStyles[i];
+                result += QString(".s%1{fill:%2;stroke:%3;stroke-width:%4")
+                        .arg(i).arg(style.fillColor.name(), style.borderColor.name()).arg(style.penWidth);
+                appendOpacity(result, "fill-opacity", style.fillColor);
+                appendOpacity(result, "stroke-opacity", style.borderColor);
+                const QString dash = dashArray(style.borderStyle, style.penWidth);
+                if (!dash.isEmpty()) {
+                    result += ";stroke-dasharray:" + dash;
+                }
+                if (style.borderStyle == Qt::NoPen) {
+                    result += ";stroke:none";
+                }
+                result += "}\n";
+                if (m_arrowHeads[i]) {                                  // 箭头头部使用边框颜色填充
+                    result += QString(".s%1 .h{fill:%2;stroke:none}\n").arg(i).arg(style.borderColor.name());
+                }
+            }
+            for (size_t i = 0; i < m_textStyles.size(); ++i) {
+                const TextStyle &style = m_textStyles[i];
+                QString family = style.font.family();
+                family.remove(QLatin1Char('\'')).remove(QLatin1Char('<'));
+                result += QString(".t%1{font-family:'%2';font-size:%3pt;fill:%4;stroke:none")
+                        .arg(i).arg(family).arg(style.font.pointSizeF()).arg(style.color.name());
+                if (style.font.bold()) result += ";font-weight:bold";
+                if (style.font.italic()) result += ";font-style:italic";
+                if (style.font.underline()) result += ";text-decoration:underline";
+                if (style.alignment & Qt::AlignLeft) {
+                    result += ";text-anchor:start";
+                } else if (style.alignment & Qt::AlignRight) {
+                    result += ";text-anchor:end";
+                } else {
+                    result += ";text-anchor:middle";
+                }
+                if (style.alignment & Qt::AlignTop) {
+                    result += ";dominant-baseline:hanging";
+                } else if (style.alignment & Qt::AlignBottom) {
+                    result += ";dominant-baseline:text-after-edge";
+                } else {
+                    result += ";dominant-baseline:central";
+                }
+                result += "}\n";
+            }
+            return result;
+        }
+
+        // 写入应用自己的样式表，读取时据此还原图形属性
+        void writeMetadata(QXmlStreamWriter &writer) const {
+            const QString ns = SvgDocument::FC_NAMESPACE;
+            writer.writeStartElement(ns, "styles");
+            for (size_t i = 0; i < m_shapeStyles.size(); ++i) {
+                const ShapeStyle &style = m_shapeStyles[i];
+                writer.writeEmptyElement(ns, "style");
+                writer.writeAttribute("id", QString("s%1").arg(i));
+                writer.writeAttribute("penWidth", QString::number(style.penWidth));
+                writer.writeAttribute("borderColor", style.borderColor.name(QColor::HexArgb));
+                writer.writeAttribute("fillColor", style.fillColor.name(QColor::HexArgb));
+                writer.writeAttribute("borderStyle", QString::number(style.borderStyle));
+            }
+            for (size_t i = 0; i < m_textStyles.size(); ++i) {
+                const TextStyle &style = m_textStyles[i];
+                writer.writeEmptyElement(ns, "font");
+                writer.writeAttribute("id", QString("t%1").arg(i));
+                writer.writeAttribute("family", style.font.family());
+                writer.writeAttribute("size", QString::number(style.font.pointSize()));
+                writer.writeAttribute("bold", QString::number(style.font.bold()));
+                writer.writeAttribute("italic", QString::number(style.font.italic()));
+                writer.writeAttribute("underline", QString::number(style.font.underline()));
+                writer.writeAttribute("color", style.color.name(QColor::HexArgb));
+                writer.writeAttribute("alignment", QString::number(style.alignment));
+            }
+            writer.writeEndElement();
+        }
+
+    private:
+        static void appendOpacity(QString &css, const char *property, const QColor &color) {
+            if (color.alpha() != 255) {
+                css += QString(";%1:%2").arg(property).arg(number(color.alphaF()));
+            }
+        }
+
+        std::vector<ShapeStyle> m_shapeStyles;
+        std::vector<bool> m_arrowHeads;
+        std::vector<TextStyle> m_textStyles;
+        QHash<QString, int> m_shapeIndex;
+        QHash<QString, int> m_textIndex;
+    };
+
+    // 写入图形本身的几何元素，旋转已经包含在坐标中
+    void writeGeometry(QXmlStreamWriter &writer, const ShapeBase *shape, ShapeFactory::TypeCode code) {
+        if (auto line = dynamic_cast<const WaypointLineShape *>(shape)) {
+            if (code == ShapeFactory::Curve) {
+                // 曲线按贝塞尔控制点写为路径，不使用展平后的折线
+                const QVector<QPointF> points = CurveShape::bezierPoints(line->anchors());
+                QString d = "M" + number(points[0].x()) + ',' + number(points[0].y());
+                for (int i = 1; i < points.size(); ++i) {
+                    d += ((i - 1) % 3 == 0 ? " C" : " ") + number(points[i].x()) + ',' + number(points[i].y());
+                }
+                writer.writeEmptyElement("path");
+                writer.writeAttribute("d", d);
+            } else {
+                writer.writeEmptyElement("polyline");
+                writer.writeAttribute("points", pointList(QPolygonF(line->anchors())));
+            }
+            writer.writeAttribute("style", "fill:none");              // 覆盖样式类中的填充色
+            const QPolygonF head = line->arrowHead();
+            if (!head.isEmpty()) {
+                writer.writeEmptyElement("polygon");
+                writer.writeAttribute("class", "h");
+                writer.writeAttribute("points", pointList(head));
+            }
+            return;
+        }
+
+        if (auto line = dynamic_cast<const LineBaseShape *>(shape)) {
+            const QVector<QPointF> points = line->pathPoints();
+            const QPointF start = points[points.size() - 2];          // 箭头沿最后一段的方向
+            const QPointF end = points.last();
+            if (points.size() > 2) {
+                writer.writeEmptyElement("polyline");
+                writer.writeAttribute("style", "fill:none");          // 覆盖样式类中的填充色
+                writer.writeAttribute("points", pointList(QPolygonF(points)));
+            } else {
+                writer.writeEmptyElement("line");
+                writer.writeAttribute("x1", number(start.x()));
+                writer.writeAttribute("y1", number(start.y()));
+                writer.writeAttribute("x2", number(end.x()));
+                writer.writeAttribute("y2", number(end.y()));
+            }
+
+            if (code == ShapeFactory::Arrow) {
+                const double angle = std::atan2(end.y() - start.y(), end.x() - start.x());
+                QPolygonF head;
+                head << end
+                     << end - QPointF(std::cos(angle - M_PI / 6.0) * ARROW_SIZE, std::sin(angle - M_PI / 6.0) * ARROW_SIZE)
+                     << end - QPointF(std::cos(angle + M_PI / 6.0) * ARROW_SIZE, std::sin(angle + M_PI / 6.0) * ARROW_SIZE);
+                writer.writeEmptyElement("polygon");
+                writer.writeAttribute("class", "h");
+                writer.writeAttribute("points", pointList(head));
+            }
+            return;
+        }
+
+        auto polygonShape = static_cast<const PolygonShape *>(shape);
+        const QRectF rect = polygonShape->getRect();
+        const qreal rotation = shape->getRotation();
+
+        if (code == ShapeFactory::Ellipse) {
+            // 旋转后的椭圆仍是椭圆：用两段弧表示，旋转角作为弧的x轴旋转角
+            const QPointF center = rect.center();
+            const qreal rx = rect.width() / 2.0;
+            const qreal ry = rect.height() / 2.0;
+            const qreal radians = qDegreesToRadians(rotation);
+            const QPointF axis(rx * qCos(radians), rx * qSin(radians));
+            const QPointF p0 = center + axis;
+            const QPointF p1 = center - axis;
+            const QString arc = QString("A%1 %2 %3 1 1 ").arg(number(rx), number(ry), number(rotation));
+            writer.writeEmptyElement("path");
+            writer.writeAttribute("d", "M" + number(p0.x()) + ',' + number(p0.y()) + ' '
+                                       + arc + number(p1.x()) + ',' + number(p1.y()) + ' '
+                                       + arc + number(p0.x()) + ',' + number(p0.y()) + 'Z');
+        } else if (code == ShapeFactory::Rect && rotation == 0.0) {
+            writer.writeEmptyElement("rect");
+            writer.writeAttribute("x", number(rect.x()));
+            writer.writeAttribute("y", number(rect.y()));
+            writer.writeAttribute("width", number(rect.width()));
+            writer.writeAttribute("height", number(rect.height()));
+        } else {
+            writer.writeEmptyElement("polygon");
+            writer.writeAttribute("points", pointList(shape->outline()));
+        }
+    }
+
+    // 写入文本，每行一个<text>元素。文本不随图形旋转，与绘图区域的显示一致
+    void writeText(QXmlStreamWriter &writer, const ShapeBase *shape, int textStyle) {
+        QRectF rect;
+        if (auto line = dynamic_cast<const LineBaseShape *>(shape)) {
+            const QPointF mid = line->pathMidPoint();
+            rect = QRectF(mid.x() - 40, mid.y() - 15, 80, 30);
+        } else {
+            rect = shape->boundingRect();
+        }
+
+        const Qt::Alignment alignment = shape->getTextAlignment();
+        qreal x = rect.center().x();
+        if (alignment & Qt::AlignLeft) x = rect.left();
+        else if (alignment & Qt::AlignRight) x = rect.right();
+        qreal y = rect.center().y();
+        if (alignment & Qt::AlignTop) y = rect.top();
+        else if (alignment & Qt::AlignBottom) y = rect.bottom();
+
+        const QStringList lines = shape->getText().split(QLatin1Char('\n'));
+        const int count = lines.size();
+        for (int i = 0; i < count; ++i) {
+            qreal offset = i;                                          // 以行为单位的纵向偏移
+            if (alignment & Qt::AlignBottom) offset = i - (count - 1);
+            else if (!(alignment & Qt::AlignTop)) offset = i - (count - 1) / 2.0;
+
+            writer.writeStartElement("text");
+            writer.writeAttribute("class", QString("t%1").arg(textStyle));
+            writer.writeAttribute("xml:space", "preserve");
+            writer.writeAttribute("x", number(x));
+            writer.writeAttribute("y", number(y));
+            if (offset != 0.0) {
+                writer.writeAttribute("dy", number(offset * LINE_HEIGHT) + "em");
+            }
+            writer.writeCharacters(lines[i]);
+            writer.writeEndElement();
+        }
+    }
+
+    // ---------------- 读取 ----------------
+
+    // 解析阶段复用的字体：相同字体的图形共享同一份QFont数据
+    class FontCache {
+    public:
+        QFont font(const QString &family, int size, bool bold, bool italic, bool underline) {
+            const QString key = family + QLatin1Char('|') + QString::number(size)
+                                + QLatin1Char('|') + QString::number(bold * 4 + italic * 2 + underline);
+            auto it = m_fonts.constFind(key);
+            if (it != m_fonts.constEnd()) {
+                return it.value();
+            }
+
+            QFont font;
+            font.setFamily(family);
+            font.setPointSize(size);
+            font.setBold(bold);
+            font.setItalic(italic);
+            font.setUnderline(underline);
+            m_fonts.insert(key, font);
+            return font;
+        }
+
+    private:
+        QHash<QString, QFont> m_fonts;
+    };
+
+    // 顺序读取文件中的图形记录，同时支持两种格式：
+    // 旧格式为<shapes>下的<shape>元素；新格式为带fc:type属性的<g>元素，样式从<fc:styles>中查找
+    class RecordScanner {
+    public:
+        RecordScanner(QIODevice &device, DocumentContent &content) : m_reader(&device), m_content(content) {}
+
+        // 读到下一个图形时返回true；文件结束或出错时返回false，出错可通过failed()判断
+        bool next(ShapeRecord &record) {
+            while (!m_reader.atEnd()) {
+                m_reader.readNext();                                   // 读取下一个元素
+                if (!m_reader.isStartElement()) {
+                    continue;
+                }
+
+                const QStringRef name = m_reader.name();
+                const bool fcElement = m_reader.namespaceUri() == SvgDocument::FC_NAMESPACE;
+                if (name == "svg") {
+                    readBackground();
+                } else if (fcElement && name == "style") {
+                    readShapeStyle();
+                } else if (fcElement && name == "font") {
+                    readTextStyle();
+                } else if (name == "shape") {                          // 旧格式<shape>
+                    return readLegacyShape(record);
+                } else if (name == "g" && m_reader.attributes().hasAttribute(SvgDocument::FC_NAMESPACE, "type")) {
+                    return readShapeGroup(record);
+                }
+            }
+            return false;
+        }
+
+        bool failed() const { return m_failed || m_reader.hasError(); }
+
+        qint64 position() const { return m_reader.device()->pos(); }
+
+        size_t recordCount() const { return m_recordCount; }
+
+        const std::vector<PendingBinding> &bindings() const { return m_bindings; }
+
+    private:
+        void readBackground() {
+            const QXmlStreamAttributes attributes = m_reader.attributes();
+            QString bgColor = attributes.value(SvgDocument::FC_NAMESPACE, "backgroundColor").toString();
+            if (bgColor.isEmpty()) {
+                bgColor = attributes.value("backgroundColor").toString();   // 旧格式的背景颜色
+            }
+            if (!bgColor.isEmpty()) {
+                m_content.backgroundColor = QColor(bgColor);
+            }
+        }
+
+        void readShapeStyle() {
+            const QXmlStreamAttributes attributes = m_reader.attributes();
+            ShapeStyle style;
+            style.penWidth = attributes.value("penWidth").toInt();
+            style.borderColor = QColor(attributes.value("borderColor").toString());
+            style.fillColor = QColor(attributes.value("fillColor").toString());
+            style.borderStyle = attributes.value("borderStyle").toInt();
+            m_shapeStyles.insert(attributes.value("id").toString(), style);
+        }
+
+        void readTextStyle() {
+            const QXmlStreamAttributes attributes = m_reader.attributes();
+            TextStyle style;
+            style.font = m_fonts.font(attributes.value("family").toString(),
+                                      attributes.value("size").toInt(),
+                                      attributes.value("bold").toInt(),
+                                      attributes.value("italic").toInt(),
+                                      attributes.value("underline").toInt());
+            style.color = QColor(attributes.value("color").toString());
+            style.alignment = attributes.value("alignment").toInt();
+            m_textStyles.insert(attributes.value("id").toString(), style);
+        }
+
+        bool readLegacyShape(ShapeRecord &record) {
+            const QXmlStreamAttributes attributes = m_reader.attributes();
+            record.code = ShapeFactory::typeCode(attributes.value("type").toString());   // 获取当前XML元素的type属性值
+            if (record.code == ShapeFactory::Unknown) {
+                return fail();
+            }
+
+            if (ShapeFactory::isLineType(record.code)) {
+                record.geometry[0] = attributes.value("startX").toDouble();
+                record.geometry[1] = attributes.value("startY").toDouble();
+                record.geometry[2] = attributes.value("endX").toDouble();
+                record.geometry[3] = attributes.value("endY").toDouble();
+                record.rotation = 0;
+            } else {
+                record.geometry[0] = attributes.value("x").toDouble();
+                record.geometry[1] = attributes.value("y").toDouble();
+                record.geometry[2] = attributes.value("width").toDouble();
+                record.geometry[3] = attributes.value("height").toDouble();
+                record.rotation = attributes.value("rotation").toDouble();
+            }
+
+            record.penWidth = attributes.value("penWidth").toInt();
+            record.borderColor = QColor(attributes.value("borderColor").toString());
+            record.fillColor = QColor(attributes.value("fillColor").toString());
+            record.borderStyle = attributes.value("borderStyle").toInt();
+
+            record.text = attributes.value("text").toString();
+            record.font = m_fonts.font(attributes.value("fontFamily").toString(),
+                                       attributes.value("fontSize").toInt(),
+                                       attributes.value("fontBold").toInt(),
+                                       attributes.value("fontItalic").toInt(),
+                                       attributes.value("fontUnderline").toInt());
+            record.fontColor = QColor(attributes.value("fontColor").toString());
+            record.textAlignment = attributes.value("textAlignment").toInt();
+            ++m_recordCount;
+            return true;
+        }
+
+        bool readShapeGroup(ShapeRecord &record) {
+            const QString ns = SvgDocument::FC_NAMESPACE;
+            const QXmlStreamAttributes attributes = m_reader.attributes();
+            record.code = ShapeFactory::typeCode(attributes.value(ns, "type").toString());
+            const QVector<QStringRef> geometry = attributes.value(ns, "geometry").split(QLatin1Char(' '));
+            if (record.code == ShapeFactory::Unknown || geometry.size() != 4) {
+                return fail();
+            }
+            for (int i = 0; i < 4; ++i) {
+                record.geometry[i] = geometry[i].toDouble();
+            }
+            record.rotation = attributes.value(ns, "rotation").toDouble();
+            if (attributes.value(ns, "routing") == QLatin1String("orthogonal")) {
+                record.routing = LineBaseShape::Orthogonal;
+            }
+            // 中间点格式为"x1 y1 x2 y2 ..."
+            const QVector<QStringRef> waypoints = attributes.value(ns, "waypoints").split(QLatin1Char(' '),
+                                                                                          QString::SkipEmptyParts);
+            for (int i = 0; i + 1 < waypoints.size(); i += 2) {
+                record.waypoints.append(QPointF(waypoints[i].toDouble(), waypoints[i + 1].toDouble()));
+            }
+
+            const ShapeStyle style = m_shapeStyles.value(attributes.value("class").toString());
+            record.penWidth = style.penWidth;
+            record.borderColor = style.borderColor;
+            record.fillColor = style.fillColor;
+            record.borderStyle = style.borderStyle;
+
+            readBinding(attributes.value(ns, "start"), 0);
+            readBinding(attributes.value(ns, "end"), 1);
+
+            // 读取<g>中的文本行，其余几何元素由元数据重新生成，直接跳过
+            QStringList lines;
+            QString textClass;
+            while (m_reader.readNextStartElement()) {
+                if (m_reader.name() == "text") {
+                    if (textClass.isEmpty()) {
+                        textClass = m_reader.attributes().value("class").toString();
+                    }
+                    lines << m_reader.readElementText(QXmlStreamReader::IncludeChildElements);
+                } else {
+                    m_reader.skipCurrentElement();
+                }
+            }
+
+            const TextStyle text = m_textStyles.value(textClass, m_defaultTextStyle);
+            record.text = lines.join(QLatin1Char('\n'));
+            record.font = text.font;
+            record.fontColor = text.color;
+            record.textAlignment = text.alignment;
+            ++m_recordCount;
+            return true;
+        }
+
+        // 绑定格式为"图形序号 磁力点序号"
+        void readBinding(const QStringRef &value, int endPoint) {
+            const QVector<QStringRef> parts = value.split(QLatin1Char(' '));
+            if (parts.size() == 2) {
+                m_bindings.push_back({m_recordCount, endPoint, parts[0].toInt(), parts[1].toInt()});
+            }
+        }
+
+        bool fail() {
+            m_failed = true;
+            return false;
+        }
+
+        QXmlStreamReader m_reader;
+        DocumentContent &m_content;
+        FontCache m_fonts;
+        QHash<QString, ShapeStyle> m_shapeStyles;
+        QHash<QString, TextStyle> m_textStyles;
+        TextStyle m_defaultTextStyle{QFont("Arial", 9), Qt::black, Qt::AlignCenter};
+        std::vector<PendingBinding> m_bindings;
+        size_t m_recordCount = 0;
+        bool m_failed = false;
+    };
+
+    // 根据记录构造图形，不访问任何共享状态，可在多个线程中同时调用
+    ShapeBase *buildShape(const ShapeRecord &record) {
+        const double *g = record.geometry;
+        ShapeBase *shape = nullptr;
+        if (ShapeFactory::isLineType(record.code)) {
+            shape = ShapeFactory::createLine(record.code, QPointF(g[0], g[1]), QPointF(g[2], g[3]));
+            if (record.routing != LineBaseShape::Straight && shape) {
+                static_cast<LineBaseShape *>(shape)->setRouting(static_cast<LineBaseShape::Routing>(record.routing));
+            }
+            if (auto line = dynamic_cast<WaypointLineShape *>(shape)) {
+                line->setWaypoints(record.waypoints);
+            }
+        } else {
+            shape = ShapeFactory::createShape(record.code, QRectF(g[0], g[1], g[2], g[3]));
+        }
+        if (!shape) {
+            return nullptr;
+        }
+
+        if (record.rotation != 0.0) {
+            shape->setRotation(record.rotation);          // 未旋转的图形无需重新计算多边形
+        }
+        shape->setPenWidth(record.penWidth);
+        shape->setBorderColor(record.borderColor);
+        shape->setFillColor(record.fillColor);
+        shape->setBorderStyle(static_cast<Qt::PenStyle>(record.borderStyle));
+
+        shape->setText(record.text);
+        shape->setFont(record.font);
+        shape->setFontColor(record.fontColor);
+        shape->setTextAlignment(static_cast<Qt::Alignment>(record.textAlignment));
+        return shape;
+    }
+
+    // 所有图形构造完成后连接线段端点
+    void applyBindings(const std::vector<PendingBinding> &bindings, std::vector<ShapeBase *> &shapes) {
+        for (const PendingBinding &binding: bindings) {
+            if (binding.line >= shapes.size() || binding.target < 0
+                || static_cast<size_t>(binding.target) >= shapes.size()) {
+                continue;
+            }
+            if (auto line = dynamic_cast<LineBaseShape *>(shapes[binding.line])) {
+                line->setEndPointBinding(binding.endPoint, shapes[binding.target], binding.magneticIndex);
+            }
+        }
+    }
+
+    int devicePercent(const RecordScanner &scanner, qint64 total, int scale) {
+        return static_cast<int>(scanner.position() * scale / total);
+    }
+
+    // 单线程：边解析边构造
+    bool loadSerial(QIODevice &device, DocumentContent &content, const ProgressCallback &progress) {
+        RecordScanner scanner(device, content);
+        const qint64 total = qMax<qint64>(1, device.size());
+        ShapeRecord record;
+
+        while (scanner.next(record)) {
+            content.shapes.push_back(buildShape(record));
+
+            // 定期汇报进度并检查是否取消
+            if (progress && (content.shapes.size() & 255) == 0 && !progress(devicePercent(scanner, total, 100))) {
+                return false;
+            }
+        }
+        if (scanner.failed()) {
+            return false;
+        }
+        applyBindings(scanner.bindings(), content.shapes);
+        return true;
+    }
+
+    // 第一阶段：顺序扫描文件，只生成原始记录，进度占0-50%
+    bool scanRecords(RecordScanner &scanner, std::vector<ShapeRecord> &records, qint64 total,
+                     const ProgressCallback &progress) {
+        records.emplace_back();
+        while (scanner.next(records.back())) {
+            if (progress && (records.size() & 255) == 0 && !progress(devicePercent(scanner, total, 50))) {
+                return false;
+            }
+            records.emplace_back();
+        }
+        records.pop_back();                                            // 最后一条为未填充的记录
+        return !scanner.failed();
+    }
+
+    // 第二阶段：分块构造图形，进度占50-100%。
+    // 当前线程也参与构造，并在块之间汇报进度；结果按记录下标写入，天然保持文件顺序
+    bool buildShapes(const std::vector<ShapeRecord> &records, std::vector<ShapeBase *> &shapes,
+                     const ProgressCallback &progress, bool parallel) {
+        const int chunkSize = SvgDocument::CHUNK_SIZE;
+        const int chunkCount = static_cast<int>((records.size() + chunkSize - 1) / chunkSize);
+        shapes.assign(records.size(), nullptr);
+
+        std::atomic<int> nextChunk(0);
+        std::atomic<int> finishedChunks(0);
+        std::atomic<bool> cancelled(false);
+
+        // 领取下一个块并构造，没有剩余块或已取消时返回false
+        auto buildNextChunk = [&]() {
+            const int chunk = nextChunk.fetch_add(1);
+            if (chunk >= chunkCount || cancelled.load()) {
+                return false;
+            }
+            const size_t begin = static_cast<size_t>(chunk) * chunkSize;
+            const size_t end = qMin(records.size(), begin + chunkSize);
+            for (size_t i = begin; i < end; ++i) {
+                shapes[i] = buildShape(records[i]);
+            }
+            finishedChunks.fetch_add(1);
+            return true;
+        };
+
+        QVector<QFuture<void>> helpers;
+        if (parallel) {
+            const int helperCount = qMin(chunkCount, QThread::idealThreadCount()) - 1;
+            for (int i = 0; i < helperCount; ++i) {
+                helpers.append(QtConcurrent::run([&buildNextChunk]() {
+                    while (buildNextChunk()) {}
+                }));
+            }
+        }
+
+        while (buildNextChunk()) {
+            if (progress && !progress(50 + finishedChunks.load() * 50 / chunkCount)) {
+                cancelled.store(true);
+            }
+        }
+        for (QFuture<void> &helper: helpers) {
+            helper.waitForFinished();
+        }
+
+        if (cancelled.load()) {
+            for (auto shape: shapes) {
+                delete shape;
+            }
+            shapes.clear();
+            return false;
+        }
+        return true;
+    }
+}
+
+bool SvgDocument::save(QIODevice &device, const std::vector<ShapeBase *> &shapes,
+                       const QColor &backgroundColor, const QSize &canvasSize) {
+    TRACE_SCOPE_DETAIL("SvgDocument::save", "io", QString("%1 shapes").arg(shapes.size()));
+    // 导出区域为所有图形的外接矩形，空文档使用整个画布
+    QRectF viewBox;
+    for (auto shape: shapes) {
+        if (shape) viewBox = viewBox.united(shape->boundingRect());
+    }
+    viewBox = viewBox.isNull() ? QRectF(QPointF(0, 0), canvasSize)
+                               : viewBox.adjusted(-VIEW_MARGIN, -VIEW_MARGIN, VIEW_MARGIN, VIEW_MARGIN);
+
+    // 先收集样式，写在图形之前，读取时图形可以直接引用
+    StyleTable styles;
+    std::vector<int> shapeStyles(shapes.size(), -1);
+    std::vector<int> textStyles(shapes.size(), -1);
+    std::unordered_map<const ShapeBase *, int> shapeIndex;
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        const ShapeBase *shape = shapes[i];
+        if (!shape) continue;
+        shapeIndex[shape] = static_cast<int>(i);
+        shapeStyles[i] = styles.shapeStyle(shape, ShapeFactory::typeCode(shape->getShapeType()) == ShapeFactory::Arrow
+                                                  || dynamic_cast<const WaypointLineShape *>(shape));
+        if (!shape->getText().isEmpty()) {
+            textStyles[i] = styles.textStyle(shape);
+        }
+    }
+
+    QXmlStreamWriter writer(&device);                // 创建XML写入器，绑定到已打开的设备
+    writer.writeStartDocument();                     // 写入文档头，标识这是一个XML文档
+    writer.writeDefaultNamespace(SVG_NAMESPACE);     // 设置命名空间（必须）
+    writer.writeNamespace(FC_NAMESPACE, "fc");       // 应用元数据使用独立的命名空间，浏览器会忽略
+    writer.writeStartElement(SVG_NAMESPACE, "svg");  // 写入<svg> 标签，定义SVG根元素
+    writer.writeAttribute("width", number(viewBox.width()));        // 设置SVG画布尺寸
+    writer.writeAttribute("height", number(viewBox.height()));
+    writer.writeAttribute("viewBox", QString("%1 %2 %3 %4").arg(number(viewBox.x()), number(viewBox.y()),
+                                                                number(viewBox.width()), number(viewBox.height())));
+    writer.writeAttribute(FC_NAMESPACE, "version", "2");
+    writer.writeAttribute(FC_NAMESPACE, "backgroundColor", backgroundColor.name(QColor::HexArgb));
+    writer.writeCharacters("\n");
+
+    writer.writeStartElement("metadata");
+    styles.writeMetadata(writer);
+    writer.writeEndElement();
+    writer.writeCharacters("\n");
+    writer.writeTextElement("style", styles.css());
+    writer.writeCharacters("\n");
+
+    writer.writeEmptyElement("rect");                // 页面背景
+    writer.writeAttribute("x", number(viewBox.x()));
+    writer.writeAttribute("y", number(viewBox.y()));
+    writer.writeAttribute("width", number(viewBox.width()));
+    writer.writeAttribute("height", number(viewBox.height()));
+    writer.writeAttribute("fill", backgroundColor.name());
+    writer.writeCharacters("\n");
+
+    // 每个图形写为一个<g>：几何元素用于显示，fc属性用于还原
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        const ShapeBase *shape = shapes[i];
+        if (!shape) continue;
+        const ShapeFactory::TypeCode code = ShapeFactory::typeCode(shape->getShapeType());
+
+        writer.writeStartElement("g");
+        writer.writeAttribute("class", QString("s%1").arg(shapeStyles[i]));
+        writer.writeAttribute(FC_NAMESPACE, "type", shape->getShapeType());
+        if (auto line = dynamic_cast<const LineBaseShape *>(shape)) {
+            writer.writeAttribute(FC_NAMESPACE, "geometry", QString("%1 %2 %3 %4")
+                    .arg(exactNumber(line->getStart().x()), exactNumber(line->getStart().y()),
+                         exactNumber(line->getEnd().x()), exactNumber(line->getEnd().y())));
+            if (line->getRouting() == LineBaseShape::Orthogonal) {
+                writer.writeAttribute(FC_NAMESPACE, "routing", "orthogonal");
+            }
+            if (auto waypointLine = dynamic_cast<const WaypointLineShape *>(line)) {
+                if (!waypointLine->getWaypoints().isEmpty()) {
+                    QStringList values;
+                    for (const QPointF &point: waypointLine->getWaypoints()) {
+                        values << exactNumber(point.x()) << exactNumber(point.y());
+                    }
+                    writer.writeAttribute(FC_NAMESPACE, "waypoints", values.join(QLatin1Char(' ')));
+                }
+            }
+            for (int end = 0; end < 2; ++end) {
+                const LineBaseShape::EndPointBinding binding = line->getEndPointBinding(end);
+                auto target = shapeIndex.find(binding.targetShape);
+                if (target != shapeIndex.end()) {
+                    writer.writeAttribute(FC_NAMESPACE, end == 0 ? "start" : "end",
+                                          QString("%1 %2").arg(target->second).arg(binding.magneticIndex));
+                }
+            }
+        } else {
+            const QRectF rect = static_cast<const PolygonShape *>(shape)->getRect();
+            writer.writeAttribute(FC_NAMESPACE, "geometry", QString("%1 %2 %3 %4")
+                    .arg(exactNumber(rect.x()), exactNumber(rect.y()),
+                         exactNumber(rect.width()), exactNumber(rect.height())));
+            if (shape->getRotation() != 0.0) {
+                writer.writeAttribute(FC_NAMESPACE, "rotation", exactNumber(shape->getRotation()));
+            }
+        }
+
+        writeGeometry(writer, shape, code);
+        if (textStyles[i] >= 0) {
+            writeText(writer, shape, textStyles[i]);
+        }
+        writer.writeEndElement();                    // 结束<g>
+        writer.writeCharacters("\n");
+    }
+
+    writer.writeEndElement();                        // 结束<svg>标签，结束SVG根元素
+    writer.writeEndDocument();                       // 结束XML文档
+    return !writer.hasError();
+}
+
+bool SvgDocument::load(QIODevice &device, DocumentContent &content, const ProgressCallback &progress,
+                       LoadStrategy strategy) {
+    TRACE_SCOPE("SvgDocument::load", "io");
+    if (strategy == Serial) {
+        return loadSerial(device, content, progress);
+    }
+
+    RecordScanner scanner(device, content);
+    std::vector<ShapeRecord> records;
+    if (!scanRecords(scanner, records, qMax<qint64>(1, device.size()), progress)) {
+        return false;
+    }
+
+    bool parallel = strategy == Parallel || records.size() >= static_cast<size_t>(PARALLEL_THRESHOLD);
+    if (!buildShapes(records, content.shapes, progress, parallel)) {
+        return false;
+    }
+    applyBindings(scanner.bindings(), content.shapes);
+    return true;
+}
+
+bool SvgDocument::save(const QString &filePath, const std::vector<ShapeBase *> &shapes,
+                       const QColor &backgroundColor, const QSize &canvasSize, int compressionLevel) {
+    QSaveFile file(filePath);                              // 先写入临时文件，成功后再替换目标文件
+    if (!isCompressedFileName(filePath)) {
+        // 以只写和文本模式打开文件
+        return file.open(QIODevice::WriteOnly | QIODevice::Text)
+               && save(file, shapes, backgroundColor, canvasSize) && file.commit();
+    }
+
+    // QXmlStreamWriter直接写入压缩流，压缩后的数据分块写入文件
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    GzipDevice gzip(&file, compressionLevel);
+    if (!gzip.open(QIODevice::WriteOnly) || !save(gzip, shapes, backgroundColor, canvasSize)) {
+        return false;
+    }
+    gzip.close();                                          // 写出压缩流的剩余数据
+    return !gzip.hasError() && file.commit();
+}
+
+bool SvgDocument::load(const QString &filePath, DocumentContent &content, const ProgressCallback &progress,
+                       LoadStrategy strategy) {
+    QFile file(filePath);
+    // 不使用文本模式，压缩数据需要按原样读取；QXmlStreamReader自己处理换行符
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    if (!GzipDevice::isGzip(&file)) {
+        return load(file, content, progress, strategy);
+    }
+
+    GzipDevice gzip(&file);
+    return gzip.open(QIODevice::ReadOnly) && load(gzip, content, progress, strategy) && !gzip.hasError();
+}
+
+bool SvgDocument::isCompressedFileName(const QString &filePath) {
+    return filePath.endsWith(".svgz", Qt::CaseInsensitive);
+}
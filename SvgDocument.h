@@ -0,0 +1,50 @@
+﻿#ifndef SVGDOCUMENT_H
+#define SVGDOCUMENT_H
+
+#include "ShapeBase.h"
+#include "DocumentContent.h"
+#include "GzipDevice.h"
+#include <QIODevice>
+#include <QString>
+#include <QColor>
+#include <QSize>
+#include <vector>
+
+// SVG文档的读写
+// 写入标准SVG：每个图形是一个<g>，包含多边形/路径/文本元素（旋转已计算到坐标中），相同样式合并为CSS类；
+// 应用自己的数据写在fc命名空间中（<fc:styles>样式表和<g>上的fc属性），浏览器会忽略，读取时据此还原图形。
+// 后缀为.svgz的文件经GzipDevice边写边压缩，读取时根据文件头自动识别是否压缩。
+// 读取同时支持旧版的<shape>元素格式，分两个阶段：先顺序扫描文件，把每个图形解析成原始记录；
+// 再把记录分块交给线程池并行构造图形（多边形构造时需要三角函数计算顶点），最后按文件顺序合并。
+class SvgDocument {
+public:
+    enum LoadStrategy {
+        Auto,                    // 图形数量达到PARALLEL_THRESHOLD时并行构造，否则在当前线程构造
+        Serial,                  // 边解析边构造（单线程）
+        Parallel                 // 总是并行构造
+    };
+
+    static bool save(QIODevice &device, const std::vector<ShapeBase *> &shapes,
+                     const QColor &backgroundColor, const QSize &canvasSize);         // 写入SVG，空文档时使用画布尺寸
+
+    static bool load(QIODevice &device, DocumentContent &content,
+                     const ProgressCallback &progress = ProgressCallback(),
+                     LoadStrategy strategy = Auto);                                   // 读取SVG（可在工作线程中调用）
+
+    static bool save(const QString &filePath, const std::vector<ShapeBase *> &shapes,
+                     const QColor &backgroundColor, const QSize &canvasSize,
+                     int compressionLevel = GzipDevice::Balanced);                    // 保存到文件，.svgz按compressionLevel压缩
+
+    static bool load(const QString &filePath, DocumentContent &content,
+                     const ProgressCallback &progress = ProgressCallback(),
+                     LoadStrategy strategy = Auto);                                   // 读取文件，自动识别是否为gzip压缩
+
+    static bool isCompressedFileName(const QString &filePath);                       // 后缀是否为.svgz
+
+    static const char *const FC_NAMESPACE;            // 应用元数据的命名空间
+
+    static const int PARALLEL_THRESHOLD = 4096;       // 并行构造的最少图形数量
+    static const int CHUNK_SIZE = 1024;               // 每个并行任务构造的图形数量
+};
+
+#endif // SVGDOCUMENT_H
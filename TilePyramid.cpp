@@ -0,0 +1,227 @@
+﻿#include "TilePyramid.h"
+#include "LineBaseShape.h"
+#include <QElapsedTimer>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+
+quint64 TilePyramid::tileKey(int tx, int ty) {
+    return (static_cast<quint64>(static_cast<quint32>(tx)) << 32) | static_cast<quint32>(ty);
+}
+
+void TilePyramid::tileCoords(quint64 key, int &tx, int &ty) {
+    tx = static_cast<int>(static_cast<quint32>(key >> 32));
+    ty = static_cast<int>(static_cast<quint32>(key));
+}
+
+int TilePyramid::tileCoord(qreal v, int shift) {
+    return static_cast<int>(qFloor(v / std::ldexp(static_cast<qreal>(TILE_SIZE), shift)));
+}
+
+QRectF TilePyramid::tileRect(int shift, int tx, int ty) {
+    const qreal size = std::ldexp(static_cast<qreal>(TILE_SIZE), shift);
+    return QRectF(tx * size, ty * size, size, size);
+}
+
+void TilePyramid::setScene(const QRectF &sceneRect, const QRectF &pageRect,
+                           const QColor &pageColor, const QColor &canvasColor) {
+    const bool restyled = pageRect != m_pageRect || pageColor != m_pageColor || canvasColor != m_canvasColor;
+    const bool resized = sceneRect != m_sceneRect;
+    m_pageRect = pageRect;
+    m_pageColor = pageColor;
+    m_canvasColor = canvasColor;
+    m_sceneRect = sceneRect;
+
+    if (resized) {
+        // 最精细的一层让场景不超过MAX_LEVEL_PIXELS，最粗的一层让场景落在一个瓦片内
+        const qreal extent = qMax(sceneRect.width(), sceneRect.height());
+        int finest = MIN_SHIFT;
+        while (extent > std::ldexp(static_cast<qreal>(MAX_LEVEL_PIXELS), finest)) ++finest;
+        int coarsest = finest;
+        while (extent > std::ldexp(static_cast<qreal>(TILE_SIZE), coarsest)) ++coarsest;
+
+        // 比例不变的层保留已绘制的瓦片
+        std::vector<Level> levels;
+        for (int shift = finest; shift <= coarsest; ++shift) {
+            auto it = std::find_if(m_levels.begin(), m_levels.end(), [shift](const Level &level) {
+                return level.shift == shift;
+            });
+            if (it != m_levels.end()) {
+                levels.push_back(std::move(*it));
+            } else {
+                levels.push_back({shift, {}, {}});
+            }
+        }
+        m_levels.swap(levels);
+
+        // 释放移出场景范围的瓦片
+        for (Level &level: m_levels) {
+            auto outside = [&](quint64 key) {
+                int tx, ty;
+                tileCoords(key, tx, ty);
+                return !tileRect(level.shift, tx, ty).intersects(m_sceneRect);
+            };
+            for (auto it = level.tiles.begin(); it != level.tiles.end();) {
+                it = outside(it->first) ? level.tiles.erase(it) : std::next(it);
+            }
+            for (auto it = level.dirty.begin(); it != level.dirty.end();) {
+                it = outside(*it) ? level.dirty.erase(it) : std::next(it);
+            }
+        }
+    }
+
+    if (restyled) {
+        invalidateAll();
+    } else if (resized) {
+        for (Level &level: m_levels) {
+            markRange(level, m_sceneRect, true);             // 新露出的区域
+        }
+    }
+}
+
+void TilePyramid::markRange(Level &level, const QRectF &rect, bool missingOnly) {
+    const int x0 = tileCoord(rect.left(), level.shift), x1 = tileCoord(rect.right(), level.shift);
+    const int y0 = tileCoord(rect.top(), level.shift), y1 = tileCoord(rect.bottom(), level.shift);
+    for (int ty = y0; ty <= y1; ++ty) {
+        for (int tx = x0; tx <= x1; ++tx) {
+            const quint64 key = tileKey(tx, ty);
+            if (!missingOnly || level.tiles.find(key) == level.tiles.end()) {
+                level.dirty.insert(key);
+            }
+        }
+    }
+}
+
+void TilePyramid::invalidate(const QRectF &rect) {
+    const QRectF normalized = rect.normalized();
+    for (Level &level: m_levels) {
+        markRange(level, normalized, false);
+    }
+}
+
+void TilePyramid::invalidateAll() {
+    for (Level &level: m_levels) {
+        markRange(level, m_sceneRect, false);
+    }
+}
+
+bool TilePyramid::isDirty() const {
+    return std::any_of(m_levels.begin(), m_levels.end(), [](const Level &level) {
+        return !level.dirty.empty();
+    });
+}
+
+bool TilePyramid::update(const ShapeQuery &query, qint64 budgetMs) {
+    QElapsedTimer timer;
+    timer.start();
+    // 粗的一层要等下一层全部绘制完成后才能缩小得到
+    for (size_t i = 0; i < m_levels.size(); ++i) {
+        Level &level = m_levels[i];
+        while (!level.dirty.empty()) {
+            if (timer.elapsed() >= budgetMs) {
+                return false;
+            }
+            const quint64 key = *level.dirty.begin();
+            level.dirty.erase(level.dirty.begin());
+            if (i == 0) {
+                renderTile(level, key, query);
+            } else {
+                downsampleTile(level, m_levels[i - 1], key);
+            }
+        }
+    }
+    return true;
+}
+
+void TilePyramid::renderTile(Level &level, quint64 key, const ShapeQuery &query) {
+    int tx, ty;
+    tileCoords(key, tx, ty);
+    const QRectF rect = tileRect(level.shift, tx, ty);
+    QImage &image = level.tiles[key];
+    if (image.isNull()) {
+        image = QImage(TILE_SIZE, TILE_SIZE, QImage::Format_RGB32);
+    }
+    image.fill(m_canvasColor);
+
+    QPainter painter(&image);
+    const qreal scale = 1.0 / std::ldexp(1.0, level.shift);
+    painter.scale(scale, scale);
+    painter.translate(-rect.topLeft());
+    painter.fillRect(m_pageRect, m_pageColor);
+    painter.setRenderHint(QPainter::Antialiasing);
+    // 缩小后文本和控制点都无法辨认，只绘制轮廓：线段画折线，其他图形填充轮廓多边形，画笔宽度固定为1像素
+    for (ShapeBase *shape: query(rect)) {
+        painter.setPen(QPen(shape->getBorderColor(), 0));
+        if (dynamic_cast<LineBaseShape *>(shape)) {
+            painter.setBrush(Qt::NoBrush);
+            painter.drawPolyline(shape->outline());
+        } else {
+            painter.setBrush(shape->getFillColor());
+            painter.drawPolygon(shape->outline());
+        }
+    }
+}
+
+void TilePyramid::downsampleTile(Level &level, const Level &finer, quint64 key) {
+    int tx, ty;
+    tileCoords(key, tx, ty);
+    QImage &image = level.tiles[key];
+    if (image.isNull()) {
+        image = QImage(TILE_SIZE, TILE_SIZE, QImage::Format_RGB32);
+    }
+    image.fill(m_canvasColor);
+
+    // 下一层的网格正好是这一层的两倍，四个子瓦片各缩小一半
+    QPainter painter(&image);
+    const int half = TILE_SIZE / 2;
+    for (int dy = 0; dy < 2; ++dy) {
+        for (int dx = 0; dx < 2; ++dx) {
+            auto it = finer.tiles.find(tileKey(2 * tx + dx, 2 * ty + dy));
+            if (it != finer.tiles.end()) {
+                painter.drawImage(dx * half, dy * half,
+                                  it->second.scaled(half, half, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+            }
+        }
+    }
+}
+
+void TilePyramid::draw(QPainter &painter, const QRectF &target) const {
+    if (m_levels.empty() || m_sceneRect.isEmpty()) return;
+    const qreal scale = target.width() / m_sceneRect.width();
+    // 选择分辨率不低于目标的最粗一层缩小绘制，目标比最精细的一层还大时只能放大最精细的一层
+    const Level *chosen = &m_levels.front();
+    for (const Level &level: m_levels) {
+        if (1.0 / std::ldexp(1.0, level.shift) >= scale) {
+            chosen = &level;
+        }
+    }
+
+    painter.save();
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.setClipRect(target, Qt::IntersectClip);
+    painter.translate(target.topLeft());
+    painter.scale(scale, scale);
+    painter.translate(-m_sceneRect.topLeft());
+    for (const auto &entry: chosen->tiles) {
+        int tx, ty;
+        tileCoords(entry.first, tx, ty);
+        painter.drawImage(tileRect(chosen->shift, tx, ty), entry.second);
+    }
+    painter.restore();
+}
+
+void TilePyramid::clear() {
+    m_levels.clear();
+    m_sceneRect = QRectF();
+    m_pageRect = QRectF();                                   // 下次setScene时全部重绘
+}
+
+qint64 TilePyramid::memoryUsage() const {
+    qint64 bytes = 0;
+    for (const Level &level: m_levels) {
+        for (const auto &entry: level.tiles) {
+            bytes += static_cast<qint64>(entry.second.width()) * entry.second.height() * entry.second.depth() / 8;
+        }
+    }
+    return bytes;
+}
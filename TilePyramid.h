@@ -0,0 +1,73 @@
+﻿#ifndef TILEPYRAMID_H
+#define TILEPYRAMID_H
+
+#include "ShapeBase.h"
+#include <QColor>
+#include <QImage>
+#include <QPainter>
+#include <QRectF>
+#include <functional>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+// 概览图使用的低分辨率瓦片金字塔。每层把场景按固定网格切成TILE_SIZE像素的瓦片，第k层的缩放比例为1/2^k，
+// 相邻两层比例相差一倍，网格在场景中的位置固定，所以场景范围增长时已绘制的瓦片仍然有效。
+// 只维护整个场景不超过MAX_LEVEL_PIXELS像素的各层：最精细的一层由图形简化绘制（只有轮廓和填充，不绘制文本），
+// 更粗的各层由下一层的四个瓦片缩小得到。图形变化时只把相关区域的瓦片标记为脏，之后在空闲时按时间预算逐步重绘
+class TilePyramid {
+public:
+    using ShapeQuery = std::function<std::vector<ShapeBase *>(const QRectF &rect)>;   // 按图层顺序返回与rect相交的图形
+
+    void setScene(const QRectF &sceneRect, const QRectF &pageRect,
+                  const QColor &pageColor, const QColor &canvasColor);   // 设置场景范围和页面，页面或颜色变化时全部重绘
+
+    QRectF sceneRect() const { return m_sceneRect; }
+
+    void invalidate(const QRectF &rect);                 // 标记各层与rect相交的瓦片需要重绘
+
+    void invalidateAll();                                // 标记全部瓦片需要重绘
+
+    bool isDirty() const;                                // 是否有等待重绘的瓦片
+
+    bool update(const ShapeQuery &query, qint64 budgetMs);   // 从精细到粗依次重绘脏瓦片，超出预算时返回false，剩余的留到下次
+
+    void draw(QPainter &painter, const QRectF &target) const;   // 把场景范围绘制到target（调用者负责保持宽高比），选择分辨率最接近的一层
+
+    void clear();                                        // 释放全部瓦片
+
+    qint64 memoryUsage() const;                          // 瓦片占用的内存（字节）
+
+    static const int TILE_SIZE = 256;                    // 瓦片边长（像素）
+    static const int MIN_SHIFT = 3;                      // 最精细的一层不超过1/8
+    static const int MAX_LEVEL_PIXELS = 1024;            // 场景在最精细一层中的最大边长（像素）
+
+private:
+    struct Level {
+        int shift;                                       // 缩放比例为1/2^shift
+        std::unordered_map<quint64, QImage> tiles;       // 瓦片坐标 -> 图像
+        std::set<quint64> dirty;                         // 等待重绘的瓦片（有序，相邻的瓦片依次绘制）
+    };
+
+    static quint64 tileKey(int tx, int ty);              // 瓦片坐标 -> 哈希键
+
+    static void tileCoords(quint64 key, int &tx, int &ty);   // 哈希键 -> 瓦片坐标
+
+    static int tileCoord(qreal v, int shift);            // 场景坐标 -> 该层的瓦片坐标
+
+    static QRectF tileRect(int shift, int tx, int ty);   // 瓦片覆盖的场景区域
+
+    void markRange(Level &level, const QRectF &rect, bool missingOnly);   // 标记与rect相交的瓦片，missingOnly为true时只标记尚未绘制的瓦片
+
+    void renderTile(Level &level, quint64 key, const ShapeQuery &query);   // 由图形绘制最精细一层的瓦片
+
+    void downsampleTile(Level &level, const Level &finer, quint64 key);    // 由下一层的四个瓦片缩小得到
+
+    QRectF m_sceneRect;
+    QRectF m_pageRect;
+    QColor m_pageColor;
+    QColor m_canvasColor;
+    std::vector<Level> m_levels;                         // 从精细到粗
+};
+
+#endif // TILEPYRAMID_H
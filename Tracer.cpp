@@ -0,0 +1,147 @@
+﻿#include "Tracer.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QThread>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Tracer::s_enabled(false);
+
+namespace {
+    struct Event {
+        const char *name;
+        const char *category;
+        QString detail;
+        qint64 start;                                  // 纳秒
+        qint64 duration;
+        int thread;
+    };
+
+    // 跟踪状态只在持有mutex时访问
+    std::mutex mutex;
+    std::vector<Event> events;                         // 环形缓冲区
+    size_t eventCapacity = 0;
+    size_t nextEvent = 0;
+    bool wrapped = false;                              // 缓冲区已写满，最早的记录被覆盖
+    std::vector<std::pair<int, QString>> threadNames;
+    QString outputPath;
+    QElapsedTimer clock;
+    std::atomic<int> threadCount(0);
+
+    thread_local int currentThread = 0;                // 当前线程在跟踪文件中的编号，0表示尚未分配
+
+    int threadId() {
+        if (currentThread == 0) {
+            currentThread = ++threadCount;
+            const QCoreApplication *app = QCoreApplication::instance();
+            const bool isMain = app && QThread::currentThread() == app->thread();
+            threadNames.emplace_back(currentThread, isMain ? QString("main") : QString("worker %1").arg(currentThread));
+        }
+        return currentThread;
+    }
+
+    // JSON字符串转义（名称为程序中的常量，只有detail需要处理特殊字符）
+    QByteArray jsonString(const QString &text) {
+        QByteArray result = "\"";
+        for (const char c: text.toUtf8()) {
+            if (c == '"' || c == '\\') {
+                result += '\\';
+                result += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                result += QByteArray("\\u00") + QByteArray::number(static_cast<unsigned char>(c), 16).rightJustified(2, '0');
+            } else {
+                result += c;
+            }
+        }
+        result += '"';
+        return result;
+    }
+
+    QByteArray eventJson(const Event &event) {
+        QByteArray json = "{\"name\":\"";
+        json += event.name;
+        json += "\",\"cat\":\"";
+        json += event.category;
+        json += "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+        json += QByteArray::number(event.thread);
+        json += ",\"ts\":";
+        json += QByteArray::number(event.start / 1000.0, 'f', 3);     // Chrome trace的时间单位为微秒
+        json += ",\"dur\":";
+        json += QByteArray::number(event.duration / 1000.0, 'f', 3);
+        if (!event.detail.isEmpty()) {
+            json += ",\"args\":{\"detail\":" + jsonString(event.detail) + "}";
+        }
+        json += "}";
+        return json;
+    }
+}
+
+void Tracer::startFromEnvironment() {
+    const QString path = QString::fromLocal8Bit(qgetenv("FLOWCHART_TRACE"));
+    if (path.isEmpty()) return;
+    bool ok = false;
+    const qulonglong limit = qgetenv("FLOWCHART_TRACE_LIMIT").toULongLong(&ok);
+    start(path, ok && limit > 0 ? static_cast<size_t>(limit) : DEFAULT_CAPACITY);
+}
+
+void Tracer::start(const QString &filePath, size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex);
+    eventCapacity = qMax<size_t>(1, capacity);
+    events.clear();
+    events.reserve(eventCapacity);
+    nextEvent = 0;
+    wrapped = false;
+    outputPath = filePath;
+    clock.start();
+    s_enabled.store(true);
+}
+
+bool Tracer::stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!s_enabled.exchange(false)) return true;
+
+    QSaveFile file(outputPath);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+
+    file.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (const auto &thread: threadNames) {
+        file.write(first ? "" : ",\n");
+        first = false;
+        file.write("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + QByteArray::number(thread.first)
+                   + ",\"args\":{\"name\":" + jsonString(thread.second) + "}}");
+    }
+
+    // 缓冲区写满时从最早的一条开始输出
+    const size_t count = events.size();
+    const size_t begin = wrapped ? nextEvent : 0;
+    for (size_t i = 0; i < count; ++i) {
+        file.write(first ? "" : ",\n");
+        first = false;
+        file.write(eventJson(events[(begin + i) % count]));
+    }
+    file.write("\n]}\n");
+
+    events.clear();
+    events.shrink_to_fit();
+    return file.commit();
+}
+
+qint64 Tracer::now() {
+    return clock.nsecsElapsed();
+}
+
+void Tracer::record(const char *name, const char *category, qint64 start, qint64 end, const QString &detail) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!s_enabled.load(std::memory_order_relaxed)) return;
+
+    Event event{name, category, detail, start, end - start, threadId()};
+    if (events.size() < eventCapacity) {
+        events.push_back(std::move(event));
+    } else {
+        events[nextEvent] = std::move(event);
+        nextEvent = (nextEvent + 1) % eventCapacity;
+        wrapped = true;
+    }
+}
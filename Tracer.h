@@ -0,0 +1,62 @@
+﻿#ifndef TRACER_H
+#define TRACER_H
+
+#include <QString>
+#include <atomic>
+#include <cstddef>
+
+// 事件跟踪：记录带起止时间的区间，停止时写成Chrome trace格式（JSON）的文件，可在chrome://tracing或Perfetto中查看。
+// 设置环境变量FLOWCHART_TRACE=输出文件后启用，程序退出时写出；未启用时每个区间只读取一次原子变量。
+// 区间保存在固定容量的环形缓冲区中（环境变量FLOWCHART_TRACE_LIMIT，默认100万个），长时间运行时保留最近的记录
+class Tracer {
+public:
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    static void startFromEnvironment();                // 根据环境变量启用跟踪
+
+    static void start(const QString &filePath, size_t capacity = DEFAULT_CAPACITY);
+
+    static bool stop();                                // 停止跟踪并写出文件，未启用时直接返回true
+
+    static qint64 now();                               // 跟踪开始以来的纳秒数
+
+    // 记录一个区间（可在任意线程中调用），name和category必须是字符串常量，detail显示在事件参数中
+    static void record(const char *name, const char *category, qint64 start, qint64 end, const QString &detail);
+
+    static const size_t DEFAULT_CAPACITY = 1000000;
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+// 在作用域结束时记录一个区间
+class TraceScope {
+public:
+    TraceScope(const char *name, const char *category, const QString &detail = QString())
+            : m_name(Tracer::isEnabled() ? name : nullptr), m_category(category), m_detail(detail) {
+        if (m_name) m_start = Tracer::now();
+    }
+
+    ~TraceScope() {
+        if (m_name) Tracer::record(m_name, m_category, m_start, Tracer::now(), m_detail);
+    }
+
+    TraceScope(const TraceScope &) = delete;
+
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *m_name;                                // 为空表示构造时没有启用跟踪
+    const char *m_category;
+    qint64 m_start = 0;
+    QString m_detail;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name, category) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, category)
+// detail只在启用跟踪时求值
+#define TRACE_SCOPE_DETAIL(name, category, detail) \
+    TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, category, Tracer::isEnabled() ? QString(detail) : QString())
+
+#endif // TRACER_H
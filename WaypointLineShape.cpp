@@ -0,0 +1,248 @@
+﻿#include "WaypointLineShape.h"
+#include <QPainter>
+#include <QtMath>
+#include <limits>
+
+namespace {
+    // 点到线段的距离
+    qreal distanceToSegment(const QPointF &point, const QPointF &a, const QPointF &b) {
+        const QPointF ab = b - a;
+        const qreal lengthSquared = QPointF::dotProduct(ab, ab);
+        qreal t = 0;
+        if (lengthSquared > 0) {
+            t = qBound(0.0, QPointF::dotProduct(point - a, ab) / lengthSquared, 1.0);
+        }
+        const QPointF d = point - (a + ab * t);
+        return qSqrt(QPointF::dotProduct(d, d));
+    }
+
+    QRectF pointBounds(const QPointF *points, int count) {
+        qreal left = points[0].x(), right = left;
+        qreal top = points[0].y(), bottom = top;
+        for (int i = 1; i < count; ++i) {
+            left = qMin(left, points[i].x());
+            right = qMax(right, points[i].x());
+            top = qMin(top, points[i].y());
+            bottom = qMax(bottom, points[i].y());
+        }
+        return QRectF(QPointF(left, top), QPointF(right, bottom));
+    }
+}
+
+WaypointLineShape::WaypointLineShape(const QPointF &start, const QPointF &end, const QVector<QPointF> &waypoints)
+        : LineBaseShape(start, end), m_waypoints(waypoints) {}
+
+void WaypointLineShape::draw(QPainter &painter, bool draft) {
+    ensureGeometry();
+    painter.save();
+
+    painter.setPen(QPen(m_borderColor, m_penWidth, penStyle(m_borderStyle, draft)));
+    painter.drawPolyline(m_flattened.constData(), m_flattened.size());
+
+    if (!m_arrowHead.isEmpty()) {
+        painter.save();
+        painter.setBrush(m_borderColor);
+        painter.setPen(Qt::NoPen);            // 取消边框线
+        painter.drawPolygon(m_arrowHead);
+        painter.restore();
+    }
+
+    drawText(painter, draft);
+
+    if (m_selected) {
+        painter.save();
+        painter.setPen(QPen(Qt::blue, 1, penStyle(Qt::DashLine, draft)));
+        painter.setBrush(Qt::white);
+
+        // 绘制控制点
+        for (const auto &pt: calculateHandles()) {
+            painter.drawRect(QRectF(pt.x() - HANDLE_SIZE / 2, pt.y() - HANDLE_SIZE / 2, HANDLE_SIZE, HANDLE_SIZE));
+        }
+        painter.restore();
+    }
+
+    painter.restore();
+}
+
+bool WaypointLineShape::containPoint(const QPointF &point) const {
+    ensureGeometry();
+    if (!m_bounds.adjusted(-HIT_TOLERANCE, -HIT_TOLERANCE, HIT_TOLERANCE, HIT_TOLERANCE).contains(point)) {
+        return false;
+    }
+    if (!m_arrowHead.isEmpty() && m_arrowHead.containsPoint(point, Qt::OddEvenFill)) {
+        return true;
+    }
+
+    // 只检查外接矩形包含该点的段
+    int first = 0;
+    for (const Segment &segment: m_segments) {
+        if (segment.bounds.adjusted(-HIT_TOLERANCE, -HIT_TOLERANCE, HIT_TOLERANCE, HIT_TOLERANCE).contains(point)) {
+            for (int i = first; i < segment.last; ++i) {
+                if (distanceToSegment(point, m_flattened[i], m_flattened[i + 1]) <= HIT_TOLERANCE) {
+                    return true;
+                }
+            }
+        }
+        first = segment.last;
+    }
+    return false;
+}
+
+void WaypointLineShape::moveBy(qreal dx, qreal dy) {
+    // 整体平移时直接平移缓存，不需要重新展平
+    const bool cacheValid = geometryCurrent();
+    const QPointF offset(dx, dy);
+    LineBaseShape::moveBy(dx, dy);
+    for (QPointF &point: m_waypoints) {
+        point += offset;
+    }
+
+    if (!cacheValid) {
+        m_geometryValid = false;
+        return;
+    }
+    m_cachedStart = m_start;
+    m_cachedEnd = m_end;
+    for (QPointF &point: m_flattened) {
+        point += offset;
+    }
+    for (Segment &segment: m_segments) {
+        segment.bounds.translate(offset);
+    }
+    m_arrowHead.translate(offset);
+    m_bounds.translate(offset);
+}
+
+QRectF WaypointLineShape::boundingRect() const {
+    ensureGeometry();
+    return m_bounds;
+}
+
+QVector<QPointF> WaypointLineShape::calculateHandles() const {
+    return anchors();
+}
+
+void WaypointLineShape::resizeBy(qreal dx, qreal dy, int handleIndex) {
+    const QPointF offset(dx, dy);
+    if (handleIndex == 0) {
+        m_start += offset;
+    } else if (handleIndex == m_waypoints.size() + 1) {
+        m_end += offset;
+    } else if (handleIndex > 0 && handleIndex <= m_waypoints.size()) {
+        m_waypoints[handleIndex - 1] += offset;
+        invalidateGeometry();
+    }
+}
+
+int WaypointLineShape::endPointOfHandle(int handleIndex) const {
+    if (handleIndex == 0) return 0;
+    if (handleIndex == m_waypoints.size() + 1) return 1;
+    return -1;
+}
+
+QVector<QPointF> WaypointLineShape::pathPoints() const {
+    ensureGeometry();
+    return m_flattened;
+}
+
+void WaypointLineShape::setWaypoints(const QVector<QPointF> &waypoints) {
+    m_waypoints = waypoints;
+    invalidateGeometry();
+}
+
+int WaypointLineShape::insertWaypoint(const QPointF &point) {
+    ensureGeometry();
+    int nearest = 0;
+    qreal nearestDistance = std::numeric_limits<qreal>::max();
+    int first = 0;
+    for (size_t i = 0; i < m_segments.size(); ++i) {
+        for (int k = first; k < m_segments[i].last; ++k) {
+            const qreal distance = distanceToSegment(point, m_flattened[k], m_flattened[k + 1]);
+            if (distance < nearestDistance) {
+                nearestDistance = distance;
+                nearest = static_cast<int>(i);
+            }
+        }
+        first = m_segments[i].last;
+    }
+    m_waypoints.insert(nearest, point);              // 第i段之后的中间点序号为i
+    invalidateGeometry();
+    return nearest;
+}
+
+void WaypointLineShape::removeWaypoint(int index) {
+    if (index < 0 || index >= m_waypoints.size()) return;
+    m_waypoints.remove(index);
+    invalidateGeometry();
+}
+
+int WaypointLineShape::waypointAt(const QPointF &point) const {
+    for (int i = 0; i < m_waypoints.size(); ++i) {
+        QRectF handleRect(m_waypoints[i].x() - HANDLE_SIZE / 2.0, m_waypoints[i].y() - HANDLE_SIZE / 2.0, HANDLE_SIZE,
+                          HANDLE_SIZE);
+        if (handleRect.contains(point))
+            return i;
+    }
+    return -1;
+}
+
+QVector<QPointF> WaypointLineShape::anchors() const {
+    QVector<QPointF> points;
+    points.reserve(m_waypoints.size() + 2);
+    points << m_start << m_waypoints << m_end;
+    return points;
+}
+
+QPolygonF WaypointLineShape::arrowHead() const {
+    ensureGeometry();
+    return m_arrowHead;
+}
+
+bool WaypointLineShape::geometryCurrent() const {
+    return m_geometryValid && m_cachedStart == m_start && m_cachedEnd == m_end && m_cachedPenWidth == m_penWidth;
+}
+
+void WaypointLineShape::ensureGeometry() const {
+    if (geometryCurrent()) {
+        return;
+    }
+
+    const QVector<QPointF> points = anchors();
+    const qreal halfPen = m_penWidth / 2.0;            // 线条向两侧各画出半个线宽
+    m_flattened.clear();
+    m_segments.clear();
+    m_segments.reserve(static_cast<size_t>(points.size() - 1));
+    m_flattened.append(points.first());
+    for (int i = 0; i + 1 < points.size(); ++i) {
+        const int first = m_flattened.size() - 1;
+        flattenSegment(points, i, m_flattened);
+        const int last = m_flattened.size() - 1;
+        const QRectF bounds = pointBounds(m_flattened.constData() + first, last - first + 1);
+        m_segments.push_back({last, bounds.adjusted(-halfPen, -halfPen, halfPen, halfPen)});
+    }
+
+    // 箭头沿最后一个与终点不重合的点到终点的方向
+    m_arrowHead.clear();
+    const QPointF tip = m_flattened.last();
+    for (int i = m_flattened.size() - 2; i >= 0; --i) {
+        const QPointF from = m_flattened[i];
+        if (from == tip) continue;
+        const qreal angle = std::atan2(tip.y() - from.y(), tip.x() - from.x());
+        m_arrowHead << tip
+                    << tip - QPointF(std::cos(angle - M_PI / 6.0) * ARROW_SIZE, std::sin(angle - M_PI / 6.0) * ARROW_SIZE)
+                    << tip - QPointF(std::cos(angle + M_PI / 6.0) * ARROW_SIZE, std::sin(angle + M_PI / 6.0) * ARROW_SIZE);
+        break;
+    }
+
+    if (!m_arrowHead.isEmpty()) {
+        m_segments.back().bounds |= pointBounds(m_arrowHead.constData(), m_arrowHead.size());
+    }
+    m_bounds = QRectF();
+    for (const Segment &segment: m_segments) {
+        m_bounds |= segment.bounds;
+    }
+    m_cachedStart = m_start;
+    m_cachedEnd = m_end;
+    m_cachedPenWidth = m_penWidth;
+    m_geometryValid = true;
+}
@@ -0,0 +1,76 @@
+﻿#ifndef WAYPOINTLINESHAPE_H
+#define WAYPOINTLINESHAPE_H
+
+#include "LineBaseShape.h"
+#include <QPolygonF>
+#include <vector>
+
+// 带中间点的连线：起点、用户可编辑的中间点和终点依次相连，每两个相邻锚点之间的一段由子类生成（直线或曲线），终点带箭头。
+// 展平后的折线、每段的外接矩形和箭头在几何改变后第一次使用时计算并缓存：
+// 命中测试先用段的外接矩形排除，只检查候选段的折线；外接矩形和绘制都直接使用缓存
+class WaypointLineShape : public LineBaseShape {
+public:
+    WaypointLineShape(const QPointF &start, const QPointF &end, const QVector<QPointF> &waypoints = QVector<QPointF>());
+
+    void draw(QPainter &painter, bool draft) override;
+
+    bool containPoint(const QPointF &point) const override;
+
+    void moveBy(qreal dx, qreal dy) override;
+
+    QRectF boundingRect() const override;
+
+    QVector<QPointF> calculateHandles() const override;              // 起点、各中间点、终点
+
+    void resizeBy(qreal dx, qreal dy, int handleIndex) override;     // 拖动端点或中间点
+
+    int endPointOfHandle(int handleIndex) const override;
+
+    QVector<QPointF> pathPoints() const override;                    // 展平后的折线
+
+    const QVector<QPointF> &getWaypoints() const { return m_waypoints; }
+
+    void setWaypoints(const QVector<QPointF> &waypoints);
+
+    int insertWaypoint(const QPointF &point);          // 在离point最近的一段上插入中间点，返回中间点序号
+
+    void removeWaypoint(int index);
+
+    int waypointAt(const QPointF &point) const;        // point所在控制点对应的中间点序号，-1表示没有
+
+    QVector<QPointF> anchors() const;                  // 起点、中间点、终点
+
+    QPolygonF arrowHead() const;                       // 终点处的箭头
+
+    static constexpr qreal HIT_TOLERANCE = 5.0;        // 命中测试时与折线的最大距离，与直线的检测宽度一致
+    static constexpr qreal ARROW_SIZE = 20.0;          // 与ArrowShape::drawArrowHead保持一致
+
+protected:
+    // 把第segment段（anchors[segment]到anchors[segment + 1]）展平后的点追加到out，不含该段的起点
+    virtual void flattenSegment(const QVector<QPointF> &anchors, int segment, QVector<QPointF> &out) const = 0;
+
+    void invalidateGeometry() { m_geometryValid = false; }
+
+private:
+    struct Segment {
+        int last;                                      // 该段最后一个点在展平折线中的下标
+        QRectF bounds;                                 // 该段展平折线的外接矩形，向外扩展半个线宽，最后一段还包含箭头
+    };
+
+    bool geometryCurrent() const;                      // 缓存是否仍然有效（中间点未改变，端点和线宽与缓存时相同）
+
+    void ensureGeometry() const;                       // 缓存过期时重新计算
+
+    QVector<QPointF> m_waypoints;
+
+    mutable bool m_geometryValid = false;
+    mutable QPointF m_cachedStart;                     // 计算缓存时的端点，端点可能被直接修改，据此判断缓存是否过期
+    mutable QPointF m_cachedEnd;
+    mutable int m_cachedPenWidth = 0;                  // 计算缓存时的线宽，外接矩形随线宽变化
+    mutable QVector<QPointF> m_flattened;
+    mutable std::vector<Segment> m_segments;
+    mutable QPolygonF m_arrowHead;
+    mutable QRectF m_bounds;                           // 所有段外接矩形的并集（含线宽和箭头）
+};
+
+#endif // WAYPOINTLINESHAPE_H
@@ -0,0 +1,186 @@
+﻿#include "BenchSupport.h"
+#include "LineBaseShape.h"
+#include "WaypointLineShape.h"
+#include <QColor>
+#include <QStringList>
+#include <QtMath>
+#include <cstdio>
+
+const char *const BenchDocument::DEFAULT_MIX = "Rect=4,Ellipse=2,Diamond=2,Pentagon=1,Hexagon=1,Line=2,Arrow=4";
+
+void useOffscreenPlatform() {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");              // 不需要显示窗口
+    }
+}
+
+namespace {
+    const qreal CELL_WIDTH = 180.0;                    // 图形按网格排列，每格的大小
+    const qreal CELL_HEIGHT = 140.0;
+    const qreal MARGIN = 50.0;                         // 与绘图区域中页面的偏移一致
+    const int NEIGHBOR_ROWS = 2;                       // 绑定连线的另一端在附近几行之内选取
+
+    const char *const WORDS[] = {
+            "start", "end", "check", "input", "output", "process", "validate", "request", "response", "retry",
+            "timeout", "error", "success", "queue", "worker", "cache", "database", "commit", "rollback", "notify",
+            "approve", "reject", "review", "schedule", "dispatch", "parse", "render", "upload", "download", "merge"
+    };
+    const QColor FILL_COLORS[] = {
+            Qt::white, QColor(255, 242, 204), QColor(218, 232, 252), QColor(213, 232, 212), QColor(248, 206, 204),
+            QColor(225, 213, 231)
+    };
+    const Qt::PenStyle BORDER_STYLES[] = {Qt::SolidLine, Qt::SolidLine, Qt::SolidLine, Qt::DashLine, Qt::DotLine};
+
+    template<typename T, size_t N>
+    int arraySize(const T (&)[N]) { return static_cast<int>(N); }
+
+    // 依次取两个随机数（函数参数的求值顺序不确定，不能直接写在同一个构造函数调用中）
+    QPointF randomPoint(BenchRandom &random, qreal x0, qreal x1, qreal y0, qreal y1) {
+        const qreal x = random.uniform(x0, x1);
+        const qreal y = random.uniform(y0, y1);
+        return QPointF(x, y);
+    }
+
+    using Mix = std::vector<std::pair<ShapeFactory::TypeCode, double>>;
+
+    ShapeFactory::TypeCode pickType(const Mix &mix, double totalWeight, BenchRandom &random) {
+        double value = random.uniform() * totalWeight;
+        for (const auto &entry: mix) {
+            if (value < entry.second) return entry.first;
+            value -= entry.second;
+        }
+        return mix.back().first;
+    }
+
+    // 随机长度的文本，每6个单词换一行
+    QString randomText(int maxWords, BenchRandom &random) {
+        if (maxWords == 0 || random.chance(0.3)) return QString();
+        const int words = 1 + random.below(maxWords);
+        QString text;
+        for (int i = 0; i < words; ++i) {
+            if (i > 0) text += i % 6 == 0 ? '\n' : ' ';
+            text += WORDS[random.below(arraySize(WORDS))];
+        }
+        return text;
+    }
+
+    void applyStyle(ShapeBase *shape, BenchRandom &random) {
+        shape->setFillColor(FILL_COLORS[random.below(arraySize(FILL_COLORS))]);
+        shape->setBorderStyle(BORDER_STYLES[random.below(arraySize(BORDER_STYLES))]);
+        shape->setPenWidth(1 + random.below(3));
+    }
+
+    // 自由连线：起点在格子内随机，终点在附近随机
+    void placeFreeEnd(LineBaseShape *line, int end, const QPointF &anchor, BenchRandom &random) {
+        line->setEndPoint(end, anchor + randomPoint(random, -CELL_WIDTH, CELL_WIDTH, -CELL_HEIGHT, CELL_HEIGHT));
+    }
+
+    void bindEnd(LineBaseShape *line, int end, ShapeBase *node, BenchRandom &random) {
+        const int magneticCount = node->getMagneticPoints().size();
+        line->setEndPointBinding(end, node, random.below(magneticCount));
+        line->updateEndPointByBinding(end);
+    }
+}
+
+bool BenchDocument::parseMix(const QString &text, Options &options) {
+    options.mix.clear();
+    for (const QString &item: text.split(',', QString::SkipEmptyParts)) {
+        const QStringList parts = item.split('=');
+        const ShapeFactory::TypeCode code = ShapeFactory::typeCode(parts[0].trimmed());
+        bool ok = parts.size() == 2;
+        const double weight = ok ? parts[1].toDouble(&ok) : 0;
+        if (code == ShapeFactory::Unknown || !ok || weight < 0) {
+            std::fprintf(stderr, "invalid mix entry: %s\n", qPrintable(item));
+            return false;
+        }
+        if (weight > 0) options.mix.emplace_back(code, weight);
+    }
+    if (options.mix.empty()) {
+        std::fprintf(stderr, "mix has no shape types\n");
+        return false;
+    }
+    return true;
+}
+
+std::vector<ShapeBase *> BenchDocument::generate(const Options &options, QSize &pageSize) {
+    Mix mix = options.mix;
+    if (mix.empty()) {
+        Options defaults;
+        parseMix(DEFAULT_MIX, defaults);
+        mix = defaults.mix;
+    }
+    BenchRandom random(options.seed);
+    double totalWeight = 0;
+    for (const auto &entry: mix) totalWeight += entry.second;
+
+    // 先确定每个位置的类型，图形（节点）按出现顺序排到网格中
+    std::vector<ShapeFactory::TypeCode> types(static_cast<size_t>(qMax(0, options.count)));
+    int nodeCount = 0;
+    for (auto &type: types) {
+        type = pickType(mix, totalWeight, random);
+        if (!ShapeFactory::isLineType(type)) ++nodeCount;
+    }
+    const bool scattered = !options.area.isEmpty();
+    const int columns = qMax(1, qCeil(qSqrt(qMax(1, options.count) * 4.0 / 3.0)));
+    const int rows = qMax(1, (qMax(nodeCount, options.count - nodeCount) + columns - 1) / columns);
+    pageSize = scattered ? QSize(qCeil(options.area.right() + MARGIN), qCeil(options.area.bottom() + MARGIN))
+                         : QSize(qCeil(columns * CELL_WIDTH + MARGIN), qCeil(rows * CELL_HEIGHT + MARGIN));
+
+    // 第index个节点或连线的位置：网格中的格子，或散布区域内的随机位置
+    auto place = [&](int index, qreal jitterX, qreal jitterY) {
+        if (scattered) {
+            return randomPoint(random, options.area.left(), options.area.right() - CELL_WIDTH,
+                               options.area.top(), options.area.bottom() - CELL_HEIGHT);
+        }
+        return QPointF(MARGIN + (index % columns) * CELL_WIDTH, MARGIN + (index / columns) * CELL_HEIGHT)
+               + randomPoint(random, 0, jitterX, 0, jitterY);
+    };
+
+    std::vector<ShapeBase *> shapes(types.size(), nullptr);
+    std::vector<ShapeBase *> nodes;
+    nodes.reserve(static_cast<size_t>(nodeCount));
+    for (size_t i = 0; i < types.size(); ++i) {
+        if (ShapeFactory::isLineType(types[i])) continue;
+        QPointF pos = place(static_cast<int>(nodes.size()), 40, 40);
+        if (!nodes.empty() && random.chance(options.overlap)) {
+            pos = nodes.back()->boundingRect().topLeft() + randomPoint(random, -30, 30, -30, 30);
+        }
+        const QPointF size = randomPoint(random, 60, 140, 40, 100);
+        ShapeBase *shape = ShapeFactory::createShape(types[i], QRectF(pos, QSizeF(size.x(), size.y())));
+        if (random.chance(options.rotation)) {
+            shape->setRotation(random.below(360));
+        }
+        applyStyle(shape, random);
+        shape->setText(randomText(options.textWords, random));
+        shapes[i] = shape;
+        nodes.push_back(shape);
+    }
+
+    // 连线：按density的比例把两端绑定到相邻几行内的图形，其余为自由连线
+    int connector = 0;
+    for (size_t i = 0; i < types.size(); ++i) {
+        if (!ShapeFactory::isLineType(types[i])) continue;
+        const QPointF cellPos = place(connector++, CELL_WIDTH, CELL_HEIGHT);
+        auto line = static_cast<LineBaseShape *>(ShapeFactory::createLine(types[i], cellPos, cellPos));
+        if (nodes.size() >= 2 && random.chance(options.density)) {
+            const int source = random.below(static_cast<int>(nodes.size()));
+            const int reach = columns * NEIGHBOR_ROWS;
+            int target = qBound(0, source + random.below(reach * 2 + 1) - reach, static_cast<int>(nodes.size()) - 1);
+            if (target == source) target = source > 0 ? source - 1 : source + 1;
+            bindEnd(line, 0, nodes[source], random);
+            bindEnd(line, 1, nodes[target], random);
+        } else {
+            placeFreeEnd(line, 1, cellPos, random);
+        }
+        if (auto waypointLine = dynamic_cast<WaypointLineShape *>(line)) {
+            const QPointF middle = (line->getStart() + line->getEnd()) / 2;
+            waypointLine->setWaypoints({middle + randomPoint(random, -40, 40, -40, 40)});
+        } else if (random.chance(options.orthogonal)) {
+            line->setRouting(LineBaseShape::Orthogonal);
+        }
+        applyStyle(line, random);
+        line->setText(random.chance(0.3) ? randomText(qMin(options.textWords, 3), random) : QString());
+        shapes[i] = line;
+    }
+    return shapes;
+}
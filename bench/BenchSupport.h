@@ -0,0 +1,55 @@
+﻿#ifndef BENCHSUPPORT_H
+#define BENCHSUPPORT_H
+
+// 基准测试工具共用的部分：离屏平台设置和可复现的随机文档生成（svg_load_bench、micro_bench、stress_gen使用同一个生成器）
+
+#include "ShapeFactory.h"
+#include <QRectF>
+#include <QSize>
+#include <QString>
+#include <random>
+#include <utility>
+#include <vector>
+
+void useOffscreenPlatform();                           // 在构造QApplication之前调用，未指定QT_QPA_PLATFORM时不显示窗口
+
+// 只使用std::mt19937的原始输出（标准规定了它的序列），不使用各标准库实现不同的分布类，保证跨平台可复现
+class BenchRandom {
+public:
+    explicit BenchRandom(quint32 seed) : m_engine(seed) {}
+
+    double uniform() { return m_engine() / 4294967296.0; }                    // [0, 1)
+
+    double uniform(double low, double high) { return low + (high - low) * uniform(); }
+
+    int below(int n) { return qMin(n - 1, static_cast<int>(uniform() * n)); }
+
+    bool chance(double probability) { return uniform() < probability; }
+
+private:
+    std::mt19937 m_engine;
+};
+
+// 用现有图形类生成流程图文档，参数和种子相同时生成的文档完全相同
+class BenchDocument {
+public:
+    struct Options {
+        int count = 10000;                             // 图形总数
+        std::vector<std::pair<ShapeFactory::TypeCode, double>> mix;   // 类型及其权重，线段类图形作为连线；为空时使用DEFAULT_MIX
+        double density = 0.8;                          // 连线两端绑定到图形磁力点的比例
+        int textWords = 12;                            // 图形文本的最大单词数
+        double rotation = 0.25;                        // 带旋转角度的图形比例
+        double overlap = 0.1;                          // 与前一个图形重叠放置的图形比例
+        double orthogonal = 0;                         // 使用正交走线的连线比例
+        quint32 seed = 1;                              // 随机数种子
+        QRectF area;                                   // 不为空时图形随机散布在area内，否则按网格排列、页面随数量增长
+    };
+
+    static std::vector<ShapeBase *> generate(const Options &options, QSize &pageSize);   // 生成图形，pageSize返回能容纳全部图形的页面大小
+
+    static bool parseMix(const QString &text, Options &options);   // 解析“Rect=4,Ellipse=2,...”形式的类型权重，出错时输出到标准错误
+
+    static const char *const DEFAULT_MIX;
+};
+
+#endif // BENCHSUPPORT_H
@@ -0,0 +1,165 @@
+﻿// 输入事件回放：打开录制时保存的文档快照，把录制的事件依次发送给（不显示在屏幕上的）绘图区域，
+// 统计每个事件从发送到处理完因它产生的重绘等事件所需的时间
+// 用法：input_replay 录制文件.jsonl [--realtime] [--repeat N] [--json]
+//   --realtime  按录制时的时间间隔发送事件，间隔期间处理计时器等事件，鼠标移动和实际使用时一样按刷新间隔合并；
+//               默认不等待，全速回放，此时关闭鼠标移动的合并，每个录制的移动都会被处理，结果与机器速度无关
+//   --repeat N  回放N次（每次重新打开文档），合并统计
+//   --json      以JSON输出统计结果
+
+#include "BenchSupport.h"
+#include "DrawArea.h"
+#include "InputRecorder.h"
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMouseEvent>
+#include <QThread>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+namespace {
+    const char *eventName(QEvent::Type type) {
+        switch (type) {
+            case QEvent::MouseButtonPress: return "press";
+            case QEvent::MouseButtonRelease: return "release";
+            case QEvent::MouseButtonDblClick: return "doubleclick";
+            case QEvent::MouseMove: return "move";
+            case QEvent::KeyPress: return "keypress";
+            case QEvent::KeyRelease: return "keyrelease";
+            case QEvent::Leave: return "leave";
+            default: return "other";
+        }
+    }
+
+    // 已排序数据的百分位数（最近秩）
+    double percentile(const std::vector<double> &sorted, double p) {
+        if (sorted.empty()) return 0;
+        const size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+        return sorted[qBound<size_t>(1, rank, sorted.size()) - 1];
+    }
+
+    // 处理事件直到录制时间到达time（毫秒）
+    void waitUntil(const QElapsedTimer &clock, double time) {
+        for (qint64 remaining = qCeil(time - clock.nsecsElapsed() / 1e6); remaining > 0;
+             remaining = qCeil(time - clock.nsecsElapsed() / 1e6)) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents, static_cast<int>(remaining));
+            QThread::usleep(200);
+        }
+    }
+
+    // 回放一次，返回false表示文档打开失败
+    bool replay(const QString &documentPath, const std::vector<InputRecorder::Event> &events, bool realtime,
+                std::map<QString, std::vector<double>> &latencies) {
+        DrawArea area;
+        if (!area.loadFile(documentPath)) {
+            return false;
+        }
+        area.finishLazyLoad();                         // 大文档按需读取，回放期间不能再有图形在空闲时陆续构造
+        area.resize(1280, 800);
+        area.setMoveCoalescingEnabled(realtime);       // 全速回放时合并计时器来不及触发，中间的拖动和吸附会被丢掉
+        area.show();                                   // 显示后重绘才会真正执行（offscreen平台不会出现窗口）
+        QCoreApplication::processEvents();
+
+        QElapsedTimer clock;
+        clock.start();
+        QElapsedTimer timer;
+        for (const InputRecorder::Event &event: events) {
+            if (realtime) {
+                waitUntil(clock, event.time);
+            }
+            std::unique_ptr<QEvent> qevent = InputRecorder::createEvent(event, area.mapFromScene(event.pos));
+            // 鼠标事件由视口接收，键盘和离开事件由绘图区域本身接收
+            QWidget *target = dynamic_cast<QMouseEvent *>(qevent.get()) ? area.viewport() : static_cast<QWidget *>(&area);
+            timer.start();
+            QApplication::sendEvent(target, qevent.get());
+            QCoreApplication::processEvents();         // 包括事件引起的重绘
+            const double ms = timer.nsecsElapsed() / 1e6;
+            latencies[eventName(event.type)].push_back(ms);
+            latencies["all"].push_back(ms);
+        }
+        if (realtime) {
+            QThread::msleep(50);                       // 等待最后一次合并的鼠标移动到期
+            QCoreApplication::processEvents();
+        }
+        return true;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    useOffscreenPlatform();
+    QApplication app(argc, argv);
+
+    QString recordingPath;
+    bool realtime = false;
+    bool json = false;
+    int repeat = 1;
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        if (args[i] == "--realtime") {
+            realtime = true;
+        } else if (args[i] == "--json") {
+            json = true;
+        } else if (args[i] == "--repeat" && i + 1 < args.size()) {
+            repeat = qMax(1, args[++i].toInt());
+        } else {
+            recordingPath = args[i];
+        }
+    }
+    if (recordingPath.isEmpty()) {
+        std::fprintf(stderr, "usage: input_replay recording.jsonl [--realtime] [--repeat N] [--json]\n");
+        return 2;
+    }
+
+    QString documentPath;
+    std::vector<InputRecorder::Event> events;
+    if (!InputRecorder::read(recordingPath, documentPath, events)) {
+        std::fprintf(stderr, "cannot read %s\n", qPrintable(recordingPath));
+        return 1;
+    }
+
+    std::map<QString, std::vector<double>> latencies;
+    for (int r = 0; r < repeat; ++r) {
+        if (!replay(documentPath, events, realtime, latencies)) {
+            std::fprintf(stderr, "cannot open %s\n", qPrintable(documentPath));
+            return 1;
+        }
+    }
+
+    QJsonArray results;
+    if (!json) {
+        std::printf("%-12s %8s %10s %10s %10s %10s\n", "event", "count", "p50 (ms)", "p90 (ms)", "p99 (ms)", "max (ms)");
+    }
+    for (auto &entry: latencies) {
+        std::vector<double> &values = entry.second;
+        std::sort(values.begin(), values.end());
+        if (json) {
+            QJsonObject object;
+            object["event"] = entry.first;
+            object["count"] = static_cast<int>(values.size());
+            object["p50_ms"] = percentile(values, 50);
+            object["p90_ms"] = percentile(values, 90);
+            object["p99_ms"] = percentile(values, 99);
+            object["max_ms"] = values.back();
+            results.append(object);
+        } else {
+            std::printf("%-12s %8d %10.3f %10.3f %10.3f %10.3f\n", qPrintable(entry.first), static_cast<int>(values.size()),
+                        percentile(values, 50), percentile(values, 90), percentile(values, 99), values.back());
+        }
+    }
+    if (json) {
+        QJsonObject root;
+        root["recording"] = recordingPath;
+        root["events"] = static_cast<int>(events.size());
+        root["repeat"] = repeat;
+        root["realtime"] = realtime;
+        root["results"] = results;
+        std::fputs(QJsonDocument(root).toJson(QJsonDocument::Indented).constData(), stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,308 @@
+﻿// 微基准测试：图形命中测试和几何计算、撤销快照、SVG读写以及离屏绘制的单次操作耗时
+// 用法：micro_bench [--sizes 1000,10000,100000] [--filter 名称片段] [--min-time 毫秒] [--format json|csv] [--output 文件]
+// 结果以JSON（默认）或CSV写到标准输出或--output指定的文件，进度写到标准错误，便于在不同版本之间比较
+
+#include "BenchSupport.h"
+#include "DrawArea.h"
+#include "SvgDocument.h"
+#include "ShapeFactory.h"
+#include "PolygonShape.h"
+#include <QApplication>
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMouseEvent>
+#include <QTemporaryDir>
+#include <QThread>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+namespace {
+    // 通过派生类取得受保护成员，只用于测量，不改变被测类的接口
+    struct PolygonAccess : PolygonShape {
+        static void rebuild(PolygonShape *shape) { (shape->*&PolygonAccess::updatePolygon)(); }
+    };
+
+    struct RotationAccess : ShapeBase {
+        using ShapeBase::applyRotation;
+    };
+
+    const ShapeFactory::TypeCode ALL_TYPES[] = {
+            ShapeFactory::Rect, ShapeFactory::Ellipse, ShapeFactory::Diamond, ShapeFactory::Pentagon,
+            ShapeFactory::Hexagon, ShapeFactory::Line, ShapeFactory::Arrow, ShapeFactory::Polyline, ShapeFactory::Curve
+    };
+    const QRectF SCENE_RECT(50, 50, 1900, 1700);       // 生成的图形都位于页面内，绘制时全部可见
+    const int SAMPLES = 5;                             // 每项测试的样本数，报告中位数和最小值
+
+    struct Result {
+        QString name;
+        int shapes;                                    // 文档中的图形数量，与规模无关的测试为0
+        qint64 iterations;                             // 每个样本执行的操作次数
+        double medianNs;                               // 单次操作耗时的中位数（纳秒）
+        double minNs;                                  // 单次操作耗时的最小值（纳秒）
+    };
+
+    class Runner {
+    public:
+        Runner(const QString &filter, double minTimeMs) : m_filter(filter), m_minTimeNs(minTimeMs * 1e6) {}
+
+        bool enabled(const QString &name) const { return m_filter.isEmpty() || name.contains(m_filter); }
+
+        // body执行一次计为ops次操作；先执行一次预热并估算耗时，再决定每个样本的执行次数
+        void run(const QString &name, int shapes, const std::function<void()> &body, qint64 ops = 1) {
+            if (!enabled(name)) return;
+
+            QElapsedTimer timer;
+            timer.start();
+            body();
+            const qint64 once = qMax<qint64>(1, timer.nsecsElapsed());
+            const qint64 calls = qMax<qint64>(1, static_cast<qint64>(m_minTimeNs / SAMPLES) / once);
+
+            std::vector<double> samples;
+            for (int s = 0; s < SAMPLES; ++s) {
+                timer.restart();
+                for (qint64 i = 0; i < calls; ++i) {
+                    body();
+                }
+                samples.push_back(static_cast<double>(timer.nsecsElapsed()) / (calls * ops));
+            }
+            std::sort(samples.begin(), samples.end());
+
+            m_results.push_back({name, shapes, calls * ops, samples[SAMPLES / 2], samples.front()});
+            std::fprintf(stderr, "%-44s %8d %16.1f ns\n", qPrintable(name), shapes, samples[SAMPLES / 2]);
+        }
+
+        const std::vector<Result> &results() const { return m_results; }
+
+    private:
+        QString m_filter;
+        double m_minTimeNs;
+        std::vector<Result> m_results;
+    };
+
+    ShapeBase *createSample(ShapeFactory::TypeCode code, const QPointF &pos) {
+        if (ShapeFactory::isLineType(code)) {
+            return ShapeFactory::createDefaultShape(ShapeFactory::typeName(code), pos);   // 折线和曲线带默认中间点
+        }
+        ShapeBase *shape = ShapeFactory::createShape(code, QRectF(pos, QSizeF(120, 80)));
+        shape->setRotation(30);
+        return shape;
+    }
+
+    // 随机散布在页面内的图形（与stress_gen使用同一个生成器），种子固定为图形数量，同一规模每次生成的文档相同
+    std::vector<ShapeBase *> generateDocument(int count) {
+        BenchDocument::Options options;
+        options.count = count;
+        options.seed = static_cast<quint32>(count);
+        options.area = SCENE_RECT;
+        QSize pageSize;
+        return BenchDocument::generate(options, pageSize);
+    }
+
+    void deleteShapes(std::vector<ShapeBase *> &shapes) {
+        for (auto shape: shapes) {
+            delete shape;
+        }
+        shapes.clear();
+    }
+
+    // 每种图形在外接矩形周围均匀取点做命中测试
+    void benchContainPoint(Runner &runner) {
+        for (ShapeFactory::TypeCode code: ALL_TYPES) {
+            const QString name = "containPoint/" + ShapeFactory::typeName(code);
+            if (!runner.enabled(name)) continue;
+
+            ShapeBase *shape = createSample(code, QPointF(100, 100));
+            const QRectF area = shape->boundingRect().adjusted(-20, -20, 20, 20);
+            std::vector<QPointF> points;
+            for (int i = 0; i < 16; ++i) {
+                for (int j = 0; j < 16; ++j) {
+                    points.emplace_back(area.left() + area.width() * i / 15, area.top() + area.height() * j / 15);
+                }
+            }
+
+            volatile int hits = 0;
+            runner.run(name, 0, [shape, &points, &hits]() {
+                for (const QPointF &point: points) {
+                    if (shape->containPoint(point)) hits = hits + 1;
+                }
+            }, static_cast<qint64>(points.size()));
+            delete shape;
+        }
+    }
+
+    void benchGeometry(Runner &runner) {
+        ShapeBase *ellipse = ShapeFactory::createShape(ShapeFactory::Ellipse, QRectF(100, 100, 120, 80));
+        ellipse->setRotation(30);
+        runner.run("EllipseShape::updatePolygon", 0, [ellipse]() {
+            PolygonAccess::rebuild(static_cast<PolygonShape *>(ellipse));
+        });
+
+        const QVector<QPointF> points = ellipse->outline();
+        const QPointF center = ellipse->boundingRect().center();
+        runner.run(QString("ShapeBase::applyRotation/%1pt").arg(points.size()), 0, [&points, center]() {
+            QVector<QPointF> rotated = RotationAccess::applyRotation(center, points, 30);
+            Q_UNUSED(rotated);
+        });
+        delete ellipse;
+    }
+
+    void benchSvg(Runner &runner, int count, std::vector<ShapeBase *> &shapes) {
+        runner.run("SvgDocument::save", count, [&shapes]() {
+            QBuffer buffer;
+            buffer.open(QIODevice::WriteOnly);
+            SvgDocument::save(buffer, shapes, Qt::white, QSize(2000, 1800));
+        });
+
+        if (!runner.enabled("SvgDocument::load")) return;
+        QByteArray data;
+        {
+            QBuffer buffer(&data);
+            buffer.open(QIODevice::WriteOnly);
+            SvgDocument::save(buffer, shapes, Qt::white, QSize(2000, 1800));
+        }
+        runner.run("SvgDocument::load", count, [&data]() {
+            QBuffer buffer(&data);
+            buffer.open(QIODevice::ReadOnly);
+            DocumentContent content;
+            SvgDocument::load(buffer, content);
+        });
+    }
+
+    // 撤销快照和离屏绘制通过DrawArea的公开接口测量：撤销和重做各执行一次createCurrentState和restoreState
+    bool benchDrawArea(Runner &runner, int count, std::vector<ShapeBase *> &shapes) {
+        const QString stateName = "DrawArea::createCurrentState+restoreState";
+        const QString paintName = "DrawArea::paintEvent";
+        if (!runner.enabled(stateName) && !runner.enabled(paintName)) return true;
+
+        QTemporaryDir dir;
+        const QString path = dir.filePath("bench.svg");
+        if (!SvgDocument::save(path, shapes, Qt::white, QSize(2000, 1800))) {
+            std::fprintf(stderr, "cannot write %d shapes\n", count);
+            return false;
+        }
+
+        DrawArea area;
+        if (!area.loadFromSvg(path)) {
+            std::fprintf(stderr, "cannot load %d shapes\n", count);
+            return false;
+        }
+        area.setPageSize(SCENE_RECT.size().toSize());
+        area.resize(2000, 1800);                       // 视口覆盖整个场景，绘制全部图形
+
+        // 把最上层的图形拖动一小段距离，产生一个撤销状态（单击不会保存撤销状态）
+        const QPointF from = area.mapFromScene(area.getAllShapes().back()->boundingRect().center());
+        const QPointF to = from + QPointF(10, 10);
+        area.setMoveCoalescingEnabled(false);          // 移动立即处理，不需要等待合并计时器
+        QMouseEvent press(QEvent::MouseButtonPress, from, Qt::LeftButton, Qt::LeftButton, Qt::NoModifier);
+        QMouseEvent move(QEvent::MouseMove, to, Qt::NoButton, Qt::LeftButton, Qt::NoModifier);
+        QMouseEvent release(QEvent::MouseButtonRelease, to, Qt::LeftButton, Qt::NoButton, Qt::NoModifier);
+        QApplication::sendEvent(area.viewport(), &press);
+        QApplication::sendEvent(area.viewport(), &move);
+        QApplication::sendEvent(area.viewport(), &release);
+        if (!area.canUndo()) {
+            std::fprintf(stderr, "no undo state for %d shapes\n", count);
+            return false;
+        }
+
+        runner.run(stateName, count, [&area]() {
+            area.undo();
+            area.redo();
+        }, 2);
+
+        QImage image(area.size(), QImage::Format_ARGB32_Premultiplied);
+        runner.run(paintName, count, [&area, &image]() {
+            area.render(&image);
+        });
+        return true;
+    }
+
+    QString toCsv(const std::vector<Result> &results) {
+        QString csv = "name,shapes,iterations,median_ns,min_ns\n";
+        for (const Result &result: results) {
+            csv += QString("%1,%2,%3,%4,%5\n").arg(result.name).arg(result.shapes).arg(result.iterations)
+                    .arg(result.medianNs, 0, 'f', 1).arg(result.minNs, 0, 'f', 1);
+        }
+        return csv;
+    }
+
+    QString toJson(const std::vector<Result> &results, double minTimeMs) {
+        QJsonArray array;
+        for (const Result &result: results) {
+            QJsonObject object;
+            object["name"] = result.name;
+            object["shapes"] = result.shapes;
+            object["iterations"] = result.iterations;
+            object["median_ns"] = result.medianNs;
+            object["min_ns"] = result.minNs;
+            array.append(object);
+        }
+        QJsonObject root;
+        root["qt_version"] = QString(qVersion());
+        root["threads"] = QThread::idealThreadCount();
+        root["samples"] = SAMPLES;
+        root["min_time_ms"] = minTimeMs;
+        root["results"] = array;
+        return QString::fromUtf8(QJsonDocument(root).toJson(QJsonDocument::Indented));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    useOffscreenPlatform();
+    QApplication app(argc, argv);
+
+    std::vector<int> sizes;
+    QString filter;
+    QString format = "json";
+    QString outputPath;
+    double minTimeMs = 500;
+    const QStringList args = app.arguments();
+    for (int i = 1; i + 1 < args.size(); ++i) {
+        if (args[i] == "--sizes") {
+            for (const QString &size: args[++i].split(',', QString::SkipEmptyParts)) {
+                if (size.toInt() > 0) sizes.push_back(size.toInt());
+            }
+        } else if (args[i] == "--filter") {
+            filter = args[++i];
+        } else if (args[i] == "--min-time") {
+            minTimeMs = qMax(1.0, args[++i].toDouble());
+        } else if (args[i] == "--format") {
+            format = args[++i];
+        } else if (args[i] == "--output") {
+            outputPath = args[++i];
+        }
+    }
+    if (sizes.empty()) {
+        sizes = {1000, 10000, 100000};
+    }
+
+    Runner runner(filter, minTimeMs);
+    benchContainPoint(runner);
+    benchGeometry(runner);
+    for (int count: sizes) {
+        std::vector<ShapeBase *> shapes = generateDocument(count);
+        benchSvg(runner, count, shapes);
+        const bool ok = benchDrawArea(runner, count, shapes);
+        deleteShapes(shapes);
+        if (!ok) return 1;
+    }
+
+    const QString report = format == "csv" ? toCsv(runner.results()) : toJson(runner.results(), minTimeMs);
+    if (outputPath.isEmpty()) {
+        std::fputs(report.toUtf8().constData(), stdout);
+    } else {
+        QFile file(outputPath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            std::fprintf(stderr, "cannot write %s\n", qPrintable(outputPath));
+            return 1;
+        }
+        file.write(report.toUtf8());
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+﻿// 压力测试文档生成器：用现有图形类生成大规模流程图，写成.svg/.svgz/.fcd文件，用于复现和比较大文档下的性能
+// 用法：stress_gen 输出文件 [--count N] [--mix Rect=4,Ellipse=2,...] [--density D] [--text 单词数]
+//                 [--rotation 比例] [--overlap 比例] [--orthogonal 比例] [--seed S]
+//   --count       图形总数（默认10000）
+//   --mix         各类图形的权重，线段类图形作为连线（默认Rect=4,Ellipse=2,Diamond=2,Pentagon=1,Hexagon=1,Line=2,Arrow=4）
+//   --density     连线两端绑定到图形磁力点的比例，0为全部自由连线，1为全部绑定（默认0.8）
+//   --text        图形文本的最大单词数，较大时生成多行长文本（默认12）
+//   --rotation    带旋转角度的图形比例（默认0.25）
+//   --overlap     与前一个图形重叠放置的图形比例（默认0.1）
+//   --orthogonal  使用正交走线的连线比例（默认0）
+//   --seed        随机数种子，参数相同时生成的文件完全相同（默认1）
+
+#include "BenchSupport.h"
+#include "SvgDocument.h"
+#include "NativeDocument.h"
+#include "LineBaseShape.h"
+#include <QGuiApplication>
+#include <QFileInfo>
+#include <QStringList>
+#include <cstdio>
+#include <vector>
+
+namespace {
+    struct Options {
+        QString outputPath;
+        BenchDocument::Options document;
+    };
+
+    bool parseArguments(const QStringList &args, Options &options) {
+        BenchDocument::Options &document = options.document;
+        BenchDocument::parseMix(BenchDocument::DEFAULT_MIX, document);
+        for (int i = 1; i < args.size(); ++i) {
+            const QString &arg = args[i];
+            if (!arg.startsWith("--")) {
+                options.outputPath = arg;
+                continue;
+            }
+            if (i + 1 >= args.size()) {
+                std::fprintf(stderr, "missing value for %s\n", qPrintable(arg));
+                return false;
+            }
+            const QString value = args[++i];
+            if (arg == "--count") {
+                document.count = qMax(0, value.toInt());
+            } else if (arg == "--mix") {
+                if (!BenchDocument::parseMix(value, document)) return false;
+            } else if (arg == "--density") {
+                document.density = qBound(0.0, value.toDouble(), 1.0);
+            } else if (arg == "--text") {
+                document.textWords = qMax(0, value.toInt());
+            } else if (arg == "--rotation") {
+                document.rotation = qBound(0.0, value.toDouble(), 1.0);
+            } else if (arg == "--overlap") {
+                document.overlap = qBound(0.0, value.toDouble(), 1.0);
+            } else if (arg == "--orthogonal") {
+                document.orthogonal = qBound(0.0, value.toDouble(), 1.0);
+            } else if (arg == "--seed") {
+                document.seed = value.toUInt();
+            } else {
+                std::fprintf(stderr, "unknown option %s\n", qPrintable(arg));
+                return false;
+            }
+        }
+        if (options.outputPath.isEmpty()) {
+            std::fprintf(stderr, "usage: stress_gen output.{svg,svgz,fcd} [--count N] [--mix Rect=4,...] "
+                                 "[--density D] [--text WORDS] [--rotation F] [--overlap F] [--orthogonal F] "
+                                 "[--seed S]\n");
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    useOffscreenPlatform();
+    QGuiApplication app(argc, argv);
+
+    Options options;
+    if (!parseArguments(app.arguments(), options)) {
+        return 2;
+    }
+
+    QSize pageSize;
+    std::vector<ShapeBase *> shapes = BenchDocument::generate(options.document, pageSize);
+
+    bool ok;
+    if (QFileInfo(options.outputPath).suffix().compare(NativeDocument::FILE_SUFFIX, Qt::CaseInsensitive) == 0) {
+        ok = NativeDocument::save(options.outputPath, shapes, Qt::white, pageSize);
+    } else {
+        ok = SvgDocument::save(options.outputPath, shapes, Qt::white, pageSize);    // .svgz自动压缩
+    }
+
+    int bound = 0;
+    for (auto shape: shapes) {
+        if (auto line = dynamic_cast<LineBaseShape *>(shape)) {
+            if (line->getEndPointBinding(0).targetShape) ++bound;
+        }
+        delete shape;
+    }
+    if (!ok) {
+        std::fprintf(stderr, "cannot write %s\n", qPrintable(options.outputPath));
+        return 1;
+    }
+    std::fprintf(stderr, "%s: %d shapes (%d bound connectors), page %dx%d, seed %u\n",
+                 qPrintable(options.outputPath), options.document.count, bound, pageSize.width(), pageSize.height(),
+                 options.document.seed);
+    return 0;
+}
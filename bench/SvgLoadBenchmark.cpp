@@ -0,0 +1,253 @@
+﻿// SVG读取性能对比：改动前的读取方式、单线程逐个构造 与 两阶段并行构造
+// 用法：svg_load_bench [图形数量...] [--repeat N]
+// 默认分别测试 10k、100k、1M 个图形的文件，每种方式取多次运行的最短时间
+// baseline列按改动前的格式写出同一文档，并用改动前DrawArea::loadFromSvg/deserializeFromXml的逻辑读取，加速比相对于它计算
+
+#include "BenchSupport.h"
+#include "SvgDocument.h"
+#include "RectShape.h"
+#include "EllipseShape.h"
+#include "DiamondShape.h"
+#include "PentagonShape.h"
+#include "HexagonShape.h"
+#include "LineShape.h"
+#include "ArrowShape.h"
+#include <QGuiApplication>
+#include <QTemporaryFile>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QThread>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <cstdio>
+#include <vector>
+
+namespace {
+    // 改动前DrawArea::saveToSvg/serializeToXml写出的格式：每个图形一个带全部属性的<shape>元素
+    void saveBaseline(QIODevice &device, const std::vector<ShapeBase *> &shapes, const QSize &pageSize) {
+        QXmlStreamWriter writer(&device);
+        writer.setAutoFormatting(true);
+        writer.writeStartDocument();
+        writer.writeStartElement("svg");
+        writer.writeAttribute("xmlns", "http://www.w3.org/2000/svg");
+        writer.writeAttribute("width", QString::number(pageSize.width()));
+        writer.writeAttribute("height", QString::number(pageSize.height()));
+        writer.writeAttribute("backgroundColor", QColor(Qt::white).name());
+        writer.writeStartElement("shapes");
+
+        for (auto shape: shapes) {
+            writer.writeStartElement("shape");
+            writer.writeAttribute("type", shape->getShapeType());
+            if (LineBaseShape *line = dynamic_cast<LineBaseShape *>(shape)) {
+                writer.writeAttribute("startX", QString::number(line->getStart().x()));
+                writer.writeAttribute("startY", QString::number(line->getStart().y()));
+                writer.writeAttribute("endX", QString::number(line->getEnd().x()));
+                writer.writeAttribute("endY", QString::number(line->getEnd().y()));
+            } else {
+                writer.writeAttribute("x", QString::number(shape->boundingRect().x()));
+                writer.writeAttribute("y", QString::number(shape->boundingRect().y()));
+                writer.writeAttribute("width", QString::number(shape->boundingRect().width()));
+                writer.writeAttribute("height", QString::number(shape->boundingRect().height()));
+                writer.writeAttribute("rotation", QString::number(shape->getRotation()));
+            }
+
+            writer.writeAttribute("penWidth", QString::number(shape->getPenWidth()));
+            writer.writeAttribute("borderColor", shape->getBorderColor().name());
+            writer.writeAttribute("fillColor", shape->getFillColor().name());
+            writer.writeAttribute("borderStyle", QString::number(shape->getBorderStyle()));
+
+            writer.writeAttribute("text", shape->getText());
+            writer.writeAttribute("fontFamily", shape->getFontFamily());
+            writer.writeAttribute("fontSize", QString::number(shape->getFontSize()));
+            writer.writeAttribute("fontBold", QString::number(shape->isFontBold()));
+            writer.writeAttribute("fontItalic", QString::number(shape->isFontItalic()));
+            writer.writeAttribute("fontUnderline", QString::number(shape->isFontUnderline()));
+            writer.writeAttribute("fontColor", shape->getFontColor().name());
+            writer.writeAttribute("textAlignment", QString::number(shape->getTextAlignment()));
+            writer.writeEndElement();
+        }
+        writer.writeEndElement();
+        writer.writeEndElement();
+        writer.writeEndDocument();
+    }
+
+    // 改动前的deserializeFromXml：按类型名逐个比较，每个属性都单独查找一次，只支持默认类型组合中的七种图形
+    ShapeBase *readBaselineShape(QXmlStreamReader &reader) {
+        QString type = reader.attributes().value("type").toString();
+        ShapeBase *shape = nullptr;
+
+        if (type == "Rect") {
+            shape = new RectShape(QRectF(
+                    reader.attributes().value("x").toDouble(),
+                    reader.attributes().value("y").toDouble(),
+                    reader.attributes().value("width").toDouble(),
+                    reader.attributes().value("height").toDouble()
+            ));
+        } else if (type == "Ellipse") {
+            shape = new EllipseShape(QRectF(
+                    reader.attributes().value("x").toDouble(),
+                    reader.attributes().value("y").toDouble(),
+                    reader.attributes().value("width").toDouble(),
+                    reader.attributes().value("height").toDouble()
+            ));
+        } else if (type == "Diamond") {
+            shape = new DiamondShape(QRectF(
+                    reader.attributes().value("x").toDouble(),
+                    reader.attributes().value("y").toDouble(),
+                    reader.attributes().value("width").toDouble(),
+                    reader.attributes().value("height").toDouble()
+            ));
+        } else if (type == "Pentagon") {
+            shape = new PentagonShape(QRectF(
+                    reader.attributes().value("x").toDouble(),
+                    reader.attributes().value("y").toDouble(),
+                    reader.attributes().value("width").toDouble(),
+                    reader.attributes().value("height").toDouble()
+            ));
+        } else if (type == "Hexagon") {
+            shape = new HexagonShape(QRectF(
+                    reader.attributes().value("x").toDouble(),
+                    reader.attributes().value("y").toDouble(),
+                    reader.attributes().value("width").toDouble(),
+                    reader.attributes().value("height").toDouble()
+            ));
+        } else if (type == "Line") {
+            shape = new LineShape(QPointF(
+                    reader.attributes().value("startX").toDouble(),
+                    reader.attributes().value("startY").toDouble()
+            ), QPointF(
+                    reader.attributes().value("endX").toDouble(),
+                    reader.attributes().value("endY").toDouble()
+            ));
+        } else if (type == "Arrow") {
+            shape = new ArrowShape(QPointF(
+                    reader.attributes().value("startX").toDouble(),
+                    reader.attributes().value("startY").toDouble()
+            ), QPointF(
+                    reader.attributes().value("endX").toDouble(),
+                    reader.attributes().value("endY").toDouble()
+            ));
+        }
+
+        if (shape) {
+            shape->setRotation(reader.attributes().value("rotation").toDouble());
+            shape->setPenWidth(reader.attributes().value("penWidth").toInt());
+            shape->setBorderColor(QColor(reader.attributes().value("borderColor").toString()));
+            shape->setFillColor(QColor(reader.attributes().value("fillColor").toString()));
+            shape->setBorderStyle(static_cast<Qt::PenStyle>(reader.attributes().value("borderStyle").toInt()));
+
+            shape->setText(reader.attributes().value("text").toString());
+            shape->setFontFamily(reader.attributes().value("fontFamily").toString());
+            shape->setFontSize(reader.attributes().value("fontSize").toInt());
+            shape->setFontBold(reader.attributes().value("fontBold").toInt());
+            shape->setFontItalic(reader.attributes().value("fontItalic").toInt());
+            shape->setFontUnderline(reader.attributes().value("fontUnderline").toInt());
+            shape->setFontColor(QColor(reader.attributes().value("fontColor").toString()));
+            shape->setTextAlignment(static_cast<Qt::Alignment>(reader.attributes().value("textAlignment").toInt()));
+        }
+        return shape;
+    }
+
+    // 改动前的loadFromSvg：在调用线程中边解析边构造，返回读取耗时（毫秒），失败返回-1
+    double timeBaselineLoad(QIODevice &device, size_t expected) {
+        device.seek(0);
+        std::vector<ShapeBase *> shapes;
+        QElapsedTimer timer;
+        timer.start();
+        QXmlStreamReader reader(&device);
+        bool ok = true;
+        while (ok && !reader.atEnd()) {
+            reader.readNext();
+            if (reader.isStartElement() && reader.name() == "shape") {
+                ShapeBase *shape = readBaselineShape(reader);
+                ok = shape != nullptr;
+                if (ok) shapes.push_back(shape);
+            }
+        }
+        ok = ok && !reader.hasError();
+        double ms = timer.nsecsElapsed() / 1e6;
+        const size_t loaded = shapes.size();
+        for (auto shape: shapes) delete shape;
+        return ok && loaded == expected ? ms : -1;
+    }
+
+    // 返回读取耗时（毫秒），失败返回-1
+    double timeLoad(QIODevice &device, SvgDocument::LoadStrategy strategy, size_t expected) {
+        device.seek(0);
+        DocumentContent content;
+        QElapsedTimer timer;
+        timer.start();
+        bool ok = SvgDocument::load(device, content, ProgressCallback(), strategy);
+        double ms = timer.nsecsElapsed() / 1e6;
+        return ok && content.shapes.size() == expected ? ms : -1;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    useOffscreenPlatform();
+    QGuiApplication app(argc, argv);
+
+    std::vector<int> counts;
+    int repeat = 3;
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        if (args[i] == "--repeat" && i + 1 < args.size()) {
+            repeat = qMax(1, args[++i].toInt());
+        } else if (args[i].toInt() > 0) {
+            counts.push_back(args[i].toInt());
+        }
+    }
+    if (counts.empty()) {
+        counts = {10000, 100000, 1000000};
+    }
+
+    std::printf("threads: %d, repeat: %d\n", QThread::idealThreadCount(), repeat);
+    std::printf("%10s %10s %14s %12s %14s %9s\n", "shapes", "file (MB)", "baseline (ms)", "serial (ms)",
+                "parallel (ms)", "speedup");
+
+    for (int count: counts) {
+        QTemporaryFile file;
+        QTemporaryFile baselineFile;
+        if (!file.open() || !baselineFile.open()) {
+            std::fprintf(stderr, "cannot create temporary file\n");
+            return 1;
+        }
+
+        {
+            // 所有图形都带旋转角度，保证读取时需要重新计算顶点
+            BenchDocument::Options options;
+            options.count = count;
+            options.rotation = 1.0;
+            QSize pageSize;
+            DocumentContent source;
+            source.shapes = BenchDocument::generate(options, pageSize);
+            if (!SvgDocument::save(file, source.shapes, Qt::white, pageSize)) {
+                std::fprintf(stderr, "cannot write %d shapes\n", count);
+                return 1;
+            }
+            file.flush();
+            saveBaseline(baselineFile, source.shapes, pageSize);
+            baselineFile.flush();
+        }
+
+        double baseline = -1;
+        double serial = -1;
+        double parallel = -1;
+        for (int r = 0; r < repeat; ++r) {
+            double b = timeBaselineLoad(baselineFile, count);
+            double s = timeLoad(file, SvgDocument::Serial, count);
+            double p = timeLoad(file, SvgDocument::Parallel, count);
+            if (b < 0 || s < 0 || p < 0) {
+                std::fprintf(stderr, "load failed for %d shapes\n", count);
+                return 1;
+            }
+            baseline = baseline < 0 ? b : qMin(baseline, b);
+            serial = serial < 0 ? s : qMin(serial, s);
+            parallel = parallel < 0 ? p : qMin(parallel, p);
+        }
+
+        std::printf("%10d %10.1f %14.1f %12.1f %14.1f %8.2fx\n", count, file.size() / (1024.0 * 1024.0),
+                    baseline, serial, parallel, baseline / parallel);
+    }
+    return 0;
+}
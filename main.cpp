@@ -1,4 +1,5 @@
 ﻿#include "MainWindow.h"
+#include "Tracer.h"
 #include <QApplication>
 #include <QTranslator>
 #include <QDir>
@@ -31,6 +32,8 @@ int main(int argc, char* argv[]) {
 
 	QApplication app(argc, argv);
 	QApplication::setFont(QFont("Microsoft YaHei", 10));
+	Tracer::startFromEnvironment();                              // FLOWCHART_TRACE=文件路径 时记录跟踪事件
+
 
 	QTranslator translator;
 	if (translator.load(getQmlPath()))
@@ -38,8 +41,13 @@ int main(int argc, char* argv[]) {
 		app.installTranslator(&translator);
 	}
 
-	MainWindow window;
-	window.show();
+	int result;
+	{
+		MainWindow window;
+		window.show();
+		result = app.exec();
+	}
 
-	return app.exec();
+	Tracer::stop();                                              // 窗口析构时的等待也记录在内
+	return result;
 }